@@ -25,6 +25,7 @@ namespace sass {
     public:
         std::string libref;
         std::string dataName;
+        ReadOptions options; // (keep= drop= firstobs= obs=)
 
         std::string getFullDsName()
         {
@@ -93,6 +94,8 @@ namespace sass {
     class VariableNode : public ASTNode {
     public:
         std::string varName;
+        // Slot of the variable in the schema of the row it was last read from
+        mutable SlotCache slot;
 
         // Constructor to initialize value
         explicit VariableNode(std::string varName) : varName(varName) {}
@@ -119,18 +122,26 @@ namespace sass {
         std::vector<DatasetRefNode> outDatasets;
     };
 
+    // Represents a CALL statement: call routine(arg1, arg2, ...);
+    class CallRoutineNode : public ASTNode {
+    public:
+        std::string routine;    // upper case
+        std::vector<std::unique_ptr<ASTNode>> arguments;
+    };
+
     // Represents an OPTIONS statement: options option1=value1 option2=value2;
     class OptionsNode : public ASTNode {
     public:
         std::vector<std::pair<std::string, std::string>> options;
     };
 
-    // Represents a LIBNAME statement: libname libref 'path';
+    // Represents a LIBNAME statement: libname libref <engine> 'path' <access=readonly>;
     class LibnameNode : public ASTNode {
     public:
         std::string libref;
+        std::string engine;
         std::string path;
-        LibraryAccess accessMode;
+        LibraryAccess accessMode = LibraryAccess::READWRITE;
     };
 
     // Represents a TITLE statement: title 'Your Title';
@@ -206,18 +217,18 @@ namespace sass {
     class EndDoNode : public ASTNode {};
 
     // Represents a PROC SORT step: proc sort data=<dataset>; by <variables>; run;
-    class ProcSortNode : public ASTNode {
+    class ProcSortNode : public ProcNode {
     public:
         DatasetRefNode inputDataSet;    // Dataset to sort (DATA=)
         DatasetRefNode outputDataSet;   // Output dataset (OUT=), can be empty
         std::vector<std::string> byVariables; // Variables to sort by
         std::unique_ptr<ASTNode> whereCondition; // Optional WHERE condition
-        bool nodupkey;               // Flag for NODUPKEY option
-        bool duplicates;             // Flag for DUPLICATES option
+        bool nodupkey = false;       // Flag for NODUPKEY option
+        bool duplicates = false;     // Flag for DUPLICATES option
     };
 
     // Represents the PROC MEANS procedure
-    class ProcMeansNode : public ASTNode {
+    class ProcMeansNode : public ProcNode {
     public:
         DatasetRefNode inputDataSet;                    // Dataset to analyze (DATA=)
         std::vector<std::string> statistics;         // Statistical options (N, MEAN, etc.)
@@ -227,6 +238,31 @@ namespace sass {
         std::unique_ptr<ASTNode> whereCondition; // Optional WHERE 
     };
 
+    // Represents the PROC UNIVARIATE procedure
+    class ProcUnivariateNode : public ProcNode {
+    public:
+        DatasetRefNode inputDataSet;                    // Dataset to analyze (DATA=)
+        std::unordered_map<std::string, std::string> options; // NOPRINT, NEXTROBS=
+        std::vector<std::string> varVariables;       // VAR statement, empty => all numeric variables
+        std::vector<std::string> histogramVariables; // HISTOGRAM statement, can be empty
+        bool histogram = false;                      // HISTOGRAM statement given
+        std::unordered_map<std::string, std::string> histogramOptions; // after the slash: NBINS=
+        DatasetRefNode outputDataSet;                   // OUTPUT OUT=, can be empty
+        // OUTPUT keywords in order, e.g. MEAN= avgx avgy, PCTLPTS= 33 66, PCTLPRE= px py
+        std::vector<std::pair<std::string, std::vector<std::string>>> outputStatistics;
+    };
+
+    // Represents the PROC RANK procedure
+    class ProcRankNode : public ProcNode {
+    public:
+        DatasetRefNode inputDataSet;                    // Dataset to rank (DATA=)
+        DatasetRefNode outputDataSet;                   // Output dataset (OUT=), empty => DATAn
+        std::unordered_map<std::string, std::string> options; // TIES=, GROUPS=, DESCENDING
+        std::vector<std::string> varVariables;       // VAR statement, empty => all numeric variables
+        std::vector<std::string> rankVariables;      // RANKS statement, empty => ranks replace the VAR values
+        std::vector<std::string> byVariables;        // BY statement
+    };
+
     // Represents an IF-ELSE statement: if <condition> then <statements> else <statements>;
     class IfElseNode : public ASTNode {
     public:
@@ -279,12 +315,12 @@ namespace sass {
     };
 
     // Represents the PROC FREQ procedure
-    class ProcFreqNode : public ASTNode {
+    class ProcFreqNode : public ProcNode {
     public:
         DatasetRefNode inputDataSet;                              // Dataset to analyze (DATA=)
         std::vector<std::pair<std::string, std::vector<std::string>>> tables; // Tables to generate, e.g., var1*var2
         std::unique_ptr<ASTNode> whereCondition;        // Optional WHERE condition
-        std::vector<std::string> options;                      // Options for the TABLES statement
+        std::vector<std::string> options;                      // Options of the PROC FREQ statement, e.g., NLEVELS
     };
 
     // Represents the PROC PRINT procedure
@@ -299,15 +335,26 @@ namespace sass {
     class SQLStatementNode : public ASTNode {};
 
     // Represents the PROC SQL procedure
-    class ProcSQLNode : public ASTNode {
+    class ProcSQLNode : public ProcNode {
     public:
+        std::unordered_map<std::string, std::string> options;      // OUTOBS=
         std::vector<std::unique_ptr<SQLStatementNode>> statements; // SQL statements within PROC SQL
     };
 
     // Represents a SELECT statement
+    // An aggregate function of a SELECT list or HAVING clause:
+    // COUNT(*), COUNT(x), COUNT(DISTINCT x), SUM, AVG, MIN, MAX
+    class SqlAggregateNode : public ASTNode {
+    public:
+        std::string function;                   // upper case, MEAN is AVG
+        bool distinct = false;
+        std::unique_ptr<ASTNode> argument;      // null for COUNT(*)
+    };
+
     class SelectStatementNode : public SQLStatementNode {
     public:
-        std::vector<std::string> selectColumns; // Columns to select
+        std::vector<std::string> selectColumns; // Names of the selected columns (alias or column name)
+        std::vector<std::unique_ptr<ASTNode>> selectExpressions; // What each of them is computed from
         std::vector<std::string> fromTables;    // Tables to select from
         std::unique_ptr<ASTNode> whereCondition; // Optional WHERE condition
         std::vector<std::string> groupByColumns; // Optional GROUP BY columns
@@ -315,14 +362,54 @@ namespace sass {
         std::vector<std::string> orderByColumns; // Optional ORDER BY columns
     };
 
-    // Represents a CREATE TABLE statement
+    // <operand> [NOT] IN (<subquery>) or [NOT] IN (<value>, ...) of a SQL condition
+    class SqlInNode : public ASTNode {
+    public:
+        std::unique_ptr<ASTNode> operand;
+        std::unique_ptr<SelectStatementNode> subquery;  // null for a list of values
+        std::vector<std::unique_ptr<ASTNode>> values;
+        bool negated = false;
+    };
+
+    // [NOT] EXISTS (<subquery>) of a SQL condition
+    class SqlExistsNode : public ASTNode {
+    public:
+        std::unique_ptr<SelectStatementNode> subquery;
+        bool negated = false;
+    };
+
+    // Represents a CREATE TABLE statement: CREATE TABLE x (columns) or CREATE TABLE x AS SELECT ...
     class CreateTableStatementNode : public SQLStatementNode {
     public:
-        std::string tableName; // Name of the table to create
+        std::string tableName; // Name of the table to create, LIBREF.TABLE
         std::vector<std::string> columns; // Columns and their definitions
+        std::unique_ptr<SelectStatementNode> asSelect; // the query filling it, or null
     };
 
-    // Additional SQL statement nodes (INSERT, UPDATE, DELETE) can be added similarly
+    // DELETE FROM x [WHERE ...]
+    class DeleteStatementNode : public SQLStatementNode {
+    public:
+        std::string tableName; // LIBREF.TABLE
+        std::unique_ptr<ASTNode> whereCondition; // null => every row
+    };
+
+    // UPDATE x SET column = expression, ... [WHERE ...]
+    class UpdateStatementNode : public SQLStatementNode {
+    public:
+        std::string tableName; // LIBREF.TABLE
+        std::vector<std::string> columns; // columns SET, in order
+        std::vector<std::unique_ptr<ASTNode>> values; // what each of them gets
+        std::unique_ptr<ASTNode> whereCondition; // null => every row
+    };
+
+    // INSERT INTO x [(columns)] VALUES (...) [VALUES (...)] ... or INSERT INTO x [(columns)] SELECT ...
+    class InsertStatementNode : public SQLStatementNode {
+    public:
+        std::string tableName; // LIBREF.TABLE
+        std::vector<std::string> columns; // empty => every column of the table, in order
+        std::vector<std::vector<std::unique_ptr<ASTNode>>> rows; // VALUES clauses
+        std::unique_ptr<SelectStatementNode> query; // or the query giving the rows
+    };
 
     class MacroVariableAssignmentNode : public ASTNode {
     public:
@@ -330,11 +417,17 @@ namespace sass {
         std::string value;
     };
 
+    // %PUT in open code
+    class MacroPutNode : public ASTNode {
+    public:
+        std::string text;
+    };
+
     class MacroDefinitionNode : public ASTNode {
     public:
         std::string macroName;
         std::vector<std::string> parameters;
-        std::vector<std::unique_ptr<ASTNode>> body;
+        std::string text;   // the body as written, compiled when the definition runs
     };
 
     class MacroCallNode : public ASTNode {
@@ -0,0 +1,932 @@
+#include "ArrowEngine.h"
+#include "MappedFile.h"
+#include "sasdoc.h"
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Arrow IPC file format, see https://arrow.apache.org/docs/format/Columnar.html
+//
+//   "ARROW1" <pad to 8>
+//   <schema message> <record batch message>... <end-of-stream marker>
+//   <footer flatbuffer> <int32 footer size> "ARROW1"
+//
+// Messages are encapsulated as 0xFFFFFFFF, int32 metadata size, a Message
+// flatbuffer and then the body holding the column buffers. We only need a
+// handful of flatbuffer tables, so they are encoded and decoded by hand
+// instead of pulling in the flatbuffers and arrow libraries.
+
+namespace sass {
+
+    namespace {
+
+        const char kMagic[] = "ARROW1";
+        const uint32_t kContinuation = 0xFFFFFFFF;
+        const int64_t kBufferAlignment = 64;
+
+        // Schema.fbs / Message.fbs enums
+        const int16_t kMetadataV5 = 4;
+        const uint8_t kHeaderSchema = 1;
+        const uint8_t kHeaderRecordBatch = 3;
+        const uint8_t kTypeInt = 2;
+        const uint8_t kTypeFloatingPoint = 3;
+        const uint8_t kTypeUtf8 = 5;
+        const uint8_t kTypeBool = 6;
+        const uint8_t kTypeLargeUtf8 = 20;
+        const int16_t kPrecisionSingle = 1;
+        const int16_t kPrecisionDouble = 2;
+
+        // Field metadata keys carrying what Arrow has no slot for
+        const char kLabelKey[] = "sas.label";
+        const char kFormatKey[] = "sas.format";
+        const char kLengthKey[] = "sas.length";
+
+        int64_t alignUp(int64_t n, int64_t alignment) {
+            return (n + alignment - 1) / alignment * alignment;
+        }
+
+        //-------------------------------------------------------------------
+        // Flatbuffer encoding
+        //-------------------------------------------------------------------
+
+        struct FbNode;
+        using FbNodePtr = std::shared_ptr<FbNode>;
+
+        struct FbField {
+            int slot;
+            int size;           // inline size; references take 4 bytes
+            uint64_t bits;      // little-endian scalar value
+            FbNodePtr ref;      // child table/vector/string for reference fields
+        };
+
+        struct FbNode {
+            enum Kind { TABLE, STRING, TABLE_VECTOR, STRUCT_VECTOR } kind = TABLE;
+            std::vector<FbField> fields;        // TABLE
+            std::string bytes;                  // STRING, STRUCT_VECTOR element data
+            std::vector<FbNodePtr> elements;    // TABLE_VECTOR
+            uint32_t count = 0;                 // STRUCT_VECTOR
+        };
+
+        FbNodePtr fbTable() {
+            return std::make_shared<FbNode>();
+        }
+
+        template <typename T>
+        void fbScalar(const FbNodePtr& table, int slot, T value) {
+            FbField f{ slot, (int)sizeof(T), 0, nullptr };
+            std::memcpy(&f.bits, &value, sizeof(T));
+            table->fields.push_back(f);
+        }
+
+        void fbRef(const FbNodePtr& table, int slot, FbNodePtr child) {
+            table->fields.push_back(FbField{ slot, 4, 0, std::move(child) });
+        }
+
+        FbNodePtr fbString(const std::string& s) {
+            auto n = std::make_shared<FbNode>();
+            n->kind = FbNode::STRING;
+            n->bytes = s;
+            return n;
+        }
+
+        FbNodePtr fbTables(std::vector<FbNodePtr> elements) {
+            auto n = std::make_shared<FbNode>();
+            n->kind = FbNode::TABLE_VECTOR;
+            n->elements = std::move(elements);
+            return n;
+        }
+
+        FbNodePtr fbStructs(const std::string& bytes, uint32_t count) {
+            auto n = std::make_shared<FbNode>();
+            n->kind = FbNode::STRUCT_VECTOR;
+            n->bytes = bytes;
+            n->count = count;
+            return n;
+        }
+
+        template <typename T>
+        void appendBytes(std::string& out, T value) {
+            out.append((const char*)&value, sizeof(T));
+        }
+
+        // Serializes top-down: a parent is laid out before its children, so
+        // every uoffset points forward as flatbuffers require. Scalars land on
+        // their natural alignment, which the Arrow readers verify.
+        class FbWriter {
+        public:
+            std::string finish(const FbNodePtr& root) {
+                buf.assign(4, '\0');
+                patch(0, write(root));
+                pad(8);
+                return buf;
+            }
+
+        private:
+            std::string buf;
+
+            void pad(size_t alignment) {
+                while (buf.size() % alignment) buf.push_back('\0');
+            }
+
+            void patch(size_t at, uint32_t value) {
+                std::memcpy(&buf[at], &value, 4);
+            }
+
+            void patchRef(size_t at, uint32_t target) {
+                patch(at, target - (uint32_t)at);
+            }
+
+            uint32_t write(const FbNodePtr& n) {
+                switch (n->kind) {
+                case FbNode::STRING: {
+                    pad(4);
+                    uint32_t pos = (uint32_t)buf.size();
+                    appendBytes(buf, (uint32_t)n->bytes.size());
+                    buf += n->bytes;
+                    buf.push_back('\0');
+                    return pos;
+                }
+                case FbNode::STRUCT_VECTOR: {
+                    // all our structs hold int64s: element data 8-aligned
+                    while ((buf.size() + 4) % 8) buf.push_back('\0');
+                    uint32_t pos = (uint32_t)buf.size();
+                    appendBytes(buf, n->count);
+                    buf += n->bytes;
+                    return pos;
+                }
+                case FbNode::TABLE_VECTOR: {
+                    pad(4);
+                    uint32_t pos = (uint32_t)buf.size();
+                    appendBytes(buf, (uint32_t)n->elements.size());
+                    size_t slots = buf.size();
+                    buf.resize(slots + 4 * n->elements.size(), '\0');
+                    for (size_t i = 0; i < n->elements.size(); i++) {
+                        patchRef(slots + 4 * i, write(n->elements[i]));
+                    }
+                    return pos;
+                }
+                default:
+                    return writeTable(*n);
+                }
+            }
+
+            uint32_t writeTable(const FbNode& t) {
+                int numSlots = 0;
+                for (auto& f : t.fields) numSlots = std::max(numSlots, f.slot + 1);
+
+                // largest fields first so each one is naturally aligned
+                std::vector<size_t> order(t.fields.size());
+                for (size_t i = 0; i < order.size(); i++) order[i] = i;
+                std::stable_sort(order.begin(), order.end(),
+                    [&](size_t a, size_t b) { return t.fields[a].size > t.fields[b].size; });
+
+                std::vector<uint16_t> slotOffsets(numSlots, 0);
+                std::vector<uint32_t> fieldOffsets(t.fields.size(), 0);
+                uint32_t cursor = 4; // soffset to the vtable
+                for (size_t i : order) {
+                    cursor = (uint32_t)alignUp(cursor, t.fields[i].size);
+                    fieldOffsets[i] = cursor;
+                    slotOffsets[t.fields[i].slot] = (uint16_t)cursor;
+                    cursor += t.fields[i].size;
+                }
+
+                pad(2);
+                uint32_t vtable = (uint32_t)buf.size();
+                appendBytes(buf, (uint16_t)(4 + 2 * numSlots));
+                appendBytes(buf, (uint16_t)cursor);
+                for (auto off : slotOffsets) appendBytes(buf, off);
+
+                pad(8);
+                uint32_t table = (uint32_t)buf.size();
+                buf.resize(table + cursor, '\0');
+                int32_t soffset = (int32_t)(table - vtable);
+                std::memcpy(&buf[table], &soffset, 4);
+                for (size_t i = 0; i < t.fields.size(); i++) {
+                    if (!t.fields[i].ref) {
+                        std::memcpy(&buf[table + fieldOffsets[i]], &t.fields[i].bits, t.fields[i].size);
+                    }
+                }
+                for (size_t i = 0; i < t.fields.size(); i++) {
+                    if (t.fields[i].ref) {
+                        patchRef(table + fieldOffsets[i], write(t.fields[i].ref));
+                    }
+                }
+                return table;
+            }
+        };
+
+        //-------------------------------------------------------------------
+        // Flatbuffer decoding, straight out of the mapped file
+        //-------------------------------------------------------------------
+
+        struct FbVector {
+            size_t start = 0;   // first element
+            uint32_t length = 0;
+        };
+
+        class FbTable {
+        public:
+            FbTable(const uint8_t* base, size_t size, size_t pos) : base(base), size(size), pos(pos) {}
+
+            static FbTable root(const uint8_t* base, size_t size) {
+                FbTable t(base, size, 0);
+                t.pos = t.read<uint32_t>(0);
+                return t;
+            }
+
+            template <typename T>
+            T read(size_t at) const {
+                if (at + sizeof(T) > size) {
+                    throw std::runtime_error("corrupt Arrow metadata");
+                }
+                T v;
+                std::memcpy(&v, base + at, sizeof(T));
+                return v;
+            }
+
+            bool has(int slot) const { return fieldOffset(slot) != 0; }
+
+            template <typename T>
+            T scalar(int slot, T defaultValue) const {
+                uint16_t off = fieldOffset(slot);
+                return off ? read<T>(pos + off) : defaultValue;
+            }
+
+            FbTable table(int slot) const {
+                size_t at = deref(slot);
+                if (!at) throw std::runtime_error("missing table in Arrow metadata");
+                return FbTable(base, size, at);
+            }
+
+            std::string string(int slot) const {
+                size_t at = deref(slot);
+                if (!at) return "";
+                uint32_t len = read<uint32_t>(at);
+                if (at + 4 + len > size) throw std::runtime_error("corrupt Arrow metadata");
+                return std::string((const char*)base + at + 4, len);
+            }
+
+            FbVector vector(int slot) const {
+                FbVector v;
+                size_t at = deref(slot);
+                if (at) {
+                    v.length = read<uint32_t>(at);
+                    v.start = at + 4;
+                }
+                return v;
+            }
+
+            FbTable element(const FbVector& v, uint32_t i) const {
+                size_t at = v.start + 4 * (size_t)i;
+                return FbTable(base, size, at + read<uint32_t>(at));
+            }
+
+        private:
+            const uint8_t* base;
+            size_t size;
+            size_t pos;
+
+            uint16_t fieldOffset(int slot) const {
+                size_t vtable = pos - read<int32_t>(pos);
+                uint16_t vtableSize = read<uint16_t>(vtable);
+                if ((size_t)(4 + 2 * slot + 2) > vtableSize) return 0;
+                return read<uint16_t>(vtable + 4 + 2 * slot);
+            }
+
+            size_t deref(int slot) const {
+                uint16_t off = fieldOffset(slot);
+                if (!off) return 0;
+                size_t at = pos + off;
+                return at + read<uint32_t>(at);
+            }
+        };
+
+        //-------------------------------------------------------------------
+        // Writing
+        //-------------------------------------------------------------------
+
+        bool isMissing(const Cell& cell) {
+            if (auto d = std::get_if<double>(&cell)) {
+                return std::isnan(*d) || std::isinf(*d);
+            }
+            return false;
+        }
+
+        FbNodePtr keyValue(const std::string& key, const std::string& value) {
+            auto kv = fbTable();
+            fbRef(kv, 0, fbString(key));
+            fbRef(kv, 1, fbString(value));
+            return kv;
+        }
+
+        FbNodePtr buildSchema(SasDoc* doc, const std::vector<bool>& largeStrings) {
+            std::vector<FbNodePtr> fields;
+            for (int c = 0; c < doc->var_count; c++) {
+                bool isString = doc->var_types[c] == READSTAT_TYPE_STRING;
+                auto field = fbTable();
+                fbRef(field, 0, fbString(doc->var_names[c]));
+                fbScalar<uint8_t>(field, 1, 1); // nullable
+                auto type = fbTable();
+                if (isString) {
+                    fbScalar<uint8_t>(field, 2, largeStrings[c] ? kTypeLargeUtf8 : kTypeUtf8);
+                }
+                else {
+                    fbScalar<uint8_t>(field, 2, kTypeFloatingPoint);
+                    fbScalar<int16_t>(type, 0, kPrecisionDouble);
+                }
+                fbRef(field, 3, type);
+                fbRef(field, 5, fbTables({})); // readers insist on a children vector
+
+                std::vector<FbNodePtr> metadata;
+                if (c < (int)doc->var_labels.size() && !doc->var_labels[c].empty()) {
+                    metadata.push_back(keyValue(kLabelKey, doc->var_labels[c]));
+                }
+                if (c < (int)doc->var_formats.size() && !doc->var_formats[c].empty()) {
+                    metadata.push_back(keyValue(kFormatKey, doc->var_formats[c]));
+                }
+                if (isString && c < (int)doc->var_length.size()) {
+                    metadata.push_back(keyValue(kLengthKey, std::to_string(doc->var_length[c])));
+                }
+                if (!metadata.empty()) {
+                    fbRef(field, 6, fbTables(metadata));
+                }
+                fields.push_back(field);
+            }
+            auto schema = fbTable();
+            fbScalar<int16_t>(schema, 0, 0); // little endian
+            fbRef(schema, 1, fbTables(fields));
+            return schema;
+        }
+
+        FbNodePtr buildMessage(uint8_t headerType, FbNodePtr header, int64_t bodyLength) {
+            auto message = fbTable();
+            fbScalar<int16_t>(message, 0, kMetadataV5);
+            fbScalar<uint8_t>(message, 1, headerType);
+            fbRef(message, 2, header);
+            fbScalar<int64_t>(message, 3, bodyLength);
+            return message;
+        }
+
+        // Block struct of the footer: offset, metadata length, body length
+        struct Block {
+            int64_t offset;
+            int32_t metaDataLength;
+            int64_t bodyLength;
+        };
+
+        Block writeMessage(std::ofstream& out, const FbNodePtr& message, int64_t bodyLength) {
+            std::string metadata = FbWriter().finish(message);
+            Block block;
+            block.offset = (int64_t)out.tellp();
+            // pad the metadata so the body, and thus every buffer, is aligned in the file
+            while ((block.offset + 8 + metadata.size()) % kBufferAlignment) metadata.push_back('\0');
+            block.metaDataLength = (int32_t)(8 + metadata.size());
+            block.bodyLength = bodyLength;
+            int32_t len = (int32_t)metadata.size();
+            out.write((const char*)&kContinuation, 4);
+            out.write((const char*)&len, 4);
+            out.write(metadata.data(), metadata.size());
+            return block;
+        }
+
+        void writePadding(std::ofstream& out, int64_t written) {
+            static const char zeros[kBufferAlignment] = {};
+            int64_t padded = alignUp(written, kBufferAlignment);
+            out.write(zeros, padded - written);
+        }
+
+        //-------------------------------------------------------------------
+        // Reading
+        //-------------------------------------------------------------------
+
+        enum class ColumnKind { FLOAT64, FLOAT32, INT, BOOL, UTF8, LARGE_UTF8 };
+
+        struct ColumnSpec {
+            ColumnKind kind;
+            int bitWidth = 0;
+            bool isSigned = true;
+            int docColumn = -1;     // -1 => not selected
+            int declaredLength = 0; // from sas.length metadata
+            std::string name;
+        };
+
+        struct BufferRef {
+            const uint8_t* data;
+            int64_t length;
+        };
+
+        bool validAt(const BufferRef& validity, int64_t i) {
+            return validity.length == 0 || (validity.data[i >> 3] >> (i & 7)) & 1;
+        }
+
+        template <typename T>
+        void decodeNumbers(const BufferRef& validity, const BufferRef& values, int64_t from, int64_t to,
+            Cell* out, size_t stride) {
+            const T* v = (const T*)values.data;
+            for (int64_t i = from; i < to; i++, out += stride) {
+                double d = validAt(validity, i) ? (double)v[i] : NAN;
+                *out = std::isnan(d) ? -INFINITY : d;
+            }
+        }
+
+        template <typename Offset>
+        int decodeStrings(const BufferRef& validity, const BufferRef& offsets, const BufferRef& data,
+            int64_t from, int64_t to, Cell* out, size_t stride) {
+            const Offset* o = (const Offset*)offsets.data;
+            int maxLength = 0;
+            for (int64_t i = from; i < to; i++, out += stride) {
+                if (!validAt(validity, i)) {
+                    *out = flyweight_string("");
+                    continue;
+                }
+                int64_t begin = o[i], end = o[i + 1];
+                if (begin < 0 || end < begin || end > data.length) {
+                    throw std::runtime_error("corrupt utf8 offsets");
+                }
+                *out = flyweight_string(std::string((const char*)data.data + begin, (size_t)(end - begin)));
+                maxLength = std::max(maxLength, (int)(end - begin));
+            }
+            return maxLength;
+        }
+
+        int readFile(const std::string& filePath, SasDoc* doc, const ReadOptions& options) {
+            MappedFile file;
+            if (!file.open(filePath)) {
+                std::cerr << "[ARROW] Cannot open " << filePath << std::endl;
+                return 1;
+            }
+            const uint8_t* p = file.data();
+            size_t size = file.size();
+            if (size < 8 + 4 + 6 || std::memcmp(p, kMagic, 6) != 0 || std::memcmp(p + size - 6, kMagic, 6) != 0) {
+                std::cerr << "[ARROW] Not an Arrow IPC file: " << filePath << std::endl;
+                return 1;
+            }
+
+            int32_t footerLength;
+            std::memcpy(&footerLength, p + size - 10, 4);
+            if (footerLength <= 0 || (size_t)footerLength > size - 10 - 8) {
+                throw std::runtime_error("bad footer length");
+            }
+            FbTable footer = FbTable::root(p + size - 10 - footerLength, footerLength);
+            FbTable schema = footer.table(1);
+
+            // Schema => doc variables
+            FbVector fields = schema.vector(1);
+            std::vector<ColumnSpec> specs;
+            for (uint32_t i = 0; i < fields.length; i++) {
+                FbTable field = schema.element(fields, i);
+                std::string name = field.string(0);
+                if (field.has(4)) {
+                    throw std::runtime_error("dictionary encoded column " + name + " is not supported");
+                }
+
+                ColumnSpec spec;
+                spec.name = name;
+                uint8_t typeId = field.scalar<uint8_t>(2, 0);
+                FbTable type = field.table(3);
+                switch (typeId) {
+                case kTypeFloatingPoint: {
+                    int16_t precision = type.scalar<int16_t>(0, 0);
+                    if (precision == kPrecisionDouble) spec.kind = ColumnKind::FLOAT64;
+                    else if (precision == kPrecisionSingle) spec.kind = ColumnKind::FLOAT32;
+                    else throw std::runtime_error("half float column " + name + " is not supported");
+                    break;
+                }
+                case kTypeInt:
+                    spec.kind = ColumnKind::INT;
+                    spec.bitWidth = type.scalar<int32_t>(0, 0);
+                    spec.isSigned = type.scalar<uint8_t>(1, 0) != 0;
+                    if (spec.bitWidth != 8 && spec.bitWidth != 16 && spec.bitWidth != 32 && spec.bitWidth != 64) {
+                        throw std::runtime_error("bad integer width for column " + name);
+                    }
+                    break;
+                case kTypeBool:
+                    spec.kind = ColumnKind::BOOL;
+                    break;
+                case kTypeUtf8:
+                    spec.kind = ColumnKind::UTF8;
+                    break;
+                case kTypeLargeUtf8:
+                    spec.kind = ColumnKind::LARGE_UTF8;
+                    break;
+                default:
+                    throw std::runtime_error("column " + name + " has an unsupported Arrow type (" + std::to_string(typeId) + ")");
+                }
+
+                std::string label, format;
+                FbVector metadata = field.vector(6);
+                for (uint32_t m = 0; m < metadata.length; m++) {
+                    FbTable kv = field.element(metadata, m);
+                    std::string key = kv.string(0);
+                    if (key == kLabelKey) label = kv.string(1);
+                    else if (key == kFormatKey) format = kv.string(1);
+                    else if (key == kLengthKey) spec.declaredLength = std::atoi(kv.string(1).c_str());
+                }
+
+                if (options.selects(name)) {
+                    bool isString = spec.kind == ColumnKind::UTF8 || spec.kind == ColumnKind::LARGE_UTF8;
+                    spec.docColumn = doc->var_count++;
+                    doc->var_names.push_back(name);
+                    doc->var_labels.push_back(label);
+                    doc->var_formats.push_back(format);
+                    doc->var_types.push_back(isString ? READSTAT_TYPE_STRING : READSTAT_TYPE_DOUBLE);
+                    doc->var_length.push_back(isString ? spec.declaredLength : 8);
+                    doc->var_display_length.push_back(0);
+                    doc->var_decimals.push_back(0);
+                }
+                specs.push_back(spec);
+            }
+
+            // Record batch messages
+            struct Batch {
+                FbTable recordBatch;
+                const uint8_t* body;
+                int64_t bodyLength;
+                int64_t rows;
+            };
+            std::vector<Batch> batches;
+            int64_t totalRows = 0;
+            FbVector blocks = footer.vector(3);
+            for (uint32_t b = 0; b < blocks.length; b++) {
+                size_t at = blocks.start + 24 * (size_t)b;
+                int64_t offset = footer.read<int64_t>(at);
+                int32_t metaDataLength = footer.read<int32_t>(at + 8);
+                int64_t bodyLength = footer.read<int64_t>(at + 16);
+                if (offset < 0 || metaDataLength < 8 || (size_t)(offset + metaDataLength + bodyLength) > size) {
+                    throw std::runtime_error("record batch outside the file");
+                }
+
+                // pre-0.15 files have no continuation marker
+                uint32_t first;
+                std::memcpy(&first, p + offset, 4);
+                size_t prefix = first == kContinuation ? 8 : 4;
+                FbTable message = FbTable::root(p + offset + prefix, metaDataLength - prefix);
+                if (message.scalar<uint8_t>(1, 0) != kHeaderRecordBatch) {
+                    throw std::runtime_error("footer block is not a record batch");
+                }
+                FbTable recordBatch = message.table(2);
+                if (recordBatch.has(3)) {
+                    throw std::runtime_error("compressed record batches are not supported");
+                }
+                int64_t rows = recordBatch.scalar<int64_t>(0, 0);
+                batches.push_back(Batch{ recordBatch, p + offset + metaDataLength, bodyLength, rows });
+                totalRows += rows;
+            }
+
+            // FIRSTOBS=/OBS= as a global row window [first, last)
+            int64_t first = std::max(1L, options.firstObs) - 1;
+            int64_t last = options.obs >= 0 ? std::min<int64_t>(options.obs, totalRows) : totalRows;
+            first = std::min(first, last);
+            size_t stride = doc->var_count;
+
+            // The buffers of every column of a record batch, in schema order
+            struct ColumnBuffers {
+                BufferRef validity, values, data;
+            };
+            auto columnBuffers = [&](const Batch& batch) {
+                FbVector nodes = batch.recordBatch.vector(1);
+                FbVector buffers = batch.recordBatch.vector(2);
+                uint32_t nextBuffer = 0;
+                auto nextBufferRef = [&]() {
+                    if (nextBuffer >= buffers.length) throw std::runtime_error("missing column buffer");
+                    size_t at = buffers.start + 16 * (size_t)nextBuffer++;
+                    int64_t offset = batch.recordBatch.read<int64_t>(at);
+                    int64_t length = batch.recordBatch.read<int64_t>(at + 8);
+                    if (offset < 0 || length < 0 || offset + length > batch.bodyLength) {
+                        throw std::runtime_error("column buffer outside the record batch");
+                    }
+                    return BufferRef{ batch.body + offset, length };
+                };
+                if (nodes.length < specs.size()) {
+                    throw std::runtime_error("record batch does not match the schema");
+                }
+                std::vector<ColumnBuffers> columns(specs.size());
+                for (size_t c = 0; c < specs.size(); c++) {
+                    int64_t nullCount = batch.recordBatch.read<int64_t>(nodes.start + 16 * c + 8);
+                    columns[c].validity = nextBufferRef();
+                    if (nullCount == 0) columns[c].validity.length = 0;
+                    else if (columns[c].validity.length * 8 < batch.rows) throw std::runtime_error("short validity bitmap");
+                    columns[c].values = nextBufferRef();
+                    bool isString = specs[c].kind == ColumnKind::UTF8 || specs[c].kind == ColumnKind::LARGE_UTF8;
+                    columns[c].data = isString ? nextBufferRef() : BufferRef{ nullptr, 0 };
+                }
+                return columns;
+            };
+
+            // Rows [from, to) of column c of a batch => out, out + stride, ...
+            std::vector<int> maxLengths(specs.size(), 0);
+            auto decodeColumn = [&](size_t c, const Batch& batch, const ColumnBuffers& b,
+                int64_t from, int64_t to, Cell* out, size_t outStride) {
+                const ColumnSpec& spec = specs[c];
+                bool isString = spec.kind == ColumnKind::UTF8 || spec.kind == ColumnKind::LARGE_UTF8;
+                int64_t width = spec.kind == ColumnKind::FLOAT64 ? 8 : spec.kind == ColumnKind::FLOAT32 ? 4
+                    : spec.kind == ColumnKind::INT ? spec.bitWidth / 8 : spec.kind == ColumnKind::LARGE_UTF8 ? 8 : 4;
+                int64_t needed = spec.kind == ColumnKind::BOOL ? (batch.rows + 7) / 8
+                    : isString ? (batch.rows + 1) * width : batch.rows * width;
+                if (b.values.length < needed) {
+                    throw std::runtime_error("short value buffer for column " + spec.name);
+                }
+
+                switch (spec.kind) {
+                case ColumnKind::FLOAT64:
+                    decodeNumbers<double>(b.validity, b.values, from, to, out, outStride);
+                    break;
+                case ColumnKind::FLOAT32:
+                    decodeNumbers<float>(b.validity, b.values, from, to, out, outStride);
+                    break;
+                case ColumnKind::INT:
+                    switch (spec.bitWidth * (spec.isSigned ? 1 : -1)) {
+                    case 8: decodeNumbers<int8_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case 16: decodeNumbers<int16_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case 32: decodeNumbers<int32_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case 64: decodeNumbers<int64_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case -8: decodeNumbers<uint8_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case -16: decodeNumbers<uint16_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case -32: decodeNumbers<uint32_t>(b.validity, b.values, from, to, out, outStride); break;
+                    case -64: decodeNumbers<uint64_t>(b.validity, b.values, from, to, out, outStride); break;
+                    }
+                    break;
+                case ColumnKind::BOOL:
+                    for (int64_t i = from; i < to; i++, out += outStride) {
+                        *out = validAt(b.validity, i) ? (double)((b.values.data[i >> 3] >> (i & 7)) & 1) : -INFINITY;
+                    }
+                    break;
+                case ColumnKind::UTF8:
+                    maxLengths[c] = std::max(maxLengths[c], decodeStrings<int32_t>(b.validity, b.values, b.data, from, to, out, outStride));
+                    break;
+                case ColumnKind::LARGE_UTF8:
+                    maxLengths[c] = std::max(maxLengths[c], decodeStrings<int64_t>(b.validity, b.values, b.data, from, to, out, outStride));
+                    break;
+                }
+            };
+
+            // SAMPLE=: pick the rows of the window before any column is decoded,
+            // with SAMPLEKEY= only the key column is decoded for that
+            std::vector<int64_t> kept;
+            bool sampled = options.isSampled();
+            if (sampled) {
+                RowSampler sampler(options, last - first);
+                int keyColumn = -1;
+                if (sampler.byKey()) {
+                    for (size_t c = 0; c < specs.size(); c++) {
+                        if (boost::iequals(specs[c].name, options.sampleKey)) keyColumn = (int)c;
+                    }
+                }
+                if (keyColumn >= 0) {
+                    std::vector<Cell> keys((size_t)(last - first));
+                    int64_t rowBase = 0;
+                    for (auto& batch : batches) {
+                        int64_t from = std::max<int64_t>(first - rowBase, 0);
+                        int64_t to = std::min<int64_t>(last - rowBase, batch.rows);
+                        if (from < to) {
+                            auto columns = columnBuffers(batch);
+                            decodeColumn(keyColumn, batch, columns[keyColumn], from, to, keys.data() + (rowBase + from - first), 1);
+                        }
+                        rowBase += batch.rows;
+                    }
+                    for (int64_t r = 0; r < last - first; r++) {
+                        bool keep = std::holds_alternative<double>(keys[r])
+                            ? sampler.keepsKey(std::get<double>(keys[r]))
+                            : sampler.keepsKey(std::string_view(std::get<flyweight_string>(keys[r]).get()));
+                        if (keep) kept.push_back(first + r);
+                    }
+                }
+                else {
+                    // no such column: rows are drawn one by one
+                    for (int64_t r = 0; r < last - first; r++) {
+                        if (sampler.keepsRow(r)) kept.push_back(first + r);
+                    }
+                }
+            }
+            int64_t outRows = sampled ? (int64_t)kept.size() : last - first;
+            doc->values.assign((size_t)outRows * stride, Cell());
+
+            int64_t rowBase = 0;
+            size_t nextKept = 0;
+            for (auto& batch : batches) {
+                int64_t from = std::max<int64_t>(first - rowBase, 0);
+                int64_t to = std::min<int64_t>(last - rowBase, batch.rows);
+                if (from >= to) {
+                    rowBase += batch.rows;
+                    continue;
+                }
+
+                auto columns = columnBuffers(batch);
+                // runs [row, row + length) of kept rows in this batch, written to outRow on
+                struct Run {
+                    int64_t row, length, outRow;
+                };
+                std::vector<Run> runs;
+                if (!sampled) {
+                    runs.push_back({ from, to - from, rowBase + from - first });
+                }
+                else {
+                    while (nextKept < kept.size() && kept[nextKept] < rowBase + to) {
+                        int64_t row = kept[nextKept] - rowBase;
+                        if (!runs.empty() && runs.back().row + runs.back().length == row) runs.back().length++;
+                        else runs.push_back({ row, 1, (int64_t)nextKept });
+                        nextKept++;
+                    }
+                }
+
+                for (size_t c = 0; c < specs.size(); c++) {
+                    if (specs[c].docColumn < 0) {
+                        continue; // projected out: buffers are never touched
+                    }
+                    for (auto& run : runs) {
+                        Cell* out = doc->values.mutate().data() + (size_t)run.outRow * stride + specs[c].docColumn;
+                        decodeColumn(c, batch, columns[c], run.row, run.row + run.length, out, stride);
+                    }
+                }
+                rowBase += batch.rows;
+            }
+
+            // Files from other producers carry no sas.length
+            for (size_t c = 0; c < specs.size(); c++) {
+                int col = specs[c].docColumn;
+                if (col >= 0 && doc->var_types[col] == READSTAT_TYPE_STRING && doc->var_length[col] <= 0) {
+                    doc->var_length[col] = std::max(1, maxLengths[c]);
+                }
+            }
+
+            doc->obs_count = (int)outRows;
+            doc->var_flag.resize(doc->var_count, true);
+            doc->obs_flag.resize(doc->obs_count, true);
+            doc->or_flag.resize(doc->obs_count, false);
+            doc->obs_library_filter.resize(doc->obs_count, true);
+            return 0;
+        }
+    }
+
+    int ArrowEngine::read(const std::string& filePath, SasDoc* doc, const ReadOptions& options) const {
+        doc->obs_count = 0;
+        doc->var_count = 0;
+        doc->var_names.clear();
+        doc->var_labels.clear();
+        doc->var_formats.clear();
+        doc->var_types.clear();
+        doc->var_length.clear();
+        doc->var_display_length.clear();
+        doc->var_decimals.clear();
+        doc->values.clear();
+
+        try {
+            return readFile(filePath, doc, options);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "[ARROW] Error reading " << filePath << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    int ArrowEngine::write(const std::string& filePath, SasDoc* doc) const {
+        std::ofstream out(filePath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[ARROW] Cannot create " << filePath << std::endl;
+            return 1;
+        }
+
+        const int64_t rows = doc->obs_count;
+        const int cols = doc->var_count;
+        const Cell* cells = doc->values.cdata();
+
+        // First pass: null counts and string sizes fix the body layout
+        std::vector<int64_t> nullCounts(cols, 0), dataBytes(cols, 0);
+        std::vector<bool> largeStrings(cols, false);
+        for (int c = 0; c < cols; c++) {
+            bool isString = doc->var_types[c] == READSTAT_TYPE_STRING;
+            for (int64_t r = 0; r < rows; r++) {
+                const Cell& cell = cells[r * cols + c];
+                if (isString) {
+                    if (auto s = std::get_if<flyweight_string>(&cell)) dataBytes[c] += s->get().size();
+                }
+                else if (isMissing(cell)) {
+                    nullCounts[c]++;
+                }
+            }
+            largeStrings[c] = dataBytes[c] > INT32_MAX;
+        }
+
+        std::string nodes, buffers;
+        int64_t bodyLength = 0;
+        auto addBuffer = [&](int64_t length) {
+            appendBytes(buffers, bodyLength);
+            appendBytes(buffers, length);
+            bodyLength += alignUp(length, kBufferAlignment);
+        };
+        for (int c = 0; c < cols; c++) {
+            appendBytes(nodes, rows);
+            appendBytes(nodes, nullCounts[c]);
+            addBuffer(nullCounts[c] ? (rows + 7) / 8 : 0);
+            if (doc->var_types[c] == READSTAT_TYPE_STRING) {
+                addBuffer((rows + 1) * (largeStrings[c] ? 8 : 4));
+                addBuffer(dataBytes[c]);
+            }
+            else {
+                addBuffer(rows * 8);
+            }
+        }
+
+        out.write("ARROW1\0\0", 8);
+        writeMessage(out, buildMessage(kHeaderSchema, buildSchema(doc, largeStrings), 0), 0);
+
+        auto recordBatch = fbTable();
+        fbScalar<int64_t>(recordBatch, 0, rows);
+        fbRef(recordBatch, 1, fbStructs(nodes, (uint32_t)cols));
+        fbRef(recordBatch, 2, fbStructs(buffers, (uint32_t)(buffers.size() / 16)));
+        Block block = writeMessage(out, buildMessage(kHeaderRecordBatch, recordBatch, bodyLength), bodyLength);
+
+        // Body: each column gathered out of the row-major cells in chunks
+        const int64_t chunk = 8192;
+        std::vector<double> numbers;
+        std::vector<int64_t> offsets;
+        for (int c = 0; c < cols; c++) {
+            if (nullCounts[c]) {
+                std::vector<uint8_t> validity((rows + 7) / 8, 0);
+                for (int64_t r = 0; r < rows; r++) {
+                    if (!isMissing(cells[r * cols + c])) validity[r >> 3] |= (uint8_t)(1 << (r & 7));
+                }
+                out.write((const char*)validity.data(), validity.size());
+                writePadding(out, validity.size());
+            }
+
+            if (doc->var_types[c] == READSTAT_TYPE_STRING) {
+                int64_t offset = 0;
+                int width = largeStrings[c] ? 8 : 4;
+                for (int64_t r0 = 0; r0 <= rows; r0 += chunk) {
+                    int64_t r1 = std::min(rows + 1, r0 + chunk);
+                    offsets.clear();
+                    for (int64_t r = r0; r < r1; r++) {
+                        offsets.push_back(offset);
+                        if (r < rows) {
+                            if (auto s = std::get_if<flyweight_string>(&cells[r * cols + c])) offset += s->get().size();
+                        }
+                    }
+                    if (width == 8) {
+                        out.write((const char*)offsets.data(), offsets.size() * 8);
+                    }
+                    else {
+                        for (int64_t o : offsets) {
+                            int32_t o32 = (int32_t)o;
+                            out.write((const char*)&o32, 4);
+                        }
+                    }
+                }
+                writePadding(out, (rows + 1) * width);
+                for (int64_t r = 0; r < rows; r++) {
+                    if (auto s = std::get_if<flyweight_string>(&cells[r * cols + c])) {
+                        out.write(s->get().data(), s->get().size());
+                    }
+                }
+                writePadding(out, dataBytes[c]);
+            }
+            else {
+                for (int64_t r0 = 0; r0 < rows; r0 += chunk) {
+                    int64_t r1 = std::min(rows, r0 + chunk);
+                    numbers.clear();
+                    for (int64_t r = r0; r < r1; r++) {
+                        const Cell& cell = cells[r * cols + c];
+                        auto d = std::get_if<double>(&cell);
+                        numbers.push_back(d && !isMissing(cell) ? *d : NAN);
+                    }
+                    out.write((const char*)numbers.data(), numbers.size() * sizeof(double));
+                }
+                writePadding(out, rows * 8);
+            }
+        }
+
+        // End-of-stream marker, then the footer for random access
+        int32_t zero = 0;
+        out.write((const char*)&kContinuation, 4);
+        out.write((const char*)&zero, 4);
+
+        std::string blockBytes;
+        appendBytes(blockBytes, block.offset);
+        appendBytes(blockBytes, block.metaDataLength);
+        appendBytes(blockBytes, zero); // struct padding
+        appendBytes(blockBytes, block.bodyLength);
+
+        auto footer = fbTable();
+        fbScalar<int16_t>(footer, 0, kMetadataV5);
+        fbRef(footer, 1, buildSchema(doc, largeStrings));
+        fbRef(footer, 2, fbStructs("", 0));
+        fbRef(footer, 3, fbStructs(blockBytes, 1));
+        std::string footerBytes = FbWriter().finish(footer);
+        int32_t footerLength = (int32_t)footerBytes.size();
+        out.write(footerBytes.data(), footerBytes.size());
+        out.write((const char*)&footerLength, 4);
+        out.write(kMagic, 6);
+
+        out.close();
+        if (!out) {
+            std::cerr << "[ARROW] Error writing " << filePath << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+}
@@ -0,0 +1,26 @@
+#ifndef ARROWENGINE_H
+#define ARROWENGINE_H
+
+#include "LibraryEngine.h"
+
+namespace sass {
+
+    // ARROW engine: members are Arrow IPC files (Feather v2), e.g.
+    //   libname a arrow 'c:\exchange';
+    //   data a.class; set sashelp.class; run;
+    // Numeric variables are written as float64 columns (missing => null),
+    // character variables as utf8 columns. Buffers are 64-byte aligned so
+    // pyarrow/arrow R can memory map the file without deserializing it.
+    // Labels, formats and char lengths travel as field metadata.
+    class ArrowEngine : public LibraryEngine {
+    public:
+        std::string getName() const override { return "ARROW"; }
+        std::vector<std::string> getExtensions() const override { return { ".arrow", ".feather" }; }
+
+        int read(const std::string& filePath, SasDoc* doc, const ReadOptions& options) const override;
+        int write(const std::string& filePath, SasDoc* doc) const override;
+    };
+
+}
+
+#endif // ARROWENGINE_H
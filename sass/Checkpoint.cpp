@@ -0,0 +1,241 @@
+#include "Checkpoint.h"
+#include "ProgramCache.h"
+#include "LibraryEngine.h"
+#include "utility.h"
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace sass {
+
+    namespace {
+        // Values go on one line, tab separated
+        std::string escape(const std::string& s) {
+            std::string out;
+            out.reserve(s.size());
+            for (char c : s) {
+                switch (c) {
+                case '\\': out += "\\\\"; break;
+                case '\t': out += "\\t"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                default: out += c;
+                }
+            }
+            return out;
+        }
+
+        std::string unescape(const std::string& s) {
+            std::string out;
+            out.reserve(s.size());
+            for (size_t i = 0; i < s.size(); i++) {
+                if (s[i] != '\\' || i + 1 == s.size()) {
+                    out += s[i];
+                    continue;
+                }
+                char c = s[++i];
+                out += c == 't' ? '\t' : c == 'n' ? '\n' : c == 'r' ? '\r' : c;
+            }
+            return out;
+        }
+
+        std::vector<std::string> splitFields(const std::string& line) {
+            std::vector<std::string> fields;
+            size_t start = 0;
+            while (true) {
+                size_t tab = line.find('\t', start);
+                fields.push_back(unescape(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start)));
+                if (tab == std::string::npos) break;
+                start = tab + 1;
+            }
+            return fields;
+        }
+
+        // A spilled dataset does not change while it is on disk, its file stamp will do
+        std::string spillStamp(const std::string& path) {
+            std::error_code ec;
+            auto modified = fs::last_write_time(path, ec);
+            if (ec) return "";
+            auto size = fs::file_size(path, ec);
+            if (ec) return "";
+            return "spill:" + std::to_string((long long)modified.time_since_epoch().count()) + ":" + std::to_string(size);
+        }
+    }
+
+    Checkpoint::Checkpoint(const std::string& folder, const std::string& source)
+        : folder(folder), programKey(ProgramCache::key(source))
+    {
+    }
+
+    std::string Checkpoint::statePath() const {
+        return (fs::path(folder) / "state").string();
+    }
+
+    size_t Checkpoint::restore(DataEnvironment& env, std::unordered_map<std::string, std::string>& macroVariables) {
+        std::ifstream in(statePath(), std::ios::binary);
+        std::string line;
+        if (!in || !std::getline(in, line) || line != version) {
+            return 0;
+        }
+
+        size_t next = 0;
+        std::string program, title;
+        std::vector<std::vector<std::string>> options, macros, libnames, datasets;
+        while (std::getline(in, line)) {
+            auto fields = splitFields(line);
+            const std::string& kind = fields[0];
+            if (kind == "program" && fields.size() == 2) program = fields[1];
+            else if (kind == "next" && fields.size() == 2) next = std::stoull(fields[1]);
+            else if (kind == "title" && fields.size() == 2) title = fields[1];
+            else if (kind == "option" && fields.size() == 3) options.push_back(fields);
+            else if (kind == "macro" && fields.size() == 3) macros.push_back(fields);
+            else if (kind == "libname" && fields.size() == 5) libnames.push_back(fields);
+            else if (kind == "dataset" && fields.size() == 4) datasets.push_back(fields);
+            else throw std::runtime_error("Checkpoint " + statePath() + " is damaged.");
+        }
+        // another program, or one that was changed since
+        if (program != programKey) {
+            return 0;
+        }
+        for (auto& ds : datasets) {
+            if (!fs::exists(fs::path(folder) / ds[3])) {
+                throw std::runtime_error("Checkpoint " + folder + " lacks the data of WORK." + ds[1] + ".");
+            }
+        }
+
+        env.setTitle(title);
+        for (auto& opt : options) {
+            env.setOption(opt[1], opt[2]);
+            if (opt[1] == "MEMSIZE") {
+                env.memory.setLimit(MemoryManager::parseMemSize(opt[2]));
+            }
+        }
+        for (auto& macro : macros) {
+            macroVariables[macro[1]] = macro[2];
+        }
+        for (auto& lib : libnames) {
+            if (env.defineLibrary(lib[1], lib[2], (LibraryAccess)std::stoi(lib[3]), lib[4]) != 0) {
+                throw std::runtime_error("Library " + lib[1] + " (" + lib[2] + ") of the checkpoint cannot be assigned.");
+            }
+        }
+
+        auto work = env.getLibrary("WORK");
+        auto arrow = LibraryEngine::create("ARROW");
+        saved.clear();
+        for (auto& ds : datasets) {
+            auto doc = std::make_shared<SasDoc>();
+            if (arrow->read((fs::path(folder) / ds[3]).string(), doc.get(), ReadOptions()) != 0) {
+                throw std::runtime_error("Cannot read WORK." + ds[1] + " from checkpoint " + folder + ".");
+            }
+            doc->name = ds[1];
+            work->addDataset(ds[1], doc);
+            // read back as it was saved, not written again until it changes
+            saved[ds[1]] = { doc->contentHash(), ds[3] };
+        }
+        return next;
+    }
+
+    void Checkpoint::save(DataEnvironment& env, const std::unordered_map<std::string, std::string>& macroVariables, size_t next) {
+        fs::create_directories(folder);
+        auto work = env.getLibrary("WORK");
+        auto arrow = LibraryEngine::create("ARROW");
+
+        // WORK datasets first: the state must not refer to files that are not complete
+        std::map<std::string, SavedDataset> current;
+        for (auto& name : work->listDatasets()) {
+            auto doc = std::dynamic_pointer_cast<SasDoc>(work->getDataset(name));
+            if (!doc) continue;
+            std::string hash = doc->contentHash();
+            auto it = saved.find(name);
+            if (it != saved.end() && it->second.hash == hash) {
+                current[name] = it->second;
+                continue;
+            }
+            std::string file = to_lower(name) + "." + hash.substr(0, 16) + ".arrow";
+            if (arrow->write((fs::path(folder) / file).string(), doc.get()) != 0) {
+                throw std::runtime_error("Cannot write WORK." + name + " to checkpoint " + folder + ".");
+            }
+            current[name] = { hash, file };
+        }
+        for (auto& name : work->listSpilled()) {
+            std::string spillFile = work->getSpillFile(name);
+            std::string hash = spillStamp(spillFile);
+            if (hash.empty()) continue;
+            auto it = saved.find(name);
+            if (it != saved.end() && it->second.hash == hash) {
+                current[name] = it->second;
+                continue;
+            }
+            std::string file = to_lower(name) + "." + Fnv1a().add(hash).hex() + ".arrow";
+            std::error_code ec;
+            fs::copy_file(spillFile, fs::path(folder) / file, fs::copy_options::overwrite_existing, ec);
+            if (ec) {
+                throw std::runtime_error("Cannot copy WORK." + name + " to checkpoint " + folder + ": " + ec.message());
+            }
+            current[name] = { hash, file };
+        }
+
+        // sorted, so a checkpoint of the same state reads the same
+        std::map<std::string, std::string> options(env.options.begin(), env.options.end());
+        std::map<std::string, std::string> macros(macroVariables.begin(), macroVariables.end());
+        std::map<std::string, std::shared_ptr<Library>> libraries;
+        for (auto& kv : env.getLibraries()) libraries.insert(kv);
+
+        std::string tmpPath = statePath() + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            out << version << "\n";
+            out << "program\t" << programKey << "\n";
+            out << "next\t" << next << "\n";
+            out << "title\t" << escape(env.title) << "\n";
+            for (auto& kv : options) {
+                out << "option\t" << escape(kv.first) << "\t" << escape(kv.second) << "\n";
+            }
+            for (auto& kv : macros) {
+                out << "macro\t" << escape(kv.first) << "\t" << escape(kv.second) << "\n";
+            }
+            for (auto& kv : libraries) {
+                // WORK is the new session's own
+                if (kv.first == "WORK") continue;
+                auto& lib = kv.second;
+                out << "libname\t" << escape(kv.first) << "\t" << escape(lib->getPath()) << "\t"
+                    << (int)lib->getAccessMode() << "\t" << escape(lib->getEngine()->getName()) << "\n";
+            }
+            for (auto& kv : current) {
+                out << "dataset\t" << escape(kv.first) << "\t" << kv.second.hash << "\t" << escape(kv.second.file) << "\n";
+            }
+            if (!out) {
+                throw std::runtime_error("Cannot write checkpoint " + tmpPath + ".");
+            }
+        }
+        std::error_code ec;
+        fs::rename(tmpPath, statePath(), ec);
+        if (ec) {
+            throw std::runtime_error("Cannot write checkpoint " + statePath() + ": " + ec.message());
+        }
+
+        // files of datasets that changed or went away
+        for (auto& kv : saved) {
+            auto it = current.find(kv.first);
+            if (it == current.end() || it->second.file != kv.second.file) {
+                fs::remove(fs::path(folder) / kv.second.file, ec);
+            }
+        }
+        saved = std::move(current);
+    }
+
+    void Checkpoint::clear() {
+        std::error_code ec;
+        fs::remove(statePath(), ec);
+        for (auto& kv : saved) {
+            fs::remove(fs::path(folder) / kv.second.file, ec);
+        }
+        saved.clear();
+        // only removed when nothing else is in it
+        fs::remove(folder, ec);
+    }
+
+}
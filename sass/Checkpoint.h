@@ -0,0 +1,57 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include "DataEnvironment.h"
+
+namespace sass {
+
+    // Step-level checkpoints of a batch program (sass -checkpoint / -restart).
+    //
+    // After every top-level statement that ran through, the session is saved
+    // in folder: WORK datasets (as Arrow files), macro variables, options,
+    // the title and the librefs, plus the index of the next statement. When
+    // the program fails, -restart restores that state and carries on with
+    // the statement after the last one that succeeded, instead of running
+    // the whole program again.
+    //
+    // folder/state holds the text part; a WORK dataset is only written again
+    // when its content changed since the previous checkpoint. A checkpoint
+    // belongs to one program text, another program does not restart from it.
+    class Checkpoint {
+    public:
+        static constexpr const char* version = "sass-checkpoint-1";
+
+        Checkpoint(const std::string& folder, const std::string& source);
+
+        const std::string& getFolder() const { return folder; }
+
+        // Restore the session from the last checkpoint of this program and
+        // return the index of the statement to continue with, 0 when there
+        // is nothing to restart from.
+        size_t restore(DataEnvironment& env, std::unordered_map<std::string, std::string>& macroVariables);
+
+        // Save the session, statements before next have run. Throws std::runtime_error when it cannot be written.
+        void save(DataEnvironment& env, const std::unordered_map<std::string, std::string>& macroVariables, size_t next);
+
+        // The program ran to the end: nothing to restart from
+        void clear();
+
+    private:
+        std::string folder;
+        std::string programKey;
+        // WORK dataset => content hash and file of its last checkpoint
+        struct SavedDataset {
+            std::string hash;
+            std::string file;
+        };
+        std::map<std::string, SavedDataset> saved;
+
+        std::string statePath() const;
+    };
+
+}
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,116 @@
+#ifndef COWVECTOR_H
+#define COWVECTOR_H
+
+#include <vector>
+#include <memory>
+#include <initializer_list>
+#include <cstddef>
+
+namespace sass {
+
+    // Reference-counted, copy-on-write vector used for dataset storage
+    // (Dataset::rows, SasDoc::values). Copying or assigning shares the
+    // buffer; the first mutation of a shared buffer makes a private copy.
+    //
+    // Element access and iteration are read only, even on a non-const
+    // CowVector, so reading the rows of a dataset never copies them. Use
+    // mutate() to modify the elements in place:
+    //   doc->values.mutate()[i] = cell;
+    //   std::sort(ds->rows.mutate().begin(), ds->rows.mutate().end(), ...);
+    template <typename T>
+    class CowVector {
+    public:
+        using value_type = T;
+        using size_type = size_t;
+        using const_iterator = typename std::vector<T>::const_iterator;
+        using iterator = const_iterator;
+
+        CowVector() : buffer(std::make_shared<std::vector<T>>()) {}
+        CowVector(std::initializer_list<T> init) : buffer(std::make_shared<std::vector<T>>(init)) {}
+        CowVector(std::vector<T> v) : buffer(std::make_shared<std::vector<T>>(std::move(v))) {}
+
+        // Copies share the buffer
+        CowVector(const CowVector&) = default;
+        CowVector& operator=(const CowVector&) = default;
+        // A moved-from CowVector is left empty, not null
+        CowVector(CowVector&& other) noexcept : buffer(std::move(other.buffer)) {
+            other.buffer = std::make_shared<std::vector<T>>();
+        }
+        CowVector& operator=(CowVector&& other) noexcept {
+            if (this != &other) {
+                buffer = std::move(other.buffer);
+                other.buffer = std::make_shared<std::vector<T>>();
+            }
+            return *this;
+        }
+        CowVector& operator=(std::initializer_list<T> init) {
+            buffer = std::make_shared<std::vector<T>>(init);
+            return *this;
+        }
+
+        // Read access
+        size_t size() const { return buffer->size(); }
+        bool empty() const { return buffer->empty(); }
+        size_t capacity() const { return buffer->capacity(); }
+        const T& operator[](size_t i) const { return (*buffer)[i]; }
+        const T& at(size_t i) const { return buffer->at(i); }
+        const T& front() const { return buffer->front(); }
+        const T& back() const { return buffer->back(); }
+        const T* data() const { return buffer->data(); }
+        const T* cdata() const { return buffer->data(); }
+        const_iterator begin() const { return buffer->cbegin(); }
+        const_iterator end() const { return buffer->cend(); }
+        const_iterator cbegin() const { return buffer->cbegin(); }
+        const_iterator cend() const { return buffer->cend(); }
+        const std::vector<T>& get() const { return *buffer; }
+
+        // Write access: detaches from other owners first
+        std::vector<T>& mutate() { return *detach(); }
+
+        void push_back(const T& v) { detach()->push_back(v); }
+        void push_back(T&& v) { detach()->push_back(std::move(v)); }
+        template <typename... Args>
+        T& emplace_back(Args&&... args) { return detach()->emplace_back(std::forward<Args>(args)...); }
+        void pop_back() { detach()->pop_back(); }
+        void resize(size_t n) { detach()->resize(n); }
+        void resize(size_t n, const T& v) { detach()->resize(n, v); }
+        void reserve(size_t n) { detach()->reserve(n); }
+        void assign(size_t n, const T& v) { replace()->assign(n, v); }
+        void erase(const_iterator first, const_iterator last) {
+            auto offset = first - begin(), count = last - first;
+            auto& v = *detach();
+            v.erase(v.begin() + offset, v.begin() + offset + count);
+        }
+        // Dropping the contents never needs to copy them
+        void clear() {
+            if (buffer.use_count() == 1) buffer->clear();
+            else buffer = std::make_shared<std::vector<T>>();
+        }
+        void swap(CowVector& other) noexcept { buffer.swap(other.buffer); }
+
+        // Number of CowVectors sharing this buffer (for memory accounting)
+        long useCount() const { return buffer.use_count(); }
+        bool sharesWith(const CowVector& other) const { return buffer == other.buffer; }
+
+    private:
+        std::shared_ptr<std::vector<T>> buffer;
+
+        std::vector<T>* detach() {
+            if (buffer.use_count() != 1) {
+                buffer = std::make_shared<std::vector<T>>(*buffer);
+            }
+            return buffer.get();
+        }
+
+        // For writes that overwrite everything: no need to copy the old contents
+        std::vector<T>* replace() {
+            if (buffer.use_count() != 1) {
+                buffer = std::make_shared<std::vector<T>>();
+            }
+            return buffer.get();
+        }
+    };
+
+}
+
+#endif // COWVECTOR_H
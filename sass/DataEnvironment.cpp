@@ -5,20 +5,26 @@
 #include "TempUtils.h"
 #include "utility.h"
 #include <filesystem>
+#include <algorithm>
+#include <cmath>
 #include "AST.h"
 
 using namespace std;
 namespace fs = std::filesystem;
 
 namespace sass {
-    DataEnvironment::DataEnvironment()
-        : workCreated(false)
+    DataEnvironment::DataEnvironment(std::shared_ptr<LibraryRegistry> registry)
+        : registry(registry), workCreated(false)
     {
         // create a subfolder in system temp
         this->workFolder = createUniqueTempFolder();
         // define a library named "WORK" with read/write access
         defineLibrary("WORK", workFolder, LibraryAccess::READWRITE);
         workCreated = true;
+
+        memory.setSpillHandler([this](size_t bytesNeeded) {
+            return spillColdDatasets(bytesNeeded);
+        });
     }
 
     DataEnvironment::~DataEnvironment() {
@@ -30,12 +36,19 @@ namespace sass {
     }
 
 
-    int DataEnvironment::defineLibrary(const std::string& libref, const std::string& path, LibraryAccess access) {
+    int DataEnvironment::defineLibrary(const std::string& libref, const std::string& path, LibraryAccess access, const std::string& engine) {
         // create or update library
+        auto libEngine = LibraryEngine::create(engine);
+        if (!libEngine) {
+            return 2;
+        }
 
         if (fs::exists(path))
         {
-            auto lib = std::make_shared<Library>(libref, path, access);
+            // WORK belongs to this session, other libraries are shared when there is a registry
+            auto lib = registry && libref != "WORK"
+                ? registry->acquire(libref, path, access, engine)
+                : std::make_shared<Library>(libref, path, access, libEngine);
             libraries[libref] = lib;
             return 0;
         }
@@ -66,15 +79,11 @@ namespace sass {
 
     void DataEnvironment::saveSas7bdat(const std::string& dsName, const std::string& filepath) {
         string libname = getLibname(dsName);
+        size_t dotPos = dsName.find('.');
+        string member = dotPos == string::npos ? dsName : dsName.substr(dotPos + 1);
         auto library = getLibrary(libname);
         if (library) {
-            auto ds1 = library->getDataset(dsName);
-            if (ds1)
-            {
-                auto ds = (SasDoc*)(ds1.get());
-                wstring path(filepath.begin(), filepath.end());
-                SasDoc::write_sas7bdat(path, ds);
-            }
+            library->writeDataset(member, filepath);
         }
     }
 
@@ -102,8 +111,9 @@ namespace sass {
         // 3) Get the folder (path) from the library
         std::string folderPath = libraryObj->getPath();
 
-        // 4) Construct a final file path, e.g. "C:/temp/a.sas7bdat" or "/tmp/a.sas7bdat"
-        std::string filePath = (fs::path(folderPath) / fs::path(ds + ".sas7bdat")).string();
+        // 4) Construct a final file path, e.g. "C:/temp/a.sas7bdat" or "/tmp/a.sas7bdat",
+        //    the extension depends on the library engine
+        std::string filePath = libraryObj->getEngine()->memberPath(folderPath, ds);
 
         // 5) Call the existing function
         //    void saveSas7bdat(const std::string& dsName, const std::string& filepath);
@@ -126,11 +136,147 @@ namespace sass {
             defineLibrary(lib, "/some/path", LibraryAccess::READWRITE);
             library = getLibrary(lib);
         }
+        // A subset is not the member: it is read for this step only
+        ReadOptions options = readOptions(ds.options);
+        if (!options.isDefault()) {
+            if (auto doc = library->readDataset(dsName, options)) {
+                return doc;
+            }
+        }
         // Now get or create the dataset in that library
         auto rc = loadDataset(lib, dsName);
         return library->getOrCreateDataset(dsName);
     }
 
+    std::shared_ptr<Dataset> DataEnvironment::getOrCreateOutputDataset(DatasetRefNode& ds) {
+        if (ds.options.firstObs > 1 || ds.options.obs >= 0) {
+            throw std::runtime_error("FIRSTOBS= and OBS= are not valid for the output data set " + ds.getFullDsName() + ".");
+        }
+        // the member itself, never a sample of it
+        std::string lib = ds.libref.empty() ? "WORK" : ds.libref;
+        auto library = getLibrary(lib);
+        if (!library) {
+            throw std::runtime_error("Library not found: " + lib);
+        }
+        loadDataset(lib, ds.dataName);
+        return library->getOrCreateDataset(ds.dataName);
+    }
+
+    ReadOptions DataEnvironment::readOptions(const ReadOptions& dsOptions) const {
+        ReadOptions options = dsOptions;
+        std::string obs = getOption("OBS");
+        if (options.obs < 0 && !obs.empty()) {
+            options.obs = parseObs(obs);
+        }
+        std::string sample = getOption("SAMPLE");
+        if (!sample.empty()) {
+            options.sample = parseSample(sample);
+            options.sampleSeed = parseSampleSeed(getOption("SAMPLESEED", "0"));
+            options.sampleKey = getOption("SAMPLEKEY");
+            if (!options.sampleKey.empty() && options.sample > 1) {
+                throw std::runtime_error("SAMPLEKEY= needs SAMPLE= as a fraction of the rows.");
+            }
+        }
+        return options;
+    }
+
+    long DataEnvironment::parseObs(const std::string& value) {
+        if (to_upper(value) == "MAX") {
+            return -1;
+        }
+        size_t pos = 0;
+        long obs = -1;
+        try {
+            obs = std::stol(value, &pos);
+        }
+        catch (...) {
+        }
+        if (pos == 0 || pos != value.size() || obs < 0) {
+            throw std::runtime_error("Invalid OBS value: " + value);
+        }
+        return obs;
+    }
+
+    double DataEnvironment::parseSample(const std::string& value) {
+        size_t pos = 0;
+        double sample = 0;
+        try {
+            sample = std::stod(value, &pos);
+        }
+        catch (...) {
+        }
+        if (pos == 0 || pos != value.size() || !(sample > 0) || std::isinf(sample)) {
+            throw std::runtime_error("SAMPLE= must be a fraction of the rows or a number of rows: " + value);
+        }
+        return sample;
+    }
+
+    uint64_t DataEnvironment::parseSampleSeed(const std::string& value) {
+        size_t pos = 0;
+        uint64_t seed = 0;
+        try {
+            seed = std::stoull(value, &pos);
+        }
+        catch (...) {
+        }
+        if (pos == 0 || pos != value.size() || value[0] == '-') {
+            throw std::runtime_error("Invalid SAMPLESEED value: " + value);
+        }
+        return seed;
+    }
+
+    void DataEnvironment::refreshMemoryUsage() {
+        std::map<std::string, size_t> usage;
+        for (auto& kv : libraries) {
+            for (auto& dsName : kv.second->listDatasets()) {
+                usage[kv.first + "." + dsName] = kv.second->getMemoryUsage(dsName);
+            }
+        }
+        memory.setDatasetUsage(usage);
+        memory.enforce();
+    }
+
+    size_t DataEnvironment::spillColdDatasets(size_t bytesNeeded) {
+        struct Candidate {
+            std::string libref;
+            std::shared_ptr<Library> lib;
+            std::string dsName;
+            uint64_t lastAccess;
+        };
+        std::vector<Candidate> candidates;
+        for (auto& kv : libraries) {
+            for (auto& dsName : kv.second->listDatasets()) {
+                if (kv.second->isSpillable(dsName)) {
+                    candidates.push_back({ kv.first, kv.second, dsName, kv.second->getLastAccess(dsName) });
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.lastAccess < b.lastAccess; });
+
+        std::string spillFolder = (fs::path(workFolder) / "_spill").string();
+        size_t released = 0;
+        for (auto& c : candidates) {
+            if (released >= bytesNeeded) break;
+            // a shared library may still be read by other sessions after this one ends
+            bool shared = registry && c.libref != "WORK";
+            size_t bytes = c.lib->spillDataset(c.dsName, shared ? registry->spillFolder(c.lib) : spillFolder);
+            if (bytes > 0) {
+                released += bytes;
+                memory.forgetDataset(c.libref + "." + c.dsName);
+                memoryNotes.push_back("NOTE: Data set " + c.libref + "." + c.dsName + " (" +
+                    MemoryManager::formatKilobytes(bytes) + ") was moved to WORK to stay within MEMSIZE.");
+            }
+        }
+        return released;
+    }
+
+    std::vector<std::string> DataEnvironment::takeMemoryNotes() {
+        std::vector<std::string> notes;
+        notes.swap(memoryNotes);
+        return notes;
+    }
+
     std::unordered_map<std::string, std::shared_ptr<Library>>   DataEnvironment::getLibraries() {
         return libraries;
     }
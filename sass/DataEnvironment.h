@@ -15,12 +15,18 @@
 #include "Library.h"
 #include "sasdoc.h"
 #include "AST.h"
+#include "MemoryManager.h"
+#include "LibraryRegistry.h"
 
 namespace sass {
-    // Manages datasets, global options, librefs, and titles
+    // Manages datasets, global options, librefs, and titles of one session.
+    // A DataEnvironment is used by one thread at a time; sessions running on
+    // other threads share libraries (and the datasets loaded in them) through
+    // a common LibraryRegistry.
     class DataEnvironment {
     public:
-        DataEnvironment();
+        // registry: libraries shared with other sessions, nullptr => this session's own
+        explicit DataEnvironment(std::shared_ptr<LibraryRegistry> registry = nullptr);
         ~DataEnvironment();
 
         // Current row being processed in a DATA step
@@ -48,8 +54,12 @@ namespace sass {
             currentRow.columns[varName] = val;
         }
 
-        // Retrieve or create a dataset
+        // Retrieve or create a dataset. With dataset options (or SAMPLE=) the
+        // rows read are the caller's own; the library keeps the whole member
         std::shared_ptr<Dataset> getOrCreateDataset(DatasetRefNode& ds);
+        // The output dataset of a step. FIRSTOBS= and OBS= select rows to read and
+        // are an error here; KEEP= and DROP= are left to the step (SasDoc::keepColumns)
+        std::shared_ptr<Dataset> getOrCreateOutputDataset(DatasetRefNode& ds);
 
         // Set a global option
         void setOption(const std::string& option, const std::string& value) {
@@ -111,7 +121,9 @@ namespace sass {
         }
 
         // The existing method for LIBNAME statement:
-        int defineLibrary(const std::string& libref, const std::string& path, LibraryAccess access);
+        // engine is the LIBNAME engine name ("" => V9). Returns 1 when the path does not exist,
+        // 2 when the engine is unknown.
+        int defineLibrary(const std::string& libref, const std::string& path, LibraryAccess access, const std::string& engine = "");
 
         // Retrieve a library pointer
         std::shared_ptr<Library> getLibrary(const std::string& libref);
@@ -122,6 +134,9 @@ namespace sass {
         // Get libraries
         std::unordered_map<std::string, std::shared_ptr<Library>>   getLibraries();
 
+        // The registry shared with other sessions, nullptr when there is none
+        std::shared_ptr<LibraryRegistry> getRegistry() const { return registry; }
+
         // Possibly a method to load a dataset: libref.datasetName
         bool loadDataset(const std::string& libref, const std::string& dsName) {
             auto lib = getLibrary(libref);
@@ -129,10 +144,37 @@ namespace sass {
                 std::cerr << "Library not found: " << libref << std::endl;
                 return false;
             }
-            return lib->loadDatasetFromSas7bdat(dsName);
+            return lib->loadDataset(dsName);
         }
 
+        // Dataset options plus the system options that apply to every read:
+        // OBS= (unless the dataset has its own), SAMPLE=, SAMPLESEED=, SAMPLEKEY=
+        ReadOptions readOptions(const ReadOptions& dsOptions) const;
+
+        // The values of those options, std::runtime_error when one is not a valid value
+        static long parseObs(const std::string& value);           // -1 for MAX
+        static double parseSample(const std::string& value);      // a fraction or a number of rows
+        static uint64_t parseSampleSeed(const std::string& value);
+
+        // MEMSIZE= accounting for the datasets, PDVs and procedure state of this session
+        MemoryManager memory;
+
+        // Re-measure the resident datasets and spill cold ones when over budget.
+        // Called at step boundaries.
+        void refreshMemoryUsage();
+
+        // Move least recently used datasets that no step holds out to WORK
+        // until bytesNeeded are released. Returns the bytes released.
+        size_t spillColdDatasets(size_t bytesNeeded);
+
+        // NOTE lines about spilled datasets since the last call
+        std::vector<std::string> takeMemoryNotes();
+
     private:
+        std::vector<std::string> memoryNotes;
+
+        std::shared_ptr<LibraryRegistry> registry;
+
         // A map from libref => Library instance
         std::unordered_map<std::string, std::shared_ptr<Library>> libraries;
 
@@ -0,0 +1,281 @@
+#include "Dataset.h"
+#include "utility.h"
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace sass {
+
+    Schema::Schema(const std::vector<std::string>& names) {
+        for (auto& name : names) {
+            add(name);
+        }
+    }
+
+    uint64_t Schema::nextId() {
+        static std::atomic<uint64_t> next{ 1 };
+        return next.fetch_add(1);
+    }
+
+    int Schema::find(const std::string& name) const {
+        auto it = slots.find(name);
+        return it != slots.end() ? (int)it->second : -1;
+    }
+
+    size_t Schema::add(const std::string& name) {
+        auto [it, added] = slots.try_emplace(name, names.size());
+        if (added) {
+            names.push_back(name);
+        }
+        return it->second;
+    }
+
+    Value& RowColumns::operator[](const std::string& name) {
+        if (!columnSchema) {
+            columnSchema = std::make_shared<Schema>();
+        }
+        return emplace(columnSchema->add(name));
+    }
+
+    Value& RowColumns::at(const std::string& name) {
+        auto it = find(name);
+        if (it == end()) {
+            throw std::out_of_range("No column " + name + " in the row.");
+        }
+        return *values[it.slot()];
+    }
+
+    const Value& RowColumns::at(const std::string& name) const {
+        auto it = find(name);
+        if (it == end()) {
+            throw std::out_of_range("No column " + name + " in the row.");
+        }
+        return *values[it.slot()];
+    }
+
+    RowColumns::iterator RowColumns::find(const std::string& name) {
+        int s = columnSchema ? columnSchema->find(name) : -1;
+        return s >= 0 && slot(s) ? iterator(this, s) : end();
+    }
+
+    RowColumns::const_iterator RowColumns::find(const std::string& name) const {
+        int s = columnSchema ? columnSchema->find(name) : -1;
+        return s >= 0 && slot(s) ? const_iterator(this, s) : end();
+    }
+
+    const Value* RowColumns::find(const std::string& name, SlotCache& cache) const {
+        if (!columnSchema) {
+            return nullptr;
+        }
+        if (cache.schema != columnSchema->id()) {
+            // a name the schema does not have yet may be added to it later: misses are not kept
+            int s = columnSchema->find(name);
+            if (s < 0) {
+                return nullptr;
+            }
+            cache.schema = columnSchema->id();
+            cache.slot = s;
+        }
+        return slot(cache.slot);
+    }
+
+    size_t RowColumns::erase(const std::string& name) {
+        auto it = find(name);
+        if (it == end()) {
+            return 0;
+        }
+        values[it.slot()].reset();
+        return 1;
+    }
+
+    size_t RowColumns::size() const {
+        return std::count_if(values.begin(), values.end(), [](const std::optional<Value>& v) { return v.has_value(); });
+    }
+
+    Value& RowColumns::emplace(size_t s) {
+        if (s >= values.size()) {
+            values.resize(s + 1);
+        }
+        if (!values[s]) {
+            values[s].emplace();
+        }
+        return *values[s];
+    }
+
+    size_t RowColumns::memoryUsage() const {
+        size_t bytes = values.capacity() * sizeof(std::optional<Value>);
+        for (auto& v : values) {
+            if (!v) continue;
+            if (auto s = std::get_if<std::string>(&*v)) bytes += s->capacity();
+        }
+        return bytes;
+    }
+
+    int ColumnBatch::columnIndex(const std::string& name) const {
+        for (size_t c = 0; c < columns.size(); c++) {
+            if (columns[c].name == name) return (int)c;
+        }
+        return -1;
+    }
+
+    Value ColumnBatch::value(size_t row, size_t c) const {
+        if (columns[c].numeric) {
+            return columns[c].numbers[row];
+        }
+        return std::string(columns[c].strings[row]);
+    }
+
+    void ColumnBatch::fillRow(size_t row, Row& out) const {
+        if (out.columns.schema() != schema) {
+            out.columns = RowColumns(schema);
+        }
+        for (auto& col : columns) {
+            if (col.source < 0) continue;
+            Value& v = out.columns.emplace(col.slot);
+            if (col.numeric) {
+                v = col.numbers[row];
+            }
+            else if (auto s = std::get_if<std::string>(&v)) {
+                // keeps the string's capacity from the previous row
+                s->assign(col.strings[row]);
+            }
+            else {
+                v = std::string(col.strings[row]);
+            }
+        }
+    }
+
+    DatasetCursor::DatasetCursor(const Dataset& dataset, const std::vector<std::string>& columns, size_t batchSize,
+        const RowSelection* selection)
+        : dataset(dataset), batchSize(std::max<size_t>(batchSize, 1)), total(dataset.scanRowCount()), selection(selection)
+    {
+        dataset.describeColumns(current, columns);
+        current.schema = std::make_shared<Schema>();
+        for (auto& col : current.columns) {
+            col.slot = current.schema->add(col.name);
+        }
+    }
+
+    bool DatasetCursor::next() {
+        while (position < total) {
+            size_t count = std::min(batchSize, total - position);
+            if (selection) {
+                // start at the next selected row, unselected runs are not read
+                size_t r = position < selection->size() && selection->test(position) ? position : selection->find_next(position);
+                if (r == RowSelection::npos || r >= total) {
+                    position = total;
+                    return false;
+                }
+                position = r;
+                count = std::min(batchSize, total - position);
+            }
+            current.first = position;
+            current.count = count;
+            for (auto& col : current.columns) {
+                // the buffers only grow, after the first batch this does not allocate
+                if (col.numeric) col.numbers.resize(current.count);
+                else col.strings.resize(current.count);
+            }
+            dataset.fillBatch(current);
+            position += count;
+            if (!selection) {
+                return true;
+            }
+
+            // keep the selected rows, at the front of the buffers
+            current.rowNumbers.clear();
+            for (size_t i = 0; i < count; i++) {
+                size_t row = current.first + i;
+                if (row >= selection->size() || !selection->test(row)) continue;
+                size_t kept = current.rowNumbers.size();
+                if (kept != i) {
+                    for (auto& col : current.columns) {
+                        if (col.numeric) col.numbers[kept] = col.numbers[i];
+                        else col.strings[kept] = col.strings[i];
+                    }
+                }
+                current.rowNumbers.push_back(row);
+            }
+            current.count = current.rowNumbers.size();
+            if (current.count > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    DatasetCursor Dataset::scan(const std::vector<std::string>& columns, size_t batchSize, const RowSelection* selection) const {
+        return DatasetCursor(*this, columns, batchSize, selection);
+    }
+
+    std::string Dataset::contentHash() const {
+        // two FNV-1a lanes with different seeds, strings length-prefixed
+        Fnv1a a, b(0x9e3779b97f4a7c15ull);
+        auto add = [&](const void* data, size_t n) { a.add(data, n); b.add(data, n); };
+        auto addString = [&](std::string_view s) {
+            uint64_t n = s.size();
+            add(&n, sizeof(n));
+            add(s.data(), s.size());
+        };
+        auto cursor = scan();
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t c = 0; c < batch.columnCount(); c++) {
+            addString(batch.column(c).name);
+            addString(batch.isNumeric(c) ? "N" : "C");
+        }
+        while (cursor.next()) {
+            for (size_t c = 0; c < batch.columnCount(); c++) {
+                if (batch.isNumeric(c)) {
+                    auto numbers = batch.numbers(c);
+                    add(numbers.data(), numbers.size_bytes());
+                }
+                else {
+                    for (auto s : batch.strings(c)) addString(s);
+                }
+            }
+        }
+        return a.hex() + b.hex();
+    }
+
+    void Dataset::describeColumns(ColumnBatch& batch, const std::vector<std::string>& names) const {
+        batch.columns.clear();
+        // Rows carry no schema: take the names and types from the first row
+        const Row* first = rows.empty() ? nullptr : &rows[0];
+        std::vector<std::string> wanted = names;
+        if (wanted.empty() && first) {
+            for (const auto& kv : first->columns) wanted.push_back(kv.first);
+        }
+        for (size_t i = 0; i < wanted.size(); i++) {
+            ColumnBatch::Column col;
+            col.name = wanted[i];
+            if (first) {
+                auto it = first->columns.find(col.name);
+                if (it != first->columns.end()) {
+                    col.source = (int)i;
+                    col.numeric = std::holds_alternative<double>(it->second);
+                }
+            }
+            batch.columns.push_back(std::move(col));
+        }
+    }
+
+    void Dataset::fillBatch(ColumnBatch& batch) const {
+        for (auto& col : batch.columns) {
+            // the rows mostly share a schema, the slot is looked up once
+            SlotCache cache;
+            for (size_t r = 0; r < batch.count; r++) {
+                const Value* v = rows[batch.first + r].columns.find(col.name, cache);
+                if (col.numeric) {
+                    const double* d = v ? std::get_if<double>(v) : nullptr;
+                    col.numbers[r] = d ? *d : -INFINITY;
+                }
+                else {
+                    const std::string* s = v ? std::get_if<std::string>(v) : nullptr;
+                    col.strings[r] = s ? std::string_view(*s) : std::string_view();
+                }
+            }
+        }
+    }
+
+}
@@ -5,20 +5,142 @@
 #include <vector>
 #include <unordered_map>
 #include <variant>
+#include <optional>
+#include <memory>
+#include <type_traits>
+#include <cstdint>
 #include <iostream>
+#include <span>
+#include <string_view>
+#include <boost/dynamic_bitset.hpp>
+#include "CowVector.h"
 
 namespace sass {
     // Define a variant type to hold different data types
     using Value = std::variant<double, std::string>;
 
+    // Column names of row based data, shared by the rows made against it:
+    // a row keeps its values in slots, the schema maps names to them. Names
+    // are only ever added, so a slot stays valid for every row using it.
+    class Schema {
+    public:
+        Schema() = default;
+        explicit Schema(const std::vector<std::string>& names);
+        Schema(const Schema&) = delete;
+        Schema& operator=(const Schema&) = delete;
+
+        // -1 if name has no slot
+        int find(const std::string& name) const;
+        // slot of name, added at the end when new
+        size_t add(const std::string& name);
+        const std::string& name(size_t slot) const { return names[slot]; }
+        size_t size() const { return names.size(); }
+        // never reused, caches of slots key on it
+        uint64_t id() const { return uid; }
+
+    private:
+        std::vector<std::string> names;
+        std::unordered_map<std::string, size_t> slots;
+        uint64_t uid = nextId();
+
+        static uint64_t nextId();
+    };
+
+    // Where one name was last found: its slot in the schema with that id.
+    // Schemas only grow, so a slot found stays right; a miss is not cached.
+    struct SlotCache {
+        uint64_t schema = 0;
+        int slot = -1;
+    };
+
+    // The values of one row, a slot per column of its schema. It reads like
+    // the map from names to values it replaced; a column the row does not
+    // have is an empty slot. Copies share the schema, a row made without
+    // one gets its own when the first column is set.
+    class RowColumns {
+    public:
+        // Walks the columns the row has, in slot order; *it is a
+        // (first = name, second = value) pair of references
+        template <bool Const>
+        class Iterator {
+        public:
+            using Owner = std::conditional_t<Const, const RowColumns, RowColumns>;
+            using Ref = std::conditional_t<Const, const Value&, Value&>;
+            struct Entry {
+                const std::string& first;
+                Ref second;
+            };
+            struct Arrow {
+                Entry entry;
+                const Entry* operator->() const { return &entry; }
+            };
+
+            Iterator(Owner* owner, size_t slot) : owner(owner), s(slot) { skip(); }
+            Entry operator*() const { return { owner->columnSchema->name(s), *owner->values[s] }; }
+            Arrow operator->() const { return { **this }; }
+            Iterator& operator++() { s++; skip(); return *this; }
+            bool operator==(const Iterator& other) const { return s == other.s; }
+            size_t slot() const { return s; }
+
+        private:
+            Owner* owner;
+            size_t s;
+
+            void skip() { while (s < owner->values.size() && !owner->values[s]) s++; }
+        };
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        RowColumns() = default;
+        explicit RowColumns(std::shared_ptr<Schema> schema) : columnSchema(std::move(schema)) {}
+
+        // By name, as std::unordered_map<std::string, Value>
+        Value& operator[](const std::string& name);
+        Value& at(const std::string& name);
+        const Value& at(const std::string& name) const;
+        iterator find(const std::string& name);
+        const_iterator find(const std::string& name) const;
+        size_t count(const std::string& name) const { return find(name) != end() ? 1 : 0; }
+        size_t erase(const std::string& name);
+        // Drops the values, the schema stays
+        void clear() { values.clear(); }
+        size_t size() const;
+        bool empty() const { return size() == 0; }
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, values.size()); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, values.size()); }
+
+        // By slot of the schema
+        const std::shared_ptr<Schema>& schema() const { return columnSchema; }
+        // nullptr when the row has no value in slot
+        Value* slot(size_t s) { return s < values.size() && values[s] ? &*values[s] : nullptr; }
+        const Value* slot(size_t s) const { return s < values.size() && values[s] ? &*values[s] : nullptr; }
+        // The value in slot, made (0) when the row has none
+        Value& emplace(size_t s);
+        // By name, the slot looked up only when this row's schema is not the one cache saw last
+        const Value* find(const std::string& name, SlotCache& cache) const;
+
+        // Bytes of the slots and their strings, the schema is shared and not counted
+        size_t memoryUsage() const;
+
+    private:
+        std::shared_ptr<Schema> columnSchema;
+        std::vector<std::optional<Value>> values;
+    };
+
     // Represents a single row in a dataset
     struct Row {
-        std::unordered_map<std::string, Value> columns;
+        RowColumns columns;
     };
 
     // Represents a single column in the dataset. It maps column names to their values.
     using Column = std::vector<Value>;
 
+    // Rows of a dataset to read, bit r for row r: what a WHERE condition
+    // selected (see WhereFilter), in the form of SasDoc::obs_flag
+    using RowSelection = boost::dynamic_bitset<>;
+
     class VariableDef {
     public:
         std::string name;
@@ -30,12 +152,80 @@ namespace sass {
         // Possibly more attributes
     };
 
+    // One batch of rows read by Dataset::scan. Every requested column is a
+    // typed span over the rows of the batch: numbers() for numeric columns,
+    // strings() for character columns. The buffers are reused from batch to
+    // batch, so reading a dataset does not allocate per row.
+    // Missing numbers are -INFINITY; a requested column the dataset does not
+    // have is numeric, all missing, with source -1. String views stay valid
+    // until the dataset is modified.
+    class ColumnBatch {
+    public:
+        struct Column {
+            std::string name;
+            int source = -1;        // column index in the dataset, -1 if not found
+            bool numeric = true;
+            size_t slot = 0;        // in schema
+            std::vector<double> numbers;
+            std::vector<std::string_view> strings;
+        };
+
+        size_t size() const { return count; }
+        size_t firstRow() const { return first; }
+        // Dataset row of row i of the batch
+        size_t rowNumber(size_t i) const { return rowNumbers.empty() ? first + i : rowNumbers[i]; }
+        size_t columnCount() const { return columns.size(); }
+        const Column& column(size_t c) const { return columns[c]; }
+        // -1 if name is not one of the scanned columns
+        int columnIndex(const std::string& name) const;
+        bool isNumeric(size_t c) const { return columns[c].numeric; }
+        std::span<const double> numbers(size_t c) const { return { columns[c].numbers.data(), count }; }
+        std::span<const std::string_view> strings(size_t c) const { return { columns[c].strings.data(), count }; }
+
+        // Row based compatibility, these copy the strings
+        Value value(size_t row, size_t c) const;
+        // Fill out with the cells of one row of the batch. out takes the scan's
+        // schema, so the rows of one scan share it; a row filled again keeps its slots.
+        void fillRow(size_t row, Row& out) const;
+
+        // Filled in by the Dataset being scanned
+        std::vector<Column> columns;
+        size_t first = 0;
+        size_t count = 0;
+        // when read through a selection: the dataset row of each row, first is the first of them
+        std::vector<size_t> rowNumbers;
+        // Set by the cursor: the schema of the rows fillRow makes, one per scan
+        std::shared_ptr<Schema> schema;
+    };
+
+    class Dataset;
+
+    // Forward-only cursor returned by Dataset::scan
+    class DatasetCursor {
+    public:
+        DatasetCursor(const Dataset& dataset, const std::vector<std::string>& columns, size_t batchSize,
+            const RowSelection* selection = nullptr);
+
+        // Read the next batch; false once every row has been read
+        bool next();
+        const ColumnBatch& batch() const { return current; }
+
+    private:
+        const Dataset& dataset;
+        size_t batchSize;
+        size_t position = 0;
+        size_t total;
+        ColumnBatch current;
+        const RowSelection* selection;
+    };
+
     // Represents a dataset containing multiple rows
     class Dataset {
     public:
         virtual ~Dataset() = default;  // This makes Dataset polymorphic
         std::string name;
-        std::vector<Row> rows;
+        // Shared copy-on-write: copying rows between datasets is O(1)
+        CowVector<Row> rows;
 
         // Method to add a row to the dataset
         virtual void addRow(const Row& row) = 0;
@@ -48,6 +238,41 @@ namespace sass {
         virtual int getColumnCount() const = 0;
 
         virtual Row getRow(int i) const = 0;
+
+        // Read the named columns (all of them when empty) a batch at a time:
+        //   auto cursor = ds->scan({ "age", "name" });
+        //   while (cursor.next()) {
+        //       auto age = cursor.batch().numbers(0);
+        //       ...
+        //   }
+        // With a selection only the rows it has are read, batches keep
+        // their rows' numbers; the selection has to outlive the cursor.
+        DatasetCursor scan(const std::vector<std::string>& columns = {}, size_t batchSize = 1024,
+            const RowSelection* selection = nullptr) const;
+
+        // Hex hash of the column names, types and values: equal hashes, same content
+        std::string contentHash() const;
+
+        // Storage side of scan(). The defaults read the Row based storage
+        // (rows); SasDoc reads its cells directly.
+        virtual size_t scanRowCount() const { return rows.size(); }
+        // Set name/source/numeric of batch.columns for the requested names
+        virtual void describeColumns(ColumnBatch& batch, const std::vector<std::string>& names) const;
+        // Fill the column buffers for rows [batch.first, batch.first + batch.count)
+        virtual void fillBatch(ColumnBatch& batch) const;
+
+        // Approximate bytes held in memory, used for MEMSIZE= accounting
+        virtual size_t memoryUsage() const {
+            size_t bytes = rows.capacity() * sizeof(Row);
+            // sample the rows instead of walking them all
+            size_t step = rows.size() / 256 + 1, sampled = 0, sampleBytes = 0;
+            for (size_t i = 0; i < rows.size(); i += step, sampled++) {
+                sampleBytes += rows[i].columns.memoryUsage();
+            }
+            if (sampled > 0) bytes += sampleBytes / sampled * rows.size();
+            // rows shared with other datasets are split between them
+            return sizeof(*this) + bytes / rows.useCount();
+        }
     };
 
 
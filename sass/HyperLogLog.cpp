@@ -0,0 +1,177 @@
+#include "HyperLogLog.h"
+#include "utility.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace sass {
+
+    namespace {
+        // the sparse list addresses 2^25 registers
+        const int sparsePrecision = 25;
+
+        // sigma and tau of Ertl's improved estimator ("New cardinality
+        // estimation algorithms for HyperLogLog sketches", 2017): they correct
+        // for empty and saturated registers without the bias tables of HLL++
+        double sigma(double x) {
+            if (x == 1) return INFINITY;
+            double y = 1, z = x, previous;
+            do {
+                x *= x;
+                previous = z;
+                z += x * y;
+                y += y;
+            } while (z != previous);
+            return z;
+        }
+
+        double tau(double x) {
+            if (x == 0 || x == 1) return 0;
+            double y = 1, z = 1 - x, previous;
+            do {
+                x = std::sqrt(x);
+                previous = z;
+                y *= 0.5;
+                z -= (1 - x) * (1 - x) * y;
+            } while (z != previous);
+            return z / 3;
+        }
+
+        uint32_t indexOf(uint32_t entry) { return entry >> 6; }
+        uint32_t rhoOf(uint32_t entry) { return entry & 63; }
+    }
+
+    HyperLogLog::HyperLogLog(int precision) : p(precision) {
+        if (precision < minPrecision || precision > maxPrecision) {
+            throw std::runtime_error("HyperLogLog precision must be between " + std::to_string(minPrecision)
+                + " and " + std::to_string(maxPrecision) + ": " + std::to_string(precision));
+        }
+    }
+
+    void HyperLogLog::addNumber(double value) {
+        add(hashNumber(value));
+    }
+
+    void HyperLogLog::addString(std::string_view value) {
+        add(hashString(value));
+    }
+
+    void HyperLogLog::add(uint64_t hash) {
+        if (!registers.empty()) {
+            uint32_t index = (uint32_t)(hash >> (64 - p));
+            uint64_t rest = hash << p;
+            uint8_t rho = (uint8_t)(rest == 0 ? 65 - p : std::countl_zero(rest) + 1);
+            registers[index] = std::max(registers[index], rho);
+            return;
+        }
+        uint32_t index = (uint32_t)(hash >> (64 - sparsePrecision));
+        uint64_t rest = hash << sparsePrecision;
+        uint32_t rho = rest == 0 ? 65 - sparsePrecision : std::countl_zero(rest) + 1;
+        pending.push_back(index << 6 | rho);
+        // sorting in batches keeps adds cheap
+        if (pending.size() >= std::max<size_t>(64, ((size_t)1 << p) / 16)) {
+            flushPending();
+            if (sparse.size() * sizeof(uint32_t) > ((size_t)1 << p)) {
+                toDense();
+            }
+        }
+    }
+
+    void HyperLogLog::flushPending() const {
+        if (pending.empty()) return;
+        std::sort(pending.begin(), pending.end());
+        size_t middle = sparse.size();
+        sparse.insert(sparse.end(), pending.begin(), pending.end());
+        std::inplace_merge(sparse.begin(), sparse.begin() + middle, sparse.end());
+        pending.clear();
+        // one entry per index, the highest rho sorts last
+        size_t kept = 0;
+        for (size_t i = 0; i < sparse.size(); i++) {
+            if (i + 1 < sparse.size() && indexOf(sparse[i + 1]) == indexOf(sparse[i])) continue;
+            sparse[kept++] = sparse[i];
+        }
+        sparse.resize(kept);
+    }
+
+    void HyperLogLog::setRegister(uint32_t entry) {
+        // the bits of the 25 bit index below the top p come first in the rest of the hash
+        int extra = sparsePrecision - p;
+        uint32_t index = indexOf(entry) >> extra;
+        uint32_t low = indexOf(entry) & ((1u << extra) - 1);
+        uint8_t rho = (uint8_t)(low != 0 ? extra - std::bit_width(low) + 1 : extra + rhoOf(entry));
+        registers[index] = std::max(registers[index], rho);
+    }
+
+    void HyperLogLog::toDense() {
+        flushPending();
+        registers.assign((size_t)1 << p, 0);
+        for (uint32_t entry : sparse) {
+            setRegister(entry);
+        }
+        sparse.clear();
+        sparse.shrink_to_fit();
+        pending.shrink_to_fit();
+    }
+
+    void HyperLogLog::merge(const HyperLogLog& other) {
+        if (other.p != p) {
+            throw std::runtime_error("Cannot merge HyperLogLog sketches of precision "
+                + std::to_string(p) + " and " + std::to_string(other.p) + ".");
+        }
+        if (other.isSparse()) {
+            other.flushPending();
+            if (isSparse()) {
+                pending.insert(pending.end(), other.sparse.begin(), other.sparse.end());
+                flushPending();
+                if (sparse.size() * sizeof(uint32_t) > ((size_t)1 << p)) {
+                    toDense();
+                }
+            }
+            else {
+                for (uint32_t entry : other.sparse) {
+                    setRegister(entry);
+                }
+            }
+            return;
+        }
+        if (isSparse()) {
+            toDense();
+        }
+        for (size_t i = 0; i < registers.size(); i++) {
+            registers[i] = std::max(registers[i], other.registers[i]);
+        }
+    }
+
+    double HyperLogLog::estimate() const {
+        if (isSparse()) {
+            // linear counting over the 2^25 registers of the sparse list
+            flushPending();
+            double m = (double)(1u << sparsePrecision);
+            double n = (double)sparse.size();
+            return n == 0 ? 0 : m * std::log(m / (m - n));
+        }
+        int q = 64 - p;
+        std::vector<size_t> counts(q + 2, 0);
+        for (uint8_t r : registers) {
+            counts[r]++;
+        }
+        double m = (double)registers.size();
+        double z = m * tau(1 - counts[q + 1] / m);
+        for (int k = q; k >= 1; k--) {
+            z = 0.5 * (z + counts[k]);
+        }
+        z += m * sigma(counts[0] / m);
+        return m * m / (2 * std::log(2.0) * z);
+    }
+
+    double HyperLogLog::standardError(int precision) {
+        return 1.04 / std::sqrt((double)((size_t)1 << precision));
+    }
+
+    size_t HyperLogLog::memoryUsage() const {
+        return registers.capacity() + (sparse.capacity() + pending.capacity()) * sizeof(uint32_t);
+    }
+
+}
@@ -0,0 +1,54 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include <vector>
+#include <string_view>
+#include <cstdint>
+
+namespace sass {
+
+    // Approximate count of distinct values (HyperLogLog++): 2^precision
+    // registers of one byte, standard error about 1.04 / sqrt(2^precision).
+    // Small counts are kept in a sparse list of 25 bit indexes, nearly
+    // exact, until it would take more room than the registers. Sketches of
+    // the same precision merge into the sketch of the union, so parts of a
+    // column can be counted on their own threads, or BY groups one by one
+    // and then together.
+    class HyperLogLog {
+    public:
+        static const int minPrecision = 4;
+        static const int maxPrecision = 18;
+        static const int defaultPrecision = 14;
+
+        explicit HyperLogLog(int precision = defaultPrecision);
+
+        // Add a value by its 64 bit hash
+        void add(uint64_t hash);
+        void addNumber(double value);
+        void addString(std::string_view value);
+
+        // Fold another sketch of the same precision into this one
+        void merge(const HyperLogLog& other);
+
+        double estimate() const;
+        int precision() const { return p; }
+        double standardError() const { return standardError(p); }
+        static double standardError(int precision);
+        bool isSparse() const { return registers.empty(); }
+        // bytes held by the sketch
+        size_t memoryUsage() const;
+
+    private:
+        int p;
+        std::vector<uint8_t> registers;         // dense: 2^p registers, empty while sparse
+        mutable std::vector<uint32_t> sparse;   // sorted, one (index << 6 | rho) per 25 bit index
+        mutable std::vector<uint32_t> pending;  // added since the last sort of sparse
+
+        void flushPending() const;
+        void toDense();
+        void setRegister(uint32_t entry);
+    };
+
+}
+
+#endif // HYPERLOGLOG_H
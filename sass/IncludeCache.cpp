@@ -0,0 +1,73 @@
+#include "IncludeCache.h"
+#include "Lexer.h"
+#include "MappedFile.h"
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace sass {
+
+    IncludeCache& IncludeCache::shared() {
+        static IncludeCache cache;
+        return cache;
+    }
+
+    IncludeCache::Tokens IncludeCache::tokens(const std::string& path) {
+        std::error_code ec;
+        fs::path file = fs::weakly_canonical(path, ec);
+        uintmax_t size = 0;
+        fs::file_time_type mtime;
+        if (!ec) size = fs::file_size(file, ec);
+        if (!ec) mtime = fs::last_write_time(file, ec);
+        if (ec) {
+            throw std::runtime_error("Cannot %include file: " + path);
+        }
+        int64_t ticks = mtime.time_since_epoch().count();
+        std::string key = file.string();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end() && it->second.mtime == ticks && it->second.size == size) {
+                hitCount++;
+                return it->second.tokens;
+            }
+        }
+
+        // lexed without holding the lock, two sessions may lex a new file at the same time
+        std::vector<Token> lexed;
+        if (size > 0) {
+            MappedFile mapped;
+            if (!mapped.open(key)) {
+                throw std::runtime_error("Cannot %include file: " + path);
+            }
+            Lexer lexer(std::move(mapped));
+            lexed = lexer.tokenizeRaw();
+        }
+        auto shared = std::make_shared<const std::vector<Token>>(std::move(lexed));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        missCount++;
+        entries[key] = Entry{ ticks, size, shared };
+        return shared;
+    }
+
+    size_t IncludeCache::hits() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hitCount;
+    }
+
+    size_t IncludeCache::misses() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return missCount;
+    }
+
+    void IncludeCache::clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        hitCount = 0;
+        missCount = 0;
+    }
+
+}
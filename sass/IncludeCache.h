@@ -0,0 +1,49 @@
+#ifndef INCLUDECACHE_H
+#define INCLUDECACHE_H
+
+#include "Token.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sass {
+
+    // The tokens of the files %INCLUDE reads, lexed once per process: every
+    // session (of a batch, of the server) including the same file shares its
+    // token stream. A file is lexed again when its modification time or size
+    // changes. The tokens are those of the file as written, the %include
+    // statements in it are expanded by the lexer that reads them.
+    class IncludeCache {
+    public:
+        using Tokens = std::shared_ptr<const std::vector<Token>>;
+
+        // The one of the process
+        static IncludeCache& shared();
+
+        // The tokens of the file at path; throws if it cannot be read
+        Tokens tokens(const std::string& path);
+
+        // Files found lexed already, and lexed
+        size_t hits() const;
+        size_t misses() const;
+        void clear();
+
+    private:
+        struct Entry {
+            int64_t mtime = 0;
+            uintmax_t size = 0;
+            Tokens tokens;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;     // by absolute path
+        size_t hitCount = 0;
+        size_t missCount = 0;
+    };
+
+}
+
+#endif // INCLUDECACHE_H
@@ -12,37 +12,146 @@
 #include "Parser.h"
 #include "PDV.h"
 #include "StepTimer.h"
+#include "StepFingerprint.h"
+#include "Checkpoint.h"
+#include "Univariate.h"
+#include "Rank.h"
+#include "HyperLogLog.h"
+#include "WhereFilter.h"
+#include <thread>
+#include <optional>
+#include <cstdio>
+#include <cstring>
 
 using namespace std;
 
 namespace sass {
+
+namespace {
+    // The text of a number as SYMPUTX and CATS write it: no blanks, . when missing
+    void appendNumber(std::string& out, double d) {
+        if (!std::isfinite(d)) {
+            out += '.';
+            return;
+        }
+        char buffer[32];
+        int n = std::snprintf(buffer, sizeof(buffer), "%.15g", d);
+        out.append(buffer, n);
+    }
+
+    std::string_view strip(std::string_view s) {
+        size_t begin = s.find_first_not_of(' ');
+        if (begin == std::string_view::npos) return {};
+        return s.substr(begin, s.find_last_not_of(' ') - begin + 1);
+    }
+
+    // Options set by name alone, and turned off by NO<name>
+    const std::set<std::string> flagOptions = {
+        "FULLSTIMER", "STIMER", "INCREMENTAL", "APPROXDISTINCT", "NOTES", "SOURCE", "CENTER", "DATE", "NUMBER"
+    };
+
+    // KEEP=/DROP= of an output data set, applied once the step has written it
+    void selectOutputColumns(SasDoc& doc, const ReadOptions& options) {
+        if (options.keep.empty() && options.drop.empty()) {
+            return;
+        }
+        std::vector<std::string> names;
+        for (const auto& name : doc.var_names) {
+            if (options.selects(name)) names.push_back(name);
+        }
+        doc.keepColumns(names);
+    }
+}
+
 // Execute the entire program
 void Interpreter::executeProgram(const std::unique_ptr<ProgramNode> &program) {
-    for (const auto &stmt : program->statements) {
+    beginProgram();
+    for (auto& stmt : program->statements) {
+        executeStatement(stmt.get());
+    }
+    endProgram();
+}
+
+void Interpreter::beginProgram() {
+    statementIndex = 0;
+    restartAt = 0;
+    programFailed = false;
+    if (checkpoint && restart) {
         try {
-            execute(stmt.get());
+            restartAt = checkpoint->restore(env, macroVariables);
         }
-        catch (const std::runtime_error &e) {
-            logLogger.error("Execution error: {}", e.what());
-            // Continue with the next statement
+        catch (const std::runtime_error& e) {
+            logLogger.error("ERROR: {} The program runs from the start.", e.what());
+        }
+        if (restartAt > 0) {
+            logLogger.info("NOTE: Restarted from checkpoint {}, the first {} statements already ran.", checkpoint->getFolder(), restartAt);
+        }
+        else {
+            logLogger.info("NOTE: No checkpoint of this program in {}, it runs from the start.", checkpoint->getFolder());
+        }
+        restart = false;
+    }
+}
+
+// Checkpoints stop at the first failure, a restart resumes right after the last success
+void Interpreter::executeStatement(ASTNode* stmt) {
+    size_t i = statementIndex++;
+    if (i < restartAt) {
+        // macro definitions are not in the checkpoint
+        if (dynamic_cast<MacroDefinitionNode*>(stmt)) {
+            execute(stmt);
+        }
+        return;
+    }
+    try {
+        execute(stmt);
+    }
+    catch (const std::exception &e) {
+        logLogger.error("Execution error: {}", e.what());
+        programFailed = true;
+        // Continue with the next statement
+    }
+    if (checkpoint && !programFailed) {
+        try {
+            checkpoint->save(env, macroVariables, i + 1);
+        }
+        catch (const std::runtime_error& e) {
+            logLogger.warn("WARNING: {}", e.what());
         }
     }
 }
 
+void Interpreter::endProgram() {
+    if (checkpoint && !programFailed) {
+        checkpoint->clear();
+    }
+}
+
 // Execute a single AST node
 void Interpreter::execute(ASTNode *node) {
+    // what the statement left out of the log is noted once it is done
+    struct LimitScope {
+        LogLimiter& limit;
+        ~LimitScope() { limit.flush(); }
+    } limitScope{ logLimit };
+
     if (auto callNode = dynamic_cast<MacroCallNode*>(node)) {
         executeMacroCall(callNode);
     }
     else if (auto macroNode = dynamic_cast<MacroDefinitionNode*>(node)) {
-        std::unique_ptr<MacroDefinitionNode> uniqueMacroNode{ macroNode };
-        executeMacroDefinition(std::move(uniqueMacroNode));
+        executeMacroDefinition(macroNode);
     }
     else if (auto letNode = dynamic_cast<MacroVariableAssignmentNode*>(node)) {
         executeMacroVariableAssignment(letNode);
     }
+    else if (auto putNode = dynamic_cast<MacroPutNode*>(node)) {
+        executeMacroPut(putNode);
+    }
     else if (auto ds = dynamic_cast<DataStepNode*>(node)) {
-        executeDataStep(ds);
+        runIncremental(ds, [&]() { executeDataStep(ds); });
+        checkMemory();
+        logLimit.flush();
+        runExecutedCode();
     }
     else if (auto opt = dynamic_cast<OptionsNode*>(node)) {
         executeOptions(opt);
@@ -55,6 +164,7 @@ void Interpreter::execute(ASTNode *node) {
     }
     else if (auto proc = dynamic_cast<ProcNode*>(node)) {
         executeProc(proc);
+        checkMemory();
     }
     else if (auto ifElseIf = dynamic_cast<IfElseIfNode*>(node)) {
         executeIfElse(ifElseIf);
@@ -153,6 +263,9 @@ void Interpreter::executeDataStepStatement(ASTNode* stmt)
             pdv->setRetainFlag(var, true);
         }
     }
+    else if (auto callStmt = dynamic_cast<CallRoutineNode*>(stmt)) {
+        executeCallRoutine(callStmt);
+    }
     // else handle other statements: array, do loops, merges, etc.
     else {
         // fallback
@@ -170,21 +283,22 @@ void Interpreter::appendPdvRowToSasDoc(PDV& pdv, SasDoc* doc)
     doc->obs_count++;
     // Make sure doc->values is big enough
     doc->values.resize(doc->var_count * doc->obs_count);
+    auto& values = doc->values.mutate();
 
     // For each variable in doc->var_names / doc->var_count
     for (int c = 0; c < doc->var_count; c++) {
         const std::string& varName = doc->var_names[c];
         int pdvIndex = pdv.findVarIndex(varName);
         if (pdvIndex >= 0) {
-            doc->values[outRowIndex * doc->var_count + c] = valueToCell(pdv.getValue(pdvIndex));
+            values[outRowIndex * doc->var_count + c] = valueToCell(pdv.getValue(pdvIndex));
         }
         else {
             // missing
             if (doc->var_types[c] == READSTAT_TYPE_STRING) {
-                doc->values[outRowIndex * doc->var_count + c] = flyweight_string("");
+                values[outRowIndex * doc->var_count + c] = flyweight_string("");
             }
             else {
-                doc->values[outRowIndex * doc->var_count + c] = double(-INFINITY);
+                values[outRowIndex * doc->var_count + c] = double(-INFINITY);
             }
         }
     }
@@ -193,10 +307,10 @@ void Interpreter::appendPdvRowToSasDoc(PDV& pdv, SasDoc* doc)
 
 // Execute a DATA step
 void Interpreter::executeDataStep(DataStepNode* node) {
-    ScopedStepTimer timer("DATA statement", logLogger);
+    ScopedStepTimer timer("DATA statement", logLogger, fullStimer());
 
     // Create or get the output dataset (SasDoc or normal Dataset)
-    auto outDatasetPtr = env.getOrCreateDataset(node->outputDataSet);
+    auto outDatasetPtr = env.getOrCreateOutputDataset(node->outputDataSet);
     // For full readstat integration, cast to SasDoc if you want:
     auto outDoc = std::dynamic_pointer_cast<SasDoc>(outDatasetPtr);
     if (!outDoc) {
@@ -206,10 +320,31 @@ void Interpreter::executeDataStep(DataStepNode* node) {
         // env.dataSets[node->outputDataSet] = outDoc;
     }
 
+    // code left by a step that failed is not run
+    executeBuffer.clear();
+
     // Build a PDV
     PDV pdv;
     this->pdv = &pdv;
     this->doc = outDoc.get();
+    // the PDV lives on this stack frame only, forget it however the step ends
+    struct PdvScope {
+        Interpreter* self;
+        ~PdvScope() { self->pdv = nullptr; self->doc = nullptr; }
+    } pdvScope{ this };
+
+    // PDV and the output buffer count against MEMSIZE while the step runs
+    MemoryCharge charge(env.memory, "DATA statement");
+    // walking the PDV costs about as much as the row: its size is taken every 256 rows
+    size_t rowsTracked = 0;
+    size_t pdvBytes = 0;
+    auto trackMemory = [&]() {
+        if (rowsTracked++ % 256 == 0) {
+            pdvBytes = pdv.memoryUsage();
+        }
+        size_t bytes = pdvBytes + outDoc->values.capacity() * sizeof(Cell);
+        if (bytes > charge.size()) charge.require(bytes - charge.size());
+    };
 
     // We also want to gather any InputNode or DatalinesNode statements
     std::vector<std::pair<std::string, bool>> inputVars; // (varName, isString)
@@ -267,11 +402,13 @@ void Interpreter::executeDataStep(DataStepNode* node) {
         pdv.initFromSasDoc(inDoc.get());
 
         // We'll iterate over each row in inDoc
+        // (read through a const reference so a shared buffer is never copied)
+        const CowVector<Cell>& inValues = inDoc->values;
         int rowCount = inDoc->obs_count;
         for (int rowIndex = 0; rowIndex < rowCount; ++rowIndex) {
             // load row from inDoc->values => PDV
             for (int col = 0; col < inDoc->var_count; ++col) {
-                Value cellVal = cellToValue(inDoc->values[rowIndex * inDoc->var_count + col]);
+                Value cellVal = cellToValue(inValues[rowIndex * inDoc->var_count + col]);
                 const std::string& varName = inDoc->var_names[col];
                 int pdvIndex = pdv.findVarIndex(varName);
                 if (pdvIndex >= 0) {
@@ -291,6 +428,7 @@ void Interpreter::executeDataStep(DataStepNode* node) {
             if (!node->hasOutput) {
                 appendPdvRowToSasDoc(pdv, outDoc.get());
             }
+            trackMemory();
 
             // resetNonRetained for next iteration
             pdv.resetNonRetained();
@@ -373,25 +511,30 @@ void Interpreter::executeDataStep(DataStepNode* node) {
             if (!node->hasOutput) {
                 appendPdvRowToSasDoc(pdv, outDoc.get());
             }
+            trackMemory();
 
             pdv.resetNonRetained();
         }
 
-        // execute the other statements for this row
-        //     e.g., assignments, if-then, drop, keep, etc.
+        // without datalines either, the statements run once, for one observation
+        if (datalines.empty()) {
+            for (auto stmt : dataStepStmts) {
+                executeDataStepStatement(stmt);
+            }
 
-        for (auto stmt : dataStepStmts) {
-            // We'll do a helper method: executeDataStepStatement(stmt, pdv, outDoc, doOutputThisRow)
-            // That method will handle assignment, if-then, output, etc.
-            executeDataStepStatement(stmt);
-        }
+            if (!node->hasOutput) {
+                appendPdvRowToSasDoc(pdv, outDoc.get());
+            }
+            trackMemory();
 
-        // resetNonRetained for next iteration
-        pdv.resetNonRetained();
+            // resetNonRetained for next iteration
+            pdv.resetNonRetained();
+        }
     }
 
-    // save
-    env.saveSas7bdat(outDoc->name);
+    // save, into the output's own library
+    selectOutputColumns(*outDoc, node->outputDataSet.options);
+    env.saveSas7bdat(node->outputDataSet.getFullDsName());
 
     // Final logging
     // outDoc->obs_count should be updated as we appended rows
@@ -443,23 +586,25 @@ void Interpreter::syncPdvColumnsToSasDoc(PDV& pdv, SasDoc* doc)
                 // We'll copy from old array to new array
                 // but a simpler approach is to do it row by row
                 int newVarCount = doc->var_count; // after increment
-                std::vector<Cell> oldValues = doc->values;
+                // oldValues shares the buffer, clear() just lets go of it
+                CowVector<Cell> oldValues = doc->values;
                 doc->values.clear();
                 doc->values.resize(newVarCount * oldRowCount);
+                auto& values = doc->values.mutate();
 
                 // row by row copy
                 for (int r = 0; r < oldRowCount; r++) {
                     // copy old row
                     for (int c = 0; c < newVarCount - 1; c++) {
                         // the old column c in that row used to be old row index = r*(var_count-1) + c
-                        doc->values[r * newVarCount + c] = oldValues[r * (newVarCount - 1) + c];
+                        values[r * newVarCount + c] = oldValues[r * (newVarCount - 1) + c];
                     }
                     // fill the new column with missing
                     if (pdv.pdvVars[i].isNumeric) {
-                        doc->values[r * newVarCount + (newVarCount - 1)] = double(-INFINITY);
+                        values[r * newVarCount + (newVarCount - 1)] = double(-INFINITY);
                     }
                     else {
-                        doc->values[r * newVarCount + (newVarCount - 1)] = flyweight_string("");
+                        values[r * newVarCount + (newVarCount - 1)] = flyweight_string("");
                     }
                 }
             }
@@ -483,14 +628,14 @@ void Interpreter::syncPdvColumnsToSasDoc(PDV& pdv, SasDoc* doc)
 void Interpreter::executeAssignment(AssignmentNode *node) {
     Value val = evaluate(node->expression.get());
     env.setVariable(node->varName, val);
-    logLogger.info("Assigned {} = {}", node->varName, toString(val));
+    logLimit.info("Assigned {} = {}", node->varName, toString(val));
 }
 
 // Execute an IF-THEN statement
 void Interpreter::executeIfThen(IfThenNode *node) {
     Value cond = evaluate(node->condition.get());
     double d = toNumber(cond);
-    logLogger.info("Evaluating IF condition: {}", d);
+    logLimit.info("Evaluating IF condition: {}", d);
 
     if (d != 0.0) { // Non-zero is true
         for (const auto &stmt : node->thenStatements) {
@@ -519,20 +664,110 @@ void Interpreter::executeOutput(OutputNode *node) {
 // Execute an OPTIONS statement
 void Interpreter::executeOptions(OptionsNode* node) {
     for (const auto& opt : node->options) {
-        env.setOption(opt.first, opt.second);
-        logLogger.info("Set option {} = {}", opt.first, opt.second);
+        std::string name = opt.first;
+        std::string value = opt.second;
+        if (value.empty()) {
+            // Flag options: FULLSTIMER / NOFULLSTIMER
+            value = "1";
+            if (!flagOptions.count(name) && name.compare(0, 2, "NO") == 0 && flagOptions.count(name.substr(2))) {
+                name = name.substr(2);
+                value = "0";
+            }
+        }
+        else if (name == "MEMSIZE") {
+            env.memory.setLimit(MemoryManager::parseMemSize(value));
+            logLogger.info("NOTE: MEMSIZE set to {}.", MemoryManager::formatKilobytes(env.memory.getLimit()));
+        }
+        else if (name == "OBS") {
+            DataEnvironment::parseObs(value);
+        }
+        else if (name == "SAMPLESEED") {
+            DataEnvironment::parseSampleSeed(value);
+        }
+        else if (name == "SAMPLE") {
+            double sample = DataEnvironment::parseSample(value);
+            if (sample < 1) {
+                logLogger.info("NOTE: Data sets are read as a sample of {:g}% of their rows, results are not those of the full data.", sample * 100);
+            }
+            else if (sample > 1) {
+                logLogger.info("NOTE: Data sets are read as a sample of {:g} rows, results are not those of the full data.", sample);
+            }
+        }
+        else if (name == "DISTINCTPRECISION") {
+            size_t pos = 0;
+            int precision = 0;
+            try {
+                precision = std::stoi(value, &pos);
+            }
+            catch (...) {
+            }
+            if (pos == 0 || pos != value.size() || precision < HyperLogLog::minPrecision || precision > HyperLogLog::maxPrecision) {
+                throw std::runtime_error("DISTINCTPRECISION= must be between " + std::to_string(HyperLogLog::minPrecision)
+                    + " and " + std::to_string(HyperLogLog::maxPrecision) + ": " + value);
+            }
+        }
+        env.setOption(name, value);
+        logLogger.info("Set option {} = {}", name, value);
+    }
+}
+
+int Interpreter::approxDistinctPrecision() {
+    if (env.getOption("APPROXDISTINCT") != "1") {
+        return 0;
+    }
+    std::string precision = env.getOption("DISTINCTPRECISION");
+    return precision.empty() ? HyperLogLog::defaultPrecision : std::stoi(precision);
+}
+
+void Interpreter::noteApproxDistinct(const std::string& what, int precision) {
+    double error = HyperLogLog::standardError(precision) * 100;
+    logLogger.info("NOTE: {} is approximate (HyperLogLog, DISTINCTPRECISION={}): standard error {:.2f}%, "
+        "95% of such counts are within {:.2f}% of the exact count.", what, precision, error, 2 * error);
+}
+
+MemoryManager* Interpreter::fullStimer() {
+    if (env.getOption("FULLSTIMER") != "1") {
+        return nullptr;
+    }
+    // datasets loaded since the last step are counted before it starts
+    env.refreshMemoryUsage();
+    return &env.memory;
+}
+
+void Interpreter::checkMemory() {
+    env.refreshMemoryUsage();
+    for (auto& note : env.takeMemoryNotes()) {
+        logLogger.info(note);
+    }
+}
+
+void Interpreter::runIncremental(ASTNode* step, const std::function<void()>& run) {
+    if (env.getOption("INCREMENTAL") != "1") {
+        run();
+        return;
+    }
+    StepFingerprint fingerprint(step, env, macroVariables);
+    if (fingerprint.isCurrent()) {
+        logLogger.info("NOTE: Step skipped, {} reused from a previous run; its code and inputs are unchanged.", fingerprint.describeOutputs());
+        return;
     }
+    run();
+    // only reached when the step did not fail
+    fingerprint.store();
 }
 
 // Execute a LIBNAME statement
 void Interpreter::executeLibname(LibnameNode* node) {
-    int rc = env.defineLibrary(node->libref, node->path, node->accessMode);
+    int rc = env.defineLibrary(node->libref, node->path, node->accessMode, node->engine);
     if (rc == 0)
     {
         logLogger.info("NOTE: Libref {} was successfully assigned as follows:", node->libref);
-        logLogger.info("      Engine:        V9");
+        logLogger.info("      Engine:        {}", env.getLibrary(node->libref)->getEngine()->getName());
         logLogger.info("      Physical Name : {}", node->path);
     }
+    else if (rc == 2) {
+        logLogger.error("ERROR: The {} engine cannot be found.", node->engine);
+    }
     else {
         logLogger.info("NOTE: Library {} does not exist.", node->libref);
     }
@@ -548,11 +783,17 @@ void Interpreter::executeTitle(TitleNode* node) {
 // Execute a PROC step
 void Interpreter::executeProc(ProcNode* node) {
     if (auto procSort = dynamic_cast<ProcSortNode*>(node)) {
-        executeProcSort(procSort);
+        runIncremental(procSort, [&]() { executeProcSort(procSort); });
     }
     else if (auto procMeans = dynamic_cast<ProcMeansNode*>(node)) {
         executeProcMeans(procMeans);
     }
+    else if (auto procUnivariate = dynamic_cast<ProcUnivariateNode*>(node)) {
+        executeProcUnivariate(procUnivariate);
+    }
+    else if (auto procRank = dynamic_cast<ProcRankNode*>(node)) {
+        executeProcRank(procRank);
+    }
     else if (auto procFreq = dynamic_cast<ProcFreqNode*>(node)) {
         executeProcFreq(procFreq);
     }
@@ -614,19 +855,42 @@ Value Interpreter::evaluate(ASTNode *node) {
         return strNode->value;
     }
     else if (auto var = dynamic_cast<VariableNode*>(node)) {
+        if (!pdv) {
+            // Outside a DATA step (procedure WHERE): the current row
+            if (const Value* v = env.currentRow.columns.find(var->varName, var->slot)) {
+                return *v;
+            }
+            logLimit.warn("Variable '{}' not found. Using missing value.", var->varName);
+            return std::nan("");
+        }
         int idx = pdv->findVarIndex(var->varName);
         if (idx >= 0) {
             return pdv->getValue(idx);
         }
         else {
             // Variable not found, return missing value
-            logLogger.warn("Variable '{}' not found. Using missing value.", var->varName);
+            logLimit.warn("Variable '{}' not found. Using missing value.", var->varName);
             return std::nan("");
         }
     }
     else if (auto funcCall = dynamic_cast<FunctionCallNode*>(node)) {
         return evaluateFunctionCall(funcCall);
     }
+    else if (auto aggregate = dynamic_cast<SqlAggregateNode*>(node)) {
+        auto it = sqlAggregateValues.find(aggregate);
+        if (it == sqlAggregateValues.end()) {
+            throw std::runtime_error("Summary function " + aggregate->function + " is not allowed here.");
+        }
+        return it->second;
+    }
+    else if (auto in = dynamic_cast<SqlInNode*>(node)) {
+        bool found = sqlValues(in).contains(evaluate(in->operand.get()));
+        return found != in->negated ? 1.0 : 0.0;
+    }
+    else if (auto exists = dynamic_cast<SqlExistsNode*>(node)) {
+        bool any = sqlValues(exists).size() > 0;
+        return any != exists->negated ? 1.0 : 0.0;
+    }
     else if (auto arrayElem = dynamic_cast<ArrayElementNode*>(node)) {
         int index = static_cast<int>(toNumber(evaluate(arrayElem->index.get())));
         return getArrayElement(arrayElem->arrayName, index);
@@ -636,6 +900,19 @@ Value Interpreter::evaluate(ASTNode *node) {
         Value rightVal = evaluate(bin->right.get());
         std::string op = bin->op;
 
+        // strings compare as strings, trailing blanks do not count
+        if (std::holds_alternative<std::string>(leftVal) && std::holds_alternative<std::string>(rightVal)) {
+            std::string_view a = std::get<std::string>(leftVal), b = std::get<std::string>(rightVal);
+            a = a.substr(0, a.find_last_not_of(' ') + 1);
+            b = b.substr(0, b.find_last_not_of(' ') + 1);
+            if (op == "==") return a == b ? 1.0 : 0.0;
+            if (op == "!=") return a != b ? 1.0 : 0.0;
+            if (op == "<") return a < b ? 1.0 : 0.0;
+            if (op == ">") return a > b ? 1.0 : 0.0;
+            if (op == "<=") return a <= b ? 1.0 : 0.0;
+            if (op == ">=") return a >= b ? 1.0 : 0.0;
+        }
+
         double l = toNumber(leftVal);
         double r = toNumber(rightVal);
 
@@ -756,7 +1033,7 @@ void Interpreter::executeDo(DoNode* node) {
         increment = toNumber(incVal);
     }
 
-    logLogger.info("Starting DO loop: {} = {} to {} by {}", node->loopVar, start, end, increment);
+    logLimit.info("Starting DO loop: {} = {} to {} by {}", node->loopVar, start, end, increment);
 
     // Initialize loop variable
     env.currentRow.columns[node->loopVar] = start;
@@ -846,47 +1123,98 @@ void Interpreter::executeDo(DoNode* node) {
         throw std::runtime_error("DO loop increment cannot be zero.");
     }
 
-    logLogger.info("Completed DO loop: {} reached {}", node->loopVar, env.currentRow.columns[node->loopVar].index() == 0 ? toString(env.currentRow.columns[node->loopVar]) : "unknown");
+    logLimit.info("Completed DO loop: {} reached {}", node->loopVar, env.currentRow.columns[node->loopVar].index() == 0 ? toString(env.currentRow.columns[node->loopVar]) : "unknown");
+}
+
+namespace {
+    bool isTrue(const Value& condValue) {
+        if (std::holds_alternative<double>(condValue)) {
+            return std::get<double>(condValue) != 0.0;
+        }
+        return !std::get<std::string>(condValue).empty();
+    }
+
+    // Make out the rows of in the selection has, in order; out may be in
+    void keepSelected(Dataset& in, const RowSelection& selection, Dataset& out) {
+        auto inDoc = dynamic_cast<SasDoc*>(&in);
+        auto outDoc = dynamic_cast<SasDoc*>(&out);
+        if (inDoc && outDoc && !inDoc->values.empty()) {
+            size_t width = inDoc->var_count;
+            size_t rows = inDoc->values.size() / std::max<size_t>(width, 1);
+            const Cell* cells = inDoc->values.cdata();
+            std::vector<Cell> kept;
+            kept.reserve(selection.count() * width);
+            for (size_t r = selection.find_first(); r < rows; r = selection.find_next(r)) {
+                kept.insert(kept.end(), cells + r * width, cells + (r + 1) * width);
+            }
+            if (outDoc != inDoc) {
+                std::string name = outDoc->name;
+                *outDoc = *inDoc;
+                outDoc->name = name;
+            }
+            outDoc->values = CowVector<Cell>(std::move(kept));
+            outDoc->obs_count = (int)(outDoc->values.size() / std::max<size_t>(width, 1));
+            if (!outDoc->obs_flag.empty()) {
+                outDoc->obs_flag.clear();
+                outDoc->obs_flag.resize(outDoc->obs_count, true);
+            }
+            return;
+        }
+        std::vector<Row> kept;
+        kept.reserve(selection.count());
+        auto cursor = in.scan({}, 1024, &selection);
+        while (cursor.next()) {
+            const ColumnBatch& batch = cursor.batch();
+            for (size_t i = 0; i < batch.size(); i++) {
+                batch.fillRow(i, kept.emplace_back());
+            }
+        }
+        if (outDoc) {
+            // the rows take the place of any cells
+            outDoc->values = CowVector<Cell>();
+            outDoc->obs_count = 0;
+        }
+        out.rows = CowVector<Row>(std::move(kept));
+    }
 }
 
 void Interpreter::executeProcSort(ProcSortNode* node) {
     logLogger.info("Executing PROC SORT");
 
-    // Retrieve the input dataset
-    Dataset* inputDS = env.getOrCreateDataset(node->inputDataSet).get();
+    // Retrieve the input dataset (held until the end, OUT= may replace it in the library)
+    auto inputPtr = env.getOrCreateDataset(node->inputDataSet);
+    Dataset* inputDS = inputPtr.get();
     if (!inputDS) {
         throw std::runtime_error("Input dataset '" + node->inputDataSet.getFullDsName() + "' not found for PROC SORT.");
     }
 
-    // Apply WHERE condition if specified
+    // Determine the output dataset
+    DatasetRefNode dsNode = node->outputDataSet.dataName.empty() ? node->inputDataSet : node->outputDataSet;
+    bool toInput = node->outputDataSet.dataName.empty() || dsNode.getFullDsName() == node->inputDataSet.getFullDsName();
+
+    // The sort runs on the output data set. With WHERE the rows it selects
+    // are written there; with OUT= alone the output shares the input's
+    // buffers until the sort writes its own, so the input stays as it was
     Dataset* filteredDS = inputDS;
+    std::shared_ptr<Dataset> outputPtr;
     if (node->whereCondition) {
-        // Create a temporary dataset to hold filtered rows
-        DatasetRefNode dsNode;
-        dsNode.dataName = "TEMP_SORT_FILTERED";
-
-        auto tempDS = env.getOrCreateDataset(dsNode);
-        tempDS->rows.clear();
-
-        for (const auto& row : inputDS->rows) {
-            env.currentRow = row;
-            Value condValue = evaluate(node->whereCondition.get());
-            bool conditionTrue = false;
-            if (std::holds_alternative<double>(condValue)) {
-                conditionTrue = (std::get<double>(condValue) != 0.0);
-            }
-            else if (std::holds_alternative<std::string>(condValue)) {
-                conditionTrue = (!std::get<std::string>(condValue).empty());
-            }
-            // Add other data types as needed
-
-            if (conditionTrue) {
-                tempDS->rows.push_back(row);
-            }
+        RowSelection selected = selectWhere(inputDS, node->whereCondition.get());
+        outputPtr = toInput ? inputPtr : env.getOrCreateOutputDataset(dsNode);
+        keepSelected(*inputDS, selected, *outputPtr);
+        filteredDS = outputPtr.get();
+    }
+    else if (!toInput) {
+        outputPtr = env.getOrCreateOutputDataset(dsNode);
+        auto inputDoc = dynamic_cast<SasDoc*>(inputDS);
+        auto outputDoc = dynamic_cast<SasDoc*>(outputPtr.get());
+        if (inputDoc && outputDoc) {
+            *outputDoc = *inputDoc;
+            outputDoc->name = dsNode.dataName;
         }
-
-        filteredDS = tempDS.get();
-        logLogger.info("Applied WHERE condition. {} observations remain after filtering.", filteredDS->rows.size());
+        else {
+            outputPtr->rows = inputDS->rows;
+        }
+        filteredDS = outputPtr.get();
     }
 
     // Sort the filtered dataset by BY variables
@@ -898,92 +1226,121 @@ void Interpreter::executeProcSort(ProcSortNode* node) {
                 return a.empty() ? b : a + ", " + b;
             }));
 
-    // Handle NODUPKEY option
+    // BY key of one row of a batch, e.g. "1.000000_Alice_"
+    auto byKey = [&](const ColumnBatch& batch, size_t i) {
+        std::string key;
+        for (const auto& var : node->byVariables) {
+            int c = batch.columnIndex(var);
+            if (c < 0 || batch.column(c).source < 0) {
+                key += "NA_";
+            }
+            else if (batch.isNumeric(c)) {
+                key += std::to_string(batch.numbers(c)[i]) + "_";
+            }
+            else {
+                key.append(batch.strings(c)[i]).append("_");
+            }
+        }
+        return key;
+    };
+
+    // Handle NODUPKEY option: the first row of each key is kept, in place
     Dataset* sortedDS = filteredDS;
     if (node->nodupkey) {
-        DatasetRefNode dsNode;
-        dsNode.dataName = "TEMP_SORT_NODUPKEY";
-        auto tempDS = env.getOrCreateDataset(dsNode);
-        tempDS->rows.clear();
-
+        RowSelection firsts(sortedDS->scanRowCount());
         std::unordered_set<std::string> seenKeys;
-        for (const auto& row : sortedDS->rows) {
-            std::string key = "";
-            for (const auto& var : node->byVariables) {
-                auto it = row.columns.find(var);
-                if (it != row.columns.end()) {
-                    if (std::holds_alternative<double>(it->second)) {
-                        key += std::to_string(std::get<double>(it->second)) + "_";
-                    }
-                    else if (std::holds_alternative<std::string>(it->second)) {
-                        key += std::get<std::string>(it->second) + "_";
-                    }
-                    // Handle other data types as needed
+        auto cursor = sortedDS->scan(node->byVariables);
+        while (cursor.next()) {
+            const ColumnBatch& batch = cursor.batch();
+            for (size_t i = 0; i < batch.size(); i++) {
+                std::string key = byKey(batch, i);
+                if (seenKeys.insert(key).second) {
+                    firsts.set(batch.rowNumber(i));
                 }
                 else {
-                    key += "NA_";
+                    logLimit.info("Duplicate key '{}' found. Skipping duplicate observation.", key);
                 }
             }
-
-            if (seenKeys.find(key) == seenKeys.end()) {
-                tempDS->rows.push_back(row);
-                seenKeys.insert(key);
-            }
-            else {
-                logLogger.info("Duplicate key '{}' found. Skipping duplicate observation.", key);
-            }
         }
 
-        sortedDS = tempDS.get();
-        logLogger.info("Applied NODUPKEY option. {} observations remain after removing duplicates.", sortedDS->rows.size());
+        keepSelected(*sortedDS, firsts, *sortedDS);
+        logLogger.info("Applied NODUPKEY option. {} observations remain after removing duplicates.", sortedDS->scanRowCount());
     }
 
     // Handle DUPLICATES option
     if (node->duplicates) {
         std::unordered_set<std::string> seenKeys;
-        for (const auto& row : sortedDS->rows) {
-            std::string key = "";
-            for (const auto& var : node->byVariables) {
-                auto it = row.columns.find(var);
-                if (it != row.columns.end()) {
-                    if (std::holds_alternative<double>(it->second)) {
-                        key += std::to_string(std::get<double>(it->second)) + "_";
-                    }
-                    else if (std::holds_alternative<std::string>(it->second)) {
-                        key += std::get<std::string>(it->second) + "_";
-                    }
-                    // Handle other data types as needed
-                }
-                else {
-                    key += "NA_";
+        auto cursor = sortedDS->scan(node->byVariables);
+        while (cursor.next()) {
+            const ColumnBatch& batch = cursor.batch();
+            for (size_t i = 0; i < batch.size(); i++) {
+                std::string key = byKey(batch, i);
+                if (!seenKeys.insert(key).second) {
+                    logLimit.info("Duplicate key '{}' found.", key);
                 }
             }
+        }
+    }
 
-            if (seenKeys.find(key) != seenKeys.end()) {
-                logLogger.info("Duplicate key '{}' found.", key);
-            }
-            else {
-                seenKeys.insert(key);
+    // Hand the sorted data to the output dataset
+    if (!outputPtr) {
+        outputPtr = toInput ? inputPtr : env.getOrCreateOutputDataset(dsNode);
+    }
+    Dataset* outputDS = outputPtr.get();
+    auto sortedDoc = dynamic_cast<SasDoc*>(sortedDS);
+    auto outputDoc = dynamic_cast<SasDoc*>(outputDS);
+    if (sortedDoc && outputDoc && !sortedDoc->values.empty()) {
+        // Sorted cells: the output shares them and is written back through its engine
+        if (outputDoc != sortedDoc) {
+            *outputDoc = *sortedDoc;
+            outputDoc->name = dsNode.dataName;
+        }
+        if (!toInput) {
+            selectOutputColumns(*outputDoc, dsNode.options);
+        }
+        else {
+            // DATA= read with options is not the member itself: the sorted subset replaces it
+            auto library = env.getLibrary(dsNode.libref.empty() ? "WORK" : dsNode.libref);
+            if (library->getDataset(dsNode.dataName) != outputPtr) {
+                library->addDataset(dsNode.dataName, outputPtr);
             }
         }
+        env.saveSas7bdat(dsNode.getFullDsName());
     }
-
-    // Determine the output dataset
-    DatasetRefNode dsNode = node->outputDataSet.dataName.empty() ? node->inputDataSet : node->outputDataSet;
-    Dataset* outputDS = env.getOrCreateDataset(dsNode).get();
-    if (dsNode.dataName != sortedDS->name) {
-        // Copy sortedDS to outputDS
+    else if (outputDS != sortedDS) {
+        // outputDS shares the sorted rows, nothing is copied until one side changes
         outputDS->rows = sortedDS->rows;
-        logLogger.info("Sorted data copied to output dataset '{}'.", dsNode.getFullDsName());
     }
-    else {
-        // Overwrite the input dataset
-        inputDS->rows = sortedDS->rows;
+    if (toInput) {
         logLogger.info("Input dataset '{}' overwritten with sorted data.", inputDS->name);
     }
+    else {
+        logLogger.info("Sorted data copied to output dataset '{}'.", dsNode.getFullDsName());
+    }
 
     logLogger.info("PROC SORT executed successfully. Output dataset '{}' has {} observations.",
-        dsNode.getFullDsName(), outputDS->rows.size());
+        dsNode.getFullDsName(), outputDS->scanRowCount());
+}
+
+// The rows of inputDS a WHERE condition selects. Comparisons with constants
+// run over the columns; the rest of the condition is evaluated on
+// env.currentRow, only for the rows still undecided.
+RowSelection Interpreter::selectWhere(Dataset* inputDS, ASTNode* whereCondition) {
+    // the values of IN (subquery) are for this condition only, however it ends
+    struct ValueSetsScope {
+        Interpreter* self;
+        ~ValueSetsScope() { self->sqlValueSets.clear(); }
+    } valueSetsScope{ this };
+    env.currentRow.columns.clear();
+    WhereFilter filter(whereCondition, [&](ASTNode* part, const ColumnBatch& batch, size_t i) {
+        batch.fillRow(i, env.currentRow);
+        return isTrue(evaluate(part));
+    });
+    RowSelection selected = filter.select(*inputDS);
+    env.currentRow.columns.clear();
+
+    logLogger.info("Applied WHERE condition. {} observations remain after filtering.", selected.count());
+    return selected;
 }
 
 void Interpreter::executeProcMeans(ProcMeansNode* node) {
@@ -996,33 +1353,9 @@ void Interpreter::executeProcMeans(ProcMeansNode* node) {
     }
 
     // Apply WHERE condition if specified
-    Dataset* filteredDS = inputDS;
+    std::optional<RowSelection> selected;
     if (node->whereCondition) {
-        // Create a temporary dataset to hold filtered rows
-        DatasetRefNode dsNode;
-        dsNode.dataName = "TEMP_MEANS_FILTERED";
-        auto tempDS = env.getOrCreateDataset(dsNode);
-        tempDS->rows.clear();
-
-        for (const auto& row : inputDS->rows) {
-            env.currentRow = row;
-            Value condValue = evaluate(node->whereCondition.get());
-            bool conditionTrue = false;
-            if (std::holds_alternative<double>(condValue)) {
-                conditionTrue = (std::get<double>(condValue) != 0.0);
-            }
-            else if (std::holds_alternative<std::string>(condValue)) {
-                conditionTrue = (!std::get<std::string>(condValue).empty());
-            }
-            // Add other data types as needed
-
-            if (conditionTrue) {
-                tempDS->rows.push_back(row);
-            }
-        }
-
-        filteredDS = tempDS.get();
-        logLogger.info("Applied WHERE condition. {} observations remain after filtering.", filteredDS->rows.size());
+        selected = selectWhere(inputDS, node->whereCondition.get());
     }
 
     // Initialize statistics containers
@@ -1038,25 +1371,39 @@ void Interpreter::executeProcMeans(ProcMeansNode* node) {
 
     std::unordered_map<std::string, Stats> statisticsMap;
 
+    // The value buffers kept for the median are charged in blocks
+    const size_t chargeBlock = 4096;
+    MemoryCharge charge(env.memory, "PROCEDURE MEANS");
+
     // Initialize Stats for each variable
     for (const auto& var : node->varVariables) {
         statisticsMap[var] = Stats();
     }
 
-    // Calculate statistics
-    for (const auto& row : filteredDS->rows) {
-        for (const auto& var : node->varVariables) {
-            auto it = row.columns.find(var);
-            if (it != row.columns.end() && std::holds_alternative<double>(it->second)) {
-                double val = std::get<double>(it->second);
-                statisticsMap[var].n += 1;
-                statisticsMap[var].mean += val;
-                statisticsMap[var].values.push_back(val);
-                if (statisticsMap[var].n == 1 || val < statisticsMap[var].min) {
-                    statisticsMap[var].min = val;
+    // Calculate statistics, one column of a batch at a time
+    auto cursor = inputDS->scan(node->varVariables, 1024, selected ? &*selected : nullptr);
+    while (cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t c = 0; c < batch.columnCount(); c++) {
+            if (!batch.isNumeric(c) || batch.column(c).source < 0) {
+                continue;
+            }
+            Stats& stats = statisticsMap[batch.column(c).name];
+            for (double val : batch.numbers(c)) {
+                if (std::isnan(val) || val == -INFINITY) {
+                    continue; // missing
+                }
+                stats.n += 1;
+                stats.mean += val;
+                stats.values.push_back(val);
+                if (stats.values.size() % chargeBlock == 1) {
+                    charge.require(chargeBlock * sizeof(double));
+                }
+                if (stats.n == 1 || val < stats.min) {
+                    stats.min = val;
                 }
-                if (statisticsMap[var].n == 1 || val > statisticsMap[var].max) {
-                    statisticsMap[var].max = val;
+                if (stats.n == 1 || val > stats.max) {
+                    stats.max = val;
                 }
             }
         }
@@ -1091,8 +1438,12 @@ void Interpreter::executeProcMeans(ProcMeansNode* node) {
 
     // Prepare output dataset if specified
     Dataset* outputDS = nullptr;
+    auto statSchema = std::make_shared<Schema>();
     if (!node->outputDataSet.dataName.empty()) {
-        outputDS = env.getOrCreateDataset(node->outputDataSet).get();
+        if (!node->outputDataSet.options.isDefault()) {
+            throw std::runtime_error("Data set options are not supported on the output of PROC MEANS.");
+        }
+        outputDS = env.getOrCreateOutputDataset(node->outputDataSet).get();
         outputDS->rows.clear();
     }
 
@@ -1126,8 +1477,8 @@ void Interpreter::executeProcMeans(ProcMeansNode* node) {
             logLogger.info(ss.str());
 
             if (outputDS) {
-                // Create a row for each statistic
-                Row statRow;
+                // Create a row for each statistic, the rows share one schema
+                Row statRow{ RowColumns(statSchema) };
                 statRow.columns["Variable"] = var;
                 for (const auto& stat : node->statistics) {
                     if (stat == "N") {
@@ -1243,6 +1594,20 @@ Value Interpreter::evaluateFunctionCall(FunctionCallNode* node) {
         }
         return str.substr(position, length);
     }
+    else if (func == "cats") {
+        // cats(item, ...): the items without leading and trailing blanks, concatenated
+        std::string result;
+        for (const auto& argument : node->arguments) {
+            Value v = evaluate(argument.get());
+            if (auto d = std::get_if<double>(&v)) {
+                appendNumber(result, *d);
+            }
+            else {
+                result += strip(std::get<std::string>(v));
+            }
+        }
+        return result;
+    }
     else if (func == "trim") {
         // trim(string)
         if (node->arguments.size() != 1) {
@@ -1501,6 +1866,10 @@ void Interpreter::executeMerge(MergeStatementNode* node) {
     auto outputDataSet = env.getCurrentDataSet();
     outputDataSet->rows.clear();
 
+    // Slots of the BY variables in each dataset's rows, and the merged rows' schema
+    std::vector<std::vector<SlotCache>> bySlots(numDatasets, std::vector<SlotCache>(byVariables.size()));
+    auto mergedSchema = std::make_shared<Schema>();
+
     bool continueMerging = true;
 
     while (continueMerging) {
@@ -1513,13 +1882,10 @@ void Interpreter::executeMerge(MergeStatementNode* node) {
                 anyDatasetHasRows = true;
                 const Row& row = mergeDatasets[i]->rows[iterators[i]];
                 std::vector<double> byVals;
-                for (const auto& var : byVariables) {
-                    double val = 0.0;
-                    auto it = row.columns.find(var);
-                    if (it != row.columns.end() && std::holds_alternative<double>(it->second)) {
-                        val = std::get<double>(it->second);
-                    }
-                    byVals.push_back(val);
+                for (size_t j = 0; j < byVariables.size(); j++) {
+                    const Value* v = row.columns.find(byVariables[j], bySlots[i][j]);
+                    const double* d = v ? std::get_if<double>(v) : nullptr;
+                    byVals.push_back(d ? *d : 0.0);
                 }
                 currentBYValues[i] = byVals;
             }
@@ -1598,22 +1964,19 @@ void Interpreter::executeMerge(MergeStatementNode* node) {
         }
 
         // Merge the matched rows into a single row
-        Row mergedRow;
+        Row mergedRow{ RowColumns(mergedSchema) };
         for (const auto& row : matchedRows) {
             for (const auto& col : row.columns) {
+                size_t slot = mergedSchema->add(col.first);
                 // Avoid overwriting BY variables
-                if (std::find(byVariables.begin(), byVariables.end(), col.first) != byVariables.end()) {
-                    mergedRow.columns[col.first] = col.second;
+                if (std::find(byVariables.begin(), byVariables.end(), col.first) != byVariables.end()
+                    || !mergedRow.columns.slot(slot)) {
+                    mergedRow.columns.emplace(slot) = col.second;
                 }
                 else {
                     // Handle variable name conflicts by prefixing with dataset name
-                    if (mergedRow.columns.find(col.first) == mergedRow.columns.end()) {
-                        mergedRow.columns[col.first] = col.second;
-                    }
-                    else {
-                        std::string newColName = row.columns.begin()->first + "_" + col.first;
-                        mergedRow.columns[newColName] = col.second;
-                    }
+                    std::string newColName = row.columns.begin()->first + "_" + col.first;
+                    mergedRow.columns.emplace(mergedSchema->add(newColName)) = col.second;
                 }
             }
         }
@@ -1641,7 +2004,7 @@ void Interpreter::executeBy(ByStatementNode* node) {
 }
 
 void Interpreter::executeDoLoop(DoLoopNode* node) {
-    logLogger.info("Entering DO loop");
+    logLimit.info("Entering DO loop");
 
     // Push the loop context onto the stack
     loopStack.emplace(std::make_pair(node, 0));
@@ -1678,7 +2041,7 @@ void Interpreter::executeDoLoop(DoLoopNode* node) {
         else {
             // Exit the loop
             loopStack.pop();
-            logLogger.info("Exiting DO loop");
+            logLimit.info("Exiting DO loop");
             break;
         }
 
@@ -1693,124 +2056,618 @@ void Interpreter::executeEnd(EndNode* node) {
 
     // Pop the current loop context to signify exiting the loop
     loopStack.pop();
-    logLogger.info("Exiting DO loop via END statement");
+    logLimit.info("Exiting DO loop via END statement");
 }
 
-void Interpreter::executeProcFreq(ProcFreqNode* node) {
-    logLogger.info("Executing PROC FREQ");
+namespace {
+    // Percent of a quantile keyword of the OUTPUT statement (Q1, MEDIAN, P90, ...), -1 if it is not one
+    double quantilePercent(const std::string& keyword) {
+        if (keyword == "Q1") return 25;
+        if (keyword == "MEDIAN") return 50;
+        if (keyword == "Q3") return 75;
+        if (keyword.size() > 1 && keyword[0] == 'P'
+            && std::all_of(keyword.begin() + 1, keyword.end(), [](char c) { return std::isdigit((unsigned char)c) || c == '_'; })) {
+            std::string digits = keyword.substr(1);
+            std::replace(digits.begin(), digits.end(), '_', '.');
+            return std::stod(digits);
+        }
+        return -1;
+    }
+
+    double quantileOf(const UnivariateStats& stats, double percent) {
+        auto it = std::find(stats.percents.begin(), stats.percents.end(), percent);
+        return it == stats.percents.end() ? NAN : stats.quantiles[it - stats.percents.begin()];
+    }
+
+    // A statistic of the OUTPUT statement, false if keyword is not one
+    bool univariateStatistic(const std::string& keyword, const UnivariateStats& stats, double& value) {
+        double percent = quantilePercent(keyword);
+        if (percent >= 0) {
+            value = quantileOf(stats, percent);
+            return true;
+        }
+        static const std::unordered_map<std::string, std::function<double(const UnivariateStats&)>> moments = {
+            { "N", [](const UnivariateStats& s) { return (double)s.n; } },
+            { "NMISS", [](const UnivariateStats& s) { return (double)s.nmiss; } },
+            { "NOBS", [](const UnivariateStats& s) { return (double)(s.n + s.nmiss); } },
+            { "SUM", [](const UnivariateStats& s) { return s.sum; } },
+            { "MEAN", [](const UnivariateStats& s) { return s.mean; } },
+            { "STD", [](const UnivariateStats& s) { return s.stdDev; } },
+            { "VAR", [](const UnivariateStats& s) { return s.variance; } },
+            { "SKEWNESS", [](const UnivariateStats& s) { return s.skewness; } },
+            { "KURTOSIS", [](const UnivariateStats& s) { return s.kurtosis; } },
+            { "USS", [](const UnivariateStats& s) { return s.uss; } },
+            { "CSS", [](const UnivariateStats& s) { return s.css; } },
+            { "CV", [](const UnivariateStats& s) { return s.cv; } },
+            { "STDMEAN", [](const UnivariateStats& s) { return s.stdMean; } },
+            { "MIN", [](const UnivariateStats& s) { return s.min; } },
+            { "MAX", [](const UnivariateStats& s) { return s.max; } },
+            { "RANGE", [](const UnivariateStats& s) { return s.max - s.min; } },
+            { "QRANGE", [](const UnivariateStats& s) { return quantileOf(s, 75) - quantileOf(s, 25); } },
+        };
+        auto it = moments.find(keyword);
+        if (it == moments.end()) {
+            return false;
+        }
+        value = it->second(stats);
+        return true;
+    }
+
+    std::string univariateNumber(double v) {
+        return std::isnan(v) ? "." : fmt::format("{:.8g}", v);
+    }
+}
+
+void Interpreter::executeProcUnivariate(ProcUnivariateNode* node) {
+    ScopedStepTimer timer("PROCEDURE UNIVARIATE", logLogger, fullStimer());
 
-    // Retrieve the input dataset
     Dataset* inputDS = env.getOrCreateDataset(node->inputDataSet).get();
     if (!inputDS) {
-        throw std::runtime_error("Input dataset '" + node->inputDataSet.getFullDsName() + "' not found for PROC FREQ.");
+        throw std::runtime_error("Input dataset '" + node->inputDataSet.getFullDsName() + "' not found for PROC UNIVARIATE.");
     }
 
-    // Apply WHERE condition if specified
-    Dataset* filteredDS = inputDS;
-    if (node->whereCondition) {
-        // Create a temporary dataset to hold filtered rows
-        DatasetRefNode dsNode;
-        dsNode.dataName = "TEMP_FREQ_FILTERED";
-        auto tempDS = env.getOrCreateDataset(dsNode);
-        tempDS->rows.clear();
-
-        for (const auto& row : inputDS->rows) {
-            env.currentRow = row;
-            Value condValue = evaluate(node->whereCondition.get());
-            bool conditionTrue = false;
-            if (std::holds_alternative<double>(condValue)) {
-                conditionTrue = (std::get<double>(condValue) != 0.0);
+    // VAR variables, every numeric variable when there is no VAR statement
+    std::vector<std::string> vars;
+    {
+        auto cursor = inputDS->scan(node->varVariables, 1);
+        for (size_t c = 0; c < cursor.batch().columnCount(); c++) {
+            const auto& column = cursor.batch().column(c);
+            if (node->varVariables.empty()) {
+                if (column.numeric && column.source >= 0) vars.push_back(column.name);
+                continue;
+            }
+            if (column.source < 0) {
+                throw std::runtime_error("Variable " + column.name + " not found.");
             }
-            else if (std::holds_alternative<std::string>(condValue)) {
-                conditionTrue = (!std::get<std::string>(condValue).empty());
+            if (!column.numeric) {
+                throw std::runtime_error("Variable " + column.name + " in list does not match type prescribed for this list.");
             }
-            // Add other data types as needed
+            vars.push_back(column.name);
+        }
+    }
 
-            if (conditionTrue) {
-                tempDS->rows.push_back(row);
+    std::vector<std::string> histogramVars;
+    if (node->histogram) {
+        histogramVars = node->histogramVariables.empty() ? vars : node->histogramVariables;
+        for (auto& var : histogramVars) {
+            if (std::find(vars.begin(), vars.end(), var) == vars.end()) {
+                throw std::runtime_error("Variable " + var + " in the HISTOGRAM statement is not in the VAR statement.");
             }
         }
+    }
+    size_t nbins = 0;
+    auto nbinsOption = node->histogramOptions.find("NBINS");
+    if (nbinsOption != node->histogramOptions.end()) {
+        nbins = std::stoul(nbinsOption->second);
+    }
+    size_t nextrobs = 5;
+    auto nextrobsOption = node->options.find("NEXTROBS");
+    if (nextrobsOption != node->options.end()) {
+        nextrobs = std::stoul(nextrobsOption->second);
+    }
+    bool noprint = node->options.count("NOPRINT") > 0;
 
-        filteredDS = tempDS.get();
-        logLogger.info("Applied WHERE condition. {} observations remain after filtering.", filteredDS->rows.size());
+    // The percentiles shown plus those of the OUTPUT statement, checked before any value is read
+    std::vector<double> percents = Univariate::defaultPercents();
+    std::vector<double> pctlpts;
+    std::vector<std::string> pctlpre;
+    for (auto& stat : node->outputStatistics) {
+        double value;
+        if (stat.first == "PCTLPTS") {
+            for (auto& p : stat.second) pctlpts.push_back(std::stod(p));
+        }
+        else if (stat.first == "PCTLPRE") {
+            pctlpre = stat.second;
+        }
+        else if (quantilePercent(stat.first) >= 0) {
+            if (std::find(percents.begin(), percents.end(), quantilePercent(stat.first)) == percents.end()) {
+                percents.push_back(quantilePercent(stat.first));
+            }
+        }
+        else if (!univariateStatistic(stat.first, UnivariateStats(), value)) {
+            throw std::runtime_error("Unknown statistic " + stat.first + " in the OUTPUT statement of PROC UNIVARIATE.");
+        }
+    }
+    for (double p : pctlpts) {
+        if (std::find(percents.begin(), percents.end(), p) == percents.end()) {
+            percents.push_back(p);
+        }
     }
 
-    // Process each table specification
-    for (const auto& tablePair : node->tables) {
-        std::string tableSpec = tablePair.first;
-        std::vector<std::string> tableOptions = tablePair.second;
+    // Output: one observation, a variable per statistic and analysis variable
+    std::vector<std::string> outNames;
+    std::vector<double> outValues;
 
-        // Split tableSpec into variables, e.g., var1 or var1*var2
-        std::vector<std::string> vars;
-        size_t starPos = tableSpec.find('*');
-        if (starPos != std::string::npos) {
-            vars.push_back(tableSpec.substr(0, starPos));
-            vars.push_back(tableSpec.substr(starPos + 1));
-        }
-        else {
-            vars.push_back(tableSpec);
+    // one column of doubles at a time is held in memory
+    MemoryCharge charge(env.memory, "PROCEDURE UNIVARIATE");
+    size_t rows = inputDS->scanRowCount();
+    for (size_t v = 0; v < vars.size(); v++) {
+        const std::string& var = vars[v];
+        charge.require(rows * sizeof(double));
+        std::vector<double> values;
+        values.reserve(rows);
+        auto cursor = inputDS->scan({ var }, 65536);
+        while (cursor.next()) {
+            auto numbers = cursor.batch().numbers(0);
+            values.insert(values.end(), numbers.begin(), numbers.end());
         }
 
-        if (vars.size() == 1) {
-            // Single variable frequency table
-            std::map<std::string, int> freqMap;
-            for (const auto& row : filteredDS->rows) {
-                auto it = row.columns.find(vars[0]);
-                if (it != row.columns.end()) {
-                    std::string key;
-                    if (std::holds_alternative<double>(it->second)) {
-                        key = std::to_string(std::get<double>(it->second));
-                    }
-                    else if (std::holds_alternative<std::string>(it->second)) {
-                        key = std::get<std::string>(it->second);
-                    }
-                    // Handle other data types as needed
+        UnivariateStats stats = Univariate::compute(values, percents, nextrobs);
+        Histogram histogram;
+        bool hasHistogram = std::find(histogramVars.begin(), histogramVars.end(), var) != histogramVars.end();
+        if (hasHistogram) {
+            // the missing values are gone by now, the order does not matter
+            histogram = Univariate::histogram(values, nbins);
+        }
+        if (!noprint) {
+            printUnivariate(var, stats, hasHistogram ? &histogram : nullptr);
+        }
 
-                    freqMap[key]++;
-                }
+        for (auto& stat : node->outputStatistics) {
+            double value;
+            if (stat.first == "PCTLPTS" || stat.first == "PCTLPRE") {
+                continue;
             }
-
-            // Log frequency table
-            std::stringstream ss;
-            ss << "Frequency Table for Variable: " << vars[0] << "\n";
-            ss << "Value\tFrequency\n";
-            for (const auto& pair : freqMap) {
-                ss << pair.first << "\t" << pair.second << "\n";
+            if (v < stat.second.size() && univariateStatistic(stat.first, stats, value)) {
+                outNames.push_back(stat.second[v]);
+                outValues.push_back(value);
             }
-            logLogger.info(ss.str());
+        }
+        if (v < pctlpre.size()) {
+            for (double p : pctlpts) {
+                // 2.5 => P2_5
+                std::string suffix = fmt::format("{:g}", p);
+                std::replace(suffix.begin(), suffix.end(), '.', '_');
+                outNames.push_back(pctlpre[v] + suffix);
+                outValues.push_back(quantileOf(stats, p));
+            }
+        }
+        charge.shrink(charge.size());
+    }
 
-            // Handle OUTPUT options if any (e.g., OUT=)
-            // This implementation focuses on logging frequencies. Extending to output datasets can be added here.
+    if (!node->outputDataSet.dataName.empty()) {
+        auto outDoc = std::dynamic_pointer_cast<SasDoc>(env.getOrCreateOutputDataset(node->outputDataSet));
+        if (!outDoc) {
+            throw std::runtime_error("Output dataset '" + node->outputDataSet.getFullDsName() + "' cannot be created for PROC UNIVARIATE.");
         }
-        else if (vars.size() == 2) {
-            // Cross-tabulation
-            std::map<std::string, std::map<std::string, int>> crosstab;
-            std::set<std::string> var1Levels;
-            std::set<std::string> var2Levels;
+        *outDoc = SasDoc();
+        outDoc->name = node->outputDataSet.dataName;
+        outDoc->var_count = (int)outNames.size();
+        outDoc->obs_count = 1;
+        outDoc->var_names = outNames;
+        outDoc->var_labels.assign(outNames.size(), "");
+        outDoc->var_formats.assign(outNames.size(), "");
+        outDoc->var_types.assign(outNames.size(), READSTAT_TYPE_DOUBLE);
+        outDoc->var_length.assign(outNames.size(), 8);
+        outDoc->var_display_length.assign(outNames.size(), 8);
+        outDoc->var_decimals.assign(outNames.size(), 0);
+        std::vector<Cell> cells;
+        for (double value : outValues) {
+            cells.push_back(std::isnan(value) ? -INFINITY : value);
+        }
+        outDoc->values = CowVector<Cell>(std::move(cells));
+        selectOutputColumns(*outDoc, node->outputDataSet.options);
+        env.saveSas7bdat(node->outputDataSet.getFullDsName());
+        logLogger.info("NOTE: The data set {} has 1 observations and {} variables.",
+            node->outputDataSet.getFullDsName(), outDoc->var_count);
+    }
+}
 
-            for (const auto& row : filteredDS->rows) {
-                auto it1 = row.columns.find(vars[0]);
-                auto it2 = row.columns.find(vars[1]);
+void Interpreter::printUnivariate(const std::string& var, const UnivariateStats& stats, const Histogram* histogram) {
+    auto num = univariateNumber;
+    lstLogger.info(env.title);
+    lstLogger.info("The UNIVARIATE Procedure");
+    lstLogger.info("Variable:  {}", var);
+    lstLogger.info("");
 
-                if (it1 != row.columns.end() && it2 != row.columns.end()) {
-                    std::string key1, key2;
-                    if (std::holds_alternative<double>(it1->second)) {
-                        key1 = std::to_string(std::get<double>(it1->second));
-                    }
-                    else if (std::holds_alternative<std::string>(it1->second)) {
-                        key1 = std::get<std::string>(it1->second);
-                    }
+    lstLogger.info("Moments");
+    auto pair = [&](const std::string& l1, const std::string& v1, const std::string& l2, const std::string& v2) {
+        lstLogger.info("{:<18}{:>14}    {:<18}{:>14}", l1, v1, l2, v2);
+    };
+    pair("N", std::to_string(stats.n), "Sum Weights", std::to_string(stats.n));
+    pair("Mean", num(stats.mean), "Sum Observations", num(stats.sum));
+    pair("Std Deviation", num(stats.stdDev), "Variance", num(stats.variance));
+    pair("Skewness", num(stats.skewness), "Kurtosis", num(stats.kurtosis));
+    pair("Uncorrected SS", num(stats.uss), "Corrected SS", num(stats.css));
+    pair("Coeff Variation", num(stats.cv), "Std Error Mean", num(stats.stdMean));
+    lstLogger.info("");
+
+    lstLogger.info("Quantiles (Definition 5)");
+    lstLogger.info("{:<14}{:>14}", "Level", "Quantile");
+    for (size_t i = 0; i < stats.percents.size(); i++) {
+        double p = stats.percents[i];
+        std::string level = fmt::format("{:g}%", p);
+        if (p == 100) level += " Max";
+        else if (p == 75) level += " Q3";
+        else if (p == 50) level += " Median";
+        else if (p == 25) level += " Q1";
+        else if (p == 0) level += " Min";
+        lstLogger.info("{:<14}{:>14}", level, num(stats.quantiles[i]));
+    }
+    lstLogger.info("");
+
+    lstLogger.info("Extreme Observations");
+    lstLogger.info("{:-^24}    {:-^24}", "Lowest", "Highest");
+    lstLogger.info("{:>14}{:>10}    {:>14}{:>10}", "Value", "Obs", "Value", "Obs");
+    for (size_t i = 0; i < std::max(stats.lowest.size(), stats.highest.size()); i++) {
+        std::string low = i < stats.lowest.size()
+            ? fmt::format("{:>14}{:>10}", num(stats.lowest[i].value), stats.lowest[i].obs) : std::string(24, ' ');
+        std::string high = i < stats.highest.size()
+            ? fmt::format("{:>14}{:>10}", num(stats.highest[i].value), stats.highest[i].obs) : "";
+        lstLogger.info("{}    {}", low, high);
+    }
+
+    if (stats.nmiss > 0) {
+        lstLogger.info("");
+        lstLogger.info("Missing Values");
+        lstLogger.info("{:<14}{:>10}{:>14}", "Missing Value", "Count", "Percent");
+        lstLogger.info("{:<14}{:>10}{:>14.2f}", ".", stats.nmiss, 100.0 * stats.nmiss / (stats.n + stats.nmiss));
+    }
+
+    if (histogram && !histogram->counts.empty()) {
+        lstLogger.info("");
+        lstLogger.info("Histogram");
+        lstLogger.info("{:>14}{:>10}{:>10}", "Bin Midpoint", "Count", "Percent");
+        size_t most = *std::max_element(histogram->counts.begin(), histogram->counts.end());
+        for (size_t b = 0; b < histogram->counts.size(); b++) {
+            size_t count = histogram->counts[b];
+            // bars of at most 40 stars
+            size_t stars = most == 0 ? 0 : (count * 40 + most - 1) / most;
+            lstLogger.info("{:>14}{:>10}{:>10.2f}  {}", num(histogram->midpoint(b)), count,
+                100.0 * count / stats.n, std::string(stars, '*'));
+        }
+    }
+    lstLogger.info("");
+}
 
-                    if (std::holds_alternative<double>(it2->second)) {
-                        key2 = std::to_string(std::get<double>(it2->second));
-                    }
-                    else if (std::holds_alternative<std::string>(it2->second)) {
-                        key2 = std::get<std::string>(it2->second);
-                    }
+void Interpreter::executeProcRank(ProcRankNode* node) {
+    ScopedStepTimer timer("PROCEDURE RANK", logLogger, fullStimer());
 
-                    crosstab[key1][key2]++;
-                    var1Levels.insert(key1);
-                    var2Levels.insert(key2);
+    auto inputPtr = env.getOrCreateDataset(node->inputDataSet);
+    Dataset* inputDS = inputPtr.get();
+    if (!inputDS) {
+        throw std::runtime_error("Input dataset '" + node->inputDataSet.getFullDsName() + "' not found for PROC RANK.");
+    }
+
+    Ranker::Options options;
+    auto option = node->options.find("TIES");
+    if (option != node->options.end()) {
+        options.ties = option->second == "LOW" ? RankTies::Low
+            : option->second == "HIGH" ? RankTies::High
+            : option->second == "DENSE" ? RankTies::Dense
+            : RankTies::Mean;
+    }
+    option = node->options.find("GROUPS");
+    if (option != node->options.end()) {
+        options.groups = std::stoul(option->second);
+    }
+    options.descending = node->options.count("DESCENDING") > 0;
+
+    // The VAR columns (every numeric one without a VAR statement) and the BY columns, in one scan
+    std::vector<std::string> vars = node->varVariables;
+    if (vars.empty()) {
+        auto cursor = inputDS->scan({}, 1);
+        for (size_t c = 0; c < cursor.batch().columnCount(); c++) {
+            const auto& column = cursor.batch().column(c);
+            bool isBy = std::find(node->byVariables.begin(), node->byVariables.end(), column.name) != node->byVariables.end();
+            if (column.numeric && column.source >= 0 && !isBy) vars.push_back(column.name);
+        }
+    }
+    if (!node->rankVariables.empty() && node->rankVariables.size() != vars.size()) {
+        throw std::runtime_error("The RANKS statement has " + std::to_string(node->rankVariables.size())
+            + " variables, the VAR statement " + std::to_string(vars.size()) + ".");
+    }
+    std::vector<std::string> names = vars;
+    names.insert(names.end(), node->byVariables.begin(), node->byVariables.end());
+
+    size_t rows = inputDS->scanRowCount();
+    MemoryCharge charge(env.memory, "PROCEDURE RANK");
+    charge.require(2 * rows * vars.size() * sizeof(double));
+
+    std::vector<std::vector<double>> columns(vars.size());
+    for (auto& column : columns) {
+        column.reserve(rows);
+    }
+    // BY groups are runs of equal BY values, the data has to be sorted by them
+    std::vector<size_t> groupStarts = { 0 };
+    std::vector<double> lastNumber(node->byVariables.size());
+    std::vector<std::string> lastString(node->byVariables.size());
+    auto cursor = inputDS->scan(names, 65536);
+    for (size_t c = 0; c < names.size(); c++) {
+        const auto& column = cursor.batch().column(c);
+        if (column.source < 0) {
+            throw std::runtime_error("Variable " + column.name + " not found.");
+        }
+        if (c < vars.size() && !column.numeric) {
+            throw std::runtime_error("Variable " + column.name + " in list does not match type prescribed for this list.");
+        }
+    }
+    while (cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t c = 0; c < vars.size(); c++) {
+            auto numbers = batch.numbers(c);
+            columns[c].insert(columns[c].end(), numbers.begin(), numbers.end());
+        }
+        for (size_t r = 0; r < batch.size(); r++) {
+            size_t row = batch.firstRow() + r;
+            int cmp = 0;
+            for (size_t b = 0; b < node->byVariables.size() && cmp == 0; b++) {
+                size_t c = vars.size() + b;
+                if (batch.isNumeric(c)) {
+                    double v = batch.numbers(c)[r];
+                    cmp = v < lastNumber[b] ? -1 : v > lastNumber[b] ? 1 : 0;
+                }
+                else {
+                    cmp = batch.strings(c)[r].compare(lastString[b]);
+                }
+            }
+            if (row > 0 && cmp < 0) {
+                throw std::runtime_error("Data set " + node->inputDataSet.getFullDsName()
+                    + " is not sorted in ascending sequence of the BY variables.");
+            }
+            if (row > 0 && cmp > 0) {
+                groupStarts.push_back(row);
+            }
+            if (row == 0 || cmp != 0) {
+                for (size_t b = 0; b < node->byVariables.size(); b++) {
+                    size_t c = vars.size() + b;
+                    if (batch.isNumeric(c)) lastNumber[b] = batch.numbers(c)[r];
+                    else lastString[b] = std::string(batch.strings(c)[r]);
+                }
+            }
+        }
+    }
+    groupStarts.push_back(rows);
+
+    auto ranks = Ranker::rank(columns, groupStarts, options);
+    columns.clear();
+
+    // The output: the input as it is, rows in the same order, with the
+    // ranks in new columns (RANKS) or in place of the VAR values
+    SasDoc out;
+    auto inputDoc = dynamic_cast<SasDoc*>(inputDS);
+    bool cellBacked = inputDoc && (!inputDoc->values.empty() || inputDoc->rows.empty());
+    if (cellBacked) {
+        out.var_names = inputDoc->var_names;
+        out.var_labels = inputDoc->var_labels;
+        out.var_formats = inputDoc->var_formats;
+        out.var_types = inputDoc->var_types;
+        out.var_length = inputDoc->var_length;
+        out.var_display_length = inputDoc->var_display_length;
+        out.var_decimals = inputDoc->var_decimals;
+    }
+    else {
+        auto described = inputDS->scan({}, 1);
+        for (size_t c = 0; c < described.batch().columnCount(); c++) {
+            const auto& column = described.batch().column(c);
+            out.var_names.push_back(column.name);
+            out.var_labels.push_back("");
+            out.var_formats.push_back("");
+            out.var_types.push_back(column.numeric ? READSTAT_TYPE_DOUBLE : READSTAT_TYPE_STRING);
+            out.var_length.push_back(8);
+            out.var_display_length.push_back(8);
+            out.var_decimals.push_back(0);
+        }
+    }
+    size_t inputWidth = out.var_names.size();
+    std::vector<size_t> targets;
+    for (size_t v = 0; v < vars.size(); v++) {
+        const std::string& name = node->rankVariables.empty() ? vars[v] : node->rankVariables[v];
+        auto it = std::find_if(out.var_names.begin(), out.var_names.end(),
+            [&](const std::string& n) { return to_upper(n) == to_upper(name); });
+        if (it != out.var_names.end()) {
+            targets.push_back(it - out.var_names.begin());
+            out.var_types[targets.back()] = READSTAT_TYPE_DOUBLE;
+            continue;
+        }
+        targets.push_back(out.var_names.size());
+        out.var_names.push_back(name);
+        out.var_labels.push_back("");
+        out.var_formats.push_back("");
+        out.var_types.push_back(READSTAT_TYPE_DOUBLE);
+        out.var_length.push_back(8);
+        out.var_display_length.push_back(8);
+        out.var_decimals.push_back(0);
+    }
+    size_t width = out.var_names.size();
+
+    std::vector<Cell> cells;
+    cells.reserve(rows * width);
+    if (cellBacked) {
+        const Cell* in = inputDoc->values.cdata();
+        for (size_t r = 0; r < rows; r++) {
+            cells.insert(cells.end(), in + r * inputWidth, in + (r + 1) * inputWidth);
+            cells.resize(cells.size() + width - inputWidth, Cell(-INFINITY));
+        }
+    }
+    else {
+        auto all = inputDS->scan(std::vector<std::string>(out.var_names.begin(), out.var_names.begin() + inputWidth));
+        while (all.next()) {
+            const ColumnBatch& batch = all.batch();
+            for (size_t r = 0; r < batch.size(); r++) {
+                for (size_t c = 0; c < inputWidth; c++) {
+                    if (batch.isNumeric(c)) cells.push_back(batch.numbers(c)[r]);
+                    else cells.push_back(flyweight_string(std::string(batch.strings(c)[r])));
+                }
+                cells.resize(cells.size() + width - inputWidth, Cell(-INFINITY));
+            }
+        }
+    }
+    // scatter the ranks back to the rows they belong to
+    for (size_t v = 0; v < vars.size(); v++) {
+        for (size_t r = 0; r < rows; r++) {
+            cells[r * width + targets[v]] = ranks[v][r];
+        }
+    }
+    out.values = CowVector<Cell>(std::move(cells));
+    out.var_count = (int)width;
+    out.obs_count = (int)rows;
+
+    // without OUT= the output is WORK.DATAn, as in SAS
+    DatasetRefNode outRef = node->outputDataSet;
+    if (outRef.dataName.empty()) {
+        auto work = env.getLibrary("WORK");
+        for (int n = 1; outRef.dataName.empty() || work->hasDataset(outRef.dataName); n++) {
+            outRef.dataName = "DATA" + std::to_string(n);
+        }
+    }
+    out.name = outRef.dataName;
+    auto outDoc = std::dynamic_pointer_cast<SasDoc>(env.getOrCreateOutputDataset(outRef));
+    if (!outDoc) {
+        throw std::runtime_error("Output dataset '" + outRef.getFullDsName() + "' cannot be created for PROC RANK.");
+    }
+    *outDoc = std::move(out);
+    selectOutputColumns(*outDoc, outRef.options);
+    env.saveSas7bdat(outRef.getFullDsName());
+    logLogger.info("NOTE: The data set {} has {} observations and {} variables.",
+        outRef.getFullDsName(), rows, outDoc->var_count);
+}
+
+void Interpreter::executeProcFreq(ProcFreqNode* node) {
+    logLogger.info("Executing PROC FREQ");
+
+    // Retrieve the input dataset
+    Dataset* inputDS = env.getOrCreateDataset(node->inputDataSet).get();
+    if (!inputDS) {
+        throw std::runtime_error("Input dataset '" + node->inputDataSet.getFullDsName() + "' not found for PROC FREQ.");
+    }
+
+    // Apply WHERE condition if specified
+    std::optional<RowSelection> selected;
+    if (node->whereCondition) {
+        selected = selectWhere(inputDS, node->whereCondition.get());
+    }
+    const RowSelection* selection = selected ? &*selected : nullptr;
+
+    // Frequency tables are charged per level
+    const size_t levelOverhead = 64;
+    MemoryCharge charge(env.memory, "PROCEDURE FREQ");
+
+    // Level of one cell as text, written into key (the buffer is reused between rows)
+    auto levelKey = [](const ColumnBatch& batch, int c, size_t i, std::string& key) {
+        if (batch.isNumeric(c)) {
+            char buf[400];
+            int len = std::snprintf(buf, sizeof(buf), "%f", batch.numbers(c)[i]);
+            key.assign(buf, len);
+        }
+        else {
+            key.assign(batch.strings(c)[i]);
+        }
+    };
+
+    // Without a TABLES statement every variable gets a one-way table
+    auto tables = node->tables;
+    if (tables.empty()) {
+        const ColumnBatch& columns = inputDS->scan().batch();
+        for (size_t c = 0; c < columns.columnCount(); c++) {
+            tables.emplace_back(columns.column(c).name, std::vector<std::string>());
+        }
+    }
+
+    if (std::find(node->options.begin(), node->options.end(), "NLEVELS") != node->options.end()) {
+        std::vector<std::string> vars;
+        for (const auto& table : tables) {
+            size_t begin = 0;
+            while (true) {
+                size_t star = table.first.find('*', begin);
+                std::string var = table.first.substr(begin, star - begin);
+                if (std::find(vars.begin(), vars.end(), var) == vars.end()) {
+                    vars.push_back(var);
+                }
+                if (star == std::string::npos) break;
+                begin = star + 1;
+            }
+        }
+        printNlevels(inputDS, vars, selection);
+    }
+
+    // Process each table specification
+    for (const auto& tablePair : tables) {
+        std::string tableSpec = tablePair.first;
+        std::vector<std::string> tableOptions = tablePair.second;
+
+        // Split tableSpec into variables, e.g., var1 or var1*var2
+        std::vector<std::string> vars;
+        size_t starPos = tableSpec.find('*');
+        if (starPos != std::string::npos) {
+            vars.push_back(tableSpec.substr(0, starPos));
+            vars.push_back(tableSpec.substr(starPos + 1));
+        }
+        else {
+            vars.push_back(tableSpec);
+        }
+
+        if (vars.size() == 1) {
+            // Single variable frequency table
+            std::map<std::string, int, std::less<>> freqMap;
+            std::string key;
+            auto cursor = inputDS->scan({ vars[0] }, 1024, selection);
+            while (cursor.next()) {
+                const ColumnBatch& batch = cursor.batch();
+                if (batch.column(0).source < 0) break;
+                for (size_t i = 0; i < batch.size(); i++) {
+                    levelKey(batch, 0, i, key);
+                    auto level = freqMap.find(key);
+                    if (level == freqMap.end()) {
+                        charge.require(key.capacity() + levelOverhead);
+                        level = freqMap.emplace(key, 0).first;
+                    }
+                    level->second++;
+                }
+            }
+
+            // Log frequency table
+            std::stringstream ss;
+            ss << "Frequency Table for Variable: " << vars[0] << "\n";
+            ss << "Value\tFrequency\n";
+            for (const auto& pair : freqMap) {
+                ss << pair.first << "\t" << pair.second << "\n";
+            }
+            logLogger.info(ss.str());
+
+            // Handle OUTPUT options if any (e.g., OUT=)
+            // This implementation focuses on logging frequencies. Extending to output datasets can be added here.
+        }
+        else if (vars.size() == 2) {
+            // Cross-tabulation
+            std::map<std::string, std::map<std::string, int>> crosstab;
+            std::set<std::string> var1Levels;
+            std::set<std::string> var2Levels;
+
+            std::string key1, key2;
+            auto cursor = inputDS->scan({ vars[0], vars[1] }, 1024, selection);
+            while (cursor.next()) {
+                const ColumnBatch& batch = cursor.batch();
+                if (batch.column(0).source < 0 || batch.column(1).source < 0) break;
+                for (size_t i = 0; i < batch.size(); i++) {
+                    levelKey(batch, 0, i, key1);
+                    levelKey(batch, 1, i, key2);
+
+                    auto [cell, inserted] = crosstab[key1].try_emplace(key2, 0);
+                    if (inserted) charge.require(key1.capacity() + key2.capacity() + levelOverhead);
+                    cell->second++;
+                    var1Levels.insert(key1);
+                    var2Levels.insert(key2);
                 }
             }
 
@@ -1862,8 +2719,106 @@ void Interpreter::executeProcFreq(ProcFreqNode* node) {
     }
 }
 
+void Interpreter::printNlevels(Dataset* ds, const std::vector<std::string>& vars, const RowSelection* selection) {
+    int precision = approxDistinctPrecision();
+
+    // The levels seen by one thread: exact sets, or a sketch under APPROXDISTINCT
+    struct Levels {
+        bool missing = false;
+        std::unordered_set<double> numbers;
+        std::unordered_set<std::string> strings;
+        std::optional<HyperLogLog> sketch;
+    };
+    // Sketches are cheap to merge, so with them each thread counts a part of
+    // every batch on its own. Exact sets stay on this thread, merging them
+    // would hold every level twice.
+    unsigned threads = precision ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    std::vector<std::vector<Levels>> parts(threads, std::vector<Levels>(vars.size()));
+    if (precision) {
+        for (auto& part : parts) {
+            for (auto& levels : part) levels.sketch.emplace(precision);
+        }
+    }
+
+    const size_t levelOverhead = 64;
+    MemoryCharge charge(env.memory, "PROCEDURE FREQ");
+    auto cursor = ds->scan(vars, precision ? 1 << 18 : 1024, selection);
+    for (size_t v = 0; v < vars.size(); v++) {
+        if (cursor.batch().column(v).source < 0) {
+            throw std::runtime_error("Variable " + vars[v] + " not found.");
+        }
+    }
+    while (cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        auto count = [&](unsigned part, size_t begin, size_t end) {
+            for (size_t v = 0; v < vars.size(); v++) {
+                Levels& levels = parts[part][v];
+                if (batch.isNumeric(v)) {
+                    auto numbers = batch.numbers(v);
+                    for (size_t i = begin; i < end; i++) {
+                        double x = numbers[i];
+                        if (std::isnan(x) || x == -INFINITY) {
+                            levels.missing = true;
+                        }
+                        else if (levels.sketch) {
+                            levels.sketch->addNumber(x);
+                        }
+                        else if (levels.numbers.insert(x == 0 ? 0 : x).second) {
+                            charge.require(sizeof(double) + levelOverhead);
+                        }
+                    }
+                }
+                else {
+                    auto strings = batch.strings(v);
+                    for (size_t i = begin; i < end; i++) {
+                        std::string_view text = strings[i];
+                        if (text.find_first_not_of(' ') == std::string_view::npos) {
+                            levels.missing = true;
+                        }
+                        else if (levels.sketch) {
+                            levels.sketch->addString(text);
+                        }
+                        else if (levels.strings.emplace(text).second) {
+                            charge.require(text.size() + levelOverhead);
+                        }
+                    }
+                }
+            }
+        };
+        // a thread for every 64K rows at most
+        size_t n = batch.size();
+        unsigned used = (unsigned)std::min<size_t>(threads, n / 65536 + 1);
+        size_t step = (n + used - 1) / used;
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < used; t++) {
+            workers.emplace_back(count, t, std::min(n, t * step), std::min(n, (t + 1) * step));
+        }
+        count(0, 0, std::min(n, step));
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    lstLogger.info("Number of Variable Levels");
+    lstLogger.info("{:<16}{:>12}{:>16}{:>20}", "Variable", "Levels", "Missing Levels", "Nonmissing Levels");
+    for (size_t v = 0; v < vars.size(); v++) {
+        Levels& levels = parts[0][v];
+        for (unsigned t = 1; t < threads; t++) {
+            levels.missing = levels.missing || parts[t][v].missing;
+            levels.sketch->merge(*parts[t][v].sketch);
+        }
+        size_t nonmissing = levels.sketch ? (size_t)std::llround(levels.sketch->estimate())
+            : levels.numbers.size() + levels.strings.size();
+        size_t missing = levels.missing ? 1 : 0;
+        lstLogger.info("{:<16}{:>12}{:>16}{:>20}", vars[v], nonmissing + missing, missing, nonmissing);
+    }
+    if (precision) {
+        noteApproxDistinct("NLEVELS", precision);
+    }
+}
+
 void Interpreter::executeProcPrint(ProcPrintNode* node) {
-    ScopedStepTimer timer("PROCEDURE PRINT", logLogger);
+    ScopedStepTimer timer("PROCEDURE PRINT", logLogger, fullStimer());
 
     // Retrieve the input dataset
     Dataset* inputDS = env.getOrCreateDataset(node->inputDataSet).get();
@@ -1872,15 +2827,11 @@ void Interpreter::executeProcPrint(ProcPrintNode* node) {
     }
 
     // Determine which variables to print
+    // If VAR statement is not specified, print all variables
+    auto cursor = inputDS->scan(node->varVariables);
     std::vector<std::string> varsToPrint;
-    if (!node->varVariables.empty()) {
-        varsToPrint = node->varVariables;
-    }
-    else {
-        // If VAR statement is not specified, print all variables
-        for (const auto& column : inputDS->getColumnNames()) {
-            varsToPrint.push_back(column);
-        }
+    for (size_t c = 0; c < cursor.batch().columnCount(); ++c) {
+        varsToPrint.push_back(cursor.batch().column(c).name);
     }
 
     // Handle options
@@ -1928,75 +2879,241 @@ void Interpreter::executeProcPrint(ProcPrintNode* node) {
 
     // Iterate over rows and print data
     int obsCount = 0;
-    for (size_t i = 0; i < inputDS->getRowCount(); ++i) {
-        if (obsLimit != -1 && obsCount >= obsLimit) {
-            break;
-        }
+    std::stringstream rowStream;
+    while ((obsLimit == -1 || obsCount < obsLimit) && cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (obsLimit != -1 && obsCount >= obsLimit) {
+                break;
+            }
 
-        const Row& row = inputDS->getRow(i);
-        std::stringstream rowStream;
-        if (!noObs) {
-            rowStream << (i + 1) << "\t";
-        }
+            rowStream.str("");
+            if (!noObs) {
+                rowStream << (batch.firstRow() + i + 1) << "\t";
+            }
 
-        for (size_t j = 0; j < varsToPrint.size(); ++j) {
-            const std::string& var = varsToPrint[j];
-            auto itVar = row.columns.find(var);
-            if (itVar != row.columns.end()) {
-                if (std::holds_alternative<double>(itVar->second)) {
-                    rowStream << std::fixed << std::setprecision(2) << std::get<double>(itVar->second);
+            for (size_t j = 0; j < batch.columnCount(); ++j) {
+                if (batch.column(j).source < 0) {
+                    rowStream << "NA"; // Handle missing variables
                 }
-                else if (std::holds_alternative<std::string>(itVar->second)) {
-                    rowStream << std::get<std::string>(itVar->second);
+                else if (batch.isNumeric(j)) {
+                    rowStream << std::fixed << std::setprecision(2) << batch.numbers(j)[i];
+                }
+                else {
+                    rowStream << batch.strings(j)[i];
                 }
-                // Handle other data types as needed
-            }
-            else {
-                rowStream << "NA"; // Handle missing variables
-            }
 
-            if (j != varsToPrint.size() - 1) {
-                rowStream << "\t";
+                if (j != batch.columnCount() - 1) {
+                    rowStream << "\t";
+                }
             }
+            lstLogger.info(rowStream.str());
+            obsCount++;
         }
-        lstLogger.info(rowStream.str());
-        obsCount++;
     }
 
-    logLogger.info("NOTE: There were {} observations read from the data set {}.", inputDS->getRowCount(), node->inputDataSet.getFullDsName());
+    logLogger.info("NOTE: There were {} observations read from the data set {}.", inputDS->scanRowCount(), node->inputDataSet.getFullDsName());
 }
 
 void Interpreter::executeProcSQL(ProcSQLNode* node) {
     logLogger.info("Executing PROC SQL");
 
+    size_t outObs = 0;
+    auto it = node->options.find("OUTOBS");
+    if (it != node->options.end()) {
+        outObs = (size_t)std::stoull(it->second);
+    }
+
+    // however PROC SQL ends, the tables it changed lose their deleted rows
+    // and are read again by the steps after it
+    struct TablesScope {
+        Interpreter* self;
+        ~TablesScope() {
+            for (const auto& name : self->sqlChangedTables) {
+                if (auto doc = dynamic_cast<SasDoc*>(self->sqlTables[name].get())) doc->compact();
+            }
+            self->sqlTables.clear();
+            self->sqlChangedTables.clear();
+        }
+    } tablesScope{ this };
+
     for (const auto& sqlStmt : node->statements) {
+        // subqueries are read again by the next statement, tables may have
+        // changed; the sets are dropped even when the statement fails
+        struct ValueSetsScope {
+            Interpreter* self;
+            ~ValueSetsScope() { self->sqlValueSets.clear(); }
+        } valueSetsScope{ this };
+
         if (auto selectStmt = dynamic_cast<SelectStatementNode*>(sqlStmt.get())) {
-            Dataset* resultDS = executeSelect(selectStmt);
-            // Handle the result dataset as needed
-            // For example, if creating a new table, it has been handled in executeSelect
-            // Otherwise, you can log the results or perform further actions
+            executeSelect(selectStmt, outObs);
         }
         else if (auto createStmt = dynamic_cast<CreateTableStatementNode*>(sqlStmt.get())) {
-            executeCreateTable(createStmt);
+            executeCreateTable(createStmt, outObs);
+        }
+        else if (auto deleteStmt = dynamic_cast<DeleteStatementNode*>(sqlStmt.get())) {
+            executeDelete(deleteStmt);
+        }
+        else if (auto updateStmt = dynamic_cast<UpdateStatementNode*>(sqlStmt.get())) {
+            executeUpdate(updateStmt);
+        }
+        else if (auto insertStmt = dynamic_cast<InsertStatementNode*>(sqlStmt.get())) {
+            executeInsert(insertStmt);
         }
         else {
             logLogger.warn("Unsupported SQL statement encountered in PROC SQL.");
         }
     }
 
+    for (const auto& name : sqlChangedTables) {
+        if (auto doc = dynamic_cast<SasDoc*>(sqlTables[name].get())) doc->compact();
+        env.saveSas7bdat(name);
+    }
+
     logLogger.info("PROC SQL executed successfully.");
 }
 
-Dataset* Interpreter::executeSelect(const SelectStatementNode* selectStmt) {
-    // For simplicity, handle basic SELECT statements without joins or subqueries
-    // Extend this method to handle joins, subqueries, and other SQL features
+namespace {
+    // The aggregates an expression of a SELECT list or HAVING clause uses
+    void collectAggregates(ASTNode* node, std::vector<SqlAggregateNode*>& out) {
+        if (auto aggregate = dynamic_cast<SqlAggregateNode*>(node)) {
+            out.push_back(aggregate);
+        }
+        else if (auto binOp = dynamic_cast<BinaryOpNode*>(node)) {
+            collectAggregates(binOp->left.get(), out);
+            collectAggregates(binOp->right.get(), out);
+        }
+        else if (auto funcCall = dynamic_cast<FunctionCallNode*>(node)) {
+            for (auto& arg : funcCall->arguments) {
+                collectAggregates(arg.get(), out);
+            }
+        }
+    }
+
+    bool isMissingValue(const Value& v) {
+        if (auto d = std::get_if<double>(&v)) {
+            return std::isnan(*d) || *d == -INFINITY;
+        }
+        return std::get<std::string>(v).find_first_not_of(' ') == std::string::npos;
+    }
+
+    // LIBREF.TABLE as a dataset reference
+    DatasetRefNode sqlTableRef(const std::string& tableName) {
+        DatasetRefNode ref;
+        size_t dot = tableName.find('.');
+        if (dot != std::string::npos) {
+            ref.libref = tableName.substr(0, dot);
+        }
+        ref.dataName = tableName.substr(dot == std::string::npos ? 0 : dot + 1);
+        return ref;
+    }
+
+    int findColumn(const SasDoc& doc, const std::string& name) {
+        for (size_t c = 0; c < doc.var_names.size(); c++) {
+            if (to_upper(doc.var_names[c]) == to_upper(name)) return (int)c;
+        }
+        throw std::runtime_error("The following columns were not found in the contributing tables: " + name);
+    }
+
+    // v as a cell of column c of doc, what names it in the error when the
+    // types differ; character columns grow to hold it
+    Cell sqlCell(SasDoc& doc, size_t c, const Value& v, const std::string& what) {
+        bool numeric = doc.var_types[c] != READSTAT_TYPE_STRING;
+        if (numeric != std::holds_alternative<double>(v)) {
+            throw std::runtime_error(what + " does not match the data type of column " + doc.var_names[c] + ".");
+        }
+        if (numeric) {
+            double d = std::get<double>(v);
+            return std::isnan(d) ? -INFINITY : d;
+        }
+        const std::string& text = std::get<std::string>(v);
+        if (c < doc.var_length.size()) {
+            doc.var_length[c] = std::max(doc.var_length[c], (int)text.size());
+        }
+        return flyweight_string(text);
+    }
+
+    // "1 row was" / "3 rows were"
+    std::string rowsWere(size_t n) {
+        return std::to_string(n) + (n == 1 ? " row was" : " rows were");
+    }
+
+    // ORDER BY order: missing values first, numbers before character values
+    int compareSqlValues(const Value& a, const Value& b) {
+        const double* x = std::get_if<double>(&a);
+        const double* y = std::get_if<double>(&b);
+        if (x && y) {
+            double u = std::isnan(*x) ? -INFINITY : *x, w = std::isnan(*y) ? -INFINITY : *y;
+            return u < w ? -1 : (w < u ? 1 : 0);
+        }
+        if (x || y) {
+            return x ? -1 : 1;
+        }
+        return std::get<std::string>(a).compare(std::get<std::string>(b));
+    }
+
+    // One aggregate over the rows of one group
+    struct SqlAccumulator {
+        size_t count = 0;       // nonmissing values, rows for COUNT(*)
+        double sum = 0;
+        std::optional<Value> min, max;
+        // DISTINCT: exact sets, or a sketch for COUNT(DISTINCT) under APPROXDISTINCT
+        std::unordered_set<double> numbers;
+        std::unordered_set<std::string> strings;
+        std::unique_ptr<HyperLogLog> sketch;
+    };
+
+    void accumulate(SqlAccumulator& acc, const SqlAggregateNode* aggregate, const Value& v, MemoryCharge& charge) {
+        const size_t valueOverhead = 64;
+        if (!aggregate->argument) {
+            acc.count++;
+            return;
+        }
+        if (isMissingValue(v)) {
+            return;
+        }
+        const double* number = std::get_if<double>(&v);
+        if ((aggregate->function == "SUM" || aggregate->function == "AVG") && !number) {
+            throw std::runtime_error("Summary function " + aggregate->function + " requires a numeric argument.");
+        }
+        if (aggregate->distinct) {
+            if (acc.sketch) {
+                if (number) acc.sketch->addNumber(*number);
+                else acc.sketch->addString(std::get<std::string>(v));
+            }
+            else if (number) {
+                if (acc.numbers.insert(*number == 0 ? 0 : *number).second) charge.require(sizeof(double) + valueOverhead);
+            }
+            else if (acc.strings.insert(std::get<std::string>(v)).second) {
+                charge.require(std::get<std::string>(v).size() + valueOverhead);
+            }
+        }
+        acc.count++;
+        if (number) acc.sum += *number;
+        if (!acc.min || v < *acc.min) acc.min = v;
+        if (!acc.max || *acc.max < v) acc.max = v;
+    }
 
-    // Create a new dataset to store the results
-    DatasetRefNode dsNode;
-    dsNode.dataName = "SQL_RESULT";
-    Dataset* resultDS = env.getOrCreateDataset(dsNode).get();
-    resultDS->rows.clear();
+    Value aggregateResult(const SqlAccumulator& acc, const SqlAggregateNode* aggregate) {
+        const std::string& f = aggregate->function;
+        size_t n = acc.count;
+        double sum = acc.sum;
+        if (aggregate->distinct) {
+            if (f == "COUNT") {
+                return acc.sketch ? std::round(acc.sketch->estimate()) : (double)(acc.numbers.size() + acc.strings.size());
+            }
+            n = acc.numbers.size();
+            sum = std::accumulate(acc.numbers.begin(), acc.numbers.end(), 0.0);
+        }
+        if (f == "COUNT") return (double)n;
+        if (f == "SUM") return n > 0 ? sum : std::nan("");
+        if (f == "AVG") return n > 0 ? sum / n : std::nan("");
+        if (f == "MIN") return acc.min ? *acc.min : Value(std::nan(""));
+        return acc.max ? *acc.max : Value(std::nan(""));
+    }
+}
 
+void Interpreter::runSelect(const SelectStatementNode* selectStmt, const std::function<bool(std::vector<Value>&)>& emit) {
     // Determine source tables
     if (selectStmt->fromTables.empty()) {
         throw std::runtime_error("SELECT statement requires at least one table in FROM clause.");
@@ -2007,141 +3124,488 @@ Dataset* Interpreter::executeSelect(const SelectStatementNode* selectStmt) {
         throw std::runtime_error("Multi-table SELECT statements (joins) are not yet supported.");
     }
 
-    DatasetRefNode dsNodeFrom;
-    dsNodeFrom.dataName = selectStmt->fromTables[0];
-    Dataset* sourceDS = env.getOrCreateDataset(dsNodeFrom).get();
+    Dataset* sourceDS = sqlTable(selectStmt->fromTables[0]);
     if (!sourceDS) {
-        throw std::runtime_error("Source table '" + dsNodeFrom.getFullDsName() + "' not found for SELECT statement.");
+        throw std::runtime_error("Source table '" + selectStmt->fromTables[0] + "' not found for SELECT statement.");
     }
+    // rows DELETE took out are still there until the table is compacted
+    auto sourceDoc = dynamic_cast<SasDoc*>(sourceDS);
+    bool deletions = sourceDoc && sourceDoc->deletedCount() > 0;
+
+    std::vector<SqlAggregateNode*> aggregates;
+    for (const auto& expr : selectStmt->selectExpressions) {
+        collectAggregates(expr.get(), aggregates);
+    }
+    collectAggregates(selectStmt->havingCondition.get(), aggregates);
+    bool grouped = !aggregates.empty() || !selectStmt->groupByColumns.empty();
+
+    // Plain columns are copied from the batch; WHERE, expressions and
+    // aggregates see the whole row
+    std::vector<std::string> sourceColumns;
+    for (const auto& expr : selectStmt->selectExpressions) {
+        if (auto var = dynamic_cast<VariableNode*>(expr.get())) {
+            sourceColumns.push_back(var->varName);
+        }
+    }
+    bool plainColumns = sourceColumns.size() == selectStmt->selectExpressions.size();
+    bool needRow = selectStmt->whereCondition || selectStmt->havingCondition || !plainColumns || grouped;
+
+    // ORDER BY has to see every row first: they are kept, sorted and
+    // emitted at the end. Otherwise rows go out as they are made.
+    std::vector<size_t> orderColumns;
+    for (const auto& col : selectStmt->orderByColumns) {
+        auto it = std::find_if(selectStmt->selectColumns.begin(), selectStmt->selectColumns.end(),
+            [&](const std::string& name) { return to_upper(name) == to_upper(col); });
+        if (it == selectStmt->selectColumns.end()) {
+            throw std::runtime_error("ORDER BY column " + col + " is not in the SELECT list.");
+        }
+        orderColumns.push_back(it - selectStmt->selectColumns.begin());
+    }
+    std::vector<std::vector<Value>> ordered;
+    auto output = [&](std::vector<Value>& row) {
+        if (orderColumns.empty()) {
+            return emit(row);
+        }
+        ordered.push_back(row);
+        return true;
+    };
+    std::vector<Value> out(selectStmt->selectColumns.size());
+
+    // Groups by their GROUP BY values; a std::map outputs them in that order
+    struct Group {
+        Row first;
+        std::vector<SqlAccumulator> accumulators;
+    };
+    std::vector<Group> groups;
+    std::map<std::vector<Value>, size_t> groupIndex;
+    std::vector<Value> key;
+    int precision = approxDistinctPrecision();
+    MemoryCharge charge(env.memory, "PROCEDURE SQL");
 
     // Iterate over source dataset rows and apply WHERE condition
-    for (const auto& row : sourceDS->rows) {
-        bool includeRow = true;
-        if (selectStmt->whereCondition) {
-            env.currentRow = row;
-            Value condValue = evaluate(selectStmt->whereCondition.get());
-            if (std::holds_alternative<double>(condValue)) {
-                includeRow = (std::get<double>(condValue) != 0.0);
+    env.currentRow.columns.clear();
+    auto cursor = sourceDS->scan(needRow ? std::vector<std::string>() : sourceColumns);
+    std::vector<int> groupColumns;
+    for (const auto& col : selectStmt->groupByColumns) {
+        int c = cursor.batch().columnIndex(col);
+        if (c < 0 || cursor.batch().column(c).source < 0) {
+            throw std::runtime_error("The following columns were not found in the contributing tables: " + col);
+        }
+        groupColumns.push_back(c);
+    }
+    std::vector<int> plainIndexes;
+    for (const auto& col : plainColumns ? sourceColumns : std::vector<std::string>()) {
+        int c = cursor.batch().columnIndex(col);
+        if (c < 0 || cursor.batch().column(c).source < 0) {
+            throw std::runtime_error("The following columns were not found in the contributing tables: " + col);
+        }
+        plainIndexes.push_back(c);
+    }
+    while (cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (deletions && sourceDoc->isDeleted(batch.firstRow() + i)) {
+                continue;
             }
-            else if (std::holds_alternative<std::string>(condValue)) {
-                includeRow = (!std::get<std::string>(condValue).empty());
+            if (needRow) {
+                batch.fillRow(i, env.currentRow);
+            }
+            if (selectStmt->whereCondition && !isTrue(evaluate(selectStmt->whereCondition.get()))) {
+                continue;
             }
-            // Add other data types as needed
-        }
 
-        if (includeRow) {
-            Row newRow;
-            for (const auto& col : selectStmt->selectColumns) {
-                auto it = row.columns.find(col);
-                if (it != row.columns.end()) {
-                    newRow.columns[col] = it->second;
+            if (!grouped) {
+                if (selectStmt->havingCondition && !isTrue(evaluate(selectStmt->havingCondition.get()))) {
+                    continue;
                 }
-                else {
-                    newRow.columns[col] = "NA"; // Handle missing columns
+                out.resize(selectStmt->selectColumns.size());
+                for (size_t j = 0; j < out.size(); j++) {
+                    out[j] = plainColumns ? batch.value(i, plainIndexes[j]) : evaluate(selectStmt->selectExpressions[j].get());
                 }
+                if (!output(out)) {
+                    return;
+                }
+                continue;
+            }
+
+            key.clear();
+            for (int c : groupColumns) {
+                key.push_back(batch.value(i, c));
+            }
+            auto [entry, inserted] = groupIndex.try_emplace(key, groups.size());
+            if (inserted) {
+                Group& group = groups.emplace_back();
+                group.first = env.currentRow;
+                group.accumulators.resize(aggregates.size());
+                for (size_t a = 0; a < aggregates.size(); a++) {
+                    if (precision && aggregates[a]->distinct && aggregates[a]->function == "COUNT") {
+                        group.accumulators[a].sketch = std::make_unique<HyperLogLog>(precision);
+                    }
+                }
+            }
+            Group& group = groups[entry->second];
+            for (size_t a = 0; a < aggregates.size(); a++) {
+                Value v = aggregates[a]->argument ? evaluate(aggregates[a]->argument.get()) : Value(0.0);
+                accumulate(group.accumulators[a], aggregates[a], v, charge);
             }
-            resultDS->rows.push_back(newRow);
         }
     }
 
-    // Handle GROUP BY and HAVING clauses if present
-    if (!selectStmt->groupByColumns.empty()) {
-        // Implement GROUP BY logic with aggregations
-        // For simplicity, this implementation does not handle aggregations
-        logLogger.warn("GROUP BY clauses are not yet fully supported in PROC SQL.");
+    if (grouped) {
+        // aggregates of a whole table give a row even when no row was read
+        if (groups.empty() && selectStmt->groupByColumns.empty()) {
+            groups.emplace_back().accumulators.resize(aggregates.size());
+            groupIndex.emplace(std::vector<Value>(), 0);
+        }
+        for (const auto& [groupKey, g] : groupIndex) {
+            Group& group = groups[g];
+            env.currentRow = group.first;
+            for (size_t a = 0; a < aggregates.size(); a++) {
+                sqlAggregateValues[aggregates[a]] = aggregateResult(group.accumulators[a], aggregates[a]);
+            }
+            if (selectStmt->havingCondition && !isTrue(evaluate(selectStmt->havingCondition.get()))) {
+                continue;
+            }
+            out.resize(selectStmt->selectColumns.size());
+            for (size_t j = 0; j < out.size(); j++) {
+                out[j] = evaluate(selectStmt->selectExpressions[j].get());
+            }
+            if (!output(out)) {
+                break;
+            }
+        }
+        sqlAggregateValues.clear();
+
+        if (precision && std::any_of(aggregates.begin(), aggregates.end(),
+            [](const SqlAggregateNode* a) { return a->distinct && a->function == "COUNT"; })) {
+            noteApproxDistinct("COUNT(DISTINCT)", precision);
+        }
     }
 
-    // Handle ORDER BY clause if present
-    if (!selectStmt->orderByColumns.empty()) {
-        // Implement ORDER BY logic
-        // For simplicity, sort by the first column specified
-        std::string sortColumn = selectStmt->orderByColumns[0];
-        std::sort(resultDS->rows.begin(), resultDS->rows.end(),
-            [&](const Row& a, const Row& b) -> bool {
-                auto itA = a.columns.find(sortColumn);
-                auto itB = b.columns.find(sortColumn);
-                if (itA != a.columns.end() && itB != b.columns.end()) {
-                    if (std::holds_alternative<double>(itA->second) &&
-                        std::holds_alternative<double>(itB->second)) {
-                        return std::get<double>(itA->second) < std::get<double>(itB->second);
-                    }
-                    else if (std::holds_alternative<std::string>(itA->second) &&
-                        std::holds_alternative<std::string>(itB->second)) {
-                        return std::get<std::string>(itA->second) < std::get<std::string>(itB->second);
-                    }
-                }
-                return false;
-            });
+    if (!orderColumns.empty()) {
+        std::stable_sort(ordered.begin(), ordered.end(), [&](const std::vector<Value>& a, const std::vector<Value>& b) {
+            for (size_t c : orderColumns) {
+                int cmp = compareSqlValues(a[c], b[c]);
+                if (cmp != 0) return cmp < 0;
+            }
+            return false;
+        });
+        for (auto& row : ordered) {
+            if (!emit(row)) {
+                break;
+            }
+        }
+    }
+}
+
+const SqlValueSet& Interpreter::sqlValues(const ASTNode* node) {
+    auto it = sqlValueSets.find(node);
+    if (it != sqlValueSets.end()) {
+        return it->second;
+    }
+    // Uncorrelated: built once, on the first row that asks. The outer
+    // query is in the middle of a row, its state is put back afterwards.
+    Row outerRow = env.currentRow;
+    auto outerAggregates = std::move(sqlAggregateValues);
+    sqlAggregateValues.clear();
+
+    SqlValueSet values;
+    if (auto in = dynamic_cast<const SqlInNode*>(node)) {
+        if (in->subquery) {
+            if (in->subquery->selectColumns.size() != 1) {
+                throw std::runtime_error("A subquery used with IN must return a single column.");
+            }
+            runSelect(in->subquery.get(), [&](std::vector<Value>& row) { values.add(row[0]); return true; });
+        }
+        else {
+            for (const auto& value : in->values) {
+                values.add(evaluate(value.get()));
+            }
+        }
+    }
+    else if (auto exists = dynamic_cast<const SqlExistsNode*>(node)) {
+        // one row answers it
+        runSelect(exists->subquery.get(), [&](std::vector<Value>&) { values.add(0.0); return false; });
+    }
+    values.seal();
+
+    env.currentRow = std::move(outerRow);
+    sqlAggregateValues = std::move(outerAggregates);
+    return sqlValueSets.emplace(node, std::move(values)).first->second;
+}
+
+void Interpreter::executeSelect(const SelectStatementNode* selectStmt, size_t outObs) {
+    // A query on its own is a report: its rows go to the listing as they
+    // are made, nothing is kept
+    std::stringstream line;
+    line << "OBS";
+    for (const auto& col : selectStmt->selectColumns) {
+        line << "\t" << col;
+    }
+    lstLogger.info(env.title);
+    lstLogger.info(line.str());
+
+    size_t rows = 0;
+    bool truncated = false;
+    runSelect(selectStmt, [&](std::vector<Value>& row) {
+        if (outObs > 0 && rows == outObs) {
+            truncated = true;
+            return false;
+        }
+        line.str("");
+        line << ++rows;
+        for (const auto& v : row) {
+            line << "\t";
+            if (isMissingValue(v) && std::holds_alternative<double>(v)) {
+                line << ".";
+            }
+            else if (auto d = std::get_if<double>(&v)) {
+                line << std::fixed << std::setprecision(2) << *d;
+            }
+            else {
+                line << std::get<std::string>(v);
+            }
+        }
+        lstLogger.info(line.str());
+        return true;
+    });
+
+    if (rows == 0) {
+        logLogger.info("NOTE: No rows were selected.");
     }
+    if (truncated) {
+        logLogger.warn("WARNING: Statement terminated early due to OUTOBS={} option.", outObs);
+    }
+}
 
-    // Log the results
-    std::stringstream ss;
-    ss << "PROC SQL SELECT Results (Dataset: " << resultDS->name << "):\n";
-    if (resultDS->rows.empty()) {
-        ss << "No records found.\n";
+void Interpreter::executeCreateTable(const CreateTableStatementNode* createStmt, size_t outObs) {
+    DatasetRefNode dsNode = sqlTableRef(createStmt->tableName);
+
+    SasDoc out;
+    out.name = dsNode.dataName;
+    auto addColumn = [&](const std::string& name, bool numeric) {
+        out.var_names.push_back(name);
+        out.var_labels.push_back("");
+        out.var_formats.push_back("");
+        out.var_types.push_back(numeric ? READSTAT_TYPE_DOUBLE : READSTAT_TYPE_STRING);
+        // character columns are as long as their longest value
+        out.var_length.push_back(numeric ? 8 : 1);
+        out.var_display_length.push_back(8);
+        out.var_decimals.push_back(0);
+    };
+
+    size_t rows = 0;
+    if (!createStmt->asSelect) {
+        // column definitions: an empty table
+        for (const auto& col : createStmt->columns) {
+            addColumn(col, true);
+        }
     }
     else {
-        // Print header
-        ss << "OBS\t";
-        size_t colCount = 0;
-        for (const auto& col : selectStmt->selectColumns) {
-            ss << col;
-            if (colCount != selectStmt->selectColumns.size() - 1) {
-                ss << "\t";
-            }
-            colCount++;
-        }
-        ss << "\n";
-
-        // Print rows
-        for (size_t i = 0; i < resultDS->rows.size(); ++i) {
-            ss << (i + 1) << "\t";
-            const Row& row = resultDS->rows[i];
-            for (size_t j = 0; j < selectStmt->selectColumns.size(); ++j) {
-                const std::string& col = selectStmt->selectColumns[j];
-                auto it = row.columns.find(col);
-                if (it != row.columns.end()) {
-                    if (std::holds_alternative<double>(it->second)) {
-                        ss << std::fixed << std::setprecision(2) << std::get<double>(it->second);
-                    }
-                    else if (std::holds_alternative<std::string>(it->second)) {
-                        ss << std::get<std::string>(it->second);
-                    }
-                    // Handle other data types as needed
+        // AS SELECT: rows are written into the cells of the new table as
+        // the query makes them. Column types are those of the first row;
+        // a query without rows makes numeric columns.
+        const auto& names = createStmt->asSelect->selectColumns;
+        std::vector<Cell> cells;
+        bool truncated = false;
+        MemoryCharge charge(env.memory, "PROCEDURE SQL");
+        runSelect(createStmt->asSelect.get(), [&](std::vector<Value>& row) {
+            if (outObs > 0 && rows == outObs) {
+                truncated = true;
+                return false;
+            }
+            if (out.var_names.empty()) {
+                for (size_t j = 0; j < names.size(); j++) {
+                    addColumn(names[j], std::holds_alternative<double>(row[j]));
                 }
-                else {
-                    ss << "NA";
+            }
+            for (size_t j = 0; j < row.size(); j++) {
+                if (out.var_types[j] == READSTAT_TYPE_DOUBLE) {
+                    auto d = std::get_if<double>(&row[j]);
+                    cells.push_back(d && !std::isnan(*d) ? *d : -INFINITY);
                 }
-
-                if (j != selectStmt->selectColumns.size() - 1) {
-                    ss << "\t";
+                else if (auto text = std::get_if<std::string>(&row[j])) {
+                    out.var_length[j] = std::max(out.var_length[j], (int)text->size());
+                    cells.push_back(flyweight_string(*text));
+                }
+                else {
+                    cells.push_back(flyweight_string(""));
                 }
             }
-            ss << "\n";
+            rows++;
+            size_t bytes = cells.capacity() * sizeof(Cell);
+            if (bytes > charge.size()) charge.require(bytes - charge.size());
+            return true;
+        });
+        if (out.var_names.empty()) {
+            for (const auto& name : names) {
+                addColumn(name, true);
+            }
+        }
+        out.values = CowVector<Cell>(std::move(cells));
+        if (truncated) {
+            logLogger.warn("WARNING: Statement terminated early due to OUTOBS={} option.", outObs);
         }
     }
+    out.var_count = (int)out.var_names.size();
+    out.obs_count = (int)rows;
 
-    logLogger.info(ss.str());
+    auto outDoc = std::dynamic_pointer_cast<SasDoc>(env.getOrCreateDataset(dsNode));
+    if (!outDoc) {
+        throw std::runtime_error("Table '" + dsNode.getFullDsName() + "' cannot be created by PROC SQL.");
+    }
+    *outDoc = std::move(out);
+    sqlTables[dsNode.getFullDsName()] = outDoc;
+    env.saveSas7bdat(dsNode.getFullDsName());
+    logLogger.info("NOTE: Table {} created, with {} rows and {} columns.", dsNode.getFullDsName(), rows, outDoc->var_count);
+}
 
-    return resultDS;
+Dataset* Interpreter::sqlTable(const std::string& tableName) {
+    auto it = sqlTables.find(tableName);
+    if (it != sqlTables.end()) {
+        return it->second.get();
+    }
+    DatasetRefNode ref = sqlTableRef(tableName);
+    auto ds = env.getOrCreateDataset(ref);
+    sqlTables[tableName] = ds;
+    return ds.get();
 }
 
-void Interpreter::executeCreateTable(const CreateTableStatementNode* createStmt) {
-    // Create a new dataset with the specified columns
-    DatasetRefNode dsNode;
-    dsNode.dataName = createStmt->tableName;
-    Dataset* newDS = env.getOrCreateDataset(dsNode).get();
-    newDS->rows.clear();
+SasDoc* Interpreter::sqlChangedTable(const std::string& tableName) {
+    auto doc = dynamic_cast<SasDoc*>(sqlTable(tableName));
+    if (!doc || doc->var_count == 0) {
+        throw std::runtime_error("File " + tableName + " does not exist.");
+    }
+    if (doc->values.empty() && !doc->rows.empty()) {
+        throw std::runtime_error("Table " + tableName + " cannot be changed by PROC SQL.");
+    }
+    sqlChangedTables.insert(tableName);
+    return doc;
+}
 
-    // For simplicity, initialize columns without specific data types
-    for (const auto& col : createStmt->columns) {
-        // todo newDS->columns[col] = Value(); // Initialize with default values
+void Interpreter::executeDelete(const DeleteStatementNode* node) {
+    // Rows are only marked in the deletion vector of the table; their
+    // cells go when it is compacted: once a quarter of it is deleted, or
+    // before it is saved
+    SasDoc* doc = sqlChangedTable(node->tableName);
+    size_t deleted = 0;
+    env.currentRow.columns.clear();
+    auto cursor = doc->scan({});
+    while (cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t i = 0; i < batch.size(); i++) {
+            size_t row = batch.firstRow() + i;
+            if (doc->isDeleted(row)) {
+                continue;
+            }
+            if (node->whereCondition) {
+                batch.fillRow(i, env.currentRow);
+                if (!isTrue(evaluate(node->whereCondition.get()))) {
+                    continue;
+                }
+            }
+            doc->deleteRow(row);
+            deleted++;
+        }
+    }
+    if (doc->deletedCount() * 4 > (size_t)doc->obs_count) {
+        doc->compact();
     }
+    logLogger.info("NOTE: {} deleted from {}.", rowsWere(deleted), node->tableName);
+}
 
-    logLogger.info("PROC SQL: Created table '{}'.", dsNode.getFullDsName());
+void Interpreter::executeUpdate(const UpdateStatementNode* node) {
+    // Cells are written where they are, every SET value coming from the
+    // row as it was
+    SasDoc* doc = sqlChangedTable(node->tableName);
+    std::vector<int> targets;
+    for (const auto& col : node->columns) {
+        targets.push_back(findColumn(*doc, col));
+    }
+    Cell* cells = doc->values.mutate().data();
+    std::vector<Value> newValues(targets.size());
+    size_t updated = 0;
+    env.currentRow.columns.clear();
+    auto cursor = doc->scan({});
+    while (cursor.next()) {
+        const ColumnBatch& batch = cursor.batch();
+        for (size_t i = 0; i < batch.size(); i++) {
+            size_t row = batch.firstRow() + i;
+            if (doc->isDeleted(row)) {
+                continue;
+            }
+            batch.fillRow(i, env.currentRow);
+            if (node->whereCondition && !isTrue(evaluate(node->whereCondition.get()))) {
+                continue;
+            }
+            for (size_t j = 0; j < targets.size(); j++) {
+                newValues[j] = evaluate(node->values[j].get());
+            }
+            for (size_t j = 0; j < targets.size(); j++) {
+                cells[row * doc->var_count + targets[j]] = sqlCell(*doc, targets[j], newValues[j],
+                    "Value " + std::to_string(j + 1) + " of the SET clause");
+            }
+            updated++;
+        }
+    }
+    logLogger.info("NOTE: {} updated in {}.", rowsWere(updated), node->tableName);
 }
 
-// Implement other SQL statement executors (INSERT, UPDATE, DELETE) as needed
+void Interpreter::executeInsert(const InsertStatementNode* node) {
+    SasDoc* doc = sqlChangedTable(node->tableName);
+    std::vector<int> targets;
+    for (const auto& col : node->columns) {
+        targets.push_back(findColumn(*doc, col));
+    }
+    if (node->columns.empty()) {
+        for (int c = 0; c < doc->var_count; c++) {
+            targets.push_back(c);
+        }
+    }
+
+    // the new rows are made apart, the query may read the table, then
+    // appended to its cells; columns not given are missing
+    std::vector<Cell> added;
+    auto addRow = [&](const std::vector<Value>& values, const std::string& clause) {
+        if (values.size() != targets.size()) {
+            throw std::runtime_error(clause + " has " + std::to_string(values.size()) + " values for "
+                + std::to_string(targets.size()) + " columns.");
+        }
+        size_t base = added.size();
+        for (int c = 0; c < doc->var_count; c++) {
+            if (doc->var_types[c] == READSTAT_TYPE_STRING) added.push_back(flyweight_string(""));
+            else added.push_back(-INFINITY);
+        }
+        for (size_t j = 0; j < targets.size(); j++) {
+            added[base + targets[j]] = sqlCell(*doc, targets[j], values[j], "Value " + std::to_string(j + 1) + " of " + clause);
+        }
+    };
+    if (node->query) {
+        runSelect(node->query.get(), [&](std::vector<Value>& row) {
+            addRow(row, "the query");
+            return true;
+        });
+    }
+    else {
+        std::vector<Value> values;
+        for (size_t r = 0; r < node->rows.size(); r++) {
+            values.clear();
+            for (const auto& expr : node->rows[r]) {
+                values.push_back(evaluate(expr.get()));
+            }
+            addRow(values, "VALUES clause " + std::to_string(r + 1));
+        }
+    }
+
+    size_t inserted = added.size() / std::max(doc->var_count, 1);
+    auto& cells = doc->values.mutate();
+    cells.insert(cells.end(), std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    doc->obs_count += (int)inserted;
+    if (!doc->obs_flag.empty()) {
+        doc->obs_flag.resize(doc->obs_count, true);
+    }
+    logLogger.info("NOTE: {} inserted into {}.", rowsWere(inserted), node->tableName);
+}
 
 std::string Interpreter::resolveMacroVariables(const std::string& input) {
     std::string result = input;
@@ -2155,9 +3619,9 @@ std::string Interpreter::resolveMacroVariables(const std::string& input) {
 
         std::string varName = result.substr(startPos + 1, endPos - startPos - 1);
 
-        auto it = macroVariables.find(varName);
+        auto it = macroVariables.find(to_upper(varName));
         if (it != macroVariables.end()) {
-            logLogger.debug("Resolving macro variable '&{}' to '{}'", varName, it->second);
+            logLimit.debug("Resolving macro variable '&{}' to '{}'", varName, it->second);
             result.replace(startPos, endPos - startPos, it->second);
         }
         else {
@@ -2170,54 +3634,141 @@ std::string Interpreter::resolveMacroVariables(const std::string& input) {
 
 
 void Interpreter::executeMacroVariableAssignment(MacroVariableAssignmentNode* node) {
-    macroVariables[node->varName] = resolveMacroVariables(node->value);
-    logLogger.info("Macro variable '{}' set to '{}'", node->varName, macroVariables[node->varName]);
+    std::string& value = macroVariables[to_upper(node->varName)];
+    value = resolveMacroVariables(node->value);
+    logLogger.info("Macro variable '{}' set to '{}'", node->varName, value);
+}
+
+void Interpreter::executeMacroPut(MacroPutNode* node) {
+    logLogger.info("{}", resolveMacroVariables(node->text));
 }
 
-void Interpreter::executeMacroDefinition(std::unique_ptr<MacroDefinitionNode> node) {
-    if (macros.find(node->macroName) != macros.end()) {
-        throw std::runtime_error("Macro '" + node->macroName + "' is already defined.");
+void Interpreter::executeMacroDefinition(MacroDefinitionNode* node) {
+    // compiled once here, not at every call; a new definition replaces the old one
+    auto macro = std::make_shared<CompiledMacro>();
+    macro->name = node->macroName;
+    for (const auto& parameter : node->parameters) {
+        macro->parameters.push_back(to_upper(parameter));
     }
-    macros[node->macroName] = std::move(node);
-    logLogger.info("Macro '{}' defined.", macros[node->macroName]->macroName);
+    macro->program = compileMacro(node->text);
+    macros[to_upper(node->macroName)] = std::move(macro);
+    logLogger.info("Macro '{}' defined.", node->macroName);
 }
 
 void Interpreter::executeMacroCall(MacroCallNode* node) {
-    auto it = macros.find(node->macroName);
+    auto it = macros.find(to_upper(node->macroName));
     if (it == macros.end()) {
         throw std::runtime_error("Undefined macro: " + node->macroName);
     }
+    auto macro = it->second;
+
+    std::vector<std::string> arguments;
+    for (const auto& argument : node->arguments) {
+        auto text = dynamic_cast<StringNode*>(argument.get());
+        arguments.push_back(text ? resolveMacroVariables(text->value) : "");
+    }
+
+    // The text the macro generates is lexed, parsed and run as the VM
+    // produces it, so the statements see the macro variables set before them
+    MacroVM vm(macroVariables, [this](const std::string& name) {
+        auto found = macros.find(name);
+        return found != macros.end() ? found->second : nullptr;
+    }, logLogger);
+    vm.call(macro, std::move(arguments));
+    Lexer lexer(Lexer::TextSource([&vm](std::string& more) { return vm.next(more); }));
+    Parser parser(lexer);
+    parser.setErrorHandler([this](const std::string& message) {
+        logLogger.error("Parse error: {}", message);
+    });
+    while (auto stmt = parser.parseNext()) {
+        execute(stmt.get());
+    }
 
-    MacroDefinitionNode* macro = it->second.get();
+    logLogger.info("Macro '{}' executed successfully.", macro->name);
+}
 
-    // Map arguments to parameters
-    if (node->arguments.size() != macro->parameters.size()) {
-        throw std::runtime_error("Macro '" + macro->macroName + "' expects " +
-            std::to_string(macro->parameters.size()) +
-            " arguments, but got " + std::to_string(node->arguments.size()));
+void Interpreter::executeCallRoutine(CallRoutineNode* node) {
+    if (node->routine == "EXECUTE") {
+        // call execute(code): the code runs after the step; the calls of a step
+        // only append to one buffer, lexed and parsed once when the step ends
+        if (node->arguments.size() != 1) {
+            throw std::runtime_error("CALL EXECUTE expects 1 argument.");
+        }
+        Value code = evaluate(node->arguments[0].get());
+        if (auto d = std::get_if<double>(&code)) {
+            appendNumber(executeBuffer, *d);
+        }
+        else {
+            executeBuffer += std::get<std::string>(code);
+        }
+        executeBuffer += '\n';
     }
+    else if (node->routine == "SYMPUTX") {
+        // call symputx(name, value[, scope]): name and value without leading and trailing blanks
+        if (node->arguments.size() < 2 || node->arguments.size() > 3) {
+            throw std::runtime_error("CALL SYMPUTX expects 2 or 3 arguments.");
+        }
+        Value name = evaluate(node->arguments[0].get());
+        Value value = evaluate(node->arguments[1].get());
+        if (node->arguments.size() == 3) {
+            // there is one symbol table, every scope is the global one
+            Value scope = evaluate(node->arguments[2].get());
+            std::string_view s = std::holds_alternative<std::string>(scope) ? strip(std::get<std::string>(scope)) : "";
+            if (s.empty() || !std::strchr("GLFglf", s[0])) {
+                throw std::runtime_error("CALL SYMPUTX scope must be G, L or F.");
+            }
+        }
+        if (!std::holds_alternative<std::string>(name)) {
+            throw std::runtime_error("CALL SYMPUTX expects a character macro variable name.");
+        }
 
-    std::unordered_map<std::string, std::string> localVariables;
-    for (size_t i = 0; i < macro->parameters.size(); ++i) {
-        localVariables[macro->parameters[i]] = resolveMacroVariables(
-            dynamic_cast<StringNode*>(node->arguments[i].get())->value);
+        // name and value are written into buffers that keep their capacity, so
+        // a step setting a variable per row allocates only for new names
+        symputName.assign(strip(std::get<std::string>(name)));
+        if (symputName.empty()) {
+            throw std::runtime_error("CALL SYMPUTX: the macro variable name is blank.");
+        }
+        for (char& c : symputName) {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        std::string& slot = macroVariables[symputName];
+        slot.clear();
+        if (auto d = std::get_if<double>(&value)) {
+            appendNumber(slot, *d);
+        }
+        else {
+            slot.assign(strip(std::get<std::string>(value)));
+        }
     }
-
-    // Temporarily override macro variables
-    auto backup = macroVariables;
-    for (const auto& pair : localVariables) {
-        macroVariables[pair.first] = pair.second;
+    else {
+        throw std::runtime_error("Unsupported CALL routine: " + node->routine);
     }
+}
 
-    // Execute macro body
-    for (const auto& stmt : macro->body) {
-        execute(stmt.get());
+void Interpreter::runExecutedCode() {
+    if (executeBuffer.empty()) {
+        return;
+    }
+    // the steps run here may CALL EXECUTE in turn, into a buffer of their own
+    std::string code = std::move(executeBuffer);
+    executeBuffer.clear();
+    logLogger.info("NOTE: CALL EXECUTE generated line.");
+
+    Lexer lexer(code);
+    Parser parser(lexer);
+    parser.setErrorHandler([this](const std::string& message) {
+        logLogger.error("Parse error: {}", message);
+    });
+    while (auto stmt = parser.parseNext()) {
+        // as in a program, a failing statement does not stop the ones after it
+        try {
+            execute(stmt.get());
+        }
+        catch (const std::exception& e) {
+            logLogger.error("Execution error: {}", e.what());
+            programFailed = true;
+        }
     }
-
-    // Restore original macro variables
-    macroVariables = backup;
-
-    logLogger.info("Macro '{}' executed successfully.", macro->macroName);
 }
 
 void Interpreter::reset() {
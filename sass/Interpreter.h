@@ -9,15 +9,34 @@
 #include <vector>
 #include <string>
 #include <stack>
+#include <set>
+#include <functional>
 #include "PDV.h"
+#include "SqlValueSet.h"
+#include "MacroVM.h"
+#include "LogLimiter.h"
 
 namespace sass {
+    class Checkpoint;
+    struct UnivariateStats;
+    struct Histogram;
+
     class Interpreter {
     public:
         Interpreter(DataEnvironment& env, spdlog::logger& logLogger, spdlog::logger& lstLogger)
             : env(env), logLogger(logLogger), lstLogger(lstLogger) {}
 
         void executeProgram(const std::unique_ptr<ProgramNode>& program);
+        // Checkpoint the session after every statement of executeProgram (nullptr => off);
+        // restart: first restore the last checkpoint and skip the statements it covers
+        void setCheckpoint(Checkpoint* cp, bool restartFromIt) { checkpoint = cp; restart = restartFromIt; }
+        // A program run as it is parsed, one statement at a time: beginProgram(),
+        // executeStatement() for each statement in order, then endProgram()
+        void beginProgram();
+        void executeStatement(ASTNode* stmt);
+        void endProgram();
+        // A statement of the program run last failed
+        bool failed() const { return programFailed; }
         spdlog::logger& logLogger;
         void execute(ASTNode* node);
 
@@ -31,6 +50,13 @@ namespace sass {
 
     private:
         DataEnvironment& env;
+        // the log of the messages written per row, per duplicate and the like
+        LogLimiter logLimit{ logLogger };
+        Checkpoint* checkpoint = nullptr;
+        bool restart = false;
+        size_t statementIndex = 0;  // of the program being run
+        size_t restartAt = 0;       // statements before it ran before the restart
+        bool programFailed = false;
         PDV* pdv = nullptr;
         SasDoc* doc = nullptr;
         spdlog::logger& lstLogger;
@@ -51,6 +77,12 @@ namespace sass {
         void executeIfElse(IfElseIfNode* node); // Updated method
         void executeOutput(OutputNode* node);
         void executeOptions(OptionsNode* node);
+        // &env.memory when OPTIONS FULLSTIMER is on, for ScopedStepTimer
+        MemoryManager* fullStimer();
+        // Re-measure datasets after a step, spill if over MEMSIZE and log what moved
+        void checkMemory();
+        // Run a step, or skip it under OPTIONS INCREMENTAL when its outputs are still current
+        void runIncremental(ASTNode* step, const std::function<void()>& run);
         void executeLibname(LibnameNode* node);
         void executeTitle(TitleNode* node);
         void executeProc(ProcNode* node);
@@ -60,8 +92,20 @@ namespace sass {
         void executeArray(ArrayNode* node);
         void executeDo(DoNode* node);
         void executeProcSort(ProcSortNode* node);
+        // WHERE for procedures: the rows of inputDS that match, to scan inputDS through
+        RowSelection selectWhere(Dataset* inputDS, ASTNode* whereCondition);
         void executeProcMeans(ProcMeansNode* node);
+        void executeProcUnivariate(ProcUnivariateNode* node);
+        void executeProcRank(ProcRankNode* node);
+        // The listing of one variable of PROC UNIVARIATE, histogram may be nullptr
+        void printUnivariate(const std::string& var, const UnivariateStats& stats, const Histogram* histogram);
         void executeProcFreq(ProcFreqNode* node);
+        // NLEVELS of PROC FREQ: the number of distinct values of each variable (of the selected rows)
+        void printNlevels(Dataset* ds, const std::vector<std::string>& vars, const RowSelection* selection = nullptr);
+        // OPTIONS APPROXDISTINCT: the HyperLogLog precision distinct counts use, 0 when they are exact
+        int approxDistinctPrecision();
+        // Log that what was counted approximately, and how close the count is
+        void noteApproxDistinct(const std::string& what, int precision);
         void executeProcPrint(ProcPrintNode* node);
         void executeProcSQL(ProcSQLNode* node);
         void executeBlock(BlockNode* node);
@@ -71,12 +115,20 @@ namespace sass {
         void executeEnd(EndNode* node);
 
         std::unordered_map<std::string, std::string> macroVariables; // Stores macro variables
-        std::unordered_map<std::string, std::unique_ptr<MacroDefinitionNode>> macros; // Stores macro definitions
+        std::unordered_map<std::string, std::shared_ptr<const CompiledMacro>> macros; // Compiled macro definitions, by upper-case name
 
         void executeMacroVariableAssignment(MacroVariableAssignmentNode* node);
-        void executeMacroDefinition(std::unique_ptr<MacroDefinitionNode> node);
+        void executeMacroPut(MacroPutNode* node);
+        void executeMacroDefinition(MacroDefinitionNode* node);
         void executeMacroCall(MacroCallNode* node);
 
+        // CALL EXECUTE and CALL SYMPUTX of a DATA step
+        void executeCallRoutine(CallRoutineNode* node);
+        // The code CALL EXECUTE generated in a step, run after the step as one program
+        void runExecutedCode();
+        std::string executeBuffer;
+        std::string symputName;     // the SYMPUTX name, reused from call to call
+
         std::string resolveMacroVariables(const std::string& input);
 
         void reset(); // reset interpreter state
@@ -95,10 +147,35 @@ namespace sass {
         Value getArrayElement(const std::string& arrayName, int index);
         void setArrayElement(const std::string& arrayName, int index, const Value& value);
 
+        // Values of the SQL aggregates for the group being output, read by evaluate()
+        std::unordered_map<const ASTNode*, Value> sqlAggregateValues;
+
+        // Values of the IN and EXISTS subqueries of the statement being run, by node
+        std::unordered_map<const ASTNode*, SqlValueSet> sqlValueSets;
+
+        // Tables the running PROC SQL has read, by LIBREF.TABLE: read once,
+        // so its statements see the changes of the ones before, not saved yet
+        std::unordered_map<std::string, std::shared_ptr<Dataset>> sqlTables;
+        // and those DELETE, UPDATE or INSERT changed, saved at QUIT
+        std::set<std::string> sqlChangedTables;
+
         // SQL execution helpers
-        Dataset* executeSelect(const SelectStatementNode* selectStmt);
-        void executeCreateTable(const CreateTableStatementNode* createStmt);
-        // Implement other SQL statement executors (INSERT, UPDATE, DELETE) as needed
+        // Run a query, emit gets every row of its result, values in SELECT
+        // list order, as it is made (after sorting under ORDER BY). emit
+        // returns false when it wants no more rows.
+        void runSelect(const SelectStatementNode* selectStmt, const std::function<bool(std::vector<Value>&)>& emit);
+        // What an IN or EXISTS node checks against, run on first use
+        const SqlValueSet& sqlValues(const ASTNode* node);
+        // outObs: OUTOBS= of PROC SQL, 0 => all rows
+        void executeSelect(const SelectStatementNode* selectStmt, size_t outObs);
+        void executeCreateTable(const CreateTableStatementNode* createStmt, size_t outObs);
+        // A table of the running PROC SQL by LIBREF.TABLE, read on first use
+        Dataset* sqlTable(const std::string& tableName);
+        // A table DELETE, UPDATE or INSERT can change in place
+        SasDoc* sqlChangedTable(const std::string& tableName);
+        void executeDelete(const DeleteStatementNode* node);
+        void executeUpdate(const UpdateStatementNode* node);
+        void executeInsert(const InsertStatementNode* node);
     };
 
 }
@@ -6,11 +6,21 @@
 
 namespace sass {
 
-	Lexer::Lexer(const std::string& in) : input(in) {
+	Lexer::Lexer(MappedFile mapped) : Lexer(std::string()) {
+		file = std::move(mapped);
+		input = std::string_view(reinterpret_cast<const char*>(file.data()), file.size());
+	}
+
+	Lexer::Lexer(TextSource more) : Lexer(std::string()) {
+		source = std::move(more);
+	}
+
+	Lexer::Lexer(const std::string& in) : text(in), input(text) {
 		keywords["AND"] = TokenType::AND;
 		keywords["ARRAY"] = TokenType::KEYWORD_ARRAY;
 		keywords["AS"] = TokenType::KEYWORD_AS;
 		keywords["BY"] = TokenType::KEYWORD_BY;
+		keywords["CALL"] = TokenType::KEYWORD_CALL;
 		keywords["CHISQ"] = TokenType::KEYWORD_CHISQ;
 		keywords["CREATE"] = TokenType::KEYWORD_CREATE;
 		keywords["DATA"] = TokenType::KEYWORD_DATA;
@@ -69,6 +79,7 @@ namespace sass {
 		keywords["TABLES"] = TokenType::KEYWORD_TABLES;
 		keywords["THEN"] = TokenType::KEYWORD_THEN;
 		keywords["TITLE"] = TokenType::KEYWORD_TITLE;
+		keywords["UNIVARIATE"] = TokenType::KEYWORD_UNIVARIATE;
 		keywords["UNTIL"] = TokenType::KEYWORD_UNTIL;
 		keywords["UPDATE"] = TokenType::KEYWORD_UPDATE;
 		keywords["VAR"] = TokenType::KEYWORD_VAR;
@@ -307,7 +318,68 @@ namespace sass {
 
 
 	Token Lexer::getNextToken() {
+		while (true) {
+			Token tok = nextToken();
+			if (tok.type != TokenType::KEYWORD_MACRO_INCLUDE) {
+				return tok;
+			}
+			Token file = nextToken();
+			if (file.type != TokenType::STRING) {
+				throw std::runtime_error("Expected a quoted file name after %include at line " + std::to_string(tok.line));
+			}
+			if (nextToken().type != TokenType::SEMICOLON) {
+				throw std::runtime_error("Expected ';' after %include '" + file.text + "'");
+			}
+			// a file that includes itself would never end
+			if (included.size() >= 64) {
+				throw std::runtime_error("%include nested too deeply: " + file.text);
+			}
+			included.push_back({ IncludeCache::shared().tokens(file.text), 0 });
+			includedFiles.push_back(file.text);
+		}
+	}
+
+	Token Lexer::nextToken() {
+		while (!included.empty()) {
+			Included& top = included.back();
+			if (top.next < top.tokens->size()) {
+				return (*top.tokens)[top.next++];
+			}
+			included.pop_back();
+		}
+		return lexToken();
+	}
+
+	bool Lexer::refill() {
+		if (!source) return false;
+		std::string more;
+		if (!source(more)) {
+			source = nullptr;
+			return false;
+		}
+		// what was read is not needed again
+		text.erase(0, pos);
+		pos = 0;
+		text += more;
+		input = text;
+		return true;
+	}
+
+	Token Lexer::lexToken() {
+		if (pendingMacroArgs) {
+			pendingMacroArgs = false;
+			skipWhitespace();
+			return macroArguments();
+		}
+		if (inMacroBody) {
+			inMacroBody = false;
+			return macroBody();
+		}
+
 		skipWhitespace();
+		while (pos >= input.size() && refill()) {
+			skipWhitespace();
+		}
 
 		// If we're already inDatalinesMode, read all lines until we see a line that is ';'
 		if (inDatalinesMode) {
@@ -319,14 +391,14 @@ namespace sass {
 		// handle block comment
 		if (c == '/' && (pos + 1 < input.size()) && input[pos + 1] == '*') {
 			skipBlockComment();
-			return getNextToken();
+			return lexToken();
 		}
 
 		// handle line comment "* ... ;"
 		if (c == '*') {
 			if (atStatementStart) {
 				skipLineComment(false);
-				return getNextToken();
+				return lexToken();
 			}
 			else {
 				// It's a multiplication operator, not a comment
@@ -348,7 +420,7 @@ namespace sass {
 			if (atStatementStart)
 			{
 				skipLineComment(true);
-				return getNextToken();
+				return lexToken();
 			}
 			else {
 
@@ -384,6 +456,10 @@ namespace sass {
 			col++;
 			// after we read a semicolon, the next token is start-of-statement
 			atStatementStart = true;
+			if (inMacroHeader) {
+				inMacroHeader = false;
+				inMacroBody = true;
+			}
 			return semTok;
 		}
 
@@ -508,21 +584,92 @@ namespace sass {
 		return tokens;
 	}
 
+	std::vector<Token> Lexer::tokenizeRaw()
+	{
+		std::vector<Token> tokens;
+		Token tok;
+		while ((tok = lexToken()).type != TokenType::EOF_TOKEN) {
+			tokens.push_back(tok);
+		}
+		return tokens;
+	}
+
 	Token Lexer::macroToken() {
 		getChar(); // Consume '%'
 		std::string value;
-		while (std::isalnum(peekChar())) {
+		while (std::isalnum(peekChar()) || peekChar() == '_') {
 			value += getChar();
 		}
 
 		if (value == "let") return Token{ TokenType::KEYWORD_MACRO_LET, "%let", line, col };
-		if (value == "macro") return Token{ TokenType::KEYWORD_MACRO_MACRO, "%macro", line, col };
+		if (value == "macro") {
+			inMacroHeader = true;
+			return Token{ TokenType::KEYWORD_MACRO_MACRO, "%macro", line, col };
+		}
 		if (value == "mend") return Token{ TokenType::KEYWORD_MACRO_MEND, "%mend", line, col };
 		if (value == "do") return Token{ TokenType::KEYWORD_MACRO_DO, "%do", line, col };
 		if (value == "if") return Token{ TokenType::KEYWORD_MACRO_IF, "%if", line, col };
 		if (value == "then") return Token{ TokenType::KEYWORD_MACRO_THEN, "%then", line, col };
 		if (value == "else") return Token{ TokenType::KEYWORD_MACRO_ELSE, "%else", line, col };
-		throw std::runtime_error("Unknown macro keyword: %" + value);
+		if (to_upper(value) == "INCLUDE") return Token{ TokenType::KEYWORD_MACRO_INCLUDE, "%include", line, col };
+		if (to_upper(value) == "PUT") {
+			// the text is written as is, so it is not split into tokens
+			int startLine = line, startCol = col;
+			while (std::isspace(static_cast<unsigned char>(peekChar()))) getChar();
+			std::string text;
+			while (pos < input.size() && peekChar() != ';') text += getChar();
+			return Token{ TokenType::KEYWORD_MACRO_PUT, text, startLine, startCol };
+		}
+		if (value.empty() || std::isdigit(static_cast<unsigned char>(value[0]))) {
+			throw std::runtime_error("Unknown macro keyword: %" + value);
+		}
+
+		// any other name calls a macro; its arguments come as one token
+		Token call{ TokenType::MACRO_CALL, "%" + value, line, col };
+		size_t next = pos;
+		while (next < input.size() && std::isspace(static_cast<unsigned char>(input[next]))) next++;
+		pendingMacroArgs = next < input.size() && input[next] == '(';
+		return call;
+	}
+
+	Token Lexer::macroArguments() {
+		int startLine = line, startCol = col;
+		getChar(); // Consume '('
+		std::string value;
+		int depth = 1;
+		char quote = 0;
+		while (pos < input.size()) {
+			char c = getChar();
+			if (quote) {
+				if (c == quote) quote = 0;
+			}
+			else if (c == '\'' || c == '"') {
+				quote = c;
+			}
+			else if (c == '(') {
+				depth++;
+			}
+			else if (c == ')' && --depth == 0) {
+				return Token{ TokenType::MACRO_ARGS, value, startLine, startCol };
+			}
+			value += c;
+		}
+		throw std::runtime_error("Unclosed arguments of a macro call at line " + std::to_string(startLine));
+	}
+
+	// The body of a macro is text, compiled when the definition runs
+	Token Lexer::macroBody() {
+		int startLine = line, startCol = col;
+		std::string value;
+		while (pos < input.size()) {
+			if (input[pos] == '%' && input.substr(pos + 1, 4).size() == 4
+				&& to_upper(std::string(input.substr(pos + 1, 4))) == "MEND"
+				&& (pos + 5 >= input.size() || !(std::isalnum(static_cast<unsigned char>(input[pos + 5])) || input[pos + 5] == '_'))) {
+				return Token{ TokenType::MACRO_BODY, value, startLine, startCol };
+			}
+			value += getChar();
+		}
+		throw std::runtime_error("%macro without %mend at line " + std::to_string(startLine));
 	}
 
 	Token Lexer::macroVariable() {
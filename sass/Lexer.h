@@ -2,23 +2,54 @@
 #define LEXER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <functional>
 #include "Token.h"
+#include "MappedFile.h"
+#include "IncludeCache.h"
 #include <unordered_map>
 
 namespace sass {
     class Lexer {
     public:
         Lexer(const std::string& input);
+        // Lex straight out of the mapping of a program file, which is never
+        // read into memory as a whole
+        explicit Lexer(MappedFile file);
+        // Lex text as it is generated: source appends the next piece of it,
+        // false once there is no more. Tokens are not split across pieces.
+        using TextSource = std::function<bool(std::string& more)>;
+        explicit Lexer(TextSource source);
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+
+        // %include 'file'; is replaced by the tokens of the file
         Token getNextToken();
         std::vector<Token> tokenize();
+        // The tokens of the input as written, %include statements left in
+        std::vector<Token> tokenizeRaw();
+        // The files %include statements have read so far
+        const std::vector<std::string>& getIncludedFiles() const { return includedFiles; }
 
     private:
-        std::string input;
+        std::string text;       // the input, when given as a string
+        MappedFile file;        // or mapped
+        std::string_view input;
+        TextSource source;
+        // the tokens of the files being included, innermost last
+        struct Included {
+            IncludeCache::Tokens tokens;
+            size_t next = 0;
+        };
+        std::vector<Included> included;
+        std::vector<std::string> includedFiles;
         size_t pos = 0;
         int line = 1;
         int col = 1;
 
+        Token lexToken();
+        Token nextToken();  // of the innermost included file, or of the input
         char peekChar() const;
         char getChar();
         void skipWhitespace();
@@ -29,6 +60,12 @@ namespace sass {
         Token identifierOrKeyword();
         Token macroToken(); // For %macro, %let, etc.
         Token macroVariable(); // For &varname or &&varname
+        Token macroArguments();
+        Token macroBody();
+        bool refill();
+        bool pendingMacroArgs = false;  // a macro call followed by '('
+        bool inMacroHeader = false;     // between %macro and its ';'
+        bool inMacroBody = false;       // the body comes next
         bool inDatalinesMode = false;  // <-- We'll set this to true after we see 'datalines;'
 
         // Because we only enter "inDatalinesMode" after reading `datalines;`,
@@ -4,43 +4,95 @@
 #include "sasdoc.h"
 #include "Dataset.h"
 #include <filesystem>
+#include <atomic>
 
 namespace fs = std::filesystem;
 
 namespace sass {
-    Library::Library(const std::string& name, const std::string& path, LibraryAccess access)
-        : libName(name), libPath(path), accessMode(access)
+    namespace {
+        // Global access clock for least-recently-used spilling
+        std::atomic<uint64_t> accessClock{ 0 };
+    }
+
+    Library::Library(const std::string& name, const std::string& path, LibraryAccess access,
+        std::shared_ptr<LibraryEngine> engine)
+        : libName(name), libPath(path), accessMode(access), engine(engine)
     {
+        if (!this->engine) {
+            this->engine = LibraryEngine::create("");
+        }
         // Optionally set creationTime = now
         creationTime = std::time(nullptr);
     }
 
+    namespace {
+        // Modification time and size of a member file, false if it is gone
+        bool fileStamp(const std::string& filePath, fs::file_time_type& modified, uintmax_t& size) {
+            std::error_code ec;
+            modified = fs::last_write_time(filePath, ec);
+            if (ec) return false;
+            size = fs::file_size(filePath, ec);
+            return !ec;
+        }
+    }
+
     bool Library::hasDataset(const std::string& dsName) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
         auto it = datasets.find(dsName);
-        return (it != datasets.end());
+        return (it != datasets.end()) || spilled.count(dsName) > 0;
     }
 
     void Library::addDataset(const std::string& dsName, std::shared_ptr<Dataset> ds) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // the caller's dataset replaces what was read from disk
+        snapshots.erase(dsName);
+        addDatasetLocked(dsName, ds);
+    }
+
+    void Library::addDatasetLocked(const std::string& dsName, std::shared_ptr<Dataset> ds) {
+        dropSpillFile(dsName);
         datasets[dsName] = ds;
+        lastAccess[dsName].store(++accessClock, std::memory_order_relaxed);
     }
 
     // Return pointer if found, else nullptr
     std::shared_ptr<Dataset> Library::getDataset(const std::string& dsName) const {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = datasets.find(dsName);
+            if (it != datasets.end()) {
+                touch(dsName);
+                return it->second;
+            }
+            if (spilled.count(dsName) == 0) {
+                return nullptr;
+            }
+        }
+        // Spilled: read it back under the exclusive lock (another session may have done it already)
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        restoreSpilled(dsName);
         auto it = datasets.find(dsName);
         if (it != datasets.end()) {
+            touch(dsName);
             return it->second;
         }
         return nullptr;
     }
 
     void Library::removeDataset(const std::string& dsName) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        dropSpillFile(dsName);
+        lastAccess.erase(dsName);
+        snapshots.erase(dsName);
         auto it = datasets.find(dsName);
         if (it != datasets.end()) {
             datasets.erase(it);
         }
     }
 
+    // Resident datasets only, spilled ones are not listed
     std::vector<std::string> Library::listDatasets() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
         std::vector<std::string> result;
         result.reserve(datasets.size());
         for (auto& kv : datasets) {
@@ -49,21 +101,166 @@ namespace sass {
         return result;
     }
 
-    // Example method: load a dataset from .sas7bdat 
+    // Only updates an existing entry, so the shared lock is enough
+    void Library::touch(const std::string& dsName) const {
+        auto it = lastAccess.find(dsName);
+        if (it != lastAccess.end()) {
+            it->second.store(++accessClock, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t Library::getLastAccess(const std::string& dsName) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = lastAccess.find(dsName);
+        return it != lastAccess.end() ? it->second.load(std::memory_order_relaxed) : 0;
+    }
+
+    size_t Library::getMemoryUsage(const std::string& dsName) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = datasets.find(dsName);
+        if (it == datasets.end()) {
+            return 0;
+        }
+        // both divide shared cells by their use count, together they add up
+        auto snap = snapshots.find(dsName);
+        return it->second->memoryUsage() + (snap != snapshots.end() ? snap->second.doc->memoryUsage() : 0);
+    }
+
+    bool Library::isSpillable(const std::string& dsName) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = datasets.find(dsName);
+        // a step still holding the dataset would not see it spilled
+        return it != datasets.end() && it->second.use_count() == 1
+            && std::dynamic_pointer_cast<SasDoc>(it->second) != nullptr;
+    }
+
+    bool Library::isSpilled(const std::string& dsName) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return spilled.count(dsName) > 0;
+    }
+
+    std::vector<std::string> Library::listSpilled() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<std::string> result;
+        result.reserve(spilled.size());
+        for (auto& kv : spilled) {
+            result.push_back(kv.first);
+        }
+        return result;
+    }
+
+    std::string Library::getSpillFile(const std::string& dsName) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = spilled.find(dsName);
+        return it == spilled.end() ? "" : it->second;
+    }
+
+    size_t Library::spillDataset(const std::string& dsName, const std::string& spillFolder) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // checked again under the exclusive lock, another session may have picked it up
+        auto it = datasets.find(dsName);
+        if (it == datasets.end() || it->second.use_count() != 1) {
+            return 0;
+        }
+        auto doc = std::dynamic_pointer_cast<SasDoc>(it->second);
+        if (!doc) {
+            return 0;
+        }
+        size_t bytes = doc->memoryUsage();
+
+        // Arrow files are mapped back in without a decode pass
+        auto spillEngine = LibraryEngine::create("ARROW");
+        fs::create_directories(spillFolder);
+        std::string filePath = (fs::path(spillFolder) / fs::path(to_lower(libName + "_" + dsName) + ".arrow")).string();
+        if (spillEngine->write(filePath, doc.get()) != 0) {
+            std::cerr << "[Library] Cannot spill " << libName << "." << dsName << " to " << filePath << std::endl;
+            return 0;
+        }
+        spilled[dsName] = filePath;
+        datasets.erase(dsName);
+        // the snapshot would keep the cells in memory
+        snapshots.erase(dsName);
+        return bytes;
+    }
+
+    bool Library::restoreSpilled(const std::string& dsName) const {
+        auto it = spilled.find(dsName);
+        if (it == spilled.end()) {
+            return false;
+        }
+        auto doc = std::make_shared<SasDoc>();
+        if (LibraryEngine::create("ARROW")->read(it->second, doc.get(), ReadOptions()) != 0) {
+            std::cerr << "[Library] Cannot restore " << libName << "." << dsName << " from " << it->second << std::endl;
+            return false;
+        }
+        doc->name = dsName;
+        datasets[dsName] = doc;
+        lastAccess.try_emplace(dsName, 0);
+        dropSpillFile(dsName);
+        return true;
+    }
+
+    void Library::dropSpillFile(const std::string& dsName) const {
+        auto it = spilled.find(dsName);
+        if (it != spilled.end()) {
+            std::error_code ec;
+            fs::remove(it->second, ec);
+            spilled.erase(it);
+        }
+    }
+
+    void Library::takeSnapshot(const std::string& dsName, const std::string& filePath, const std::shared_ptr<Dataset>& ds) {
+        auto doc = std::dynamic_pointer_cast<SasDoc>(ds);
+        Snapshot snap;
+        // rows that were never turned into cells are not in the file
+        bool fileMatches = doc && (!doc->values.empty() || doc->rows.empty());
+        if (!fileMatches || !fileStamp(filePath, snap.modified, snap.size)) {
+            snapshots.erase(dsName);
+            return;
+        }
+        // shares the cells with ds until either side changes them
+        snap.doc = std::make_shared<SasDoc>(*doc);
+        snapshots[dsName] = std::move(snap);
+    }
+
+    // Load a dataset from .sas7bdat (or whatever the library engine stores)
     // If successful, store it in datasets[dsName]
     bool Library::loadDatasetFromSas7bdat(const std::string& dsName) {
+        return loadDataset(dsName);
+    }
+
+    bool Library::loadDataset(const std::string& dsName) {
         if (accessMode == LibraryAccess::READONLY || accessMode == LibraryAccess::READWRITE) {
-            fs::path filePath = fs::path(libPath) / fs::path(dsName + ".sas7bdat");
-            if (!fs::exists(filePath)) return false;
+            std::string filePath = engine->findMember(libPath, dsName);
+            if (filePath.empty()) return false;
 
-            auto doc = std::make_shared<SasDoc>();
-            if (SasDoc::read_sas7bdat(filePath.wstring(), doc.get()) == 0) {
-                // success
-                this->datasets[dsName] = doc; // or convert doc-> to a Dataset
+            // An unchanged member is copied from the snapshot: no decode, and the
+            // copy shares its cells with every other session that loaded it
+            std::shared_ptr<SasDoc> copy;
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                auto it = snapshots.find(dsName);
+                fs::file_time_type modified;
+                uintmax_t size;
+                if (it != snapshots.end() && fileStamp(filePath, modified, size)
+                    && modified == it->second.modified && size == it->second.size) {
+                    copy = std::make_shared<SasDoc>(*std::static_pointer_cast<const SasDoc>(it->second.doc));
+                }
+            }
+            if (copy) {
+                std::unique_lock<std::shared_mutex> lock(mutex);
+                addDatasetLocked(dsName, copy);
                 return true;
-            } else {
+            }
+
+            auto doc = readDataset(dsName, ReadOptions());
+            if (!doc) {
                 return false;
             }
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            addDatasetLocked(dsName, doc);
+            takeSnapshot(dsName, filePath, doc);
+            return true;
         }
         else {
             std::cerr << "[Library] Cannot read dataset in TEMP or restricted mode.\n";
@@ -71,42 +268,77 @@ namespace sass {
         }
     }
 
-    // Example method: save a dataset to .sas7bdat
+    std::shared_ptr<SasDoc> Library::readDataset(const std::string& dsName, const ReadOptions& options) {
+        if (accessMode != LibraryAccess::READONLY && accessMode != LibraryAccess::READWRITE) {
+            std::cerr << "[Library] Cannot read dataset in TEMP or restricted mode.\n";
+            return nullptr;
+        }
+        std::string filePath = engine->findMember(libPath, dsName);
+        if (filePath.empty()) return nullptr;
+
+        auto doc = std::make_shared<SasDoc>();
+        std::lock_guard<std::mutex> io(ioMutex);
+        if (engine->read(filePath, doc.get(), options) != 0) {
+            return nullptr;
+        }
+        doc->name = dsName;
+        return doc;
+    }
+
+    // Save a dataset through the library engine
     bool Library::saveDatasetToSas7bdat(const std::string& dsName) {
         if (accessMode == LibraryAccess::READWRITE) {
+            return writeDataset(dsName, engine->memberPath(libPath, dsName));
+        }
+        else {
+            std::cerr << "[Library] Library is read-only or temp, cannot save dataset.\n";
+            return false;
+        }
+    }
+
+    bool Library::writeDataset(const std::string& dsName, const std::string& filePath) {
+        std::shared_ptr<Dataset> ds;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
             auto it = datasets.find(dsName);
             if (it == datasets.end()) {
                 std::cerr << "[Library] Dataset not found: " << dsName << std::endl;
                 return false;
             }
-            // we have the dataset in memory, write it out
-            std::string filePath = (fs::path(libPath) /  fs::path(dsName + ".sas7bdat")).string();
-            std::cout << "[Library] Saving " << dsName << " to " << filePath << std::endl;
-
-            // if using SasDoc or readstat writer calls:
-            // auto doc = std::dynamic_pointer_cast<SasDoc>(it->second);
-            // if (doc) {
-            //     int rc = SasDoc::write_sas7bdat(filePath, doc.get());
-            //     return (rc == 0);
-            // }
-            return true;
+            ds = it->second;
         }
-        else {
-            std::cerr << "[Library] Library is read-only or temp, cannot save dataset.\n";
+        auto doc = std::dynamic_pointer_cast<SasDoc>(ds);
+        if (!doc) {
+            std::cerr << "[Library] Dataset cannot be written by the " << engine->getName() << " engine: " << dsName << std::endl;
             return false;
         }
+        std::lock_guard<std::mutex> io(ioMutex);
+        if (engine->write(filePath, doc.get()) != 0) {
+            return false;
+        }
+        // what was just written is the snapshot of the member file
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (filePath == engine->memberPath(libPath, dsName)) {
+            takeSnapshot(dsName, filePath, doc);
+        }
+        return true;
     }
 
     // If the dataset doesn't exist, create it in memory:
     std::shared_ptr<Dataset> Library::getOrCreateDataset(const std::string& dsName) {
+        if (auto ds = getDataset(dsName)) {
+            return ds;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // another session may have created it in the meantime
         auto it = datasets.find(dsName);
         if (it != datasets.end()) {
-
             return it->second;
         }
         auto newds = std::make_shared<SasDoc>();
         newds->name = dsName;
-        datasets[dsName] = newds;
+        snapshots.erase(dsName);
+        addDatasetLocked(dsName, newds);
         return newds;
     }
 
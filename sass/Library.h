@@ -6,7 +6,13 @@
 #include <map>
 #include <memory>
 #include <ctime>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <filesystem>
 #include "Dataset.h"
+#include "LibraryEngine.h"
 
 namespace sass {
     // Forward-declare any classes you need, e.g. SasDoc or DataEnvironment
@@ -21,16 +27,22 @@ namespace sass {
 
     // Represents a single SAS library (libref). 
     // Typically points to a directory or path.
+    //
+    // A Library can be shared by several sessions (see LibraryRegistry), so
+    // its dataset map is guarded by a reader-writer lock: lookups run in
+    // parallel, loads/saves/spills take it exclusively.
     class Library {
     public:
         // Constructors
         Library() = default;
-        Library(const std::string& name, const std::string& path, LibraryAccess access = LibraryAccess::READWRITE);
+        Library(const std::string& name, const std::string& path, LibraryAccess access = LibraryAccess::READWRITE,
+            std::shared_ptr<LibraryEngine> engine = nullptr);
 
         // Basic getters
         const std::string& getName() const { return libName; }
         const std::string& getPath() const { return libPath; }
         LibraryAccess getAccessMode() const { return accessMode; }
+        std::shared_ptr<LibraryEngine> getEngine() const { return engine; }
 
         // Possibly store or retrieve metadata like creationTime
         time_t getCreationTime() const { return creationTime; }
@@ -47,17 +59,64 @@ namespace sass {
         // Example methods to read and write SAS7BDAT from this library path
         // (integration with a read/write logic - you might use SasDoc or ReadStat behind the scenes)
         bool loadDatasetFromSas7bdat(const std::string& dsName);
+        // Read the whole member through the library engine and keep it as dsName
+        bool loadDataset(const std::string& dsName);
+        // Read a member honoring KEEP=/DROP=/FIRSTOBS=/OBS=; the subset belongs to
+        // the caller and is not kept. nullptr when the member cannot be read
+        std::shared_ptr<SasDoc> readDataset(const std::string& dsName, const ReadOptions& options);
         bool saveDatasetToSas7bdat(const std::string& dsName);
+        // Write a resident dataset to filePath through the library engine
+        bool writeDataset(const std::string& dsName, const std::string& filePath);
         std::shared_ptr<Dataset> getOrCreateDataset(const std::string& dsName);
+
+        // Memory management (MEMSIZE=): a dataset nobody but the library holds
+        // can be moved out to a spill file; it is read back on next access.
+        uint64_t getLastAccess(const std::string& dsName) const;
+        // Bytes held by a resident dataset (0 when spilled or unknown), does not count as an access
+        size_t getMemoryUsage(const std::string& dsName) const;
+        bool isSpillable(const std::string& dsName) const;
+        // Returns the bytes released, 0 if the dataset was not spilled
+        size_t spillDataset(const std::string& dsName, const std::string& spillFolder);
+        bool isSpilled(const std::string& dsName) const;
+        // Datasets currently spilled (listDatasets() has the resident ones) and their Arrow files
+        std::vector<std::string> listSpilled() const;
+        std::string getSpillFile(const std::string& dsName) const;
     private:
+        // Guards datasets, spilled, lastAccess and snapshots
+        mutable std::shared_mutex mutex;
+        // Serializes member file reads and writes of this library
+        std::mutex ioMutex;
+
         std::string libName;   // e.g. "MYLIB"
         std::string libPath;   // e.g. "/my/directory"
         LibraryAccess accessMode;
         time_t creationTime;
+        std::shared_ptr<LibraryEngine> engine; // how members are stored on disk
 
         // A map from dataset name -> dataset pointer
         // You can store a "SasDoc" instead if you prefer
-        std::unordered_map<std::string, std::shared_ptr<Dataset>> datasets;
+        // (mutable: spilled datasets are restored transparently by getDataset)
+        mutable std::unordered_map<std::string, std::shared_ptr<Dataset>> datasets;
+        mutable std::unordered_map<std::string, std::string> spilled; // dsName => spill file
+        // dsName => access tick (atomic: updated under the shared lock)
+        mutable std::unordered_map<std::string, std::atomic<uint64_t>> lastAccess;
+
+        // The member as last read from / written to disk. A later load of an
+        // unchanged file gets a copy that shares its cells instead of decoding
+        // the file again, so sessions reading the same member share one buffer.
+        struct Snapshot {
+            std::shared_ptr<const Dataset> doc;
+            std::filesystem::file_time_type modified;
+            uintmax_t size = 0;
+        };
+        std::unordered_map<std::string, Snapshot> snapshots;
+
+        // The *Locked helpers expect the caller to hold mutex exclusively
+        void addDatasetLocked(const std::string& dsName, std::shared_ptr<Dataset> ds);
+        void touch(const std::string& dsName) const;
+        bool restoreSpilled(const std::string& dsName) const;
+        void dropSpillFile(const std::string& dsName) const;
+        void takeSnapshot(const std::string& dsName, const std::string& filePath, const std::shared_ptr<Dataset>& ds);
     };
 
 }
@@ -0,0 +1,484 @@
+#include "LibraryEngine.h"
+#include "sasdoc.h"
+#include "ArrowEngine.h"
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <cmath>
+#include <boost/algorithm/string.hpp>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace sass {
+
+    bool ReadOptions::selects(const std::string& column) const {
+        auto same = [&](const std::string& name) { return boost::iequals(name, column); };
+        if (!keep.empty() && std::none_of(keep.begin(), keep.end(), same)) {
+            return false;
+        }
+        return std::none_of(drop.begin(), drop.end(), same);
+    }
+
+    namespace {
+        uint64_t mix(uint64_t x) {
+            // splitmix64 finalizer
+            x += 0x9e3779b97f4a7c15ull;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+    }
+
+    RowSampler::RowSampler(const ReadOptions& options, int64_t rows)
+        : rows(rows), seed(options.sampleSeed)
+    {
+        if (options.sample < 0) {
+            throw std::runtime_error("SAMPLE= must not be negative.");
+        }
+        if (options.sample < 1) {
+            fraction = options.sample;
+            keyColumn = options.sampleKey;
+        }
+        else {
+            count = (int64_t)options.sample;
+            if (rows >= 0) {
+                drawn = draw(seed, count, rows);
+            }
+        }
+    }
+
+    bool RowSampler::keepsHash(uint64_t h) const {
+        // top 53 bits as a uniform double in [0, 1)
+        return (double)(h >> 11) * 0x1.0p-53 < fraction;
+    }
+
+    bool RowSampler::keepsRow(int64_t row) const {
+        if (count >= 0) {
+            return rows < 0 || std::binary_search(drawn.begin(), drawn.end(), row);
+        }
+        return keepsHash(mix(seed ^ mix((uint64_t)row)));
+    }
+
+    bool RowSampler::keepsKey(double key) const {
+        if (key == 0) key = 0; // -0 and 0 are the same key
+        uint64_t bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return keepsHash(mix(seed ^ mix(bits)));
+    }
+
+    bool RowSampler::keepsKey(std::string_view key) const {
+        // character values are blank padded
+        while (!key.empty() && key.back() == ' ') key.remove_suffix(1);
+        return keepsHash(mix(seed ^ Fnv1a().add(key.data(), key.size()).hash));
+    }
+
+    std::vector<int64_t> RowSampler::draw(uint64_t seed, int64_t n, int64_t rows) {
+        std::vector<int64_t> result;
+        if (n >= rows) {
+            result.resize((size_t)std::max<int64_t>(rows, 0));
+            std::iota(result.begin(), result.end(), 0);
+            return result;
+        }
+        // Floyd's algorithm: n draws for n rows, whatever the size of the window
+        std::mt19937_64 rng(seed);
+        std::unordered_set<int64_t> chosen;
+        for (int64_t j = rows - n; j < rows; j++) {
+            int64_t t = std::uniform_int_distribution<int64_t>(0, j)(rng);
+            chosen.insert(chosen.count(t) ? j : t);
+        }
+        result.assign(chosen.begin(), chosen.end());
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    std::string LibraryEngine::findMember(const std::string& dir, const std::string& dsName) const {
+        // SAS uppercases member names, files on disk are usually lowercase
+        std::vector<std::string> names = { dsName, to_lower(dsName), to_upper(dsName) };
+        for (const auto& ext : getExtensions()) {
+            for (const auto& name : names) {
+                fs::path candidate = fs::path(dir) / fs::path(name + ext);
+                if (fs::exists(candidate)) {
+                    return candidate.string();
+                }
+            }
+        }
+        return "";
+    }
+
+    std::string LibraryEngine::memberPath(const std::string& dir, const std::string& dsName) const {
+        return (fs::path(dir) / fs::path(to_lower(dsName) + getExtensions().front())).string();
+    }
+
+    //-------------------------------------------------------------------
+    // ReadStat based engines (V9, STATA, SPSS)
+    //-------------------------------------------------------------------
+    namespace {
+
+        // State shared by the ReadStat callbacks while one member is decoded
+        struct ReadStatReadContext {
+            SasDoc* doc = nullptr;
+            const ReadOptions* options = nullptr;
+            std::vector<int> columnMap;   // ReadStat variable index => doc column, -1 => projected out
+            long expectedRows = -1;       // from metadata, after FIRSTOBS=/OBS=; -1 => unknown
+            long allocatedRows = 0;
+            long rowsSeen = 0;
+            int firstObsIndex = -1;       // obs_index of the first row delivered
+            bool stoppedAtLimit = false;
+
+            // SAMPLE=: rows are numbered in the window as before, but stored
+            // one after the other in the slot of the next kept row
+            std::unique_ptr<RowSampler> sampler;
+            int keyIndex = -1;            // ReadStat variable index of SAMPLEKEY=, -1 => none
+            long currentRow = -1;         // window row being delivered
+            long keptRows = 0;            // kept rows before currentRow
+            bool dropRow = false;
+        };
+
+        long rowLimit(const ReadOptions& options) {
+            if (options.obs < 0) return -1;
+            return std::max(0L, options.obs - std::max(1L, options.firstObs) + 1);
+        }
+
+        int handleMetadata(readstat_metadata_t* metadata, void* ctx) {
+            auto* rc = static_cast<ReadStatReadContext*>(ctx);
+            SasDoc* doc = rc->doc;
+
+            doc->creation_time = readstat_get_creation_time(metadata);
+            doc->modified_time = readstat_get_modified_time(metadata);
+            doc->file_format_version = readstat_get_file_format_version(metadata);
+            doc->compression = readstat_get_compression(metadata);
+            doc->endianness = readstat_get_endianness(metadata);
+            const char* s = readstat_get_table_name(metadata);
+            doc->file_name = s ? s : "";
+            s = readstat_get_file_label(metadata);
+            doc->file_label = s ? s : "";
+            s = readstat_get_file_encoding(metadata);
+            doc->file_encoding = s ? s : "";
+            doc->is64bit = readstat_get_file_format_is_64bit(metadata);
+
+            int varCount = readstat_get_var_count(metadata);
+            if (varCount > (int)rc->columnMap.size()) {
+                rc->columnMap.resize(varCount, -1);
+            }
+
+            // XPORT reports -1 until the row count is known
+            long rowCount = readstat_get_row_count(metadata);
+            if (rowCount >= 0) {
+                long rows = std::max(0L, rowCount - (std::max(1L, rc->options->firstObs) - 1));
+                long limit = rowLimit(*rc->options);
+                rc->expectedRows = limit >= 0 ? std::min(rows, limit) : rows;
+            }
+            if (rc->options->isSampled()) {
+                rc->sampler = std::make_unique<RowSampler>(*rc->options, rc->expectedRows);
+            }
+            return READSTAT_HANDLER_OK;
+        }
+
+        int handleVariable(int index, readstat_variable_t* variable, const char* val_labels, void* ctx) {
+            auto* rc = static_cast<ReadStatReadContext*>(ctx);
+            SasDoc* doc = rc->doc;
+
+            std::string name = readstat_variable_get_name(variable);
+            if (index >= (int)rc->columnMap.size()) {
+                rc->columnMap.resize(index + 1, -1);
+            }
+            bool isKey = rc->sampler && rc->sampler->byKey() && boost::iequals(name, rc->options->sampleKey);
+            if (isKey) {
+                rc->keyIndex = index;
+            }
+            if (!rc->options->selects(name)) {
+                // ReadStat never decodes values of skipped variables, the sample key is needed anyway
+                return isKey ? READSTAT_HANDLER_OK : READSTAT_HANDLER_SKIP_VARIABLE;
+            }
+
+            rc->columnMap[index] = doc->var_count++;
+            const char* label = readstat_variable_get_label(variable);
+            const char* format = readstat_variable_get_format(variable);
+            doc->var_names.push_back(name);
+            doc->var_labels.push_back(label ? label : "");
+            doc->var_formats.push_back(format ? format : "");
+            // Values are held as double or string whatever the width on disk
+            bool isString = variable->type == READSTAT_TYPE_STRING || variable->type == READSTAT_TYPE_STRING_REF;
+            doc->var_types.push_back(isString ? READSTAT_TYPE_STRING : READSTAT_TYPE_DOUBLE);
+            doc->var_length.push_back(isString ? (int)variable->storage_width : 8);
+            doc->var_display_length.push_back(variable->display_width);
+            doc->var_decimals.push_back(variable->decimals);
+            return READSTAT_HANDLER_OK;
+        }
+
+        int handleValue(int obs_index, readstat_variable_t* variable, readstat_value_t value, void* ctx) {
+            auto* rc = static_cast<ReadStatReadContext*>(ctx);
+            SasDoc* doc = rc->doc;
+
+            int index = readstat_variable_get_index(variable);
+            int col = rc->columnMap[index];
+            if (col < 0 && index != rc->keyIndex) {
+                return READSTAT_HANDLER_OK;
+            }
+
+            // Row numbers are taken relative to the first row we are handed,
+            // ReadStat has already skipped the FIRSTOBS= rows for us.
+            if (rc->firstObsIndex < 0) {
+                rc->firstObsIndex = obs_index;
+            }
+            long row = obs_index - rc->firstObsIndex;
+            long limit = rowLimit(*rc->options);
+            if (limit >= 0 && row >= limit) {
+                rc->stoppedAtLimit = true;
+                return READSTAT_HANDLER_ABORT;
+            }
+
+            if (rc->sampler) {
+                if (row != rc->currentRow) {
+                    if (rc->currentRow >= 0 && !rc->dropRow) rc->keptRows++;
+                    rc->currentRow = row;
+                    // without a key column the row is drawn by its number
+                    rc->dropRow = rc->keyIndex < 0 && !rc->sampler->keepsRow(row);
+                }
+                if (rc->dropRow) {
+                    return READSTAT_HANDLER_OK;
+                }
+                if (index == rc->keyIndex) {
+                    bool isString = readstat_value_type(value) == READSTAT_TYPE_STRING || readstat_value_type(value) == READSTAT_TYPE_STRING_REF;
+                    const char* str = isString ? readstat_string_value(value) : nullptr;
+                    // missing keys hash like the cells they are stored as
+                    bool missing = readstat_value_is_missing(value, variable);
+                    bool keep = isString ? rc->sampler->keepsKey(std::string_view(!missing && str ? str : ""))
+                        : rc->sampler->keepsKey(missing ? double(-INFINITY) : readstat_double_value(value));
+                    // cells already stored for this row are overwritten by the next kept one
+                    rc->dropRow = !keep;
+                    if (rc->dropRow || col < 0) {
+                        return READSTAT_HANDLER_OK;
+                    }
+                }
+                row = rc->keptRows;
+            }
+
+            // Grow the row-major value buffer in place, never per cell
+            if (row >= rc->allocatedRows) {
+                long expected = rc->sampler ? 0 : rc->expectedRows;
+                long rows = std::max(row + 1, std::max(expected, rc->allocatedRows * 2));
+                doc->values.resize((size_t)rows * doc->var_count);
+                rc->allocatedRows = rows;
+            }
+            rc->rowsSeen = std::max(rc->rowsSeen, row + 1);
+
+            Cell& cell = doc->values.mutate()[(size_t)row * doc->var_count + col];
+            bool isString = doc->var_types[col] == READSTAT_TYPE_STRING;
+            if (readstat_value_is_missing(value, variable)) {
+                if (isString) cell = flyweight_string("");
+                else cell = double(-INFINITY);
+                return READSTAT_HANDLER_OK;
+            }
+
+            switch (readstat_value_type(value)) {
+            case READSTAT_TYPE_STRING:
+            case READSTAT_TYPE_STRING_REF: {
+                const char* str = readstat_string_value(value);
+                cell = flyweight_string(str ? str : "");
+                break;
+            }
+            case READSTAT_TYPE_INT8:
+                cell = (double)readstat_int8_value(value);
+                break;
+            case READSTAT_TYPE_INT16:
+                cell = (double)readstat_int16_value(value);
+                break;
+            case READSTAT_TYPE_INT32:
+                cell = (double)readstat_int32_value(value);
+                break;
+            case READSTAT_TYPE_FLOAT:
+                cell = (double)readstat_float_value(value);
+                break;
+            case READSTAT_TYPE_DOUBLE:
+                cell = readstat_double_value(value);
+                break;
+            default:
+                break;
+            }
+            return READSTAT_HANDLER_OK;
+        }
+
+        class ReadStatEngine : public LibraryEngine {
+        public:
+            ReadStatEngine(const std::string& name, std::vector<std::pair<std::string, ReadStatFormat>> formats)
+                : name(name), formats(std::move(formats)) {}
+
+            std::string getName() const override { return name; }
+
+            std::vector<std::string> getExtensions() const override {
+                std::vector<std::string> exts;
+                for (auto& f : formats) exts.push_back(f.first);
+                return exts;
+            }
+
+            int read(const std::string& filePath, SasDoc* doc, const ReadOptions& options) const override {
+                ReadStatFormat format;
+                if (!formatOf(filePath, format)) {
+                    std::cerr << "[" << name << "] Unsupported member file: " << filePath << std::endl;
+                    return READSTAT_ERROR_OPEN;
+                }
+
+                doc->obs_count = 0;
+                doc->var_count = 0;
+                doc->var_names.clear();
+                doc->var_labels.clear();
+                doc->var_formats.clear();
+                doc->var_types.clear();
+                doc->var_length.clear();
+                doc->var_display_length.clear();
+                doc->var_decimals.clear();
+                doc->values.clear();
+
+                ReadStatReadContext ctx;
+                ctx.doc = doc;
+                ctx.options = &options;
+
+                readstat_parser_t* parser = readstat_parser_init();
+                readstat_set_metadata_handler(parser, &handleMetadata);
+                readstat_set_variable_handler(parser, &handleVariable);
+                readstat_set_value_handler(parser, &handleValue);
+                // Let the parser itself skip rows instead of decoding them
+                if (options.firstObs > 1) {
+                    readstat_set_row_offset(parser, options.firstObs - 1);
+                }
+                long limit = rowLimit(options);
+                if (limit > 0) {
+                    readstat_set_row_limit(parser, limit);
+                }
+
+                readstat_error_t error = READSTAT_OK;
+                if (limit != 0) {
+                    std::wstring path(filePath.begin(), filePath.end());
+                    switch (format) {
+                    case ReadStatFormat::XPORT:
+                        error = readstat_parse_xport(parser, path.c_str(), &ctx);
+                        break;
+                    case ReadStatFormat::DTA:
+                        error = readstat_parse_dta(parser, path.c_str(), &ctx);
+                        break;
+                    case ReadStatFormat::SAV:
+                        error = readstat_parse_sav(parser, path.c_str(), &ctx);
+                        break;
+                    case ReadStatFormat::POR:
+                        error = readstat_parse_por(parser, path.c_str(), &ctx);
+                        break;
+                    default:
+                        error = readstat_parse_sas7bdat(parser, path.c_str(), &ctx);
+                        break;
+                    }
+                }
+                readstat_parser_free(parser);
+
+                if (error != READSTAT_OK && !(error == READSTAT_ERROR_USER_ABORT && ctx.stoppedAtLimit)) {
+                    std::cerr << "[" << name << "] Error processing " << filePath << ": " << error << std::endl;
+                    return error;
+                }
+
+                // A member without selected columns still has its rows
+                long rows = ctx.rowsSeen;
+                if (doc->var_count == 0 && ctx.expectedRows > 0 && !ctx.sampler) {
+                    rows = ctx.expectedRows;
+                }
+                if (ctx.sampler) {
+                    rows = ctx.keptRows + (ctx.currentRow >= 0 && !ctx.dropRow ? 1 : 0);
+                }
+                doc->obs_count = (int)rows;
+                doc->values.resize((size_t)doc->obs_count * doc->var_count);
+                if (ctx.sampler && ctx.sampler->drawsAfterwards()) {
+                    // SAMPLE=n of an XPORT file: its row count was only known at the end
+                    auto drawn = RowSampler::draw(options.sampleSeed, (int64_t)options.sample, doc->obs_count);
+                    size_t width = doc->var_count;
+                    auto& values = doc->values.mutate();
+                    for (size_t i = 0; i < drawn.size(); i++) {
+                        for (size_t c = 0; c < width; c++) {
+                            values[i * width + c] = std::move(values[(size_t)drawn[i] * width + c]);
+                        }
+                    }
+                    doc->obs_count = (int)drawn.size();
+                    doc->values.resize((size_t)doc->obs_count * width);
+                }
+                doc->var_flag.resize(doc->var_count, true);
+                doc->obs_flag.resize(doc->obs_count, true);
+                doc->or_flag.resize(doc->obs_count, false);
+                doc->obs_library_filter.resize(doc->obs_count, true);
+                return 0;
+            }
+
+            int write(const std::string& filePath, SasDoc* doc) const override {
+                ReadStatFormat format;
+                if (!formatOf(filePath, format)) {
+                    format = formats.front().second;
+                }
+                return SasDoc::write_file(std::wstring(filePath.begin(), filePath.end()), doc, format);
+            }
+
+        private:
+            std::string name;
+            std::vector<std::pair<std::string, ReadStatFormat>> formats;
+
+            bool formatOf(const std::string& filePath, ReadStatFormat& format) const {
+                std::string ext = to_lower(fs::path(filePath).extension().string());
+                for (auto& f : formats) {
+                    if (f.first == ext) {
+                        format = f.second;
+                        return true;
+                    }
+                }
+                return false;
+            }
+        };
+
+        std::mutex& registryMutex() {
+            static std::mutex m;
+            return m;
+        }
+
+        std::map<std::string, LibraryEngine::Factory>& registry() {
+            static std::map<std::string, LibraryEngine::Factory> engines = {
+                { "V9", [] {
+                    return std::make_shared<ReadStatEngine>("V9", std::vector<std::pair<std::string, ReadStatFormat>>{
+                        { ".sas7bdat", ReadStatFormat::SAS7BDAT }, { ".xpt", ReadStatFormat::XPORT } });
+                } },
+                { "STATA", [] {
+                    return std::make_shared<ReadStatEngine>("STATA", std::vector<std::pair<std::string, ReadStatFormat>>{
+                        { ".dta", ReadStatFormat::DTA } });
+                } },
+                { "SPSS", [] {
+                    return std::make_shared<ReadStatEngine>("SPSS", std::vector<std::pair<std::string, ReadStatFormat>>{
+                        { ".sav", ReadStatFormat::SAV }, { ".por", ReadStatFormat::POR } });
+                } },
+                { "ARROW", [] { return std::make_shared<ArrowEngine>(); } },
+            };
+            return engines;
+        }
+    }
+
+    std::shared_ptr<LibraryEngine> LibraryEngine::create(const std::string& engineName) {
+        std::string key = to_upper(engineName);
+        if (key.empty() || key == "BASE" || key == "V9" || key == "SAS7BDAT") {
+            key = "V9";
+        }
+        else if (key == "FEATHER") {
+            key = "ARROW";
+        }
+        std::lock_guard<std::mutex> lock(registryMutex());
+        auto it = registry().find(key);
+        if (it == registry().end()) {
+            return nullptr;
+        }
+        return it->second();
+    }
+
+    void LibraryEngine::registerEngine(const std::string& engineName, Factory factory) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry()[to_upper(engineName)] = std::move(factory);
+    }
+
+}
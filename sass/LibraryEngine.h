@@ -0,0 +1,112 @@
+#ifndef LIBRARYENGINE_H
+#define LIBRARYENGINE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <string_view>
+
+namespace sass {
+    class SasDoc;
+
+    // Dataset options that narrow what an engine decodes from a member file,
+    // e.g. set s.auto(keep=make price firstobs=11 obs=20);
+    struct ReadOptions {
+        std::vector<std::string> keep;   // columns to read, empty => all
+        std::vector<std::string> drop;   // columns to skip
+        long firstObs = 1;               // FIRSTOBS=, 1-based
+        long obs = -1;                   // OBS=, number of the last row to read, -1 => no limit
+        // System options SAMPLE=/SAMPLESEED=/SAMPLEKEY= for development runs (see RowSampler)
+        double sample = 1;               // < 1 a fraction of the rows, > 1 a number of rows, 1 => all
+        uint64_t sampleSeed = 0;
+        std::string sampleKey;           // column whose value decides, "" => each row on its own
+
+        bool isDefault() const {
+            return keep.empty() && drop.empty() && firstObs <= 1 && obs < 0 && !isSampled();
+        }
+
+        bool isSampled() const { return sample != 1; }
+
+        // Is the column selected by KEEP=/DROP= (case-insensitive, as in SAS)?
+        bool selects(const std::string& column) const;
+    };
+
+    // Which rows of a member a sampled read keeps. Engines ask before a row
+    // is decoded, so the rows left out are never decoded at all.
+    //   SAMPLE=0.1      every row with probability 0.1
+    //   SAMPLE=1000     1000 rows drawn uniformly
+    //   SAMPLEKEY=id    with a fraction: by a hash of id instead, so tables
+    //                   sampled with the same seed keep the same ids and joins still match
+    // The same SAMPLESEED= always picks the same rows.
+    class RowSampler {
+    public:
+        // rows: rows in the FIRSTOBS=/OBS= window, -1 when not known before reading
+        RowSampler(const ReadOptions& options, int64_t rows);
+
+        bool byKey() const { return !keyColumn.empty(); }
+
+        // row: 0-based in the window
+        bool keepsRow(int64_t row) const;
+        bool keepsKey(double key) const;
+        bool keepsKey(std::string_view key) const;
+
+        // SAMPLE=n over a window of unknown size: every row is read and
+        // draw() picks the sample afterwards
+        bool drawsAfterwards() const { return count >= 0 && rows < 0; }
+
+        // n distinct rows out of [0, rows), ascending
+        static std::vector<int64_t> draw(uint64_t seed, int64_t n, int64_t rows);
+
+    private:
+        double fraction = 1;
+        int64_t count = -1;
+        int64_t rows;
+        uint64_t seed;
+        std::string keyColumn;
+        std::vector<int64_t> drawn;
+
+        bool keepsHash(uint64_t h) const;
+    };
+
+    // A library engine knows how members of one LIBNAME engine (V9, STATA,
+    // SPSS, ...) are stored on disk. Library delegates all member I/O to it,
+    // so a new format only needs a new engine registered under its name.
+    class LibraryEngine {
+    public:
+        using Factory = std::function<std::shared_ptr<LibraryEngine>()>;
+
+        virtual ~LibraryEngine() = default;
+
+        // Engine name as shown in the LIBNAME note, e.g. "V9"
+        virtual std::string getName() const = 0;
+
+        // Member file extensions this engine recognizes, preferred (written) one first
+        virtual std::vector<std::string> getExtensions() const = 0;
+
+        // Decode a member file into doc. Rows outside FIRSTOBS=/OBS= and
+        // columns outside KEEP=/DROP= are skipped by the reader, not decoded
+        // and discarded afterwards. Returns 0 on success.
+        virtual int read(const std::string& filePath, SasDoc* doc, const ReadOptions& options) const = 0;
+
+        // Encode doc to a member file. Returns 0 on success.
+        virtual int write(const std::string& filePath, SasDoc* doc) const = 0;
+
+        // Resolve dsName to an existing member file in dir, or "" if there is none
+        std::string findMember(const std::string& dir, const std::string& dsName) const;
+
+        // Path a new member would be written to, e.g. "dir/a.sas7bdat"
+        std::string memberPath(const std::string& dir, const std::string& dsName) const;
+
+        // Create the engine registered under engineName ("" means the default V9 engine).
+        // Returns nullptr when no such engine exists.
+        static std::shared_ptr<LibraryEngine> create(const std::string& engineName);
+
+        // Plug in an additional engine, e.g. registerEngine("XLSX", ...)
+        static void registerEngine(const std::string& engineName, Factory factory);
+    };
+
+}
+
+#endif // LIBRARYENGINE_H
@@ -0,0 +1,92 @@
+#include "LibraryRegistry.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+namespace sass {
+
+    LibraryRegistry::~LibraryRegistry() {
+        if (!spillRoot.empty()) {
+            removeDirectoryRecursively(spillRoot);
+        }
+    }
+
+    std::shared_ptr<Library> LibraryRegistry::acquire(const std::string& libref, const std::string& path,
+        LibraryAccess access, const std::string& engine) {
+        auto libEngine = LibraryEngine::create(engine);
+        if (!libEngine) {
+            return nullptr;
+        }
+
+        std::error_code ec;
+        fs::path canonical = fs::weakly_canonical(path, ec);
+        std::string key = (ec ? path : canonical.string()) + "|" + libEngine->getName() + "|" + std::to_string((int)access);
+
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = libraries.find(key);
+            if (it != libraries.end()) {
+                if (auto lib = it->second.lib.lock()) {
+                    return lib;
+                }
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // another session may have created it in the meantime
+        auto& entry = libraries[key];
+        if (auto lib = entry.lib.lock()) {
+            return lib;
+        }
+        auto lib = std::make_shared<Library>(libref, path, access, libEngine);
+        entry.lib = lib;
+        entry.id = ++nextId;
+        if (retain) {
+            entry.retained = lib;
+        }
+        prune();
+        return lib;
+    }
+
+    std::string LibraryRegistry::spillFolder(const std::shared_ptr<Library>& lib) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (spillRoot.empty()) {
+            spillRoot = createUniqueTempFolder();
+        }
+        for (auto& kv : libraries) {
+            if (kv.second.lib.lock() == lib) {
+                return (fs::path(spillRoot) / ("lib" + std::to_string(kv.second.id))).string();
+            }
+        }
+        return spillRoot;
+    }
+
+    size_t LibraryRegistry::size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        size_t n = 0;
+        for (auto& kv : libraries) {
+            if (!kv.second.lib.expired()) n++;
+        }
+        return n;
+    }
+
+    void LibraryRegistry::setRetain(bool retain) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        this->retain = retain;
+        for (auto& kv : libraries) {
+            kv.second.retained = retain ? kv.second.lib.lock() : nullptr;
+        }
+        prune();
+    }
+
+    // Drop the entries of libraries no session uses any more
+    void LibraryRegistry::prune() {
+        for (auto it = libraries.begin(); it != libraries.end(); ) {
+            if (it->second.lib.expired()) it = libraries.erase(it);
+            else ++it;
+        }
+    }
+
+}
@@ -0,0 +1,64 @@
+#ifndef LIBRARYREGISTRY_H
+#define LIBRARYREGISTRY_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include "Library.h"
+
+namespace sass {
+
+    // Libraries shared by all sessions of one process. Sessions assigning a
+    // libref to the same directory with the same engine and access get the
+    // same Library, so a member loaded by one session is read by the others
+    // without loading it again. WORK is never shared, every session has its own.
+    //
+    // The registry is thread safe. A DataEnvironment (the per-session context:
+    // librefs, options, macro variables, the current row) is used by one
+    // thread at a time.
+    class LibraryRegistry {
+    public:
+        LibraryRegistry() = default;
+        ~LibraryRegistry();
+
+        LibraryRegistry(const LibraryRegistry&) = delete;
+        LibraryRegistry& operator=(const LibraryRegistry&) = delete;
+
+        // The library for path/engine/access, created on first use.
+        // libref only names a newly created library. Returns nullptr when the engine is unknown.
+        std::shared_ptr<Library> acquire(const std::string& libref, const std::string& path,
+            LibraryAccess access, const std::string& engine = "");
+
+        // Folder where members of a shared library are spilled (MEMSIZE=).
+        // It outlives the WORK folder of the session that spilled them.
+        std::string spillFolder(const std::shared_ptr<Library>& lib);
+
+        // Number of libraries some session still uses (or that are retained)
+        size_t size() const;
+
+        // Keep libraries, and the members loaded in them, after the last
+        // session using them ends. The server turns this on so the next job
+        // finds them warm.
+        void setRetain(bool retain);
+
+    private:
+        struct Entry {
+            std::weak_ptr<Library> lib;
+            std::shared_ptr<Library> retained;
+            int id = 0;
+        };
+
+        mutable std::shared_mutex mutex;
+        // "canonical path|ENGINE|access" => library
+        std::map<std::string, Entry> libraries;
+        int nextId = 0;
+        bool retain = false;
+        std::string spillRoot;
+
+        void prune();
+    };
+
+}
+
+#endif // LIBRARYREGISTRY_H
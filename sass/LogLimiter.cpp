@@ -0,0 +1,29 @@
+#include "LogLimiter.h"
+
+namespace sass {
+
+    LogLimiter::Site* LogLimiter::admit(spdlog::level::level_enum level, spdlog::string_view_t format) {
+        auto [it, added] = index.try_emplace(format.data(), sites.size());
+        if (added) {
+            sites.push_back({ level });
+        }
+        Site& site = sites[it->second];
+        if (site.written < limit) {
+            site.written++;
+            return &site;
+        }
+        site.suppressed++;
+        return nullptr;
+    }
+
+    void LogLimiter::flush() {
+        for (auto& site : sites) {
+            if (site.suppressed > 0) {
+                log.log(site.level, "NOTE: {} similar messages suppressed, the first was: {}", site.suppressed, site.example);
+            }
+        }
+        sites.clear();
+        index.clear();
+    }
+
+}
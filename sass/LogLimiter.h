@@ -0,0 +1,77 @@
+#ifndef LOGLIMITER_H
+#define LOGLIMITER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <spdlog/spdlog.h>
+
+namespace sass {
+
+    // Caps the log lines of each message site: a statement logging per row or
+    // per duplicate writes its first `limit` lines, the others are only counted
+    // until flush() notes how many were left out, with the first line of the
+    // site as the example. A site is its format string.
+    // Below the logger's level nothing is counted and nothing formatted.
+    class LogLimiter {
+    public:
+        explicit LogLimiter(spdlog::logger& log, size_t limit = 20) : log(log), limit(limit) {}
+
+        template<typename... Args>
+        void info(spdlog::format_string_t<Args...> fmt, Args&&... args) {
+            write(spdlog::level::info, fmt, std::forward<Args>(args)...);
+        }
+
+        template<typename... Args>
+        void warn(spdlog::format_string_t<Args...> fmt, Args&&... args) {
+            write(spdlog::level::warn, fmt, std::forward<Args>(args)...);
+        }
+
+        template<typename... Args>
+        void debug(spdlog::format_string_t<Args...> fmt, Args&&... args) {
+            write(spdlog::level::debug, fmt, std::forward<Args>(args)...);
+        }
+
+        // Note the lines suppressed since the last flush, one note per site in the
+        // order the sites first logged, and start over
+        void flush();
+
+    private:
+        struct Site {
+            spdlog::level::level_enum level;
+            std::string example;    // the first line written
+            size_t written = 0;
+            size_t suppressed = 0;
+        };
+
+        spdlog::logger& log;
+        size_t limit;
+        std::vector<Site> sites;                        // in the order they first logged
+        std::unordered_map<const char*, size_t> index;  // by the address of the format string
+
+        // The site of format when it may write one more line, nullptr otherwise
+        Site* admit(spdlog::level::level_enum level, spdlog::string_view_t format);
+
+        template<typename... Args>
+        void write(spdlog::level::level_enum level, spdlog::format_string_t<Args...> fmt, Args&&... args) {
+            if (!log.should_log(level)) {
+                return;
+            }
+            Site* site = admit(level, spdlog::string_view_t(fmt));
+            if (!site) {
+                return;
+            }
+            if (site->written == 1) {
+                // kept for the note of flush()
+                site->example = fmt::vformat(spdlog::string_view_t(fmt), fmt::make_format_args(args...));
+                log.log(level, spdlog::string_view_t(site->example));
+            }
+            else {
+                log.log(level, fmt, std::forward<Args>(args)...);
+            }
+        }
+    };
+
+}
+
+#endif // LOGLIMITER_H
@@ -0,0 +1,861 @@
+#include "MacroVM.h"
+#include "utility.h"
+#include <cctype>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sass {
+
+    namespace {
+        using Code = MacroProgram::Code;
+
+        bool isNameStart(char c) { return std::isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+        bool isNameChar(char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+        bool isFunction(const std::string& name) {
+            return name == "EVAL" || name == "SCAN" || name == "SUBSTR" || name == "UPCASE";
+        }
+
+        class Compiler {
+        public:
+            explicit Compiler(const std::string& body) : s(body), program(std::make_shared<MacroProgram>()) {}
+
+            std::shared_ptr<const MacroProgram> compile() {
+                statements(false, false);
+                return program;
+            }
+
+        private:
+            // Text being built: literal characters not pushed yet, and the values pushed
+            struct Run {
+                std::string literal;
+                uint32_t values = 0;
+                bool rescan = false;
+            };
+
+            const std::string& s;
+            size_t i = 0;
+            std::shared_ptr<MacroProgram> program;
+            std::unordered_map<std::string, uint32_t> stringIndex;
+
+            uint32_t add(const std::string& str) {
+                auto it = stringIndex.find(str);
+                if (it != stringIndex.end()) return it->second;
+                program->strings.push_back(str);
+                return stringIndex[str] = (uint32_t)(program->strings.size() - 1);
+            }
+
+            size_t op(Code code, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0) {
+                program->code.push_back({ code, a, b, c, 0 });
+                return program->code.size() - 1;
+            }
+
+            uint32_t here() const { return (uint32_t)program->code.size(); }
+
+            void flushLiteral(Run& run) {
+                if (run.literal.empty()) return;
+                op(Code::Text, add(run.literal));
+                run.literal.clear();
+                run.values++;
+            }
+
+            // Leave the run on the stack as one value
+            void finish(Run& run) {
+                flushLiteral(run);
+                if (run.values == 0) op(Code::Text, add(""));
+                else if (run.values > 1) op(Code::Concat, run.values);
+                if (run.rescan) op(Code::Rescan);
+                run = Run();
+            }
+
+            void emit(Run& run) {
+                if (run.literal.empty() && run.values == 0) return;
+                finish(run);
+                op(Code::Emit);
+            }
+
+            std::string name(size_t at) const {
+                size_t end = at;
+                if (end < s.size() && isNameStart(s[end])) {
+                    while (end < s.size() && isNameChar(s[end])) end++;
+                }
+                return s.substr(at, end - at);
+            }
+
+            // %keyword at i
+            bool at(const char* keyword) const {
+                if (i >= s.size() || s[i] != '%') return false;
+                std::string word = name(i + 1);
+                return to_upper(word) == keyword;
+            }
+
+            void skipSpaces() {
+                while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) i++;
+            }
+
+            void expect(char c, const std::string& what) {
+                if (i >= s.size() || s[i] != c) {
+                    throw std::runtime_error("Expected '" + std::string(1, c) + "' " + what + " in the macro");
+                }
+                i++;
+            }
+
+            // One piece of text into run: a character, a quoted string, a comment,
+            // an & reference or a macro function
+            void piece(Run& run, bool quotesProtect) {
+                char c = s[i];
+                if (c == '&') {
+                    size_t count = 0;
+                    while (i + count < s.size() && s[i + count] == '&') count++;
+                    // && is & and the text is scanned again
+                    if (count > 1) {
+                        run.literal.append(count / 2, '&');
+                        run.rescan = true;
+                        i += count - count % 2;
+                        if (count % 2 == 0) return;
+                    }
+                    std::string var = name(i + 1);
+                    if (var.empty()) {
+                        run.literal += '&';
+                        i++;
+                        return;
+                    }
+                    flushLiteral(run);
+                    op(Code::Var, add(to_upper(var)));
+                    run.values++;
+                    i += 1 + var.size();
+                    if (i < s.size() && s[i] == '.') i++;
+                    return;
+                }
+                if (c == '%') {
+                    std::string function = to_upper(name(i + 1));
+                    if (isFunction(function)) {
+                        flushLiteral(run);
+                        call(function);
+                        run.values++;
+                        return;
+                    }
+                }
+                if (quotesProtect && c == '\'') {
+                    size_t end = s.find('\'', i + 1);
+                    end = end == std::string::npos ? s.size() : end + 1;
+                    run.literal.append(s, i, end - i);
+                    i = end;
+                    return;
+                }
+                if (c == '/' && i + 1 < s.size() && s[i + 1] == '*') {
+                    size_t end = s.find("*/", i + 2);
+                    end = end == std::string::npos ? s.size() : end + 2;
+                    run.literal.append(s, i, end - i);
+                    i = end;
+                    return;
+                }
+                run.literal += c;
+                i++;
+            }
+
+            // Text up to stop (at the top level of parentheses) as one value
+            template <typename Stop>
+            void value(Stop stop) {
+                Run run;
+                int depth = 0;
+                while (i < s.size()) {
+                    if (depth == 0 && stop()) break;
+                    if (s[i] == '(') depth++;
+                    else if (s[i] == ')' && depth > 0) depth--;
+                    if (s[i] == '%' && !isFunction(to_upper(name(i + 1))) && !name(i + 1).empty()) {
+                        throw std::runtime_error("Macro statement %" + name(i + 1) + " is not allowed in a macro expression");
+                    }
+                    piece(run, false);
+                }
+                finish(run);
+            }
+
+            // Arguments in parentheses, each a value; returns how many
+            uint32_t arguments(const std::string& of) {
+                skipSpaces();
+                expect('(', "after " + of);
+                uint32_t count = 0;
+                skipSpaces();
+                if (i < s.size() && s[i] == ')') {
+                    i++;
+                    return 0;
+                }
+                while (true) {
+                    value([&]() { return s[i] == ',' || s[i] == ')'; });
+                    count++;
+                    if (i < s.size() && s[i] == ',') {
+                        i++;
+                        continue;
+                    }
+                    expect(')', "after the arguments of " + of);
+                    return count;
+                }
+            }
+
+            // %function(...) or %macro(...)
+            void call(const std::string& upperName) {
+                std::string of = "%" + upperName;
+                i += 1 + upperName.size();
+                if (upperName == "EVAL" || upperName == "UPCASE") {
+                    if (arguments(of) != 1) throw std::runtime_error(of + " takes one argument");
+                    op(upperName == "EVAL" ? Code::Eval : Code::Upcase);
+                    return;
+                }
+                if (upperName == "SCAN" || upperName == "SUBSTR") {
+                    uint32_t count = arguments(of);
+                    if (count < 2 || count > 3) throw std::runtime_error(of + " takes two or three arguments");
+                    op(upperName == "SCAN" ? Code::Scan : Code::Substr, count);
+                    return;
+                }
+
+                size_t after = i;
+                skipSpaces();
+                uint32_t count = 0;
+                if (i < s.size() && s[i] == '(') {
+                    count = arguments(of);
+                }
+                else {
+                    i = after;
+                }
+                // the ; after a call would be an empty statement in the generated text
+                after = i;
+                skipSpaces();
+                if (i < s.size() && s[i] == ';') i++;
+                else i = after;
+                op(Code::Call, add(upperName), count);
+            }
+
+            void let() {
+                i += 4;
+                skipSpaces();
+                std::string var = name(i);
+                if (var.empty()) throw std::runtime_error("Expected a variable name after %LET");
+                i += var.size();
+                skipSpaces();
+                expect('=', "after %LET " + var);
+                value([&]() { return s[i] == ';'; });
+                expect(';', "after %LET " + var);
+                op(Code::Let, add(to_upper(var)));
+            }
+
+            void put() {
+                i += 4;
+                if (i < s.size() && s[i] == ' ') i++;
+                value([&]() { return s[i] == ';'; });
+                expect(';', "after %PUT");
+                op(Code::Put);
+            }
+
+            void ifStatement() {
+                i += 3;
+                value([&]() { return at("THEN"); });
+                if (!at("THEN")) throw std::runtime_error("%IF without %THEN in the macro");
+                i += 5;
+                size_t toElse = op(Code::JumpIfFalse);
+                skipSpaces();
+                statements(false, true);
+
+                size_t after = i;
+                skipSpaces();
+                if (at("ELSE")) {
+                    i += 5;
+                    size_t toEnd = op(Code::Jump);
+                    program->code[toElse].a = here();
+                    skipSpaces();
+                    statements(false, true);
+                    program->code[toEnd].a = here();
+                }
+                else {
+                    i = after;
+                    program->code[toElse].a = here();
+                }
+            }
+
+            void doStatement() {
+                i += 3;
+                skipSpaces();
+                if (i < s.size() && s[i] == ';') {
+                    i++;
+                    statements(true, false);
+                    return;
+                }
+
+                if (at("WHILE") || at("UNTIL")) {
+                    bool whileLoop = at("WHILE");
+                    i += 6;
+                    skipSpaces();
+                    if (i >= s.size() || s[i] != '(') throw std::runtime_error("Expected '(' after %DO %WHILE or %UNTIL in the macro");
+                    // the condition is compiled where it is tested
+                    size_t condition = i;
+                    int depth = 0;
+                    do {
+                        if (i >= s.size()) throw std::runtime_error("Unclosed %DO condition in the macro");
+                        if (s[i] == '(') depth++;
+                        else if (s[i] == ')') depth--;
+                        i++;
+                    } while (depth > 0);
+                    skipSpaces();
+                    expect(';', "after the %DO condition");
+                    size_t body = i;
+
+                    uint32_t top = here();
+                    size_t exit = 0;
+                    if (whileLoop) {
+                        i = condition + 1;
+                        value([&]() { return s[i] == ')'; });
+                        exit = op(Code::JumpIfFalse);
+                        i = body;
+                    }
+                    statements(true, false);
+                    if (whileLoop) {
+                        op(Code::Jump, top);
+                        program->code[exit].a = here();
+                    }
+                    else {
+                        size_t end = i;
+                        i = condition + 1;
+                        value([&]() { return s[i] == ')'; });
+                        op(Code::JumpIfFalse, top);
+                        i = end;
+                    }
+                    return;
+                }
+
+                std::string var = name(i);
+                if (var.empty()) throw std::runtime_error("Expected a %DO index variable in the macro");
+                uint32_t index = add(to_upper(var));
+                i += var.size();
+                skipSpaces();
+                expect('=', "after %DO " + var);
+                value([&]() { return at("TO"); });
+                if (!at("TO")) throw std::runtime_error("%DO " + var + " without %TO in the macro");
+                i += 3;
+                op(Code::Eval);
+                op(Code::Let, index);
+
+                uint32_t toSlot = program->slots++;
+                uint32_t bySlot = program->slots++;
+                value([&]() { return at("BY") || s[i] == ';'; });
+                op(Code::Eval);
+                op(Code::SetSlot, toSlot);
+                if (at("BY")) {
+                    i += 3;
+                    value([&]() { return s[i] == ';'; });
+                }
+                else {
+                    op(Code::Text, add("1"));
+                }
+                op(Code::Eval);
+                op(Code::SetSlot, bySlot);
+                expect(';', "after %DO " + var);
+
+                size_t test = op(Code::DoTest, index, toSlot, bySlot);
+                statements(true, false);
+                op(Code::DoStep, index, bySlot);
+                op(Code::Jump, (uint32_t)test);
+                program->code[test].d = here();
+            }
+
+            // Statements up to the %END of a %DO (inDo), or only one (single:
+            // the action of %IF / %ELSE), or to the end of the body
+            void statements(bool inDo, bool single) {
+                Run run;
+                while (i < s.size()) {
+                    if (s[i] == '%') {
+                        std::string word = to_upper(name(i + 1));
+                        if (word.empty() && i + 1 < s.size() && s[i + 1] == '*') {
+                            // %* comment;
+                            size_t end = s.find(';', i);
+                            i = end == std::string::npos ? s.size() : end + 1;
+                            continue;
+                        }
+                        if (!word.empty() && !isFunction(word)) {
+                            emit(run);
+                            if (word == "END" || word == "ELSE") {
+                                if (single) return;
+                                if (word == "ELSE" || !inDo) throw std::runtime_error("%" + word + " without a matching statement in the macro");
+                                i += 4;
+                                skipSpaces();
+                                if (i < s.size() && s[i] == ';') i++;
+                                return;
+                            }
+                            if (word == "LET") let();
+                            else if (word == "PUT") put();
+                            else if (word == "IF") ifStatement();
+                            else if (word == "DO") doStatement();
+                            else if (word == "THEN" || word == "TO" || word == "BY" || word == "MACRO" || word == "MEND") {
+                                throw std::runtime_error("Unexpected %" + word + " in the macro");
+                            }
+                            else call(word);
+                            if (single) return;
+                            continue;
+                        }
+                    }
+                    bool semicolon = s[i] == ';';
+                    piece(run, true);
+                    if (single && semicolon) {
+                        emit(run);
+                        return;
+                    }
+                }
+                if (inDo) throw std::runtime_error("%DO without %END in the macro");
+                emit(run);
+            }
+        };
+
+        // %EVAL
+        class Evaluator {
+        public:
+            explicit Evaluator(const std::string& expr) : expr(expr) {
+                tokenize();
+            }
+
+            long long evaluate() {
+                Value result = orExpr();
+                if (tokens[next].kind != Token::End) {
+                    throw std::runtime_error("Invalid %EVAL expression: " + expr);
+                }
+                return numeric(result);
+            }
+
+        private:
+            struct Token {
+                enum Kind { Operand, Op, LParen, RParen, End } kind;
+                std::string text;
+            };
+            struct Value {
+                bool number;
+                long long n;
+                std::string text;
+            };
+
+            const std::string& expr;
+            std::vector<Token> tokens;
+            size_t next = 0;
+
+            void tokenize() {
+                static const char* ops[] = { "**", "<=", ">=", "^=", "~=", "=", "<", ">", "+", "-", "*", "/", "&", "|", "^", "~" };
+                static const std::unordered_map<std::string, std::string> mnemonics = {
+                    { "EQ", "=" }, { "NE", "^=" }, { "LT", "<" }, { "LE", "<=" }, { "GT", ">" }, { "GE", ">=" },
+                    { "AND", "&" }, { "OR", "|" }, { "NOT", "^" } };
+                size_t i = 0;
+                auto opAt = [&](size_t at) -> const char* {
+                    for (const char* op : ops) {
+                        if (expr.compare(at, std::char_traits<char>::length(op), op) == 0) return op;
+                    }
+                    return nullptr;
+                };
+                while (i < expr.size()) {
+                    char c = expr[i];
+                    if (std::isspace(static_cast<unsigned char>(c))) {
+                        i++;
+                        continue;
+                    }
+                    if (c == '(' || c == ')') {
+                        tokens.push_back({ c == '(' ? Token::LParen : Token::RParen, std::string(1, c) });
+                        i++;
+                        continue;
+                    }
+                    if (const char* op = opAt(i)) {
+                        tokens.push_back({ Token::Op, std::string(op) == "~=" ? "^=" : std::string(op) == "~" ? "^" : op });
+                        i += std::char_traits<char>::length(op);
+                        continue;
+                    }
+                    size_t end = i;
+                    while (end < expr.size() && !std::isspace(static_cast<unsigned char>(expr[end]))
+                        && expr[end] != '(' && expr[end] != ')' && !opAt(end)) {
+                        end++;
+                    }
+                    std::string word = expr.substr(i, end - i);
+                    i = end;
+                    auto mnemonic = mnemonics.find(to_upper(word));
+                    if (mnemonic != mnemonics.end()) {
+                        tokens.push_back({ Token::Op, mnemonic->second });
+                    }
+                    else if (!tokens.empty() && tokens.back().kind == Token::Operand) {
+                        // text of several words
+                        tokens.back().text += " " + word;
+                    }
+                    else {
+                        tokens.push_back({ Token::Operand, word });
+                    }
+                }
+                tokens.push_back({ Token::End, "" });
+            }
+
+            bool isOp(const char* op) const {
+                return tokens[next].kind == Token::Op && tokens[next].text == op;
+            }
+
+            long long numeric(const Value& v) const {
+                if (!v.number) {
+                    throw std::runtime_error("A character operand was found in the %EVAL function or %IF condition where a numeric operand is required: " + expr);
+                }
+                return v.n;
+            }
+
+            static Value number(long long n) { return { true, n, "" }; }
+
+            Value orExpr() {
+                Value left = andExpr();
+                while (isOp("|")) {
+                    next++;
+                    Value right = andExpr();
+                    left = number(numeric(left) != 0 || numeric(right) != 0);
+                }
+                return left;
+            }
+
+            Value andExpr() {
+                Value left = notExpr();
+                while (isOp("&")) {
+                    next++;
+                    Value right = notExpr();
+                    left = number(numeric(left) != 0 && numeric(right) != 0);
+                }
+                return left;
+            }
+
+            Value notExpr() {
+                if (isOp("^")) {
+                    next++;
+                    return number(numeric(notExpr()) == 0);
+                }
+                return comparison();
+            }
+
+            Value comparison() {
+                Value left = additive();
+                while (isOp("=") || isOp("^=") || isOp("<") || isOp("<=") || isOp(">") || isOp(">=")) {
+                    std::string op = tokens[next++].text;
+                    Value right = additive();
+                    int order;
+                    if (left.number && right.number) {
+                        order = left.n < right.n ? -1 : left.n > right.n ? 1 : 0;
+                    }
+                    else {
+                        std::string a = left.number ? std::to_string(left.n) : left.text;
+                        std::string b = right.number ? std::to_string(right.n) : right.text;
+                        order = a.compare(b);
+                        order = order < 0 ? -1 : order > 0 ? 1 : 0;
+                    }
+                    bool result = op == "=" ? order == 0 : op == "^=" ? order != 0 : op == "<" ? order < 0
+                        : op == "<=" ? order <= 0 : op == ">" ? order > 0 : order >= 0;
+                    left = number(result);
+                }
+                return left;
+            }
+
+            Value additive() {
+                Value left = multiplicative();
+                while (isOp("+") || isOp("-")) {
+                    bool plus = tokens[next++].text == "+";
+                    Value right = multiplicative();
+                    left = number(plus ? numeric(left) + numeric(right) : numeric(left) - numeric(right));
+                }
+                return left;
+            }
+
+            Value multiplicative() {
+                Value left = unary();
+                while (isOp("*") || isOp("/")) {
+                    bool times = tokens[next++].text == "*";
+                    Value right = unary();
+                    if (times) {
+                        left = number(numeric(left) * numeric(right));
+                    }
+                    else {
+                        long long divisor = numeric(right);
+                        if (divisor == 0) throw std::runtime_error("Division by zero in %EVAL: " + expr);
+                        left = number(numeric(left) / divisor);
+                    }
+                }
+                return left;
+            }
+
+            Value unary() {
+                if (isOp("-") || isOp("+")) {
+                    bool minus = tokens[next++].text == "-";
+                    long long n = numeric(unary());
+                    return number(minus ? -n : n);
+                }
+                Value base = primary();
+                if (isOp("**")) {
+                    next++;
+                    long long exponent = numeric(unary());
+                    long long b = numeric(base), result = 1;
+                    for (long long k = 0; k < exponent; k++) result *= b;
+                    return number(result);
+                }
+                return base;
+            }
+
+            Value primary() {
+                const Token& token = tokens[next];
+                if (token.kind == Token::LParen) {
+                    next++;
+                    Value inner = orExpr();
+                    if (tokens[next].kind != Token::RParen) {
+                        throw std::runtime_error("Unbalanced parentheses in %EVAL: " + expr);
+                    }
+                    next++;
+                    return inner;
+                }
+                if (token.kind == Token::Operand) {
+                    next++;
+                    const std::string& text = token.text;
+                    bool digits = !text.empty() && text.find_first_not_of("0123456789") == std::string::npos;
+                    if (digits) {
+                        try {
+                            return number(std::stoll(text));
+                        }
+                        catch (const std::out_of_range&) {
+                            throw std::runtime_error("Integer too large in %EVAL: " + text);
+                        }
+                    }
+                    return { false, 0, text };
+                }
+                // a missing operand, as in %if &x = %then: empty text
+                return { false, 0, "" };
+            }
+        };
+
+        std::string scan(const std::string& text, long long n, const std::string& delimiters) {
+            std::vector<std::string> words;
+            size_t i = 0;
+            while (i < text.size()) {
+                size_t start = text.find_first_not_of(delimiters, i);
+                if (start == std::string::npos) break;
+                size_t end = text.find_first_of(delimiters, start);
+                if (end == std::string::npos) end = text.size();
+                words.push_back(text.substr(start, end - start));
+                i = end;
+            }
+            if (n > 0 && (size_t)n <= words.size()) return words[n - 1];
+            if (n < 0 && (size_t)-n <= words.size()) return words[words.size() + n];
+            return "";
+        }
+    }
+
+    std::shared_ptr<const MacroProgram> compileMacro(const std::string& body) {
+        return Compiler(body).compile();
+    }
+
+    long long evalMacroExpression(const std::string& expr) {
+        return Evaluator(expr).evaluate();
+    }
+
+    MacroVM::MacroVM(std::unordered_map<std::string, std::string>& globals, Lookup findMacro, spdlog::logger& log)
+        : globals(globals), findMacro(std::move(findMacro)), log(log)
+    {
+    }
+
+    void MacroVM::call(std::shared_ptr<const CompiledMacro> macro, std::vector<std::string> arguments) {
+        if (frames.size() >= 1000) {
+            throw std::runtime_error("Macro calls nested too deeply at %" + macro->name);
+        }
+        if (arguments.size() > macro->parameters.size()) {
+            throw std::runtime_error("Macro '" + macro->name + "' expects " +
+                std::to_string(macro->parameters.size()) +
+                " arguments, but got " + std::to_string(arguments.size()));
+        }
+        Frame frame;
+        frame.macro = std::move(macro);
+        // parameters left out are empty
+        for (size_t k = 0; k < frame.macro->parameters.size(); k++) {
+            frame.locals[frame.macro->parameters[k]] = k < arguments.size() ? trim(arguments[k]) : "";
+        }
+        frame.slots.resize(frame.macro->program->slots);
+        frames.push_back(std::move(frame));
+    }
+
+    std::string MacroVM::pop() {
+        std::string top = std::move(stack.back());
+        stack.pop_back();
+        return top;
+    }
+
+    std::string* MacroVM::find(const std::string& name) {
+        for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+            auto it = frame->locals.find(name);
+            if (it != frame->locals.end()) return &it->second;
+        }
+        auto it = globals.find(name);
+        return it != globals.end() ? &it->second : nullptr;
+    }
+
+    // to the variable where it is defined, otherwise a new local one
+    void MacroVM::assign(const std::string& name, std::string value) {
+        if (std::string* existing = find(name)) {
+            *existing = std::move(value);
+        }
+        else if (!frames.empty()) {
+            frames.back().locals[name] = std::move(value);
+        }
+        else {
+            globals[name] = std::move(value);
+        }
+    }
+
+    long long MacroVM::integer(const std::string& name) {
+        std::string* value = find(name);
+        try {
+            size_t used = 0;
+            long long n = std::stoll(value ? *value : "", &used);
+            if (used == value->size()) return n;
+        }
+        catch (const std::logic_error&) {
+        }
+        throw std::runtime_error("The %DO loop index variable " + name + " is not an integer.");
+    }
+
+    std::string MacroVM::resolve(const std::string& text) {
+        std::string result = text;
+        bool again = true;
+        while (again) {
+            again = false;
+            std::string out;
+            size_t i = 0;
+            while (i < result.size()) {
+                if (result[i] != '&') {
+                    out += result[i++];
+                    continue;
+                }
+                if (i + 1 < result.size() && result[i + 1] == '&') {
+                    out += '&';
+                    i += 2;
+                    again = true;
+                    continue;
+                }
+                size_t end = i + 1;
+                if (end < result.size() && isNameStart(result[end])) {
+                    while (end < result.size() && isNameChar(result[end])) end++;
+                }
+                if (end == i + 1) {
+                    out += result[i++];
+                    continue;
+                }
+                std::string name = to_upper(result.substr(i + 1, end - i - 1));
+                if (std::string* value = find(name)) {
+                    out += *value;
+                    if (end < result.size() && result[end] == '.') end++;
+                }
+                else {
+                    log.warn("WARNING: Apparent symbolic reference {} not resolved.", name);
+                    out.append(result, i, end - i);
+                }
+                i = end;
+            }
+            result = std::move(out);
+        }
+        return result;
+    }
+
+    bool MacroVM::next(std::string& text) {
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            const MacroProgram& program = *frame.macro->program;
+            if (frame.pc >= program.code.size()) {
+                frames.pop_back();
+                continue;
+            }
+            const MacroProgram::Op& op = program.code[frame.pc++];
+            switch (op.code) {
+            case Code::Text:
+                stack.push_back(program.strings[op.a]);
+                break;
+            case Code::Var:
+                if (std::string* value = find(program.strings[op.a])) {
+                    stack.push_back(*value);
+                }
+                else {
+                    log.warn("WARNING: Apparent symbolic reference {} not resolved.", program.strings[op.a]);
+                    stack.push_back("&" + program.strings[op.a]);
+                }
+                break;
+            case Code::Concat: {
+                size_t first = stack.size() - op.a;
+                std::string joined = std::move(stack[first]);
+                for (size_t k = first + 1; k < stack.size(); k++) {
+                    joined += stack[k];
+                }
+                stack.resize(first);
+                stack.push_back(std::move(joined));
+                break;
+            }
+            case Code::Rescan:
+                stack.back() = resolve(stack.back());
+                break;
+            case Code::Eval:
+                stack.back() = std::to_string(evalMacroExpression(stack.back()));
+                break;
+            case Code::Scan: {
+                // default delimiters of %SCAN
+                std::string delimiters = op.a == 3 ? pop() : " .<(+&!$*);^-/,%|";
+                long long n = evalMacroExpression(pop());
+                stack.back() = scan(stack.back(), n, delimiters);
+                break;
+            }
+            case Code::Substr: {
+                long long length = op.a == 3 ? evalMacroExpression(pop()) : -1;
+                long long position = evalMacroExpression(pop());
+                std::string& value = stack.back();
+                if (position < 1 || (size_t)position > value.size() || length == 0) {
+                    value.clear();
+                }
+                else {
+                    value = value.substr(position - 1, length < 0 ? std::string::npos : (size_t)length);
+                }
+                break;
+            }
+            case Code::Upcase:
+                to_upper_inplace(stack.back());
+                break;
+            case Code::Emit:
+                text = pop();
+                if (!text.empty()) return true;
+                break;
+            case Code::Let:
+                assign(program.strings[op.a], trim(pop()));
+                break;
+            case Code::Put:
+                log.info("{}", pop());
+                break;
+            case Code::Jump:
+                frame.pc = op.a;
+                break;
+            case Code::JumpIfFalse:
+                if (evalMacroExpression(pop()) == 0) frame.pc = op.a;
+                break;
+            case Code::SetSlot:
+                frame.slots[op.a] = std::stoll(pop());
+                break;
+            case Code::DoTest: {
+                long long index = integer(program.strings[op.a]);
+                long long to = frame.slots[op.b], by = frame.slots[op.c];
+                if (by == 0) throw std::runtime_error("The %BY value of the %DO " + program.strings[op.a] + " loop is zero.");
+                if (by > 0 ? index > to : index < to) frame.pc = op.d;
+                break;
+            }
+            case Code::DoStep:
+                assign(program.strings[op.a], std::to_string(integer(program.strings[op.a]) + frame.slots[op.b]));
+                break;
+            case Code::Call: {
+                const std::string& name = program.strings[op.a];
+                auto macro = findMacro(name);
+                if (!macro) throw std::runtime_error("Undefined macro: " + name);
+                std::vector<std::string> arguments(op.b);
+                for (size_t k = op.b; k > 0; k--) {
+                    arguments[k - 1] = pop();
+                }
+                // frame is not used past here, the call adds one
+                call(std::move(macro), std::move(arguments));
+                break;
+            }
+            }
+        }
+        return false;
+    }
+
+}
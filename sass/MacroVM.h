@@ -0,0 +1,103 @@
+#ifndef MACROVM_H
+#define MACROVM_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+namespace sass {
+
+    // A macro body compiled for the MacroVM. The body is text: each run of it
+    // between macro statements becomes ops that build the text (its literal
+    // parts, &variables, %EVAL, %SCAN, %SUBSTR, %UPCASE) and emit it, while
+    // %LET, %PUT, %IF and %DO become ops and jumps, and macro calls a Call.
+    struct MacroProgram {
+        enum Code : uint8_t {
+            Text,           // push strings[a]
+            Var,            // push the value of variable strings[a]
+            Concat,         // pop a values, push them joined
+            Rescan,         // resolve the & references left in the top value (by &&)
+            Eval,           // the %EVAL function of the top value
+            Scan,           // %SCAN of the a values on top
+            Substr,         // %SUBSTR of the a values on top
+            Upcase,         // %UPCASE of the top value
+            Emit,           // pop, append to the generated text
+            Let,            // pop, assign to variable strings[a]
+            Put,            // pop, write to the log
+            Jump,           // to a
+            JumpIfFalse,    // pop a %EVAL condition, jump to a if it is 0
+            SetSlot,        // pop an integer into slot a
+            DoTest,         // jump to d if variable strings[a] is past slot b, counting by slot c
+            DoStep,         // add slot b to variable strings[a]
+            Call,           // call macro strings[a] with b arguments from the stack
+        };
+        struct Op {
+            Code code;
+            uint32_t a = 0, b = 0, c = 0, d = 0;
+        };
+
+        std::vector<Op> code;
+        std::vector<std::string> strings;
+        uint32_t slots = 0;     // %DO bounds and steps
+    };
+
+    // Compile a macro body; throws on a %DO without %END and the like.
+    // Variable and macro names are kept in upper case.
+    std::shared_ptr<const MacroProgram> compileMacro(const std::string& body);
+
+    // %EVAL: integer arithmetic, comparisons (as integers when both sides
+    // are, as text otherwise) and logical operators; 1 is true
+    long long evalMacroExpression(const std::string& expr);
+
+    struct CompiledMacro {
+        std::string name;
+        std::vector<std::string> parameters;    // upper case
+        std::shared_ptr<const MacroProgram> program;
+    };
+
+    // Runs a macro call, and the calls it makes, one piece of generated text
+    // at a time: the caller lexes a piece while the VM waits, so a %LET
+    // after a step runs only once the step before it was read.
+    class MacroVM {
+    public:
+        using Lookup = std::function<std::shared_ptr<const CompiledMacro>(const std::string& name)>;
+
+        // globals: the macro variables of the session; findMacro: the macro of
+        // an upper-case name, nullptr if there is none
+        MacroVM(std::unordered_map<std::string, std::string>& globals, Lookup findMacro, spdlog::logger& log);
+
+        void call(std::shared_ptr<const CompiledMacro> macro, std::vector<std::string> arguments);
+
+        // Run until the next piece of text; false once the call has returned
+        bool next(std::string& text);
+
+        // Resolve the & references of text; && resolves to & and the result is scanned again
+        std::string resolve(const std::string& text);
+
+    private:
+        struct Frame {
+            std::shared_ptr<const CompiledMacro> macro;
+            size_t pc = 0;
+            std::unordered_map<std::string, std::string> locals;
+            std::vector<long long> slots;
+        };
+
+        std::unordered_map<std::string, std::string>& globals;
+        Lookup findMacro;
+        spdlog::logger& log;
+        std::vector<Frame> frames;
+        std::vector<std::string> stack;
+
+        std::string pop();
+        std::string* find(const std::string& name);
+        void assign(const std::string& name, std::string value);
+        long long integer(const std::string& name);
+    };
+
+}
+
+#endif // MACROVM_H
@@ -0,0 +1,119 @@
+// MappedFile.cpp
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sass {
+
+    MappedFile::MappedFile(const std::string& path) {
+        open(path);
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(opened, other.opened);
+#ifdef _WIN32
+            std::swap(fileHandle, other.fileHandle);
+            std::swap(mappingHandle, other.mappingHandle);
+#endif
+        }
+        return *this;
+    }
+
+    bool MappedFile::open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            return false;
+        }
+        fileHandle = file;
+        size_ = (size_t)fileSize.QuadPart;
+        opened = true;
+        if (size_ == 0) {
+            // empty files cannot be mapped
+            return true;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            return false;
+        }
+        mappingHandle = mapping;
+        data_ = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data_ == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = (size_t)st.st_size;
+        opened = true;
+        if (size_ == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            size_ = 0;
+            opened = false;
+            return false;
+        }
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = (const uint8_t*)p;
+        return true;
+#endif
+    }
+
+    void MappedFile::close() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mappingHandle) CloseHandle((HANDLE)mappingHandle);
+        if (fileHandle) CloseHandle((HANDLE)fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        if (data_) munmap((void*)data_, size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        opened = false;
+    }
+
+} // namespace sass
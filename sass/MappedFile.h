@@ -0,0 +1,46 @@
+// MappedFile.h
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace sass {
+
+    // Read-only memory mapping of a whole file. The OS pages the file in on
+    // demand, so readers can decode straight out of the mapping instead of
+    // copying the file into their own buffers first.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        // Map path, replacing any current mapping. Returns false if the file
+        // cannot be opened or mapped.
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const { return opened; }
+        const uint8_t* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+        bool opened = false;
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+    };
+
+} // namespace sass
+
+#endif // MAPPED_FILE_H
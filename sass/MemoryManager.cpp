@@ -0,0 +1,184 @@
+#include "MemoryManager.h"
+#include "utility.h"
+#include <stdexcept>
+#include <cstdio>
+#include <limits>
+
+namespace sass {
+
+    void MemoryManager::setLimit(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            limit = bytes;
+        }
+        enforce();
+    }
+
+    size_t MemoryManager::getLimit() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return limit;
+    }
+
+    size_t MemoryManager::parseMemSize(const std::string& text) {
+        std::string value = to_upper(text);
+        if (value == "MAX" || value == "0") {
+            return 0;
+        }
+        if (value == "MIN") {
+            return 256 * 1024 * 1024;
+        }
+
+        size_t pos = 0;
+        double number;
+        try {
+            number = std::stod(value, &pos);
+        }
+        catch (...) {
+            throw std::runtime_error("Invalid MEMSIZE value: " + text);
+        }
+        double unit = 1;
+        std::string suffix = value.substr(pos);
+        if (suffix == "K" || suffix == "KB") unit = 1024.0;
+        else if (suffix == "M" || suffix == "MB") unit = 1024.0 * 1024;
+        else if (suffix == "G" || suffix == "GB") unit = 1024.0 * 1024 * 1024;
+        else if (suffix == "T" || suffix == "TB") unit = 1024.0 * 1024 * 1024 * 1024;
+        else if (!suffix.empty()) throw std::runtime_error("Invalid MEMSIZE value: " + text);
+        if (number < 0) {
+            throw std::runtime_error("Invalid MEMSIZE value: " + text);
+        }
+        return (size_t)(number * unit);
+    }
+
+    std::string MemoryManager::formatKilobytes(size_t bytes) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.2fk", bytes / 1024.0);
+        return buf;
+    }
+
+    void MemoryManager::setSpillHandler(SpillHandler handler) {
+        std::lock_guard<std::mutex> lock(mutex);
+        spillHandler = std::move(handler);
+    }
+
+    size_t MemoryManager::threshold() const {
+        return limit == 0 ? std::numeric_limits<size_t>::max() : (size_t)(limit * spillFraction);
+    }
+
+    bool MemoryManager::reserve(const std::string& owner, size_t bytes) {
+        size_t needed = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (used + bytes > threshold()) {
+                needed = used + bytes - threshold();
+            }
+        }
+        if (needed > 0) {
+            spill(needed);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (limit != 0 && used + bytes > limit) {
+            return false;
+        }
+        charges[owner] += bytes;
+        used += bytes;
+        peak = std::max(peak, used);
+        return true;
+    }
+
+    void MemoryManager::release(const std::string& owner, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = charges.find(owner);
+        if (it == charges.end()) return;
+        bytes = std::min(bytes, it->second);
+        it->second -= bytes;
+        used -= bytes;
+        if (it->second == 0) charges.erase(it);
+    }
+
+    void MemoryManager::setDatasetUsage(const std::string& key, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t& current = datasets[key];
+        used = used - current + bytes;
+        current = bytes;
+        peak = std::max(peak, used);
+    }
+
+    void MemoryManager::forgetDataset(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = datasets.find(key);
+        if (it == datasets.end()) return;
+        used -= it->second;
+        datasets.erase(it);
+    }
+
+    void MemoryManager::setDatasetUsage(const std::map<std::string, size_t>& usage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& kv : datasets) used -= kv.second;
+        datasets = usage;
+        for (auto& kv : datasets) used += kv.second;
+        peak = std::max(peak, used);
+    }
+
+    void MemoryManager::enforce() {
+        size_t needed = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (used > threshold()) needed = used - threshold();
+        }
+        if (needed > 0) {
+            spill(needed);
+        }
+    }
+
+    void MemoryManager::spill(size_t bytesNeeded) {
+        SpillHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // the handler itself updates dataset usage, don't recurse
+            if (spilling || !spillHandler) return;
+            spilling = true;
+            handler = spillHandler;
+        }
+        try {
+            handler(bytesNeeded);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            spilling = false;
+            throw;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        spilling = false;
+    }
+
+    size_t MemoryManager::getUsed() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+
+    size_t MemoryManager::getPeak() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+
+    void MemoryManager::resetPeak() {
+        std::lock_guard<std::mutex> lock(mutex);
+        peak = used;
+    }
+
+    std::map<std::string, size_t> MemoryManager::getUsage() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, size_t> usage = datasets;
+        for (auto& kv : charges) usage[kv.first] += kv.second;
+        return usage;
+    }
+
+    void MemoryCharge::require(size_t n) {
+        if (!grow(n)) {
+            throw std::runtime_error("The " + owner + " step ran out of memory (MEMSIZE=" +
+                MemoryManager::formatKilobytes(manager.getLimit()) + ").");
+        }
+    }
+
+}
@@ -0,0 +1,114 @@
+#ifndef MEMORYMANAGER_H
+#define MEMORYMANAGER_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+
+namespace sass {
+
+    // Accounts for the bytes held by in-memory datasets, PDVs and procedure
+    // state (value buffers, hash tables, ...) against the MEMSIZE= budget.
+    //
+    // Datasets are accounted by absolute size (setDatasetUsage), everything
+    // else by charges that grow and shrink (reserve/release, usually through
+    // MemoryCharge). When usage is about to cross the spill threshold the
+    // spill handler is asked to move cold datasets out to WORK.
+    class MemoryManager {
+    public:
+        // Called with the number of bytes to free; returns the bytes it freed
+        using SpillHandler = std::function<size_t(size_t bytesNeeded)>;
+
+        // Spill once usage would go above this fraction of MEMSIZE
+        static constexpr double spillFraction = 0.9;
+
+        // MEMSIZE=0 / MEMSIZE=MAX => no limit
+        void setLimit(size_t bytes);
+        size_t getLimit() const;
+
+        // Parse a MEMSIZE= value: 2G, 512M, 64K, 1048576, MAX, MIN
+        static size_t parseMemSize(const std::string& text);
+
+        // e.g. 1536 => "1.50k" as in the FULLSTIMER notes
+        static std::string formatKilobytes(size_t bytes);
+
+        void setSpillHandler(SpillHandler handler);
+
+        // Charge bytes to owner. Spills cold datasets when needed and returns
+        // false if the charge still does not fit under MEMSIZE (the charge is
+        // not taken then).
+        bool reserve(const std::string& owner, size_t bytes);
+        void release(const std::string& owner, size_t bytes);
+
+        // Absolute size of a resident dataset, key is "LIBREF.NAME"
+        void setDatasetUsage(const std::string& key, size_t bytes);
+        void forgetDataset(const std::string& key);
+        // Replace all dataset entries at once, e.g. after re-measuring every library
+        void setDatasetUsage(const std::map<std::string, size_t>& usage);
+
+        // Spill until usage is back under the spill threshold
+        void enforce();
+
+        size_t getUsed() const;
+        size_t getPeak() const;
+        // Start a new peak measurement (e.g. at the beginning of a step)
+        void resetPeak();
+
+        // Current bytes by owner (datasets and charges)
+        std::map<std::string, size_t> getUsage() const;
+
+    private:
+        mutable std::mutex mutex;
+        size_t limit = 0;
+        size_t used = 0;
+        size_t peak = 0;
+        std::map<std::string, size_t> charges;
+        std::map<std::string, size_t> datasets;
+        SpillHandler spillHandler;
+        bool spilling = false;
+
+        size_t threshold() const;
+        // Called without the lock held
+        void spill(size_t bytesNeeded);
+    };
+
+    // RAII charge for operator state, released when the operator finishes:
+    //   MemoryCharge charge(env.memory, "PROC MEANS");
+    //   if (!charge.grow(sizeof(double) * n)) ...
+    class MemoryCharge {
+    public:
+        MemoryCharge(MemoryManager& manager, const std::string& owner)
+            : manager(manager), owner(owner) {}
+        ~MemoryCharge() { manager.release(owner, bytes); }
+
+        MemoryCharge(const MemoryCharge&) = delete;
+        MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+        bool grow(size_t n) {
+            if (!manager.reserve(owner, n)) return false;
+            bytes += n;
+            return true;
+        }
+
+        // Like grow but throws when MEMSIZE is exhausted
+        void require(size_t n);
+
+        void shrink(size_t n) {
+            n = n < bytes ? n : bytes;
+            manager.release(owner, n);
+            bytes -= n;
+        }
+
+        size_t size() const { return bytes; }
+
+    private:
+        MemoryManager& manager;
+        std::string owner;
+        size_t bytes = 0;
+    };
+
+}
+
+#endif // MEMORYMANAGER_H
@@ -42,6 +42,17 @@ namespace sass {
         return pdvValues[varIndex];
     }
 
+    size_t PDV::memoryUsage() const {
+        size_t bytes = sizeof(*this) + pdvVars.capacity() * sizeof(PdvVar) + pdvValues.capacity() * sizeof(Value);
+        for (auto& var : pdvVars) {
+            bytes += var.name.capacity() + var.label.capacity() + var.format.capacity() + var.informat.capacity();
+        }
+        for (auto& val : pdvValues) {
+            if (auto s = std::get_if<std::string>(&val)) bytes += s->capacity();
+        }
+        return bytes;
+    }
+
     void PDV::resetNonRetained() {
         for (size_t i = 0; i < pdvVars.size(); i++) {
             if (!pdvVars[i].retained) {
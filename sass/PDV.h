@@ -48,6 +48,9 @@ namespace sass {
         void setValue(int varIndex, const Value& val);
         Value getValue(int varIndex) const;
 
+        // Approximate bytes held, for MEMSIZE= accounting
+        size_t memoryUsage() const;
+
         // Reset non-retained variables to missing. 
         // Called at the start of each iteration, except for the first
         // (assuming default missing is a double=-INF or an empty string).
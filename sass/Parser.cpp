@@ -7,11 +7,38 @@
 using namespace std;
 
 namespace sass {
-Parser::Parser(const std::vector<Token> &t) : tokens(t) {}
+
+namespace {
+    bool isSqlAggregate(const std::string& name) {
+        std::string f = to_upper(name);
+        return f == "COUNT" || f == "SUM" || f == "AVG" || f == "MEAN" || f == "MIN" || f == "MAX";
+    }
+}
+
+Parser::Parser(const std::vector<Token> &t) : tokens(&t) {}
+
+Parser::Parser(Lexer& lexer) : lexer(&lexer) {}
 
 Token Parser::peek(int offset) const {
-    if (pos + offset < tokens.size()) {
-        return tokens[pos + offset];
+    if (tokens) {
+        if (pos + offset < tokens->size()) {
+            return (*tokens)[pos + offset];
+        }
+    }
+    else {
+        // lexing ahead does not change what the parser has consumed
+        auto self = const_cast<Parser*>(this);
+        while (!lexerDone && lookahead.size() <= (size_t)offset) {
+            Token t = lexer->getNextToken();
+            if (t.type == TokenType::EOF_TOKEN) {
+                self->lexerDone = true;
+                break;
+            }
+            self->lookahead.push_back(std::move(t));
+        }
+        if ((size_t)offset < lookahead.size()) {
+            return lookahead[offset];
+        }
     }
 
     // Return an EOF token if out of range
@@ -21,7 +48,15 @@ Token Parser::peek(int offset) const {
 }
 
 Token Parser::advance() {
-    if (pos < tokens.size()) return tokens[pos++];
+    if (tokens) {
+        if (pos < tokens->size()) return (*tokens)[pos++];
+    }
+    else if (!lookahead.empty() || peek().type != TokenType::EOF_TOKEN) {
+        Token t = std::move(lookahead.front());
+        lookahead.pop_front();
+        pos++;
+        return t;
+    }
     Token eofToken;
     eofToken.type = TokenType::EOF_TOKEN;
     return eofToken;
@@ -57,11 +92,18 @@ std::unique_ptr<ASTNode> Parser::parse() {
 
 std::unique_ptr<ProgramNode> Parser::parseProgram() {
     auto program = std::make_unique<ProgramNode>();
+    while (auto stmt = parseNext()) {
+        program->statements.push_back(std::move(stmt));
+    }
+    return program;
+}
+
+std::unique_ptr<ASTNode> Parser::parseNext() {
     while (peek().type != TokenType::EOF_TOKEN) {
         try {
             auto stmt = parseStatement();
-            if (stmt.status == ParseStatus::PARSE_SUCCESS) {
-                program->statements.push_back(std::move(stmt.node));
+            if (stmt.status == ParseStatus::PARSE_SUCCESS && stmt.node) {
+                return std::move(stmt.node);
             }
             else if (stmt.status == ParseStatus::PARSE_ERROR)
             {
@@ -70,7 +112,13 @@ std::unique_ptr<ProgramNode> Parser::parseProgram() {
         }
         catch (const std::runtime_error& e) {
             // Handle parse error, possibly log it and skip to next statement
-            std::cerr << "Parse error: " << e.what() << "\n";
+            if (onError) {
+                onError(e.what());
+            }
+            else {
+                std::cerr << "Parse error: " << e.what() << "\n";
+            }
+            errorCount++;
             // Implement error recovery if desired
             // For simplicity, skip tokens until next semicolon
             while (peek().type != TokenType::SEMICOLON && peek().type != TokenType::EOF_TOKEN) {
@@ -81,7 +129,7 @@ std::unique_ptr<ProgramNode> Parser::parseProgram() {
             }
         }
     }
-    return program;
+    return nullptr;
 }
 
 ParseResult Parser::parseStatement() {
@@ -135,10 +183,16 @@ ParseResult Parser::parseStatement() {
 			throw std::runtime_error("Unexpected 'ELSE IF' without preceding 'IF'.");
 		case TokenType::KEYWORD_OUTPUT:
 			astNode = parseOutput(); break;
+		case TokenType::KEYWORD_CALL:
+			astNode = parseCall(); break;
 		case TokenType::KEYWORD_MACRO_LET:
 			astNode = parseLetStatement(); break;
+		case TokenType::KEYWORD_MACRO_PUT:
+			astNode = parseMacroPut(); break;
 		case TokenType::KEYWORD_MACRO_MACRO:
 			astNode = parseMacroDefinition(); break;
+		case TokenType::MACRO_CALL:
+			astNode = parseMacroCall(); break;
 		case TokenType::EOF_TOKEN: {
 			// No tokens at all -> incomplete or just end?
 			// If the user typed nothing, we might say incomplete or just success with no statement.
@@ -229,22 +283,40 @@ std::unique_ptr<ASTNode> Parser::parseDataStep() {
 }
 
 std::unique_ptr<ASTNode> Parser::parseOptions() {
-    // options option1=value1 option2=value2;
+    // options option1=value1 option2=value2 flag noflag;
     auto node = std::make_unique<OptionsNode>();
     consume(TokenType::KEYWORD_OPTIONS, "Expected 'options'");
 
     while (peek().type != TokenType::SEMICOLON && peek().type != TokenType::EOF_TOKEN) {
         // Parse option name
-        std::string optionName = consume(TokenType::IDENTIFIER, "Expected option name").text;
-        // Expect '='
+        // OBS is a keyword of its own (for dataset options), it names a system option as well
+        std::string optionName = peek().type == TokenType::KEYWORD_OBS
+            ? to_upper(advance().text)
+            : to_upper(consume(TokenType::IDENTIFIER, "Expected option name").text);
+        // Flag option without a value, e.g. fullstimer / nofullstimer
+        if (peek().type != TokenType::EQUAL) {
+            node->options.emplace_back(optionName, "");
+            continue;
+        }
         consume(TokenType::EQUAL, "Expected '=' after option name");
         // Parse option value, could be string or number
         std::string optionValue;
         if (peek().type == TokenType::STRING) {
             optionValue = consume(TokenType::STRING, "Expected string value for option").text;
         }
-        else if (peek().type == TokenType::NUMBER || peek().type == TokenType::IDENTIFIER) {
-            optionValue = consume(peek().type, "Expected value for option").text;
+        else if (peek().type == TokenType::NUMBER) {
+            optionValue = consume(TokenType::NUMBER, "Expected value for option").text;
+            // size units are lexed separately: memsize=2G
+            if (peek().type == TokenType::IDENTIFIER) {
+                std::string unit = to_upper(peek().text);
+                if (unit == "K" || unit == "M" || unit == "G" || unit == "T" ||
+                    unit == "KB" || unit == "MB" || unit == "GB" || unit == "TB") {
+                    optionValue += consume(TokenType::IDENTIFIER, "Expected unit").text;
+                }
+            }
+        }
+        else if (peek().type == TokenType::IDENTIFIER) {
+            optionValue = consume(TokenType::IDENTIFIER, "Expected value for option").text;
         }
         else {
             throw std::runtime_error("Invalid option value for option: " + optionName);
@@ -257,12 +329,16 @@ std::unique_ptr<ASTNode> Parser::parseOptions() {
 }
 
 std::unique_ptr<ASTNode> Parser::parseLibname() {
-    // libname libref 'path';
+    // libname libref <engine> 'path' <access=readonly>;
     auto node = std::make_unique<LibnameNode>();
     consume(TokenType::KEYWORD_LIBNAME, "Expected 'libname'");
 
     node->libref = to_upper(consume(TokenType::IDENTIFIER, "Expected libref").text);
-    // Optionally, there could be more options or syntax here
+
+    // Optional engine name, e.g. libname s stata 'c:\data';
+    if (peek().type == TokenType::IDENTIFIER) {
+        node->engine = to_upper(advance().text);
+    }
 
     // Expect the path, which is typically a string
     if (peek().type == TokenType::STRING) {
@@ -272,6 +348,19 @@ std::unique_ptr<ASTNode> Parser::parseLibname() {
         throw std::runtime_error("Expected path string for libname");
     }
 
+    // Optional access=readonly
+    if (to_upper(peek().text) == "ACCESS" && peek(1).type == TokenType::EQUAL) {
+        advance();
+        advance();
+        std::string access = to_upper(advance().text);
+        if (access == "READONLY") {
+            node->accessMode = LibraryAccess::READONLY;
+        }
+        else {
+            throw std::runtime_error("Unsupported ACCESS= value for libname: " + access);
+        }
+    }
+
     consume(TokenType::SEMICOLON, "Expected ';' after libname statement");
     return node;
 }
@@ -326,6 +415,24 @@ std::unique_ptr<ASTNode> Parser::parseOutput() {
     return node;
 }
 
+std::unique_ptr<ASTNode> Parser::parseCall() {
+    // call routine(arg1, arg2, ...);
+    auto node = std::make_unique<CallRoutineNode>();
+    consume(TokenType::KEYWORD_CALL, "Expected 'call'");
+    node->routine = to_upper(consume(TokenType::IDENTIFIER, "Expected routine name after 'call'").text);
+    consume(TokenType::LPAREN, "Expected '(' after routine name");
+    if (peek().type != TokenType::RPAREN) {
+        while (true) {
+            node->arguments.push_back(parseExpression());
+            if (peek().type != TokenType::COMMA) break;
+            advance();
+        }
+    }
+    consume(TokenType::RPAREN, "Expected ')' after routine arguments");
+    consume(TokenType::SEMICOLON, "Expected ';' after CALL statement");
+    return node;
+}
+
 std::unique_ptr<ASTNode> Parser::parseExpression(int precedence) {
     // First parse the "primary" expression
     auto left = parsePrimary();
@@ -334,8 +441,22 @@ std::unique_ptr<ASTNode> Parser::parseExpression(int precedence) {
         Token t = peek();
         if (t.type == TokenType::EOF_TOKEN) break; // no more tokens
 
+        // [NOT] IN of SQL conditions, a comparison
+        if (sqlConditions && precedence <= 3
+            && (to_upper(t.text) == "IN" || (t.type == TokenType::NOT && to_upper(peek(1).text) == "IN"))) {
+            left = parseSqlIn(std::move(left));
+            continue;
+        }
+
         // e.g., if t.text == "+" or "*", check precedence
         std::string op = t.text;
+        if (op == "=" && sqlConditions) {
+            // SQL has no assignment, = compares
+            op = "==";
+        }
+        else if (to_lower(op) == "and" || to_lower(op) == "or") {
+            op = to_lower(op);
+        }
         int currentPrecedence = getPrecedence(op);
 
         // If this operator has lower precedence than 'precedence', we stop
@@ -373,13 +494,22 @@ std::unique_ptr<ASTNode> Parser::parsePrimary() {
         advance();
         return std::make_unique<StringNode>(t.text);
     }
+    // [NOT] EXISTS (<subquery>) of SQL conditions
+    else if (sqlConditions && (to_upper(t.text) == "EXISTS"
+        || (t.type == TokenType::NOT && to_upper(peek(1).text) == "EXISTS"))) {
+        return parseSqlExists();
+    }
+    // Aggregate functions of a SQL SELECT list or HAVING clause (MIN, MAX and MEAN are keywords)
+    else if (sqlAggregates && peek(1).type == TokenType::LPAREN && isSqlAggregate(t.text)) {
+        return parseSqlAggregate();
+    }
     else if (t.type == TokenType::IDENTIFIER) {
         // Check if it's a function call
-        if (tokens.size() > pos + 1 && tokens[pos + 1].type == TokenType::LPAREN) {
+        if (peek(1).type == TokenType::LPAREN) {
             return parseFunctionCall();
         }
         // Check if it's an array element reference
-        else if (tokens.size() > pos + 1 && tokens[pos + 1].type == TokenType::LBRACKET) {
+        else if (peek(1).type == TokenType::LBRACKET) {
             auto arrayElement = std::make_unique<ArrayElementNode>();
             arrayElement->arrayName = consume(TokenType::IDENTIFIER, "Expected array name").text;
             consume(TokenType::LBRACKET, "Expected '[' after array name");
@@ -431,6 +561,13 @@ std::unique_ptr<ASTNode> Parser::parseProc() {
     else if (t.type == TokenType::KEYWORD_MEANS) {
         return parseProcMeans();
     }
+    else if (t.type == TokenType::KEYWORD_UNIVARIATE) {
+        return parseProcUnivariate();
+    }
+    // not a keyword, RANK is a common variable name
+    else if (t.type == TokenType::IDENTIFIER && to_upper(t.text) == "RANK") {
+        return parseProcRank();
+    }
     else if (t.type == TokenType::KEYWORD_FREQ) {
         return parseProcFreq();
     }
@@ -729,7 +866,7 @@ std::unique_ptr<ASTNode> Parser::parseDoLoop() {
     // Parse the body of the DO loop (a block of statements)
     doLoopNode->body = std::make_unique<BlockNode>();
 
-    while (!match(TokenType::KEYWORD_ENDDOLOOP) && pos < tokens.size()) {
+    while (!match(TokenType::KEYWORD_ENDDOLOOP) && peek().type != TokenType::EOF_TOKEN) {
         auto parseResult = parseStatement();
         if (parseResult.status == ParseStatus::PARSE_SUCCESS)
             doLoopNode->body->statements.push_back(std::move(parseResult.node));
@@ -742,211 +879,334 @@ std::unique_ptr<ASTNode> Parser::parseDoLoop() {
 }
 
 std::unique_ptr<ASTNode> Parser::parseProcSort() {
+    // proc sort data=<dataset> [out=<dataset>] [nodupkey] [duplicates]; by <variables>; [where <condition>;] run;
     auto procSortNode = std::make_unique<ProcSortNode>();
     consume(TokenType::KEYWORD_SORT, "Expected 'SORT' keyword after 'PROC'");
 
-    // Parse DATA= option
-    if (match(TokenType::KEYWORD_DATA)) {
-        consume(TokenType::KEYWORD_DATA, "Expected 'DATA=' option in PROC SORT");
-
-        auto dsNode = parseDatasetName();
-        procSortNode->inputDataSet = *dsNode;
+    while (peek().type != TokenType::SEMICOLON) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Unexpected end of file while parsing PROC SORT statement.");
+        }
+        if (match("data")) {
+            consume(TokenType::EQUAL, "Expected '=' after DATA");
+            procSortNode->inputDataSet = *parseDatasetName();
+        }
+        else if (match("out")) {
+            consume(TokenType::EQUAL, "Expected '=' after OUT");
+            procSortNode->outputDataSet = *parseDatasetName();
+        }
+        else if (match("NODUPKEY")) {
+            procSortNode->nodupkey = true;
+        }
+        else if (match("DUPLICATES")) {
+            procSortNode->duplicates = true;
+        }
+        else {
+            throw std::runtime_error("Unknown option in PROC SORT statement: " + peek().text);
+        }
     }
-    else {
+    consume(TokenType::SEMICOLON, "Expected ';' after PROC SORT statement");
+    if (procSortNode->inputDataSet.dataName.empty()) {
         throw std::runtime_error("PROC SORT requires a DATA= option");
     }
 
-    // Parse OUT= option (optional)
-    if (match(TokenType::KEYWORD_OUT)) {
-        consume(TokenType::KEYWORD_OUT, "Expected 'OUT=' option in PROC SORT");
-        auto dsNode = parseDatasetName();
-        procSortNode->outputDataSet = *dsNode;
-    }
-
-    // Parse BY statement
-    if (match(TokenType::KEYWORD_BY)) {
-        consume(TokenType::KEYWORD_BY, "Expected 'BY' keyword in PROC SORT");
-        while (peek().type == TokenType::IDENTIFIER) {
-            Token varToken = consume(TokenType::IDENTIFIER, "Expected variable name in BY statement");
-            procSortNode->byVariables.push_back(varToken.text);
+    while (!match(TokenType::KEYWORD_RUN)) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Expected 'RUN;' to terminate PROC SORT");
         }
-    }
-    else {
-        throw std::runtime_error("PROC SORT requires a BY statement");
-    }
-
-    // Parse optional WHERE statement
-    if (match(TokenType::KEYWORD_WHERE)) {
-        consume(TokenType::KEYWORD_WHERE, "Expected 'WHERE' keyword in PROC SORT");
-        consume(TokenType::LPAREN, "Expected '(' after 'WHERE'");
-        procSortNode->whereCondition = parseExpression(); // Parse condition expression
-        consume(TokenType::RPAREN, "Expected ')' after 'WHERE' condition");
-    }
-
-    // Parse optional NODUPKEY and DUPLICATES options
-    while (match(TokenType::KEYWORD_NODUPKEY) || match(TokenType::KEYWORD_DUPLICATES)) {
-        if (match(TokenType::KEYWORD_NODUPKEY)) {
-            consume(TokenType::KEYWORD_NODUPKEY, "Expected 'NODUPKEY' keyword");
-            procSortNode->nodupkey = true;
+        if (match(TokenType::KEYWORD_BY)) {
+            while (peek().type == TokenType::IDENTIFIER) {
+                procSortNode->byVariables.push_back(advance().text);
+            }
         }
-        if (match(TokenType::KEYWORD_DUPLICATES)) {
-            consume(TokenType::KEYWORD_DUPLICATES, "Expected 'DUPLICATES' keyword");
-            procSortNode->duplicates = true;
+        else if (match(TokenType::KEYWORD_WHERE)) {
+            procSortNode->whereCondition = parseSqlCondition();
+        }
+        else {
+            throw std::runtime_error("Unsupported statement in PROC SORT: " + peek().text);
         }
+        consume(TokenType::SEMICOLON, "Expected ';' after statement in PROC SORT");
     }
-
-    // Expect RUN; statement
-    consume(TokenType::KEYWORD_RUN, "Expected 'RUN;' to terminate PROC SORT");
     consume(TokenType::SEMICOLON, "Expected ';' after 'RUN'");
+    if (procSortNode->byVariables.empty()) {
+        throw std::runtime_error("PROC SORT requires a BY statement");
+    }
 
     return procSortNode;
 }
 
 std::unique_ptr<ASTNode> Parser::parseProcMeans() {
+    // proc means data=<dataset> [statistics]; var <variables>; [where <condition>;]
+    //    [output out=<dataset> <statistic>=<name> ...;] run;
     auto procMeansNode = std::make_unique<ProcMeansNode>();
     consume(TokenType::KEYWORD_MEANS, "Expected 'MEANS' keyword after 'PROC'");
 
-    // Parse DATA= option
-    if (match(TokenType::KEYWORD_DATA)) {
-        consume(TokenType::KEYWORD_DATA, "Expected 'DATA=' option in PROC MEANS");
-        auto dsNode = parseDatasetName();
-        procMeansNode->inputDataSet = *dsNode;
+    while (peek().type != TokenType::SEMICOLON) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Unexpected end of file while parsing PROC MEANS statement.");
+        }
+        std::string statistic = to_upper(peek().text);
+        if (match("data")) {
+            consume(TokenType::EQUAL, "Expected '=' after DATA");
+            procMeansNode->inputDataSet = *parseDatasetName();
+        }
+        else if (statistic == "N" || statistic == "MEAN" || statistic == "MEDIAN"
+            || statistic == "STD" || statistic == "MIN" || statistic == "MAX") {
+            advance();
+            procMeansNode->statistics.push_back(statistic);
+        }
+        else {
+            throw std::runtime_error("Unknown option in PROC MEANS statement: " + peek().text);
+        }
     }
-    else {
+    consume(TokenType::SEMICOLON, "Expected ';' after PROC MEANS statement");
+    if (procMeansNode->inputDataSet.dataName.empty()) {
         throw std::runtime_error("PROC MEANS requires a DATA= option");
     }
-
-    // Parse statistical options (N, MEAN, MEDIAN, STD, MIN, MAX)
-    while (match(TokenType::KEYWORD_N) ||
-        match(TokenType::KEYWORD_MEAN) ||
-        match(TokenType::KEYWORD_MEDIAN) ||
-        match(TokenType::KEYWORD_STD) ||
-        match(TokenType::KEYWORD_MIN) ||
-        match(TokenType::KEYWORD_MAX)) {
-        Token statToken = advance();
-        switch (statToken.type) {
-        case TokenType::KEYWORD_N:
-            procMeansNode->statistics.push_back("N");
-            break;
-        case TokenType::KEYWORD_MEAN:
-            procMeansNode->statistics.push_back("MEAN");
-            break;
-        case TokenType::KEYWORD_MEDIAN:
-            procMeansNode->statistics.push_back("MEDIAN");
-            break;
-        case TokenType::KEYWORD_STD:
-            procMeansNode->statistics.push_back("STD");
-            break;
-        case TokenType::KEYWORD_MIN:
-            procMeansNode->statistics.push_back("MIN");
-            break;
-        case TokenType::KEYWORD_MAX:
-            procMeansNode->statistics.push_back("MAX");
-            break;
-        default:
-            break;
-        }
+    if (procMeansNode->statistics.empty()) {
+        // the statistics PROC MEANS prints by default
+        procMeansNode->statistics = { "N", "MEAN", "STD", "MIN", "MAX" };
     }
 
-    // Parse VAR statement
-    if (match(TokenType::KEYWORD_VAR)) {
-        consume(TokenType::KEYWORD_VAR, "Expected 'VAR' keyword in PROC MEANS");
-        while (peek().type == TokenType::IDENTIFIER) {
-            Token varToken = consume(TokenType::IDENTIFIER, "Expected variable name in VAR statement");
-            procMeansNode->varVariables.push_back(varToken.text);
+    while (!match(TokenType::KEYWORD_RUN)) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Expected 'RUN;' to terminate PROC MEANS");
         }
+        if (match(TokenType::KEYWORD_VAR)) {
+            while (peek().type == TokenType::IDENTIFIER) {
+                procMeansNode->varVariables.push_back(advance().text);
+            }
+        }
+        else if (match(TokenType::KEYWORD_WHERE)) {
+            procMeansNode->whereCondition = parseSqlCondition();
+        }
+        else if (match(TokenType::KEYWORD_OUTPUT)) {
+            if (match("out")) {
+                consume(TokenType::EQUAL, "Expected '=' after OUT");
+                procMeansNode->outputDataSet = *parseDatasetName();
+            }
+            // output options like N=, MEAN=, etc.
+            while (peek().type != TokenType::SEMICOLON && peek().type != TokenType::EOF_TOKEN) {
+                std::string option = to_upper(advance().text);
+                consume(TokenType::EQUAL, "Expected '=' after output option in OUTPUT statement");
+                procMeansNode->outputOptions[option] = advance().text;
+            }
+        }
+        else {
+            throw std::runtime_error("Unsupported statement in PROC MEANS: " + peek().text);
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after statement in PROC MEANS");
     }
-    else {
+    consume(TokenType::SEMICOLON, "Expected ';' after 'RUN'");
+    if (procMeansNode->varVariables.empty()) {
         throw std::runtime_error("PROC MEANS requires a VAR statement");
     }
 
-    // Parse optional OUTPUT statement
-    if (match(TokenType::KEYWORD_OUTPUT)) {
-        consume(TokenType::KEYWORD_OUTPUT, "Expected 'OUTPUT' keyword in PROC MEANS");
-        if (match(TokenType::KEYWORD_OUT)) {
-            consume(TokenType::KEYWORD_OUT, "Expected 'OUT=' option in OUTPUT statement");
-            auto dsNode = parseDatasetName();
-            procMeansNode->outputDataSet = *dsNode;
+    return procMeansNode;
+}
+
+// proc univariate data=<dataset> <noprint> <nextrobs=n>;
+//    var <variables>;
+//    histogram <variables> </ nbins=n>;
+//    output out=<dataset> <statistic>=<names> ... <pctlpts=<percents> pctlpre=<prefixes>>;
+// run;
+std::unique_ptr<ASTNode> Parser::parseProcUnivariate() {
+    auto node = std::make_unique<ProcUnivariateNode>();
+    consume(TokenType::KEYWORD_UNIVARIATE, "Expected 'UNIVARIATE' keyword after 'PROC'");
+
+    // PROC UNIVARIATE statement options
+    while (peek().type != TokenType::SEMICOLON) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Unexpected end of file while parsing PROC UNIVARIATE statement.");
+        }
+        if (match("data")) {
+            consume(TokenType::EQUAL, "Expected '=' after DATA");
+            node->inputDataSet = *parseDatasetName();
+        }
+        else if (match("NOPRINT")) {
+            node->options["NOPRINT"] = "YES";
+        }
+        else if (match("NEXTROBS")) {
+            consume(TokenType::EQUAL, "Expected '=' after NEXTROBS");
+            node->options["NEXTROBS"] = consume(TokenType::NUMBER, "Expected a number after NEXTROBS=").text;
         }
+        else {
+            throw std::runtime_error("Unknown option in PROC UNIVARIATE statement: " + peek().text);
+        }
+    }
+    consume(TokenType::SEMICOLON, "Expected ';' after PROC UNIVARIATE statement");
+    if (node->inputDataSet.dataName.empty()) {
+        throw std::runtime_error("PROC UNIVARIATE requires a DATA= option");
+    }
 
-        // Parse output options like N=, MEAN=, etc.
-        while (match(TokenType::IDENTIFIER)) {
-            Token optionToken = consume(TokenType::IDENTIFIER, "Expected output option in OUTPUT statement");
-            if (match(TokenType::EQUAL)) {
-                consume(TokenType::EQUAL, "Expected '=' after output option");
-                Token valueToken = consume(TokenType::IDENTIFIER, "Expected value after '=' in output option");
-                procMeansNode->outputOptions[optionToken.text] = valueToken.text;
+    while (!match(TokenType::KEYWORD_RUN)) {
+        if (match(TokenType::KEYWORD_VAR)) {
+            while (peek().type == TokenType::IDENTIFIER) {
+                node->varVariables.push_back(advance().text);
             }
-            else {
-                throw std::runtime_error("Expected '=' after output option in OUTPUT statement");
+        }
+        else if (match("HISTOGRAM")) {
+            node->histogram = true;
+            while (peek().type == TokenType::IDENTIFIER) {
+                node->histogramVariables.push_back(advance().text);
+            }
+            if (match(TokenType::DIV)) {
+                while (peek().type != TokenType::SEMICOLON && peek().type != TokenType::EOF_TOKEN) {
+                    std::string option = to_upper(advance().text);
+                    consume(TokenType::EQUAL, "Expected '=' after " + option);
+                    node->histogramOptions[option] = consume(TokenType::NUMBER, "Expected a number after " + option + "=").text;
+                }
+            }
+        }
+        else if (match(TokenType::KEYWORD_OUTPUT)) {
+            while (peek().type != TokenType::SEMICOLON && peek().type != TokenType::EOF_TOKEN) {
+                std::string keyword = to_upper(advance().text);
+                consume(TokenType::EQUAL, "Expected '=' after " + keyword + " in OUTPUT statement");
+                if (keyword == "OUT") {
+                    node->outputDataSet = *parseDatasetName();
+                    continue;
+                }
+                // names (or percents) up to the next keyword=
+                std::vector<std::string> names;
+                while (peek().type != TokenType::SEMICOLON && peek().type != TokenType::EOF_TOKEN
+                    && peek(1).type != TokenType::EQUAL) {
+                    names.push_back(advance().text);
+                }
+                node->outputStatistics.emplace_back(keyword, names);
             }
         }
+        else {
+            throw std::runtime_error("Unsupported statement in PROC UNIVARIATE: " + peek().text);
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after statement in PROC UNIVARIATE");
     }
+    consume(TokenType::SEMICOLON, "Expected ';' after 'RUN'");
 
-    // Expect RUN; statement
-    consume(TokenType::KEYWORD_RUN, "Expected 'RUN;' to terminate PROC MEANS");
+    return node;
+}
+
+// proc rank data=<dataset> <out=<dataset>> <ties=mean|low|high|dense> <groups=n> <descending>;
+//    var <variables>;
+//    ranks <new variables>;
+//    by <variables>;
+// run;
+std::unique_ptr<ASTNode> Parser::parseProcRank() {
+    auto node = std::make_unique<ProcRankNode>();
+    advance(); // RANK
+
+    while (peek().type != TokenType::SEMICOLON) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Unexpected end of file while parsing PROC RANK statement.");
+        }
+        if (match("data")) {
+            consume(TokenType::EQUAL, "Expected '=' after DATA");
+            node->inputDataSet = *parseDatasetName();
+        }
+        else if (match("out")) {
+            consume(TokenType::EQUAL, "Expected '=' after OUT");
+            node->outputDataSet = *parseDatasetName();
+        }
+        else if (match("TIES")) {
+            consume(TokenType::EQUAL, "Expected '=' after TIES");
+            std::string ties = to_upper(consume(TokenType::IDENTIFIER, "Expected MEAN, LOW, HIGH or DENSE after TIES=").text);
+            if (ties != "MEAN" && ties != "LOW" && ties != "HIGH" && ties != "DENSE") {
+                throw std::runtime_error("TIES=" + ties + " is not MEAN, LOW, HIGH or DENSE.");
+            }
+            node->options["TIES"] = ties;
+        }
+        else if (match("GROUPS")) {
+            consume(TokenType::EQUAL, "Expected '=' after GROUPS");
+            node->options["GROUPS"] = consume(TokenType::NUMBER, "Expected a number after GROUPS=").text;
+        }
+        else if (match("DESCENDING")) {
+            node->options["DESCENDING"] = "YES";
+        }
+        else {
+            throw std::runtime_error("Unknown option in PROC RANK statement: " + peek().text);
+        }
+    }
+    consume(TokenType::SEMICOLON, "Expected ';' after PROC RANK statement");
+    if (node->inputDataSet.dataName.empty()) {
+        throw std::runtime_error("PROC RANK requires a DATA= option");
+    }
+
+    while (!match(TokenType::KEYWORD_RUN)) {
+        std::vector<std::string>* list;
+        if (match(TokenType::KEYWORD_VAR)) {
+            list = &node->varVariables;
+        }
+        else if (match("RANKS")) {
+            list = &node->rankVariables;
+        }
+        else if (match(TokenType::KEYWORD_BY)) {
+            list = &node->byVariables;
+        }
+        else {
+            throw std::runtime_error("Unsupported statement in PROC RANK: " + peek().text);
+        }
+        while (peek().type == TokenType::IDENTIFIER) {
+            list->push_back(advance().text);
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after statement in PROC RANK");
+    }
     consume(TokenType::SEMICOLON, "Expected ';' after 'RUN'");
 
-    return procMeansNode;
+    return node;
 }
 
 std::unique_ptr<ASTNode> Parser::parseProcFreq() {
+    // proc freq data=<dataset> [nlevels]; [tables a b*c [/ options];] [where <condition>;] run;
     auto procFreqNode = std::make_unique<ProcFreqNode>();
     consume(TokenType::KEYWORD_FREQ, "Expected 'FREQ' keyword after 'PROC'");
 
-    // Parse DATA= option
-    if (match(TokenType::KEYWORD_DATA)) {
-        consume(TokenType::KEYWORD_DATA, "Expected 'DATA=' option in PROC FREQ");
-        auto dsNode = parseDatasetName();
-        procFreqNode->inputDataSet = *dsNode;
+    while (peek().type != TokenType::SEMICOLON) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Unexpected end of file while parsing PROC FREQ statement.");
+        }
+        if (match("data")) {
+            consume(TokenType::EQUAL, "Expected '=' after DATA");
+            procFreqNode->inputDataSet = *parseDatasetName();
+        }
+        else if (match("NLEVELS")) {
+            procFreqNode->options.push_back("NLEVELS");
+        }
+        else {
+            throw std::runtime_error("Unknown option in PROC FREQ statement: " + peek().text);
+        }
     }
-    else {
+    consume(TokenType::SEMICOLON, "Expected ';' after PROC FREQ statement");
+    if (procFreqNode->inputDataSet.dataName.empty()) {
         throw std::runtime_error("PROC FREQ requires a DATA= option");
     }
 
-    // Parse TABLES statement
-    if (match(TokenType::KEYWORD_TABLES)) {
-        consume(TokenType::KEYWORD_TABLES, "Expected 'TABLES' keyword in PROC FREQ");
-        while (peek().type == TokenType::IDENTIFIER || peek().type == TokenType::STAR) {
-            std::string table;
-            // Parse table specification, e.g., var1 or var1*var2
-            Token varToken = consume(TokenType::IDENTIFIER, "Expected variable name in TABLES statement");
-            table += varToken.text;
-
-            if (match(TokenType::STAR)) {
-                consume(TokenType::STAR, "Expected '*' in TABLES statement for cross-tabulation");
-                Token var2Token = consume(TokenType::IDENTIFIER, "Expected second variable name in TABLES statement");
-                table += "*" + var2Token.text;
+    while (!match(TokenType::KEYWORD_RUN)) {
+        if (match(TokenType::KEYWORD_TABLES)) {
+            // table specifications, e.g., var1 or var1*var2, the options after '/' go with all of them
+            size_t first = procFreqNode->tables.size();
+            while (peek().type == TokenType::IDENTIFIER) {
+                std::string table = advance().text;
+                if (match(TokenType::STAR)) {
+                    table += "*" + consume(TokenType::IDENTIFIER, "Expected second variable name in TABLES statement").text;
+                }
+                procFreqNode->tables.emplace_back(table, std::vector<std::string>());
             }
-
-            // Parse options after '/' if present
-            std::vector<std::string> options;
-            if (match(TokenType::SLASH)) { // Assuming '/' is tokenized as SLASH
-                consume(TokenType::SLASH, "Expected '/' before TABLES options");
+            if (match(TokenType::DIV)) {
                 while (peek().type == TokenType::IDENTIFIER) {
-                    Token optionToken = consume(TokenType::IDENTIFIER, "Expected option in TABLES statement");
-                    options.push_back(optionToken.text);
-                    // Handle options with parameters if necessary, e.g., chisq
+                    std::string option = to_upper(advance().text);
+                    for (size_t i = first; i < procFreqNode->tables.size(); i++) {
+                        procFreqNode->tables[i].second.push_back(option);
+                    }
                 }
             }
-
-            procFreqNode->tables.emplace_back(std::make_pair(table, options));
         }
+        else if (match(TokenType::KEYWORD_WHERE)) {
+            procFreqNode->whereCondition = parseSqlCondition();
+        }
+        else {
+            throw std::runtime_error("Unsupported statement in PROC FREQ: " + peek().text);
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after statement in PROC FREQ");
     }
-    else {
-        throw std::runtime_error("PROC FREQ requires a TABLES statement");
-    }
-
-    // Parse optional WHERE statement
-    if (match(TokenType::KEYWORD_WHERE)) {
-        consume(TokenType::KEYWORD_WHERE, "Expected 'WHERE' keyword in PROC FREQ");
-        consume(TokenType::LPAREN, "Expected '(' after 'WHERE'");
-        procFreqNode->whereCondition = parseExpression(); // Parse condition expression
-        consume(TokenType::RPAREN, "Expected ')' after 'WHERE' condition");
-    }
-
-    // Expect RUN; statement
-    consume(TokenType::KEYWORD_RUN, "Expected 'RUN;' to terminate PROC FREQ");
     consume(TokenType::SEMICOLON, "Expected ';' after 'RUN'");
 
     return procFreqNode;
@@ -1111,20 +1371,30 @@ std::unique_ptr<ASTNode> Parser::parseProcPrint() {
 std::unique_ptr<ASTNode> Parser::parseProcSQL() {
     auto procSQLNode = std::make_unique<ProcSQLNode>();
     consume(TokenType::KEYWORD_SQL, "Expected 'SQL' keyword after 'PROC'");
+    while (peek().type != TokenType::SEMICOLON) {
+        if (match("OUTOBS")) {
+            consume(TokenType::EQUAL, "Expected '=' after OUTOBS");
+            procSQLNode->options["OUTOBS"] = consume(TokenType::NUMBER, "Expected a number after OUTOBS=").text;
+        }
+        else {
+            throw std::runtime_error("Unknown option in PROC SQL statement: " + peek().text);
+        }
+    }
+    consume(TokenType::SEMICOLON, "Expected ';' after PROC SQL");
 
     // Parse SQL statements until 'QUIT;' is encountered
-    while (!(match(TokenType::KEYWORD_QUIT) && peek().type == TokenType::SEMICOLON)) {
+    while (!match(TokenType::KEYWORD_QUIT)) {
+        if (peek().type == TokenType::EOF_TOKEN) {
+            throw std::runtime_error("Unexpected end of file in PROC SQL, expected 'QUIT'.");
+        }
         auto sqlStmt = parseSQLStatement();
         if (sqlStmt) {
             procSQLNode->statements.emplace_back(std::move(sqlStmt));
         }
         else {
-            throw std::runtime_error("Unsupported SQL statement in PROC SQL.");
+            throw std::runtime_error("Unsupported SQL statement in PROC SQL: " + peek().text);
         }
     }
-
-    // Consume 'QUIT;' statement
-    consume(TokenType::KEYWORD_QUIT, "Expected 'QUIT' to terminate PROC SQL");
     consume(TokenType::SEMICOLON, "Expected ';' after 'QUIT'");
 
     return procSQLNode;
@@ -1133,82 +1403,7 @@ std::unique_ptr<ASTNode> Parser::parseProcSQL() {
 std::unique_ptr<SQLStatementNode> Parser::parseSQLStatement() {
     Token t = peek();
     if (t.type == TokenType::KEYWORD_SELECT) {
-        // Parse SELECT statement
-        auto selectStmt = std::make_unique<SelectStatementNode>();
-        consume(TokenType::KEYWORD_SELECT, "Expected 'SELECT' keyword");
-
-        // Parse selected columns
-        while (true) {
-            Token varToken = consume(TokenType::IDENTIFIER, "Expected column name in SELECT statement");
-            selectStmt->selectColumns.push_back(varToken.text);
-
-            if (match(TokenType::COMMA)) {
-                consume(TokenType::COMMA, "Expected ',' between columns in SELECT statement");
-            }
-            else {
-                break;
-            }
-        }
-
-        // Parse FROM clause
-        consume(TokenType::KEYWORD_FROM, "Expected 'FROM' keyword in SELECT statement");
-        while (true) {
-            Token tableToken = consume(TokenType::IDENTIFIER, "Expected table name in FROM clause");
-            selectStmt->fromTables.push_back(tableToken.text);
-
-            if (match(TokenType::COMMA)) {
-                consume(TokenType::COMMA, "Expected ',' between tables in FROM clause");
-            }
-            else {
-                break;
-            }
-        }
-
-        // Parse optional WHERE clause
-        if (match(TokenType::KEYWORD_WHERE)) {
-            consume(TokenType::KEYWORD_WHERE, "Expected 'WHERE' keyword");
-            selectStmt->whereCondition = parseExpression(); // Parse condition expression
-        }
-
-        // Parse optional GROUP BY clause
-        if (match(TokenType::KEYWORD_GROUP)) {
-            consume(TokenType::KEYWORD_GROUP, "Expected 'GROUP' keyword");
-            consume(TokenType::KEYWORD_BY, "Expected 'BY' keyword after 'GROUP'");
-            while (true) {
-                Token groupVarToken = consume(TokenType::IDENTIFIER, "Expected column name in GROUP BY clause");
-                selectStmt->groupByColumns.push_back(groupVarToken.text);
-
-                if (match(TokenType::COMMA)) {
-                    consume(TokenType::COMMA, "Expected ',' between columns in GROUP BY clause");
-                }
-                else {
-                    break;
-                }
-            }
-        }
-
-        // Parse optional HAVING clause
-        if (match(TokenType::KEYWORD_HAVING)) {
-            consume(TokenType::KEYWORD_HAVING, "Expected 'HAVING' keyword");
-            selectStmt->havingCondition = parseExpression(); // Parse HAVING condition expression
-        }
-
-        // Parse optional ORDER BY clause
-        if (match(TokenType::KEYWORD_ORDER)) {
-            consume(TokenType::KEYWORD_ORDER, "Expected 'ORDER' keyword");
-            consume(TokenType::KEYWORD_BY, "Expected 'BY' keyword after 'ORDER'");
-            while (true) {
-                Token orderVarToken = consume(TokenType::IDENTIFIER, "Expected column name in ORDER BY clause");
-                selectStmt->orderByColumns.push_back(orderVarToken.text);
-
-                if (match(TokenType::COMMA)) {
-                    consume(TokenType::COMMA, "Expected ',' between columns in ORDER BY clause");
-                }
-                else {
-                    break;
-                }
-            }
-        }
+        auto selectStmt = parseSelect();
 
         // Consume semicolon at the end of the statement
         consume(TokenType::SEMICOLON, "Expected ';' after SELECT statement");
@@ -1222,8 +1417,13 @@ std::unique_ptr<SQLStatementNode> Parser::parseSQLStatement() {
 
         consume(TokenType::KEYWORD_TABLE, "Expected 'TABLE' keyword after 'CREATE'");
 
-        Token tableNameToken = consume(TokenType::IDENTIFIER, "Expected table name after 'CREATE TABLE'");
-        createStmt->tableName = tableNameToken.text;
+        createStmt->tableName = parseSqlTableName();
+
+        if (match(TokenType::KEYWORD_AS)) {
+            createStmt->asSelect = parseSelect();
+            consume(TokenType::SEMICOLON, "Expected ';' after CREATE TABLE statement");
+            return createStmt;
+        }
 
         consume(TokenType::LPAREN, "Expected '(' after table name in CREATE TABLE statement");
 
@@ -1235,10 +1435,7 @@ std::unique_ptr<SQLStatementNode> Parser::parseSQLStatement() {
             // Optionally, parse data type definitions (e.g., varchar, int)
             // This implementation focuses on column names. Extend as needed.
 
-            if (match(TokenType::COMMA)) {
-                consume(TokenType::COMMA, "Expected ',' between columns in CREATE TABLE statement");
-            }
-            else {
+            if (!match(TokenType::COMMA)) {
                 break;
             }
         }
@@ -1249,14 +1446,237 @@ std::unique_ptr<SQLStatementNode> Parser::parseSQLStatement() {
         return createStmt;
     }
 
-    // Implement other SQL statement parsers (INSERT, UPDATE, DELETE) similarly
-
+    else if (match(TokenType::KEYWORD_DELETE)) {
+        auto deleteStmt = std::make_unique<DeleteStatementNode>();
+        consume(TokenType::KEYWORD_FROM, "Expected 'FROM' after 'DELETE'");
+        deleteStmt->tableName = parseSqlTableName();
+        if (match(TokenType::KEYWORD_WHERE)) {
+            deleteStmt->whereCondition = parseSqlCondition();
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after DELETE statement");
+        return deleteStmt;
+    }
+    else if (match(TokenType::KEYWORD_UPDATE)) {
+        auto updateStmt = std::make_unique<UpdateStatementNode>();
+        updateStmt->tableName = parseSqlTableName();
+        consume(TokenType::KEYWORD_SET, "Expected 'SET' after the table name in UPDATE statement");
+        do {
+            updateStmt->columns.push_back(consume(TokenType::IDENTIFIER, "Expected column name in SET clause").text);
+            consume(TokenType::EQUAL, "Expected '=' after column name in SET clause");
+            updateStmt->values.push_back(parseSqlCondition());
+        } while (match(TokenType::COMMA));
+        if (match(TokenType::KEYWORD_WHERE)) {
+            updateStmt->whereCondition = parseSqlCondition();
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after UPDATE statement");
+        return updateStmt;
+    }
+    else if (match(TokenType::KEYWORD_INSERT)) {
+        auto insertStmt = std::make_unique<InsertStatementNode>();
+        if (!match("INTO")) {
+            throw std::runtime_error("Expected 'INTO' after 'INSERT'");
+        }
+        insertStmt->tableName = parseSqlTableName();
+        if (match(TokenType::LPAREN)) {
+            do {
+                insertStmt->columns.push_back(consume(TokenType::IDENTIFIER, "Expected column name in INSERT column list").text);
+            } while (match(TokenType::COMMA));
+            consume(TokenType::RPAREN, "Expected ')' after INSERT column list");
+        }
+        if (peek().type == TokenType::KEYWORD_SELECT) {
+            insertStmt->query = parseSelect();
+        }
+        else {
+            // SAS repeats VALUES for every row, the SQL standard separates them with commas
+            if (!match("VALUES")) {
+                throw std::runtime_error("Expected VALUES or SELECT in INSERT statement");
+            }
+            do {
+                auto& row = insertStmt->rows.emplace_back();
+                consume(TokenType::LPAREN, "Expected '(' after VALUES");
+                do {
+                    row.push_back(parseSqlCondition());
+                } while (match(TokenType::COMMA));
+                consume(TokenType::RPAREN, "Expected ')' after the values of VALUES");
+            } while (match("VALUES") || match(TokenType::COMMA));
+        }
+        consume(TokenType::SEMICOLON, "Expected ';' after INSERT statement");
+        return insertStmt;
+    }
     else {
         // Unsupported SQL statement
         return nullptr;
     }
 }
 
+std::string Parser::parseSqlTableName() {
+    // LIBREF.TABLE, WORK when no libref is given; no dataset options, a
+    // '(' after the name starts a column list
+    DatasetRefNode table;
+    table.dataName = to_upper(consume(TokenType::IDENTIFIER, "Expected table name").text);
+    if (match(TokenType::DOT)) {
+        table.libref = table.dataName;
+        table.dataName = to_upper(consume(TokenType::IDENTIFIER, "Expected table name after '.'").text);
+    }
+    return table.getFullDsName();
+}
+
+std::unique_ptr<ASTNode> Parser::parseSqlCondition() {
+    // an expression of a SQL statement other than SELECT: = compares
+    bool outerConditions = sqlConditions;
+    sqlConditions = true;
+    auto expr = parseExpression();
+    sqlConditions = outerConditions;
+    return expr;
+}
+
+std::unique_ptr<SelectStatementNode> Parser::parseSelect() {
+    // SELECT ... up to, not including, the ';' or the ')' of a subquery.
+    // A subquery is parsed within a condition of its outer query, whose
+    // state is restored at the end.
+    bool outerAggregates = sqlAggregates, outerConditions = sqlConditions;
+    auto selectStmt = std::make_unique<SelectStatementNode>();
+    consume(TokenType::KEYWORD_SELECT, "Expected 'SELECT' keyword");
+
+    // Parse selected columns: expressions, each with an optional AS alias
+    sqlAggregates = true;
+    sqlConditions = true;
+    while (true) {
+        auto expr = parseExpression();
+        std::string name;
+        if (match(TokenType::KEYWORD_AS)) {
+            name = consume(TokenType::IDENTIFIER, "Expected column alias after 'AS'").text;
+        }
+        else if (auto var = dynamic_cast<VariableNode*>(expr.get())) {
+            name = var->varName;
+        }
+        else {
+            // SAS names the columns it computes without an alias _TEMA001, _TEMA002, ...
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), "_TEMA%03d", (int)selectStmt->selectColumns.size() + 1);
+            name = buf;
+        }
+        selectStmt->selectColumns.push_back(name);
+        selectStmt->selectExpressions.push_back(std::move(expr));
+
+        if (!match(TokenType::COMMA)) {
+            break;
+        }
+    }
+    sqlAggregates = false;
+
+    // Parse FROM clause
+    consume(TokenType::KEYWORD_FROM, "Expected 'FROM' keyword in SELECT statement");
+    while (true) {
+        // as LIBREF.TABLE, WORK when no libref is given
+        selectStmt->fromTables.push_back(parseDatasetName()->getFullDsName());
+
+        if (!match(TokenType::COMMA)) {
+            break;
+        }
+    }
+
+    // Parse optional WHERE clause
+    if (match(TokenType::KEYWORD_WHERE)) {
+        selectStmt->whereCondition = parseExpression(); // Parse condition expression
+    }
+
+    // Parse optional GROUP BY clause
+    if (match(TokenType::KEYWORD_GROUP)) {
+        consume(TokenType::KEYWORD_BY, "Expected 'BY' keyword after 'GROUP'");
+        while (true) {
+            Token groupVarToken = consume(TokenType::IDENTIFIER, "Expected column name in GROUP BY clause");
+            selectStmt->groupByColumns.push_back(groupVarToken.text);
+
+            if (!match(TokenType::COMMA)) {
+                break;
+            }
+        }
+    }
+
+    // Parse optional HAVING clause
+    if (match(TokenType::KEYWORD_HAVING)) {
+        sqlAggregates = true;
+        selectStmt->havingCondition = parseExpression(); // Parse HAVING condition expression
+        sqlAggregates = false;
+    }
+
+    // Parse optional ORDER BY clause
+    if (match(TokenType::KEYWORD_ORDER)) {
+        consume(TokenType::KEYWORD_BY, "Expected 'BY' keyword after 'ORDER'");
+        while (true) {
+            Token orderVarToken = consume(TokenType::IDENTIFIER, "Expected column name in ORDER BY clause");
+            selectStmt->orderByColumns.push_back(orderVarToken.text);
+
+            if (!match(TokenType::COMMA)) {
+                break;
+            }
+        }
+    }
+
+    sqlAggregates = outerAggregates;
+    sqlConditions = outerConditions;
+    return selectStmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseSqlIn(std::unique_ptr<ASTNode> operand) {
+    // <operand> [NOT] IN (<subquery>) or [NOT] IN (<value>, ...)
+    auto node = std::make_unique<SqlInNode>();
+    node->operand = std::move(operand);
+    node->negated = match(TokenType::NOT);
+    advance(); // IN
+    consume(TokenType::LPAREN, "Expected '(' after IN");
+    if (peek().type == TokenType::KEYWORD_SELECT) {
+        node->subquery = parseSelect();
+    }
+    else {
+        while (true) {
+            node->values.push_back(parseExpression());
+            if (!match(TokenType::COMMA)) {
+                break;
+            }
+        }
+    }
+    consume(TokenType::RPAREN, "Expected ')' after IN list");
+    return node;
+}
+
+std::unique_ptr<ASTNode> Parser::parseSqlExists() {
+    // [NOT] EXISTS (<subquery>)
+    auto node = std::make_unique<SqlExistsNode>();
+    node->negated = match(TokenType::NOT);
+    advance(); // EXISTS
+    consume(TokenType::LPAREN, "Expected '(' after EXISTS");
+    node->subquery = parseSelect();
+    consume(TokenType::RPAREN, "Expected ')' after EXISTS subquery");
+    return node;
+}
+
+std::unique_ptr<ASTNode> Parser::parseSqlAggregate() {
+    // COUNT(*), COUNT([DISTINCT] <expr>), SUM/AVG/MEAN/MIN/MAX([DISTINCT] <expr>)
+    auto node = std::make_unique<SqlAggregateNode>();
+    node->function = to_upper(advance().text);
+    if (node->function == "MEAN") {
+        node->function = "AVG";
+    }
+    consume(TokenType::LPAREN, "Expected '(' after " + node->function);
+    if (match(TokenType::STAR)) {
+        if (node->function != "COUNT") {
+            throw std::runtime_error(node->function + "(*) is not supported, only COUNT(*).");
+        }
+    }
+    else {
+        // DISTINCT is not a keyword; here it is one unless it is the argument itself
+        if (to_upper(peek().text) == "DISTINCT" && peek(1).type != TokenType::RPAREN) {
+            advance();
+            node->distinct = true;
+        }
+        node->argument = parseExpression();
+    }
+    consume(TokenType::RPAREN, "Expected ')' after the argument of " + node->function);
+    return node;
+}
+
 std::unique_ptr<ASTNode> Parser::parseLetStatement() {
     consume(TokenType::KEYWORD_MACRO_LET, "Expected '%let'");
     std::string varName = consume(TokenType::IDENTIFIER, "Expected macro variable name").text;
@@ -1270,16 +1690,32 @@ std::unique_ptr<ASTNode> Parser::parseLetStatement() {
     return node;
 }
 
+std::unique_ptr<ASTNode> Parser::parseMacroPut() {
+    auto node = std::make_unique<MacroPutNode>();
+    node->text = consume(TokenType::KEYWORD_MACRO_PUT, "Expected '%put'").text;
+    consume(TokenType::SEMICOLON, "Expected ';' after '%put' statement");
+    return node;
+}
+
 std::unique_ptr<ASTNode> Parser::parseMacroDefinition() {
+    // %macro name[(param, ...)]; <body> %mend [name];
     consume(TokenType::KEYWORD_MACRO_MACRO, "Expected '%macro'");
-    std::string macroName = consume(TokenType::IDENTIFIER, "Expected macro name").text;
-    consume(TokenType::LPAREN, "Expected '(' after macro name");
+    // names may be words the lexer knows as keywords, like N or DATA
+    auto name = [this](const std::string& message) {
+        const Token& t = peek();
+        if (t.type != TokenType::STRING && !t.text.empty()
+            && (std::isalpha(static_cast<unsigned char>(t.text[0])) || t.text[0] == '_')) {
+            return advance().text;
+        }
+        return consume(TokenType::IDENTIFIER, message).text;
+    };
+    std::string macroName = name("Expected macro name");
 
     // Parse parameters
     std::vector<std::string> parameters;
-    if (peek().type != TokenType::RPAREN) { // Handle macros with parameters
+    if (match(TokenType::LPAREN) && peek().type != TokenType::RPAREN) { // Handle macros with parameters
         while (true) {
-            parameters.push_back(consume(TokenType::IDENTIFIER, "Expected parameter name").text);
+            parameters.push_back(name("Expected parameter name"));
             if (peek().type == TokenType::COMMA) {
                 consume(TokenType::COMMA, "Expected ',' between parameters");
             }
@@ -1288,45 +1724,57 @@ std::unique_ptr<ASTNode> Parser::parseMacroDefinition() {
             }
         }
     }
-    consume(TokenType::RPAREN, "Expected ')' after parameters");
+    if (!parameters.empty() || peek().type == TokenType::RPAREN) {
+        consume(TokenType::RPAREN, "Expected ')' after parameters");
+    }
+    consume(TokenType::SEMICOLON, "Expected ';' after the parameters of macro " + macroName);
 
     auto macroNode = std::make_unique<MacroDefinitionNode>();
     macroNode->macroName = macroName;
     macroNode->parameters = parameters;
-
-    // Parse macro body
-    while (peek().type != TokenType::KEYWORD_MACRO_MEND && peek().type != TokenType::EOF_TOKEN) {
-        auto stmt = parseStatement();
-        if (stmt.status == ParseStatus::PARSE_SUCCESS) macroNode->body.push_back(std::move(stmt.node));
-    }
+    macroNode->text = consume(TokenType::MACRO_BODY, "Expected the body of macro " + macroName).text;
     consume(TokenType::KEYWORD_MACRO_MEND, "Expected '%mend'");
+    if (peek().type != TokenType::SEMICOLON) {
+        name("Expected ';' after '%mend'");
+    }
     consume(TokenType::SEMICOLON, "Expected ';' after '%mend'");
 
     return macroNode;
 }
 
 std::unique_ptr<ASTNode> Parser::parseMacroCall() {
-    Token macroNameToken = consume(TokenType::IDENTIFIER, "Expected macro name");
+    // %name[(text, ...)]: the arguments are text, split at the commas outside parentheses and quotes
+    Token macroNameToken = consume(TokenType::MACRO_CALL, "Expected macro name");
 
     auto node = std::make_unique<MacroCallNode>();
-    node->macroName = macroNameToken.text;
-
-    if (peek().type == TokenType::LPAREN) {
-        consume(TokenType::LPAREN, "Expected '(' after macro name");
-
-        while (peek().type != TokenType::RPAREN) {
-            auto arg = parseExpression();
-            node->arguments.push_back(std::move(arg));
-
-            if (peek().type == TokenType::COMMA) {
-                consume(TokenType::COMMA, "Expected ',' between arguments");
+    node->macroName = macroNameToken.text.substr(1);
+
+    if (peek().type == TokenType::MACRO_ARGS) {
+        std::string args = advance().text;
+        std::string current;
+        int depth = 0;
+        char quote = 0;
+        for (char c : args) {
+            if (quote) {
+                if (c == quote) quote = 0;
+            }
+            else if (c == '\'' || c == '"') quote = c;
+            else if (c == '(') depth++;
+            else if (c == ')') depth--;
+            else if (c == ',' && depth == 0) {
+                node->arguments.push_back(std::make_unique<StringNode>(current));
+                current.clear();
+                continue;
             }
+            current += c;
+        }
+        if (!current.empty() || !node->arguments.empty()) {
+            node->arguments.push_back(std::make_unique<StringNode>(current));
         }
-
-        consume(TokenType::RPAREN, "Expected ')' after macro arguments");
     }
 
-    consume(TokenType::SEMICOLON, "Expected ';' after macro call");
+    // a macro call needs no ';'
+    match(TokenType::SEMICOLON);
     return node;
 }
 
@@ -1429,6 +1877,7 @@ std::unique_ptr<DatasetRefNode> Parser::parseDatasetName() {
         auto dsNode = std::make_unique<DatasetRefNode>();
         dsNode->libref = to_upper(firstName);
         dsNode->dataName = to_upper(secondName);
+        parseDatasetOptions(dsNode->options);
         return dsNode;
     }
     else {
@@ -1436,10 +1885,43 @@ std::unique_ptr<DatasetRefNode> Parser::parseDatasetName() {
         auto dsNode = std::make_unique<DatasetRefNode>();
         dsNode->libref = "";   // or "WORK" if you default
         dsNode->dataName = to_upper(firstName);
+        parseDatasetOptions(dsNode->options);
         return dsNode;
     }
 }
 
+// dataset_options : LPAREN ( (KEEP|DROP) EQUAL IDENTIFIER+ | (FIRSTOBS|OBS) EQUAL NUMBER )* RPAREN ;
+//
+// e.g. set s.auto(keep=make price firstobs=11 obs=20);
+void Parser::parseDatasetOptions(ReadOptions& options) {
+    if (!match(TokenType::LPAREN)) {
+        return;
+    }
+
+    while (peek().type != TokenType::RPAREN && peek().type != TokenType::EOF_TOKEN) {
+        std::string optName = to_upper(advance().text);
+        consume(TokenType::EQUAL, "Expected '=' after dataset option " + optName);
+
+        if (optName == "KEEP" || optName == "DROP") {
+            auto& names = optName == "KEEP" ? options.keep : options.drop;
+            // variable list runs until the next "name=" or ')'
+            while (peek().type != TokenType::RPAREN && peek().type != TokenType::EOF_TOKEN
+                && peek(1).type != TokenType::EQUAL) {
+                names.push_back(advance().text);
+            }
+        }
+        else if (optName == "FIRSTOBS" || optName == "OBS") {
+            long n = std::stol(consume(TokenType::NUMBER, "Expected a number after " + optName + "=").text);
+            if (optName == "FIRSTOBS") options.firstObs = n;
+            else options.obs = n;
+        }
+        else {
+            throw std::runtime_error("Unsupported dataset option: " + optName);
+        }
+    }
+    consume(TokenType::RPAREN, "Expected ')' after dataset options");
+}
+
 std::unique_ptr<ASTNode> Parser::parseSetStatement() {
     // We assume we've already consumed the 'SET' keyword token
     // e.g. if (match(TokenType::KEYWORD_SET)) { parseSetStatement(); }
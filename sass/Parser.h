@@ -4,7 +4,9 @@
 #include "AST.h"
 #include "Lexer.h"
 #include <vector>
+#include <deque>
 #include <memory>
+#include <functional>
 
 namespace sass {
     // An enum to indicate parse status
@@ -24,15 +26,33 @@ namespace sass {
     class Parser {
     public:
         Parser(const std::vector<Token>& tokens);
+        // Pull the tokens from lexer as they are needed: only the few the
+        // parser looks ahead at are held, not the whole program's
+        explicit Parser(Lexer& lexer);
 
         std::unique_ptr<ASTNode> parse();
         std::unique_ptr<ProgramNode> parseProgram(); // To handle multiple global and data statements
         ParseResult parseStatement();
+        // The next statement of the program, nullptr at its end. Statements
+        // that fail to parse are reported and skipped, as parseProgram() does.
+        std::unique_ptr<ASTNode> parseNext();
+
+        // Statements parseProgram() skipped after a parse error
+        size_t getErrorCount() const { return errorCount; }
+        // Where the messages of those errors go, instead of std::cerr
+        void setErrorHandler(std::function<void(const std::string&)> handler) { onError = std::move(handler); }
 
     private:
-        const std::vector<Token>& tokens;
+        const std::vector<Token>* tokens = nullptr;    // all of them, or
+        Lexer* lexer = nullptr;                         // where they come from
+        std::deque<Token> lookahead;                    // pulled from lexer, not yet consumed
+        bool lexerDone = false;
         size_t pos = 0;
+        size_t errorCount = 0;
+        std::function<void(const std::string&)> onError;
         bool dsHasOuput;
+        bool sqlAggregates = false;     // parsing a SELECT list or HAVING clause
+        bool sqlConditions = false;     // parsing a SELECT: = compares, IN and EXISTS are operators
 
         Token peek(int offset = 0) const;
         Token advance();
@@ -53,6 +73,7 @@ namespace sass {
         std::unique_ptr<ASTNode> parseIfThen();
         std::unique_ptr<ASTNode> parseIfElse();
         std::unique_ptr<ASTNode> parseOutput();
+        std::unique_ptr<ASTNode> parseCall();
         std::unique_ptr<ASTNode> parseDrop();
         std::unique_ptr<ASTNode> parseKeep();
         std::unique_ptr<ASTNode> parseRetain();
@@ -66,12 +87,21 @@ namespace sass {
         std::unique_ptr<ASTNode> parseDoLoop();
         std::unique_ptr<ASTNode> parseProcSort();
         std::unique_ptr<ASTNode> parseProcMeans();
+        std::unique_ptr<ASTNode> parseProcUnivariate();
+        std::unique_ptr<ASTNode> parseProcRank();
         std::unique_ptr<ASTNode> parseProcFreq();
         std::unique_ptr<ProcPrintNode> parseProcPrintStatement();
         std::unique_ptr<ASTNode> parseProcPrint();
         std::unique_ptr<ASTNode> parseProcSQL();
         std::unique_ptr<SQLStatementNode> parseSQLStatement();
+        std::unique_ptr<SelectStatementNode> parseSelect();
+        std::string parseSqlTableName();
+        std::unique_ptr<ASTNode> parseSqlCondition();
+        std::unique_ptr<ASTNode> parseSqlAggregate();
+        std::unique_ptr<ASTNode> parseSqlIn(std::unique_ptr<ASTNode> operand);
+        std::unique_ptr<ASTNode> parseSqlExists();
         std::unique_ptr<ASTNode> parseLetStatement();
+        std::unique_ptr<ASTNode> parseMacroPut();
         std::unique_ptr<ASTNode> parseMacroDefinition();
         std::unique_ptr<ASTNode> parseMacroCall();
 
@@ -80,6 +110,7 @@ namespace sass {
         std::unique_ptr<ASTNode> parseDatalines();
 
         std::unique_ptr<DatasetRefNode> parseDatasetName();
+        void parseDatasetOptions(ReadOptions& options);
 
         std::unique_ptr<ASTNode> parseSetStatement();
 
@@ -0,0 +1,616 @@
+#include "ProgramCache.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "utility.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <typeinfo>
+
+namespace fs = std::filesystem;
+
+namespace sass {
+
+    namespace {
+        // second hash of the source stored in an entry, with another seed than the key
+        uint64_t sourceCheck(const std::string& source) {
+            return Fnv1a(0x9e3779b97f4a7c15ull).add(source).hash;
+        }
+
+        const char magic[] = "SASSAST\n";
+
+        // One tag per node type, written before the node's fields
+        enum class NodeTag : uint8_t {
+            Null = 0, Expression, DatasetRef, SetStatement, DataStep, Assignment, Literal, Number,
+            String, Variable, BinaryOp, IfThen, Output, Options, Libname, Title, Program,
+            FunctionCall, Proc, Drop, Keep, Retain, Array, ArrayElement, Do, EndDo, ProcSort,
+            ProcMeans, IfElse, IfElseIf, Block, ByStatement, MergeStatement, DoLoop, End,
+            ProcFreq, ProcPrint, SQLStatement, ProcSQL, Select, CreateTable,
+            MacroVariableAssignment, MacroDefinition, MacroCall, Input, Datalines, ProcUnivariate,
+            ProcRank, SqlAggregate, SqlIn, SqlExists, DeleteStatement, UpdateStatement, InsertStatement,
+            CallRoutine, MacroPut
+        };
+
+        class Writer {
+        public:
+            std::string out;
+
+            void u8(uint8_t v) { out.push_back((char)v); }
+            void u64(uint64_t v) { out.append((const char*)&v, sizeof(v)); }
+            void i64(int64_t v) { out.append((const char*)&v, sizeof(v)); }
+            void f64(double v) { out.append((const char*)&v, sizeof(v)); }
+            void boolean(bool v) { u8(v ? 1 : 0); }
+            void str(const std::string& s) { u64(s.size()); out.append(s); }
+            void strs(const std::vector<std::string>& v) {
+                u64(v.size());
+                for (auto& s : v) str(s);
+            }
+            void strMap(const std::unordered_map<std::string, std::string>& m) {
+                u64(m.size());
+                for (auto& kv : m) { str(kv.first); str(kv.second); }
+            }
+            void dsRef(const DatasetRefNode& ds) {
+                str(ds.libref);
+                str(ds.dataName);
+                strs(ds.options.keep);
+                strs(ds.options.drop);
+                i64(ds.options.firstObs);
+                i64(ds.options.obs);
+            }
+            void dsRefs(const std::vector<DatasetRefNode>& v) {
+                u64(v.size());
+                for (auto& ds : v) dsRef(ds);
+            }
+            template <typename T>
+            void nodes(const std::vector<std::unique_ptr<T>>& v) {
+                u64(v.size());
+                for (auto& n : v) node(n.get());
+            }
+
+            void node(const ASTNode* n) {
+                if (!n) { tag(NodeTag::Null); return; }
+                if (auto p = dynamic_cast<const DatasetRefNode*>(n)) { tag(NodeTag::DatasetRef); dsRef(*p); }
+                else if (auto p = dynamic_cast<const SetStatementNode*>(n)) { tag(NodeTag::SetStatement); dsRefs(p->dataSets); }
+                else if (auto p = dynamic_cast<const DataStepNode*>(n)) {
+                    tag(NodeTag::DataStep);
+                    dsRef(p->outputDataSet); dsRef(p->inputDataSet);
+                    nodes(p->statements); dsRefs(p->inputDataSets); boolean(p->hasOutput);
+                }
+                else if (auto p = dynamic_cast<const AssignmentNode*>(n)) { tag(NodeTag::Assignment); str(p->varName); node(p->expression.get()); }
+                else if (auto p = dynamic_cast<const LiteralNode*>(n)) { tag(NodeTag::Literal); str(p->value); }
+                else if (auto p = dynamic_cast<const NumberNode*>(n)) { tag(NodeTag::Number); f64(p->value); }
+                else if (auto p = dynamic_cast<const StringNode*>(n)) { tag(NodeTag::String); str(p->value); }
+                else if (auto p = dynamic_cast<const VariableNode*>(n)) { tag(NodeTag::Variable); str(p->varName); }
+                else if (auto p = dynamic_cast<const BinaryOpNode*>(n)) { tag(NodeTag::BinaryOp); node(p->left.get()); node(p->right.get()); str(p->op); }
+                else if (auto p = dynamic_cast<const IfThenNode*>(n)) { tag(NodeTag::IfThen); node(p->condition.get()); nodes(p->thenStatements); }
+                else if (auto p = dynamic_cast<const OutputNode*>(n)) { tag(NodeTag::Output); dsRefs(p->outDatasets); }
+                else if (auto p = dynamic_cast<const CallRoutineNode*>(n)) { tag(NodeTag::CallRoutine); str(p->routine); nodes(p->arguments); }
+                else if (auto p = dynamic_cast<const OptionsNode*>(n)) {
+                    tag(NodeTag::Options);
+                    u64(p->options.size());
+                    for (auto& kv : p->options) { str(kv.first); str(kv.second); }
+                }
+                else if (auto p = dynamic_cast<const LibnameNode*>(n)) {
+                    tag(NodeTag::Libname);
+                    str(p->libref); str(p->engine); str(p->path); u8((uint8_t)p->accessMode);
+                }
+                else if (auto p = dynamic_cast<const TitleNode*>(n)) { tag(NodeTag::Title); str(p->title); }
+                else if (auto p = dynamic_cast<const ProgramNode*>(n)) { tag(NodeTag::Program); nodes(p->statements); }
+                else if (auto p = dynamic_cast<const FunctionCallNode*>(n)) { tag(NodeTag::FunctionCall); str(p->functionName); nodes(p->arguments); }
+                else if (auto p = dynamic_cast<const ProcPrintNode*>(n)) {
+                    tag(NodeTag::ProcPrint);
+                    str(p->procName); str(p->datasetName);
+                    dsRef(p->inputDataSet); strs(p->varVariables); strMap(p->options);
+                }
+                else if (auto p = dynamic_cast<const ProcUnivariateNode*>(n)) {
+                    tag(NodeTag::ProcUnivariate);
+                    str(p->procName); str(p->datasetName);
+                    dsRef(p->inputDataSet); strMap(p->options); strs(p->varVariables);
+                    strs(p->histogramVariables); boolean(p->histogram); strMap(p->histogramOptions);
+                    dsRef(p->outputDataSet);
+                    u64(p->outputStatistics.size());
+                    for (auto& stat : p->outputStatistics) { str(stat.first); strs(stat.second); }
+                }
+                else if (auto p = dynamic_cast<const ProcRankNode*>(n)) {
+                    tag(NodeTag::ProcRank);
+                    str(p->procName); str(p->datasetName);
+                    dsRef(p->inputDataSet); dsRef(p->outputDataSet); strMap(p->options);
+                    strs(p->varVariables); strs(p->rankVariables); strs(p->byVariables);
+                }
+                else if (auto p = dynamic_cast<const ProcFreqNode*>(n)) {
+                    tag(NodeTag::ProcFreq);
+                    dsRef(p->inputDataSet);
+                    u64(p->tables.size());
+                    for (auto& t : p->tables) { str(t.first); strs(t.second); }
+                    node(p->whereCondition.get()); strs(p->options);
+                }
+                else if (auto p = dynamic_cast<const ProcSortNode*>(n)) {
+                    tag(NodeTag::ProcSort);
+                    dsRef(p->inputDataSet); dsRef(p->outputDataSet); strs(p->byVariables);
+                    node(p->whereCondition.get()); boolean(p->nodupkey); boolean(p->duplicates);
+                }
+                else if (auto p = dynamic_cast<const ProcMeansNode*>(n)) {
+                    tag(NodeTag::ProcMeans);
+                    dsRef(p->inputDataSet); strs(p->statistics); strs(p->varVariables);
+                    dsRef(p->outputDataSet); strMap(p->outputOptions); node(p->whereCondition.get());
+                }
+                else if (auto p = dynamic_cast<const ProcSQLNode*>(n)) { tag(NodeTag::ProcSQL); strMap(p->options); nodes(p->statements); }
+                else if (auto p = dynamic_cast<const ProcNode*>(n)) { tag(NodeTag::Proc); str(p->procName); str(p->datasetName); }
+                else if (auto p = dynamic_cast<const DropNode*>(n)) { tag(NodeTag::Drop); strs(p->variables); }
+                else if (auto p = dynamic_cast<const KeepNode*>(n)) { tag(NodeTag::Keep); strs(p->variables); }
+                else if (auto p = dynamic_cast<const RetainNode*>(n)) { tag(NodeTag::Retain); strs(p->variables); }
+                else if (auto p = dynamic_cast<const ArrayNode*>(n)) { tag(NodeTag::Array); str(p->arrayName); i64(p->size); strs(p->variables); }
+                else if (auto p = dynamic_cast<const ArrayElementNode*>(n)) { tag(NodeTag::ArrayElement); str(p->arrayName); node(p->index.get()); }
+                else if (auto p = dynamic_cast<const DoNode*>(n)) {
+                    tag(NodeTag::Do);
+                    str(p->loopVar); node(p->startExpr.get()); node(p->endExpr.get()); node(p->incrementExpr.get());
+                    nodes(p->statements);
+                }
+                else if (dynamic_cast<const EndDoNode*>(n)) { tag(NodeTag::EndDo); }
+                else if (auto p = dynamic_cast<const IfElseNode*>(n)) {
+                    tag(NodeTag::IfElse);
+                    node(p->condition.get()); nodes(p->thenStatements); nodes(p->elseStatements);
+                }
+                else if (auto p = dynamic_cast<const IfElseIfNode*>(n)) {
+                    tag(NodeTag::IfElseIf);
+                    node(p->condition.get()); nodes(p->thenStatements);
+                    u64(p->elseIfBranches.size());
+                    for (auto& branch : p->elseIfBranches) { node(branch.first.get()); nodes(branch.second); }
+                    nodes(p->elseStatements);
+                }
+                else if (auto p = dynamic_cast<const BlockNode*>(n)) { tag(NodeTag::Block); nodes(p->statements); }
+                else if (auto p = dynamic_cast<const ByStatementNode*>(n)) { tag(NodeTag::ByStatement); strs(p->variables); }
+                else if (auto p = dynamic_cast<const MergeStatementNode*>(n)) { tag(NodeTag::MergeStatement); dsRefs(p->datasets); }
+                else if (auto p = dynamic_cast<const DoLoopNode*>(n)) {
+                    tag(NodeTag::DoLoop);
+                    node(p->condition.get()); node(p->body.get()); boolean(p->isWhile);
+                }
+                else if (dynamic_cast<const EndNode*>(n)) { tag(NodeTag::End); }
+                else if (auto p = dynamic_cast<const SelectStatementNode*>(n)) {
+                    tag(NodeTag::Select);
+                    strs(p->selectColumns); nodes(p->selectExpressions); strs(p->fromTables); node(p->whereCondition.get());
+                    strs(p->groupByColumns); node(p->havingCondition.get()); strs(p->orderByColumns);
+                }
+                else if (auto p = dynamic_cast<const SqlAggregateNode*>(n)) {
+                    tag(NodeTag::SqlAggregate); str(p->function); boolean(p->distinct); node(p->argument.get());
+                }
+                else if (auto p = dynamic_cast<const SqlInNode*>(n)) {
+                    tag(NodeTag::SqlIn); node(p->operand.get()); node(p->subquery.get()); nodes(p->values); boolean(p->negated);
+                }
+                else if (auto p = dynamic_cast<const SqlExistsNode*>(n)) {
+                    tag(NodeTag::SqlExists); node(p->subquery.get()); boolean(p->negated);
+                }
+                else if (auto p = dynamic_cast<const CreateTableStatementNode*>(n)) { tag(NodeTag::CreateTable); str(p->tableName); strs(p->columns); node(p->asSelect.get()); }
+                else if (auto p = dynamic_cast<const DeleteStatementNode*>(n)) {
+                    tag(NodeTag::DeleteStatement); str(p->tableName); node(p->whereCondition.get());
+                }
+                else if (auto p = dynamic_cast<const UpdateStatementNode*>(n)) {
+                    tag(NodeTag::UpdateStatement); str(p->tableName); strs(p->columns); nodes(p->values); node(p->whereCondition.get());
+                }
+                else if (auto p = dynamic_cast<const InsertStatementNode*>(n)) {
+                    tag(NodeTag::InsertStatement); str(p->tableName); strs(p->columns);
+                    u64(p->rows.size());
+                    for (auto& row : p->rows) nodes(row);
+                    node(p->query.get());
+                }
+                else if (dynamic_cast<const SQLStatementNode*>(n)) { tag(NodeTag::SQLStatement); }
+                else if (auto p = dynamic_cast<const MacroVariableAssignmentNode*>(n)) { tag(NodeTag::MacroVariableAssignment); str(p->varName); str(p->value); }
+                else if (auto p = dynamic_cast<const MacroPutNode*>(n)) { tag(NodeTag::MacroPut); str(p->text); }
+                else if (auto p = dynamic_cast<const MacroDefinitionNode*>(n)) { tag(NodeTag::MacroDefinition); str(p->macroName); strs(p->parameters); str(p->text); }
+                else if (auto p = dynamic_cast<const MacroCallNode*>(n)) { tag(NodeTag::MacroCall); str(p->macroName); nodes(p->arguments); }
+                else if (auto p = dynamic_cast<const InputNode*>(n)) {
+                    tag(NodeTag::Input);
+                    u64(p->variables.size());
+                    for (auto& v : p->variables) { str(v.first); boolean(v.second); }
+                }
+                else if (auto p = dynamic_cast<const DatalinesNode*>(n)) { tag(NodeTag::Datalines); strs(p->lines); }
+                else if (dynamic_cast<const ExpressionNode*>(n)) { tag(NodeTag::Expression); }
+                else {
+                    throw std::runtime_error(std::string("Cannot cache AST node ") + typeid(*n).name());
+                }
+            }
+
+        private:
+            void tag(NodeTag t) { u8((uint8_t)t); }
+        };
+
+        class Reader {
+        public:
+            Reader(const std::string& in, size_t pos) : in(in), pos(pos) {}
+
+            bool atEnd() const { return pos == in.size(); }
+
+            uint8_t u8() { need(1); return (uint8_t)in[pos++]; }
+            uint64_t u64() { uint64_t v; raw(&v, sizeof(v)); return v; }
+            int64_t i64() { int64_t v; raw(&v, sizeof(v)); return v; }
+            double f64() { double v; raw(&v, sizeof(v)); return v; }
+            bool boolean() { return u8() != 0; }
+            std::string str() {
+                size_t n = count();
+                need(n);
+                std::string s = in.substr(pos, n);
+                pos += n;
+                return s;
+            }
+            std::vector<std::string> strs() {
+                std::vector<std::string> v(count());
+                for (auto& s : v) s = str();
+                return v;
+            }
+            std::unordered_map<std::string, std::string> strMap() {
+                std::unordered_map<std::string, std::string> m;
+                for (size_t i = count(); i > 0; i--) {
+                    std::string k = str();
+                    m[k] = str();
+                }
+                return m;
+            }
+            DatasetRefNode dsRef() {
+                DatasetRefNode ds;
+                ds.libref = str();
+                ds.dataName = str();
+                ds.options.keep = strs();
+                ds.options.drop = strs();
+                ds.options.firstObs = (long)i64();
+                ds.options.obs = (long)i64();
+                return ds;
+            }
+            std::vector<DatasetRefNode> dsRefs() {
+                std::vector<DatasetRefNode> v;
+                for (size_t i = count(); i > 0; i--) v.push_back(dsRef());
+                return v;
+            }
+            template <typename T>
+            std::vector<std::unique_ptr<T>> nodes() {
+                std::vector<std::unique_ptr<T>> v;
+                for (size_t i = count(); i > 0; i--) v.push_back(nodeAs<T>());
+                return v;
+            }
+            template <typename T>
+            std::unique_ptr<T> nodeAs() {
+                auto n = node();
+                if (!n) return nullptr;
+                auto p = dynamic_cast<T*>(n.get());
+                if (!p) throw std::runtime_error("Unexpected node type in cached program");
+                n.release();
+                return std::unique_ptr<T>(p);
+            }
+
+            std::unique_ptr<ASTNode> node() {
+                NodeTag t = (NodeTag)u8();
+                switch (t) {
+                case NodeTag::Null: return nullptr;
+                case NodeTag::Expression: return std::make_unique<ExpressionNode>();
+                case NodeTag::DatasetRef: return std::make_unique<DatasetRefNode>(dsRef());
+                case NodeTag::SetStatement: { auto p = std::make_unique<SetStatementNode>(); p->dataSets = dsRefs(); return p; }
+                case NodeTag::DataStep: {
+                    auto p = std::make_unique<DataStepNode>();
+                    p->outputDataSet = dsRef(); p->inputDataSet = dsRef();
+                    p->statements = nodes<ASTNode>(); p->inputDataSets = dsRefs(); p->hasOutput = boolean();
+                    return p;
+                }
+                case NodeTag::Assignment: { auto p = std::make_unique<AssignmentNode>(); p->varName = str(); p->expression = node(); return p; }
+                case NodeTag::Literal: { auto p = std::make_unique<LiteralNode>(); p->value = str(); return p; }
+                case NodeTag::Number: return std::make_unique<NumberNode>(f64());
+                case NodeTag::String: return std::make_unique<StringNode>(str());
+                case NodeTag::Variable: return std::make_unique<VariableNode>(str());
+                case NodeTag::BinaryOp: {
+                    auto p = std::make_unique<BinaryOpNode>();
+                    p->left = node(); p->right = node(); p->op = str();
+                    return p;
+                }
+                case NodeTag::IfThen: { auto p = std::make_unique<IfThenNode>(); p->condition = node(); p->thenStatements = nodes<ASTNode>(); return p; }
+                case NodeTag::Output: { auto p = std::make_unique<OutputNode>(); p->outDatasets = dsRefs(); return p; }
+                case NodeTag::CallRoutine: { auto p = std::make_unique<CallRoutineNode>(); p->routine = str(); p->arguments = nodes<ASTNode>(); return p; }
+                case NodeTag::Options: {
+                    auto p = std::make_unique<OptionsNode>();
+                    for (size_t i = count(); i > 0; i--) {
+                        std::string k = str();
+                        p->options.emplace_back(k, str());
+                    }
+                    return p;
+                }
+                case NodeTag::Libname: {
+                    auto p = std::make_unique<LibnameNode>();
+                    p->libref = str(); p->engine = str(); p->path = str(); p->accessMode = (LibraryAccess)u8();
+                    return p;
+                }
+                case NodeTag::Title: { auto p = std::make_unique<TitleNode>(); p->title = str(); return p; }
+                case NodeTag::Program: { auto p = std::make_unique<ProgramNode>(); p->statements = nodes<ASTNode>(); return p; }
+                case NodeTag::FunctionCall: { auto p = std::make_unique<FunctionCallNode>(); p->functionName = str(); p->arguments = nodes<ASTNode>(); return p; }
+                case NodeTag::Proc: { auto p = std::make_unique<ProcNode>(); p->procName = str(); p->datasetName = str(); return p; }
+                case NodeTag::ProcPrint: {
+                    auto p = std::make_unique<ProcPrintNode>();
+                    p->procName = str(); p->datasetName = str();
+                    p->inputDataSet = dsRef(); p->varVariables = strs(); p->options = strMap();
+                    return p;
+                }
+                case NodeTag::Drop: { auto p = std::make_unique<DropNode>(); p->variables = strs(); return p; }
+                case NodeTag::Keep: { auto p = std::make_unique<KeepNode>(); p->variables = strs(); return p; }
+                case NodeTag::Retain: { auto p = std::make_unique<RetainNode>(); p->variables = strs(); return p; }
+                case NodeTag::Array: {
+                    auto p = std::make_unique<ArrayNode>();
+                    p->arrayName = str(); p->size = (int)i64(); p->variables = strs();
+                    return p;
+                }
+                case NodeTag::ArrayElement: { auto p = std::make_unique<ArrayElementNode>(); p->arrayName = str(); p->index = node(); return p; }
+                case NodeTag::Do: {
+                    auto p = std::make_unique<DoNode>();
+                    p->loopVar = str(); p->startExpr = node(); p->endExpr = node(); p->incrementExpr = node();
+                    p->statements = nodes<ASTNode>();
+                    return p;
+                }
+                case NodeTag::EndDo: return std::make_unique<EndDoNode>();
+                case NodeTag::ProcSort: {
+                    auto p = std::make_unique<ProcSortNode>();
+                    p->inputDataSet = dsRef(); p->outputDataSet = dsRef(); p->byVariables = strs();
+                    p->whereCondition = node(); p->nodupkey = boolean(); p->duplicates = boolean();
+                    return p;
+                }
+                case NodeTag::ProcMeans: {
+                    auto p = std::make_unique<ProcMeansNode>();
+                    p->inputDataSet = dsRef(); p->statistics = strs(); p->varVariables = strs();
+                    p->outputDataSet = dsRef(); p->outputOptions = strMap(); p->whereCondition = node();
+                    return p;
+                }
+                case NodeTag::IfElse: {
+                    auto p = std::make_unique<IfElseNode>();
+                    p->condition = node(); p->thenStatements = nodes<ASTNode>(); p->elseStatements = nodes<ASTNode>();
+                    return p;
+                }
+                case NodeTag::IfElseIf: {
+                    auto p = std::make_unique<IfElseIfNode>();
+                    p->condition = node(); p->thenStatements = nodes<ASTNode>();
+                    for (size_t i = count(); i > 0; i--) {
+                        auto condition = node();
+                        p->elseIfBranches.emplace_back(std::move(condition), nodes<ASTNode>());
+                    }
+                    p->elseStatements = nodes<ASTNode>();
+                    return p;
+                }
+                case NodeTag::Block: { auto p = std::make_unique<BlockNode>(); p->statements = nodes<ASTNode>(); return p; }
+                case NodeTag::ByStatement: { auto p = std::make_unique<ByStatementNode>(); p->variables = strs(); return p; }
+                case NodeTag::MergeStatement: { auto p = std::make_unique<MergeStatementNode>(); p->datasets = dsRefs(); return p; }
+                case NodeTag::DoLoop: {
+                    auto p = std::make_unique<DoLoopNode>();
+                    p->condition = node(); p->body = nodeAs<BlockNode>(); p->isWhile = boolean();
+                    return p;
+                }
+                case NodeTag::End: return std::make_unique<EndNode>();
+                case NodeTag::ProcFreq: {
+                    auto p = std::make_unique<ProcFreqNode>();
+                    p->inputDataSet = dsRef();
+                    for (size_t i = count(); i > 0; i--) {
+                        std::string table = str();
+                        p->tables.emplace_back(table, strs());
+                    }
+                    p->whereCondition = node(); p->options = strs();
+                    return p;
+                }
+                case NodeTag::SQLStatement: return std::make_unique<SQLStatementNode>();
+                case NodeTag::ProcSQL: { auto p = std::make_unique<ProcSQLNode>(); p->options = strMap(); p->statements = nodes<SQLStatementNode>(); return p; }
+                case NodeTag::Select: {
+                    auto p = std::make_unique<SelectStatementNode>();
+                    p->selectColumns = strs(); p->selectExpressions = nodes<ASTNode>(); p->fromTables = strs(); p->whereCondition = node();
+                    p->groupByColumns = strs(); p->havingCondition = node(); p->orderByColumns = strs();
+                    return p;
+                }
+                case NodeTag::SqlAggregate: {
+                    auto p = std::make_unique<SqlAggregateNode>();
+                    p->function = str(); p->distinct = boolean(); p->argument = node();
+                    return p;
+                }
+                case NodeTag::SqlIn: {
+                    auto p = std::make_unique<SqlInNode>();
+                    p->operand = node(); p->subquery = nodeAs<SelectStatementNode>(); p->values = nodes<ASTNode>(); p->negated = boolean();
+                    return p;
+                }
+                case NodeTag::SqlExists: {
+                    auto p = std::make_unique<SqlExistsNode>();
+                    p->subquery = nodeAs<SelectStatementNode>(); p->negated = boolean();
+                    return p;
+                }
+                case NodeTag::CreateTable: { auto p = std::make_unique<CreateTableStatementNode>(); p->tableName = str(); p->columns = strs(); p->asSelect = nodeAs<SelectStatementNode>(); return p; }
+                case NodeTag::DeleteStatement: {
+                    auto p = std::make_unique<DeleteStatementNode>();
+                    p->tableName = str(); p->whereCondition = node();
+                    return p;
+                }
+                case NodeTag::UpdateStatement: {
+                    auto p = std::make_unique<UpdateStatementNode>();
+                    p->tableName = str(); p->columns = strs(); p->values = nodes<ASTNode>(); p->whereCondition = node();
+                    return p;
+                }
+                case NodeTag::InsertStatement: {
+                    auto p = std::make_unique<InsertStatementNode>();
+                    p->tableName = str(); p->columns = strs();
+                    p->rows.resize(count());
+                    for (auto& row : p->rows) row = nodes<ASTNode>();
+                    p->query = nodeAs<SelectStatementNode>();
+                    return p;
+                }
+                case NodeTag::MacroVariableAssignment: { auto p = std::make_unique<MacroVariableAssignmentNode>(); p->varName = str(); p->value = str(); return p; }
+                case NodeTag::MacroPut: { auto p = std::make_unique<MacroPutNode>(); p->text = str(); return p; }
+                case NodeTag::MacroDefinition: {
+                    auto p = std::make_unique<MacroDefinitionNode>();
+                    p->macroName = str(); p->parameters = strs(); p->text = str();
+                    return p;
+                }
+                case NodeTag::MacroCall: { auto p = std::make_unique<MacroCallNode>(); p->macroName = str(); p->arguments = nodes<ASTNode>(); return p; }
+                case NodeTag::Input: {
+                    auto p = std::make_unique<InputNode>();
+                    for (size_t i = count(); i > 0; i--) {
+                        std::string name = str();
+                        p->variables.emplace_back(name, boolean());
+                    }
+                    return p;
+                }
+                case NodeTag::Datalines: { auto p = std::make_unique<DatalinesNode>(); p->lines = strs(); return p; }
+                case NodeTag::ProcRank: {
+                    auto p = std::make_unique<ProcRankNode>();
+                    p->procName = str(); p->datasetName = str();
+                    p->inputDataSet = dsRef(); p->outputDataSet = dsRef(); p->options = strMap();
+                    p->varVariables = strs(); p->rankVariables = strs(); p->byVariables = strs();
+                    return p;
+                }
+                case NodeTag::ProcUnivariate: {
+                    auto p = std::make_unique<ProcUnivariateNode>();
+                    p->procName = str(); p->datasetName = str();
+                    p->inputDataSet = dsRef(); p->options = strMap(); p->varVariables = strs();
+                    p->histogramVariables = strs(); p->histogram = boolean(); p->histogramOptions = strMap();
+                    p->outputDataSet = dsRef();
+                    for (size_t i = count(); i > 0; i--) {
+                        std::string keyword = str();
+                        p->outputStatistics.emplace_back(keyword, strs());
+                    }
+                    return p;
+                }
+                }
+                throw std::runtime_error("Unknown node tag in cached program");
+            }
+
+        private:
+            const std::string& in;
+            size_t pos;
+
+            void need(size_t n) const {
+                if (in.size() - pos < n) throw std::runtime_error("Truncated cached program");
+            }
+            void raw(void* out, size_t n) {
+                need(n);
+                std::memcpy(out, in.data() + pos, n);
+                pos += n;
+            }
+            // element counts can never exceed the bytes left, a damaged count fails here
+            size_t count() {
+                uint64_t n = u64();
+                need(n);
+                return (size_t)n;
+            }
+        };
+    }
+
+    ProgramCache::ProgramCache(const std::string& folder) : folder(folder) {
+        std::error_code ec;
+        fs::create_directories(folder, ec);
+    }
+
+    std::string ProgramCache::key(const std::string& source) {
+        return Fnv1a().add(version).add(source).hex();
+    }
+
+    std::string ProgramCache::entryPath(const std::string& source) const {
+        return (fs::path(folder) / (key(source) + ".ast")).string();
+    }
+
+    std::string ProgramCache::serialize(const ProgramNode& program) {
+        Writer w;
+        w.node(&program);
+        return w.out;
+    }
+
+    std::string ProgramCache::serializeNode(const ASTNode& node) {
+        Writer w;
+        w.node(&node);
+        return w.out;
+    }
+
+    std::unique_ptr<ProgramNode> ProgramCache::deserialize(const std::string& bytes) {
+        Reader r(bytes, 0);
+        auto program = r.nodeAs<ProgramNode>();
+        if (!program || !r.atEnd()) {
+            throw std::runtime_error("Damaged cached program");
+        }
+        return program;
+    }
+
+    std::unique_ptr<ProgramNode> ProgramCache::load(const std::string& source) const {
+        std::ifstream in(entryPath(source), std::ios::binary);
+        if (!in) {
+            return nullptr;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        std::string bytes = ss.str();
+
+        // header: magic, version, source length and a second hash of the
+        // source, so a hash collision is not mistaken for a hit
+        std::string header = std::string(magic) + version + "\n";
+        if (bytes.compare(0, header.size(), header) != 0) {
+            return nullptr;
+        }
+        try {
+            Reader r(bytes, header.size());
+            if (r.u64() != source.size() || r.u64() != sourceCheck(source)) {
+                return nullptr;
+            }
+            return deserialize(bytes.substr(header.size() + 16));
+        }
+        catch (const std::runtime_error&) {
+            return nullptr;
+        }
+    }
+
+    bool ProgramCache::store(const std::string& source, const ProgramNode& program) const {
+        std::string body;
+        try {
+            body = serialize(program);
+        }
+        catch (const std::runtime_error&) {
+            return false;
+        }
+        Writer header;
+        header.out = std::string(magic) + version + "\n";
+        header.u64(source.size());
+        header.u64(sourceCheck(source));
+
+        // written under a temporary name and renamed, so concurrent runs never read half an entry
+        static std::atomic<unsigned> counter{ 0 };
+        std::string path = entryPath(source);
+        std::string tmpPath = path + ".tmp" + std::to_string(std::random_device()()) + "_" + std::to_string(counter++);
+        {
+            std::ofstream out(tmpPath, std::ios::binary);
+            if (!out) return false;
+            out << header.out << body;
+            if (!out) return false;
+        }
+        std::error_code ec;
+        fs::rename(tmpPath, path, ec);
+        if (ec) {
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<ProgramNode> ProgramCache::compile(const std::string& source, const ProgramCache* cache, bool* hit) {
+        if (hit) *hit = false;
+        if (cache) {
+            if (auto program = cache->load(source)) {
+                if (hit) *hit = true;
+                return program;
+            }
+        }
+
+        Lexer lexer(source);
+        std::vector<Token> tokens;
+        Token tok;
+        while ((tok = lexer.getNextToken()).type != TokenType::EOF_TOKEN) {
+            tokens.push_back(tok);
+        }
+
+        Parser parser(tokens);
+        auto program = parser.parseProgram();
+        // a program that includes files is parsed every time, they may have changed
+        if (cache && parser.getErrorCount() == 0 && lexer.getIncludedFiles().empty()) {
+            cache->store(source, *program);
+        }
+        return program;
+    }
+
+}
@@ -0,0 +1,56 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "AST.h"
+
+namespace sass {
+
+    // On-disk cache of parsed programs (sass -progcache=dir).
+    //
+    // An entry holds the serialized ProgramNode of one source text and is
+    // named after a hash of the source and the interpreter version, so a
+    // program that was parsed before is read back instead of lexed and
+    // parsed again. Entries of another version are never found; a damaged
+    // entry is treated as a miss.
+    class ProgramCache {
+    public:
+        // Bump whenever the lexer, the parser or AST.h changes what a program parses to
+        static constexpr const char* version = "sass-ast-11";
+
+        explicit ProgramCache(const std::string& folder);
+
+        const std::string& getFolder() const { return folder; }
+
+        // The cached program for source, nullptr on a miss
+        std::unique_ptr<ProgramNode> load(const std::string& source) const;
+
+        // Cache program as the parse of source. Returns false when it cannot
+        // be written or holds a node the cache does not know.
+        bool store(const std::string& source, const ProgramNode& program) const;
+
+        // Lex and parse source, going through cache when it is not null.
+        // Programs with parse errors are not cached, so their errors are
+        // reported again on the next run. hit tells whether the cache was used.
+        static std::unique_ptr<ProgramNode> compile(const std::string& source, const ProgramCache* cache, bool* hit = nullptr);
+
+        // AST <=> bytes
+        static std::string serialize(const ProgramNode& program);
+        static std::unique_ptr<ProgramNode> deserialize(const std::string& bytes);
+        // Any single statement, e.g. to fingerprint a step. Throws for nodes the cache does not know.
+        static std::string serializeNode(const ASTNode& node);
+
+        // Entry key: hex hash of version + source
+        static std::string key(const std::string& source);
+
+    private:
+        std::string folder;
+
+        std::string entryPath(const std::string& source) const;
+    };
+
+}
+
+#endif // PROGRAMCACHE_H
@@ -0,0 +1,100 @@
+#include "Rank.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+namespace sass {
+
+    namespace {
+        bool isMissing(double v) {
+            return std::isnan(v) || v == -INFINITY;
+        }
+    }
+
+    void Ranker::rankValues(std::span<const double> values, std::span<double> ranks, const Options& options) {
+        std::vector<std::pair<double, size_t>> keys;
+        keys.reserve(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            if (isMissing(values[i])) {
+                ranks[i] = -INFINITY;
+            }
+            else {
+                keys.emplace_back(options.descending ? -values[i] : values[i], i);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+
+        // rank tied runs [first, last) of the sorted keys
+        size_t distinct = 0;
+        for (size_t first = 0; first < keys.size();) {
+            size_t last = first + 1;
+            while (last < keys.size() && keys[last].first == keys[first].first) {
+                last++;
+            }
+            distinct++;
+            double rank;
+            switch (options.ties) {
+            case RankTies::Low: rank = (double)(first + 1); break;
+            case RankTies::High: rank = (double)last; break;
+            case RankTies::Dense: rank = (double)distinct; break;
+            default: rank = (first + 1 + last) / 2.0; break;
+            }
+            for (size_t k = first; k < last; k++) {
+                ranks[keys[k].second] = rank;
+            }
+            first = last;
+        }
+
+        if (options.groups > 0 && !keys.empty()) {
+            // GROUPS=k: floor(rank * k / (n + 1)), n counting distinct values under TIES=DENSE
+            double n = (double)(options.ties == RankTies::Dense ? distinct : keys.size());
+            for (auto& key : keys) {
+                double& rank = ranks[key.second];
+                rank = std::floor(rank * options.groups / (n + 1));
+            }
+        }
+    }
+
+    std::vector<std::vector<double>> Ranker::rank(const std::vector<std::vector<double>>& columns,
+        const std::vector<size_t>& groupStarts, const Options& options, unsigned threads) {
+        std::vector<std::vector<double>> ranks(columns.size());
+        for (size_t c = 0; c < columns.size(); c++) {
+            ranks[c].resize(columns[c].size());
+        }
+        size_t groups = groupStarts.empty() ? 0 : groupStarts.size() - 1;
+        size_t tasks = groups * columns.size();
+        if (tasks == 0) {
+            return ranks;
+        }
+
+        // workers take the next (group, column) until none is left; they
+        // write to disjoint row ranges of the rank columns
+        std::atomic<size_t> next{ 0 };
+        auto work = [&]() {
+            for (size_t t; (t = next.fetch_add(1)) < tasks;) {
+                size_t g = t / columns.size(), c = t % columns.size();
+                size_t begin = groupStarts[g], end = groupStarts[g + 1];
+                rankValues(std::span<const double>(columns[c]).subspan(begin, end - begin),
+                    std::span<double>(ranks[c]).subspan(begin, end - begin), options);
+            }
+        };
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // a thread for every 64K rows at most, small inputs stay on this one
+        size_t rows = groupStarts.back() * columns.size();
+        threads = (unsigned)std::min<size_t>({ threads, tasks, rows / 65536 + 1 });
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& w : workers) {
+            w.join();
+        }
+        return ranks;
+    }
+
+}
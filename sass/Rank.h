@@ -0,0 +1,43 @@
+#ifndef RANK_H
+#define RANK_H
+
+#include <vector>
+#include <span>
+#include <cstddef>
+
+namespace sass {
+
+    // TIES= of PROC RANK: the rank tied values share
+    enum class RankTies {
+        Mean,   // mean of the positions they take
+        Low,    // lowest position
+        High,   // highest position
+        Dense   // number of distinct values up to them
+    };
+
+    // The rank computations of PROC RANK. Only (value, row) pairs are sorted,
+    // the dataset keeps its order; ranks are scattered back to the row each
+    // value came from. Missing values (-INFINITY or NaN) get a missing rank,
+    // returned as -INFINITY.
+    class Ranker {
+    public:
+        struct Options {
+            RankTies ties = RankTies::Mean;
+            size_t groups = 0;          // GROUPS=, 0 => plain ranks
+            bool descending = false;
+        };
+
+        // Ranks of values, in ranks (same size)
+        static void rankValues(std::span<const double> values, std::span<double> ranks, const Options& options);
+
+        // Ranks of every column within every BY group, the groups being the
+        // row ranges [groupStarts[g], groupStarts[g + 1]) with the row count
+        // last. Each (group, column) pair is ranked on its own, in parallel.
+        // threads: 0 => as many as the machine has.
+        static std::vector<std::vector<double>> rank(const std::vector<std::vector<double>>& columns,
+            const std::vector<size_t>& groupStarts, const Options& options, unsigned threads = 0);
+    };
+
+}
+
+#endif // RANK_H
@@ -0,0 +1,344 @@
+#include "Server.h"
+#include "Interpreter.h"
+#include "DataEnvironment.h"
+#include "StepPipeline.h"
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/base_sink.h>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace sass {
+
+    namespace {
+        bool writeAll(int fd, const char* data, size_t n) {
+#ifdef _WIN32
+            return false;
+#else
+            while (n > 0) {
+                ssize_t written = ::send(fd, data, n, MSG_NOSIGNAL);
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                data += written;
+                n -= written;
+            }
+            return true;
+#endif
+        }
+
+        bool readExact(int fd, char* data, size_t n) {
+#ifdef _WIN32
+            return false;
+#else
+            while (n > 0) {
+                ssize_t got = ::recv(fd, data, n, 0);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) return false;
+                data += got;
+                n -= got;
+            }
+            return true;
+#endif
+        }
+
+        bool writeFrame(int fd, char type, std::string_view payload) {
+            std::string frame;
+            frame.reserve(payload.size() + 24);
+            frame += type;
+            frame += std::to_string(payload.size());
+            frame += '\n';
+            frame.append(payload);
+            return writeAll(fd, frame.data(), frame.size());
+        }
+
+        bool readFrame(int fd, char& type, std::string& payload) {
+            std::string header;
+            char c;
+            while (true) {
+                if (!readExact(fd, &c, 1)) return false;
+                if (c == '\n') break;
+                header += c;
+                if (header.size() > 24) return false;
+            }
+            if (header.size() < 2) return false;
+            type = header[0];
+            size_t length;
+            try {
+                length = std::stoull(header.substr(1));
+            }
+            catch (...) {
+                return false;
+            }
+            if (length > Server::maxFrameSize) {
+                std::cerr << "[Server] Frame of " << length << " bytes is over the limit of " << Server::maxFrameSize << std::endl;
+                return false;
+            }
+            payload.resize(length);
+            return length == 0 || readExact(fd, payload.data(), length);
+        }
+
+        // Sends every formatted log or listing line to the client as one frame
+        class FrameSink : public spdlog::sinks::base_sink<std::mutex> {
+        public:
+            FrameSink(int fd, std::mutex& fdMutex, char type) : fd(fd), fdMutex(fdMutex), type(type) {}
+
+        protected:
+            void sink_it_(const spdlog::details::log_msg& msg) override {
+                spdlog::memory_buf_t formatted;
+                formatter_->format(msg, formatted);
+                // log and listing share the socket
+                std::lock_guard<std::mutex> lock(fdMutex);
+                writeFrame(fd, type, std::string_view(formatted.data(), formatted.size()));
+            }
+            void flush_() override {}
+
+        private:
+            int fd;
+            std::mutex& fdMutex;
+            char type;
+        };
+
+        // Lex, parse and run code; 0 when every statement ran, 1 otherwise
+        int runProgram(const std::string& code, Interpreter& interpreter, const ProgramCache* cache) {
+            if (!cache) {
+                // the first steps run while the rest is parsed
+                StepPipeline pipeline(std::make_unique<Lexer>(code));
+                return pipeline.run(interpreter) && !interpreter.failed() ? 0 : 1;
+            }
+
+            std::unique_ptr<ProgramNode> program;
+            try {
+                program = ProgramCache::compile(code, cache);
+            }
+            catch (const std::runtime_error& e) {
+                interpreter.logLogger.error("Parsing failed: {}", e.what());
+                return 1;
+            }
+
+            try {
+                interpreter.executeProgram(program);
+            }
+            catch (const std::exception& e) {
+                interpreter.logLogger.error("Execution failed: {}", e.what());
+                return 1;
+            }
+            return interpreter.failed() ? 1 : 0;
+        }
+    }
+
+    Server::Server(const std::string& socketPath, size_t memSize, const std::string& cacheFolder)
+        : socketPath(socketPath), memSize(memSize), registry(std::make_shared<LibraryRegistry>())
+    {
+        if (!cacheFolder.empty()) {
+            cache = std::make_unique<ProgramCache>(cacheFolder);
+        }
+        // libraries and the members read in them outlive the job that loaded them
+        registry->setRetain(true);
+    }
+
+    Server::~Server() {
+        stop();
+        joinWorkers(true);
+    }
+
+    int Server::run() {
+#ifdef _WIN32
+        std::cerr << "[Server] Unix domain sockets are not supported on this platform." << std::endl;
+        return 1;
+#else
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "[Server] Socket path is too long: " << socketPath << std::endl;
+            return 1;
+        }
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        // a socket file left over by a previous server is replaced, anything else is not
+        struct stat st;
+        if (::lstat(socketPath.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                std::cerr << "[Server] " << socketPath << " exists and is not a socket" << std::endl;
+                return 1;
+            }
+            int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            bool live = probe >= 0 && ::connect(probe, (sockaddr*)&addr, sizeof(addr)) == 0;
+            if (probe >= 0) {
+                ::close(probe);
+            }
+            if (live) {
+                std::cerr << "[Server] Another server is listening on " << socketPath << std::endl;
+                return 1;
+            }
+            ::unlink(socketPath.c_str());
+        }
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            std::cerr << "[Server] Cannot create socket: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        // only the user running the server may submit jobs: the socket is made
+        // 0600 before it accepts connections
+        if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) != 0
+            || ::listen(fd, SOMAXCONN) != 0) {
+            std::cerr << "[Server] Cannot listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+            ::close(fd);
+            return 1;
+        }
+        listenFd = fd;
+        if (stopping) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+
+        while (!stopping) {
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            joinWorkers(false);
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            workers.push_back({ std::thread([this, client, done]() {
+                try {
+                    serve(client);
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "[Server] Connection dropped: " << e.what() << std::endl;
+                }
+                catch (...) {
+                    std::cerr << "[Server] Connection dropped" << std::endl;
+                }
+                ::close(client);
+                *done = true;
+            }), done });
+        }
+
+        listenFd = -1;
+        ::close(fd);
+        ::unlink(socketPath.c_str());
+        joinWorkers(true);
+        return 0;
+#endif
+    }
+
+    void Server::stop() {
+        stopping = true;
+#ifndef _WIN32
+        // wakes up accept()
+        int fd = listenFd;
+        if (fd >= 0) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+#endif
+    }
+
+    void Server::joinWorkers(bool all) {
+        for (auto it = workers.begin(); it != workers.end(); ) {
+            if (all || *it->done) {
+                it->thread.join();
+                it = workers.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void Server::serve(int fd) {
+        char type;
+        std::string payload;
+        while (readFrame(fd, type, payload)) {
+            if (type != 'P') {
+                std::cerr << "[Server] Unknown request '" << type << "'" << std::endl;
+                return;
+            }
+            runJob(payload, fd);
+        }
+    }
+
+    int Server::runJob(const std::string& code, int fd) {
+        std::mutex fdMutex;
+        auto logLogger = std::make_shared<spdlog::logger>("log", std::make_shared<FrameSink>(fd, fdMutex, 'L'));
+        auto lstLogger = std::make_shared<spdlog::logger>("lst", std::make_shared<FrameSink>(fd, fdMutex, 'O'));
+        logLogger->set_level(spdlog::level::info);
+        logLogger->set_pattern("%v");
+        lstLogger->set_level(spdlog::level::info);
+        lstLogger->set_pattern("%v");
+
+        int rc;
+        try {
+            // a fresh session: own WORK, options and macro variables, shared libraries
+            DataEnvironment env(registry);
+            if (memSize > 0) {
+                env.memory.setLimit(memSize);
+            }
+            Interpreter interpreter(env, *logLogger, *lstLogger);
+            rc = runProgram(code, interpreter, cache.get());
+        }
+        catch (const std::exception& e) {
+            // the client gets its end of job whatever went wrong
+            logLogger->error("Job failed: {}", e.what());
+            rc = 1;
+        }
+        catch (...) {
+            logLogger->error("Job failed.");
+            rc = 1;
+        }
+
+        std::lock_guard<std::mutex> lock(fdMutex);
+        writeFrame(fd, 'E', std::to_string(rc));
+        return rc;
+    }
+
+    int submitProgram(const std::string& socketPath, const std::string& code, std::ostream& log, std::ostream& lst) {
+#ifdef _WIN32
+        std::cerr << "[Server] Unix domain sockets are not supported on this platform." << std::endl;
+        return -1;
+#else
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(addr.sun_path) || code.size() > Server::maxFrameSize) {
+            return -1;
+        }
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || !writeFrame(fd, 'P', code)) {
+            ::close(fd);
+            return -1;
+        }
+
+        int rc = -1;
+        char type;
+        std::string payload;
+        while (readFrame(fd, type, payload)) {
+            if (type == 'L') {
+                log << payload << std::flush;
+            }
+            else if (type == 'O') {
+                lst << payload << std::flush;
+            }
+            else if (type == 'E') {
+                rc = std::atoi(payload.c_str());
+                break;
+            }
+        }
+        ::close(fd);
+        return rc;
+#endif
+    }
+
+}
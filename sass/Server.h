@@ -0,0 +1,76 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <thread>
+#include <ostream>
+#include "LibraryRegistry.h"
+#include "ProgramCache.h"
+
+namespace sass {
+
+    // Daemon mode: sass -server=/path/to/socket
+    //
+    // Listens on a Unix domain socket and runs every program it receives in
+    // a fresh session (its own DataEnvironment: WORK, options, macro variables),
+    // while the process, the library registry and the members loaded in it
+    // stay warm from one job to the next.
+    //
+    // Both directions use the same frames: <type><length>\n<payload>
+    //   client => server  P  program text
+    //   server => client  L  log text, O  listing text (streamed while the job runs)
+    //                     E  end of job, payload is the return code (0 ok, 1 a statement failed)
+    // A connection may submit several programs one after the other. A frame
+    // longer than maxFrameSize ends the connection.
+    //
+    // The socket is created 0600, and a socket another server still listens
+    // on is left alone: run() fails instead.
+    class Server {
+    public:
+        static constexpr size_t maxFrameSize = 64 * 1024 * 1024;
+
+        // cacheFolder: where parsed programs are kept between jobs, "" => no program cache
+        Server(const std::string& socketPath, size_t memSize = 0, const std::string& cacheFolder = "");
+        ~Server();
+
+        // Accept connections until stop() is called. Returns non-zero when
+        // the socket cannot be set up or another server is listening on it.
+        int run();
+
+        // Stop accepting, finish the running jobs and return from run()
+        void stop();
+
+        std::shared_ptr<LibraryRegistry> getRegistry() const { return registry; }
+
+        // Run one program in a new session, sending its log and listing to fd
+        int runJob(const std::string& code, int fd);
+
+    private:
+        struct Worker {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+
+        std::string socketPath;
+        size_t memSize;
+        std::shared_ptr<LibraryRegistry> registry;
+        std::unique_ptr<ProgramCache> cache;
+        std::atomic<bool> stopping{ false };
+        std::atomic<int> listenFd{ -1 };
+        std::list<Worker> workers;
+
+        void serve(int fd);
+        void joinWorkers(bool all);
+    };
+
+    // Client side: send code to the server listening on socketPath and copy
+    // its log and listing to the streams as they arrive. Returns the job's
+    // return code, or -1 when the server cannot be reached.
+    int submitProgram(const std::string& socketPath, const std::string& code, std::ostream& log, std::ostream& lst);
+
+}
+#endif // SERVER_H
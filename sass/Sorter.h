@@ -5,32 +5,73 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <numeric>
 
 namespace sass {
     class Sorter {
     public:
-        // Sorts the dataset by the specified variables
+        // Sorts the dataset by the specified variables. The BY columns are read
+        // once through scan(), the row numbers are sorted on them and each row
+        // is then moved once. Missing values sort first, ties keep their order.
         static void sortDataset(Dataset* dataset, const std::vector<std::string>& byVariables) {
-            std::sort(dataset->rows.begin(), dataset->rows.end(),
-                [&](const Row& a, const Row& b) -> bool {
-                    for (const auto& var : byVariables) {
-                        double valA = 0.0;
-                        double valB = 0.0;
-                        auto itA = a.columns.find(var);
-                        if (itA != a.columns.end() && std::holds_alternative<double>(itA->second)) {
-                            valA = std::get<double>(itA->second);
+            size_t n = dataset->scanRowCount();
+            if (n < 2 || byVariables.empty()) {
+                return;
+            }
+            auto cursor = dataset->scan(byVariables, n);
+            cursor.next();
+            const ColumnBatch& keys = cursor.batch();
+
+            std::vector<size_t> order(n);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(),
+                [&](size_t a, size_t b) -> bool {
+                    for (size_t c = 0; c < keys.columnCount(); c++) {
+                        if (keys.isNumeric(c)) {
+                            double valA = keys.numbers(c)[a];
+                            double valB = keys.numbers(c)[b];
+                            if (valA < valB) return true;
+                            if (valA > valB) return false;
                         }
-                        auto itB = b.columns.find(var);
-                        if (itB != b.columns.end() && std::holds_alternative<double>(itB->second)) {
-                            valB = std::get<double>(itB->second);
+                        else {
+                            int cmp = keys.strings(c)[a].compare(keys.strings(c)[b]);
+                            if (cmp != 0) return cmp < 0;
                         }
-                        if (valA < valB) return true;
-                        if (valA > valB) return false;
                         // If equal, continue to next BY variable
                     }
                     return false; // All BY variables are equal
                 }
             );
+
+            auto doc = dynamic_cast<SasDoc*>(dataset);
+            if (doc && !doc->values.empty()) {
+                size_t width = doc->var_count;
+                const Cell* cells = doc->values.cdata();
+                std::vector<Cell> sorted;
+                sorted.reserve(n * width);
+                for (size_t row : order) {
+                    sorted.insert(sorted.end(), cells + row * width, cells + (row + 1) * width);
+                }
+                // a buffer shared with another dataset is left as it was
+                doc->values = CowVector<Cell>(std::move(sorted));
+            }
+            else {
+                std::vector<Row> sorted;
+                sorted.reserve(n);
+                if (dataset->rows.useCount() == 1) {
+                    auto& rows = dataset->rows.mutate();
+                    for (size_t row : order) {
+                        sorted.push_back(std::move(rows[row]));
+                    }
+                }
+                else {
+                    // rows shared with another dataset are copied, not moved
+                    for (size_t row : order) {
+                        sorted.push_back(dataset->rows.get()[row]);
+                    }
+                }
+                dataset->rows = CowVector<Row>(std::move(sorted));
+            }
         }
     };
 
@@ -0,0 +1,90 @@
+#include "SqlValueSet.h"
+#include "utility.h"
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+namespace sass {
+
+    namespace {
+        bool isMissingNumber(double x) {
+            return std::isnan(x) || x == -INFINITY;
+        }
+
+        // SAS pads strings with blanks, 'Y' and 'Y  ' are the same value
+        std::string_view withoutTrailingBlanks(const std::string& s) {
+            size_t end = s.find_last_not_of(' ');
+            return std::string_view(s.data(), end == std::string::npos ? 0 : end + 1);
+        }
+    }
+
+    BloomFilter::BloomFilter(size_t expected, double falsePositives) {
+        // m = -n ln p / (ln 2)^2 bits, k = m / n ln 2 probes
+        double n = (double)std::max<size_t>(expected, 1);
+        double m = std::ceil(-n * std::log(falsePositives) / (std::log(2.0) * std::log(2.0)));
+        bits.assign(((uint64_t)m + 63) / 64, 0);
+        bitCount = bits.size() * 64;
+        probes = std::max(1, (int)std::lround(m / n * std::log(2.0)));
+    }
+
+    void BloomFilter::add(uint64_t hash) {
+        // double hashing: probe i is h1 + i * h2
+        uint64_t h2 = mix64(hash) | 1;
+        for (int i = 0; i < probes; i++) {
+            uint64_t bit = (hash + i * h2) % bitCount;
+            bits[bit / 64] |= 1ull << (bit % 64);
+        }
+    }
+
+    bool BloomFilter::mayContain(uint64_t hash) const {
+        uint64_t h2 = mix64(hash) | 1;
+        for (int i = 0; i < probes; i++) {
+            uint64_t bit = (hash + i * h2) % bitCount;
+            if (!(bits[bit / 64] & (1ull << (bit % 64)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void SqlValueSet::add(const Value& value) {
+        count++;
+        if (auto number = std::get_if<double>(&value)) {
+            if (isMissingNumber(*number)) missing = true;
+            else numbers.insert(*number == 0 ? 0 : *number);
+            return;
+        }
+        std::string_view text = withoutTrailingBlanks(std::get<std::string>(value));
+        if (text.empty()) missing = true;
+        else strings.emplace(text);
+    }
+
+    void SqlValueSet::seal() {
+        if (numbers.size() + strings.size() < bloomThreshold) {
+            return;
+        }
+        bloom.emplace(numbers.size() + strings.size());
+        for (double x : numbers) bloom->add(hashNumber(x));
+        for (const auto& s : strings) bloom->add(hashString(s));
+    }
+
+    bool SqlValueSet::contains(const Value& value) const {
+        if (auto number = std::get_if<double>(&value)) {
+            if (isMissingNumber(*number)) return missing;
+            if (numbers.empty() && !strings.empty()) {
+                throw std::runtime_error("Expression using IN has components that are of different data types.");
+            }
+            double x = *number == 0 ? 0 : *number;
+            if (bloom && !bloom->mayContain(hashNumber(x))) return false;
+            return numbers.count(x) > 0;
+        }
+        std::string_view text = withoutTrailingBlanks(std::get<std::string>(value));
+        if (text.empty()) return missing;
+        if (strings.empty() && !numbers.empty()) {
+            throw std::runtime_error("Expression using IN has components that are of different data types.");
+        }
+        if (bloom && !bloom->mayContain(hashString(text))) return false;
+        return strings.find(text) != strings.end();
+    }
+
+}
@@ -0,0 +1,63 @@
+#ifndef SQLVALUESET_H
+#define SQLVALUESET_H
+
+#include "Dataset.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <optional>
+#include <cstdint>
+
+namespace sass {
+
+    // A set of hashes that may answer "maybe" for one that was never added
+    // (about falsePositives of the time) but never "no" for one that was.
+    class BloomFilter {
+    public:
+        BloomFilter(size_t expected, double falsePositives = 0.01);
+
+        void add(uint64_t hash);
+        bool mayContain(uint64_t hash) const;
+
+    private:
+        std::vector<uint64_t> bits;
+        uint64_t bitCount;
+        int probes;
+    };
+
+    // The values of an uncorrelated subquery or of an IN list, built once
+    // and probed for every row of the outer query. Numbers and strings go to
+    // their own hash sets, strings without their trailing blanks. As in SAS,
+    // a missing value is a value: it is in the set when the subquery returned
+    // one, so NOT IN keeps the rows whose value is missing only when it did
+    // not. A large set gets a Bloom filter in front, then most probes that
+    // miss stop there instead of in the hash set.
+    class SqlValueSet {
+    public:
+        static const size_t bloomThreshold = 1 << 16;
+
+        void add(const Value& value);
+        // Call once after the last add
+        void seal();
+        bool contains(const Value& value) const;
+        // Values added, EXISTS asks whether there was any
+        size_t size() const { return count; }
+
+    private:
+        // probes by string_view, without a copy of the probed text
+        struct TextHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>()(s); }
+        };
+
+        std::unordered_set<double> numbers;
+        std::unordered_set<std::string, TextHash, std::equal_to<>> strings;
+        bool missing = false;
+        size_t count = 0;
+        std::optional<BloomFilter> bloom;
+    };
+
+}
+
+#endif // SQLVALUESET_H
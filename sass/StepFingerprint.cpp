@@ -0,0 +1,219 @@
+#include "StepFingerprint.h"
+#include "ProgramCache.h"
+#include "utility.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace sass {
+
+    namespace {
+        bool isWork(const DatasetRefNode& ds) {
+            return ds.libref.empty() || to_upper(ds.libref) == "WORK";
+        }
+
+        void addUnique(std::vector<DatasetRefNode>& list, const DatasetRefNode& ds) {
+            if (ds.dataName.empty()) return;
+            DatasetRefNode copy = ds;
+            for (auto& existing : list) {
+                if (existing.getFullDsName() == copy.getFullDsName()) return;
+            }
+            list.push_back(copy);
+        }
+
+        // Datasets a DATA step statement reads (SET, MERGE) and writes (OUTPUT), nested blocks included;
+        // calls: it has a CALL routine, whose effects outside the step are not in the outputs
+        void collect(ASTNode* node, std::vector<DatasetRefNode>& inputs, std::vector<DatasetRefNode>& outputs, bool& calls) {
+            auto all = [&](const std::vector<std::unique_ptr<ASTNode>>& statements) {
+                for (auto& s : statements) collect(s.get(), inputs, outputs, calls);
+            };
+            if (!node) return;
+            if (dynamic_cast<CallRoutineNode*>(node)) {
+                calls = true;
+            }
+            else if (auto set = dynamic_cast<SetStatementNode*>(node)) {
+                for (auto& ds : set->dataSets) addUnique(inputs, ds);
+            }
+            else if (auto merge = dynamic_cast<MergeStatementNode*>(node)) {
+                for (auto& ds : merge->datasets) addUnique(inputs, ds);
+            }
+            else if (auto out = dynamic_cast<OutputNode*>(node)) {
+                for (auto& ds : out->outDatasets) addUnique(outputs, ds);
+            }
+            else if (auto ifThen = dynamic_cast<IfThenNode*>(node)) {
+                all(ifThen->thenStatements);
+            }
+            else if (auto ifElse = dynamic_cast<IfElseNode*>(node)) {
+                all(ifElse->thenStatements);
+                all(ifElse->elseStatements);
+            }
+            else if (auto ifElseIf = dynamic_cast<IfElseIfNode*>(node)) {
+                all(ifElseIf->thenStatements);
+                for (auto& branch : ifElseIf->elseIfBranches) all(branch.second);
+                all(ifElseIf->elseStatements);
+            }
+            else if (auto block = dynamic_cast<BlockNode*>(node)) {
+                all(block->statements);
+            }
+            else if (auto doNode = dynamic_cast<DoNode*>(node)) {
+                all(doNode->statements);
+            }
+            else if (auto doLoop = dynamic_cast<DoLoopNode*>(node)) {
+                collect(doLoop->body.get(), inputs, outputs, calls);
+            }
+        }
+
+        bool fileStamp(const std::string& path, std::string& stamp) {
+            std::error_code ec;
+            auto modified = fs::last_write_time(path, ec);
+            if (ec) return false;
+            auto size = fs::file_size(path, ec);
+            if (ec) return false;
+            stamp = std::to_string((long long)modified.time_since_epoch().count()) + " " + std::to_string(size);
+            return true;
+        }
+
+        // Two FNV-1a lanes with different seeds, fields length-prefixed
+        struct Hasher {
+            Fnv1a a, b{ 0x9e3779b97f4a7c15ull };
+
+            void bytes(const void* data, size_t n) { a.add(data, n); b.add(data, n); }
+            void field(const std::string& s) {
+                uint64_t n = s.size();
+                bytes(&n, sizeof(n));
+                bytes(s.data(), s.size());
+            }
+            std::string hex() const { return a.hex() + b.hex(); }
+        };
+
+        // Options that change how a step reports, not what it writes
+        const std::set<std::string> reportingOptions = { "INCREMENTAL", "FULLSTIMER", "STIMER", "MEMSIZE" };
+    }
+
+    StepFingerprint::StepFingerprint(ASTNode* step, DataEnvironment& env,
+        const std::unordered_map<std::string, std::string>& macroVariables)
+        : env(env)
+    {
+        if (auto dataStep = dynamic_cast<DataStepNode*>(step)) {
+            addUnique(outputs, dataStep->outputDataSet);
+            addUnique(inputs, dataStep->inputDataSet);
+            for (auto& ds : dataStep->inputDataSets) addUnique(inputs, ds);
+            bool calls = false;
+            for (auto& stmt : dataStep->statements) collect(stmt.get(), inputs, outputs, calls);
+            // CALL EXECUTE and CALL SYMPUTX would be lost with the skipped run
+            if (calls) {
+                return;
+            }
+        }
+        else if (auto sort = dynamic_cast<ProcSortNode*>(step)) {
+            addUnique(inputs, sort->inputDataSet);
+            addUnique(outputs, sort->outputDataSet.dataName.empty() ? sort->inputDataSet : sort->outputDataSet);
+        }
+        if (outputs.empty()) {
+            return;
+        }
+        // WORK outputs are gone after the run, there is nothing to reuse
+        for (auto& out : outputs) {
+            if (isWork(out)) return;
+        }
+
+        Hasher h;
+        try {
+            h.field(ProgramCache::version);
+            h.field(ProgramCache::serializeNode(*step));
+        }
+        catch (const std::runtime_error&) {
+            return;
+        }
+
+        std::map<std::string, std::string> options;
+        for (auto& kv : env.options) {
+            if (!reportingOptions.count(kv.first)) options.insert(kv);
+        }
+        for (auto& kv : options) { h.field(kv.first); h.field(kv.second); }
+        std::map<std::string, std::string> macros(macroVariables.begin(), macroVariables.end());
+        for (auto& kv : macros) { h.field(kv.first); h.field(kv.second); }
+
+        for (auto& in : inputs) {
+            h.field(in.getFullDsName());
+            std::string libref = in.libref.empty() ? "WORK" : in.libref;
+            auto lib = env.getLibrary(libref);
+            if (!lib) {
+                return;
+            }
+            std::string memberFile = lib->getEngine()->findMember(lib->getPath(), in.dataName);
+            if (isWork(in)) {
+                // rebuilt by every run: compare what it holds
+                if (!lib->hasDataset(in.dataName) && !memberFile.empty()) {
+                    lib->loadDataset(in.dataName);
+                }
+                auto ds = lib->getDataset(in.dataName);
+                if (ds) h.field(ds->contentHash());
+                else h.field("missing");
+            }
+            else {
+                std::string stamp;
+                if (memberFile.empty() || !fileStamp(memberFile, stamp)) {
+                    h.field("missing");
+                }
+                else {
+                    h.field(memberFile);
+                    h.field(stamp);
+                }
+            }
+        }
+        fingerprint = h.hex();
+    }
+
+    std::string StepFingerprint::sidecarPath(DatasetRefNode& ds, std::string& memberFile) const {
+        auto lib = env.getLibrary(ds.libref);
+        if (!lib) return "";
+        memberFile = lib->getEngine()->findMember(lib->getPath(), ds.dataName);
+        return memberFile.empty() ? "" : memberFile + ".sassfp";
+    }
+
+    bool StepFingerprint::isCurrent() const {
+        if (!isEligible()) {
+            return false;
+        }
+        for (auto out : outputs) {
+            std::string memberFile;
+            std::string path = sidecarPath(out, memberFile);
+            if (path.empty()) return false;
+            std::ifstream in(path);
+            std::string storedFingerprint, storedStamp, stamp;
+            if (!std::getline(in, storedFingerprint) || !std::getline(in, storedStamp)) return false;
+            // the member must still be the file that run wrote
+            if (storedFingerprint != fingerprint || !fileStamp(memberFile, stamp) || stamp != storedStamp) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void StepFingerprint::store() const {
+        if (!isEligible()) {
+            return;
+        }
+        for (auto out : outputs) {
+            std::string memberFile, stamp;
+            std::string path = sidecarPath(out, memberFile);
+            if (path.empty() || !fileStamp(memberFile, stamp)) continue;
+            std::ofstream sidecar(path, std::ios::trunc);
+            sidecar << fingerprint << "\n" << stamp << "\n";
+        }
+    }
+
+    std::string StepFingerprint::describeOutputs() const {
+        std::string names;
+        for (auto out : outputs) {
+            if (!names.empty()) names += ", ";
+            names += out.getFullDsName();
+        }
+        return names;
+    }
+
+}
@@ -0,0 +1,58 @@
+#ifndef STEPFINGERPRINT_H
+#define STEPFINGERPRINT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "AST.h"
+#include "DataEnvironment.h"
+
+namespace sass {
+
+    // Incremental re-execution (OPTIONS INCREMENTAL;)
+    //
+    // A step is fingerprinted by its parsed code, the session's options and
+    // macro variables, and its input datasets: member files of permanent
+    // libraries by path, mtime and size, WORK datasets by content (they are
+    // rebuilt by every run). After a step ran, the fingerprint is stored next
+    // to each permanent output member as <member file>.sassfp, together with
+    // the member's own mtime and size. When every output still carries the
+    // fingerprint the step has now and was not touched since, the step can
+    // be skipped and its outputs reused.
+    //
+    // Only DATA steps and PROC SORT whose outputs are all in permanent
+    // libraries take part; anything else always runs, and so does a DATA
+    // step with a CALL routine (CALL EXECUTE, CALL SYMPUTX).
+    class StepFingerprint {
+    public:
+        // Computed from the state before the step runs
+        StepFingerprint(ASTNode* step, DataEnvironment& env,
+            const std::unordered_map<std::string, std::string>& macroVariables);
+
+        // Can this step be skipped at all?
+        bool isEligible() const { return !fingerprint.empty(); }
+
+        // Every output was written by a run with this fingerprint and not changed since
+        bool isCurrent() const;
+
+        // Record the fingerprint for the outputs just written
+        void store() const;
+
+        // Outputs, e.g. "MYLIB.OUT", for the log
+        std::string describeOutputs() const;
+
+        const std::string& getFingerprint() const { return fingerprint; }
+
+    private:
+        DataEnvironment& env;
+        std::vector<DatasetRefNode> inputs;
+        std::vector<DatasetRefNode> outputs;
+        std::string fingerprint;
+
+        // <member file>.sassfp of an output, "" when the member has no file
+        std::string sidecarPath(DatasetRefNode& ds, std::string& memberFile) const;
+    };
+
+}
+
+#endif // STEPFINGERPRINT_H
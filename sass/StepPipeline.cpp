@@ -0,0 +1,89 @@
+#include "StepPipeline.h"
+#include "Interpreter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace sass {
+
+    StepPipeline::StepPipeline(std::unique_ptr<Lexer> lexer, size_t capacity)
+        : lexer(std::move(lexer)), parser(*this->lexer), capacity(std::max<size_t>(capacity, 1))
+    {
+        thread = std::thread([this]() { parseAll(); });
+    }
+
+    StepPipeline::~StepPipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    void StepPipeline::parseAll() {
+        // errors are queued in between the statements, to be reported in order
+        bool stopped = false;
+        parser.setErrorHandler([&](const std::string& message) {
+            Item item;
+            item.error = message;
+            stopped = stopped || !push(std::move(item));
+        });
+        try {
+            while (!stopped) {
+                auto stmt = parser.parseNext();
+                if (!stmt) break;
+                Item item;
+                item.statement = std::move(stmt);
+                if (!push(std::move(item))) break;
+            }
+        }
+        catch (const std::runtime_error& e) {
+            Item item;
+            item.error = e.what();
+            item.fatal = true;
+            push(std::move(item));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        changed.notify_all();
+    }
+
+    bool StepPipeline::push(Item item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return stopping || queue.size() < capacity; });
+        if (stopping) return false;
+        queue.push_back(std::move(item));
+        changed.notify_all();
+        return true;
+    }
+
+    bool StepPipeline::next(Item& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return finished || !queue.empty(); });
+        if (queue.empty()) return false;
+        item = std::move(queue.front());
+        queue.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+    bool StepPipeline::run(Interpreter& interpreter) {
+        interpreter.beginProgram();
+        Item item;
+        while (next(item)) {
+            if (item.fatal) {
+                interpreter.logLogger.error("Parsing failed: {}", item.error);
+                return false;
+            }
+            if (!item.error.empty()) {
+                interpreter.logLogger.error("Parse error: {}", item.error);
+                continue;
+            }
+            interpreter.executeStatement(item.statement.get());
+            item.statement.reset();
+        }
+        interpreter.endProgram();
+        return true;
+    }
+
+}
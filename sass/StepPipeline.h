@@ -0,0 +1,68 @@
+#ifndef STEPPIPELINE_H
+#define STEPPIPELINE_H
+
+#include "AST.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sass {
+
+    class Interpreter;
+
+    // Parses a program on its own thread while the interpreter runs it. The
+    // parsed statements wait in a bounded queue: the first step starts as
+    // soon as it is parsed, and the parser never gets more than capacity
+    // statements ahead of the interpreter.
+    class StepPipeline {
+    public:
+        static const size_t defaultCapacity = 8;
+
+        // What the parser made of the next part of the program
+        struct Item {
+            std::unique_ptr<ASTNode> statement;
+            std::string error;      // a statement that failed to parse and was skipped
+            bool fatal = false;     // error stopped the parser, nothing follows
+        };
+
+        explicit StepPipeline(std::unique_ptr<Lexer> lexer, size_t capacity = defaultCapacity);
+        // Stops the parser where it is, if the program was not run to its end
+        ~StepPipeline();
+
+        StepPipeline(const StepPipeline&) = delete;
+        StepPipeline& operator=(const StepPipeline&) = delete;
+
+        // The next item in program order, waiting for the parser if need be;
+        // false at the end of the program
+        bool next(Item& item);
+
+        // Run the program on interpreter as it is parsed. Parse errors are
+        // logged where they are in the program, after the statements before
+        // them ran. false when the lexer stopped the program early.
+        bool run(Interpreter& interpreter);
+
+    private:
+        std::unique_ptr<Lexer> lexer;
+        Parser parser;
+        size_t capacity;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Item> queue;
+        bool finished = false;      // the parser has queued its last item
+        bool stopping = false;
+        std::thread thread;
+
+        void parseAll();
+        // false when the pipeline is stopping
+        bool push(Item item);
+    };
+
+}
+
+#endif // STEPPIPELINE_H
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <ctime>
 #include <spdlog/spdlog.h>
+#include "MemoryManager.h"
 
 namespace sass {
 
@@ -38,9 +39,11 @@ namespace sass {
 
     class ScopedStepTimer {
     public:
-        ScopedStepTimer(const std::string& stepName, spdlog::logger& logger)
-            : name(stepName), log(logger)
+        // With a MemoryManager (OPTIONS FULLSTIMER) the step's peak memory is reported too
+        ScopedStepTimer(const std::string& stepName, spdlog::logger& logger, MemoryManager* memory = nullptr)
+            : name(stepName), log(logger), memory(memory)
         {
+            if (memory) memory->resetPeak();
             timer.start();
         }
         ~ScopedStepTimer() {
@@ -50,11 +53,18 @@ namespace sass {
             log.info("NOTE: {} used (Total process time):", name);
             log.info("      real time           {:.2f} seconds", realTime);
             log.info("      cpu time            {:.2f} seconds", cpuTime);
+            if (memory) {
+                log.info("      memory              {}", MemoryManager::formatKilobytes(memory->getPeak()));
+                if (memory->getLimit() != 0) {
+                    log.info("      memsize             {}", MemoryManager::formatKilobytes(memory->getLimit()));
+                }
+            }
         }
     private:
         StepTimer timer;
         std::string name;
         spdlog::logger& log;
+        MemoryManager* memory;
     };
 
 } // namespace sass
@@ -5,6 +5,7 @@
 #include <string>
 #include <sys/stat.h>
 #include <iostream>
+#include <atomic>
 
 // If on Windows
 #ifdef _WIN32
@@ -50,6 +51,10 @@ namespace sass {
     // e.g. on Unix: /tmp/sas_work_12345
     std::string createUniqueTempFolder() {
         std::string base = getSystemTempFolder();
+        // several sessions in one process each need their own folder
+        static std::atomic<unsigned> counter{ 0 };
+        unsigned n = counter++;
+        std::string suffix = n == 0 ? "" : "_" + std::to_string(n);
 
 #ifdef _WIN32
         // We can generate a unique name. 
@@ -58,13 +63,13 @@ namespace sass {
         char tmpName[MAX_PATH];
         // This is a simplistic approach, you can use GetTempFileNameA too
         sprintf_s(tmpName, "sas_work_%u", (unsigned int)GetTickCount());
-        std::string folder = base + "\\" + tmpName;
+        std::string folder = base + "\\" + tmpName + suffix;
         _mkdir(folder.c_str());
 #else
         // On Unix
         char tmpName[64];
         sprintf(tmpName, "sas_work_%d", (int)getpid());
-        std::string folder = base + "/" + tmpName;
+        std::string folder = base + "/" + tmpName + suffix;
         mkdir(folder.c_str(), 0700);
 #endif
 
@@ -17,6 +17,7 @@ namespace sass {
         KEYWORD_ELSE,
         KEYWORD_ELSE_IF,
         KEYWORD_OUTPUT,
+        KEYWORD_CALL,
         KEYWORD_INPUT,
         KEYWORD_DATALINES,
         DATALINES_CONTENT,
@@ -47,6 +48,7 @@ namespace sass {
         KEYWORD_MAX,
         KEYWORD_MEAN,
         KEYWORD_MEANS,
+        KEYWORD_UNIVARIATE,
         KEYWORD_MEDIAN,
         KEYWORD_MIN,
         KEYWORD_N,
@@ -88,6 +90,11 @@ namespace sass {
         KEYWORD_MACRO_IF,         // %if
         KEYWORD_MACRO_THEN,       // %then
         KEYWORD_MACRO_ELSE,       // %else
+        KEYWORD_MACRO_INCLUDE,    // %include, expanded by the lexer
+        KEYWORD_MACRO_PUT,        // %put, its text up to the semicolon
+        MACRO_CALL,         // %name
+        MACRO_ARGS,         // the text in the parentheses after %name
+        MACRO_BODY,         // the text of a macro definition, up to %mend
         MACRO_VAR,          // &varname or &&varname
         EQUAL,
         SEMICOLON,
@@ -0,0 +1,296 @@
+#include "Univariate.h"
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include <string>
+
+namespace sass {
+
+    namespace {
+        using Extreme = UnivariateStats::Extreme;
+
+        // A part smaller than this is not worth a thread
+        const size_t minPart = 1 << 16;
+
+        unsigned partCount(size_t n, unsigned threads) {
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            return (unsigned)std::min<size_t>(threads, n / minPart + 1);
+        }
+
+        // fn(part, begin, end) over parts of [0, n), the first part on the calling thread
+        template <typename Fn>
+        void forParts(size_t n, unsigned parts, Fn&& fn) {
+            size_t step = (n + parts - 1) / parts;
+            std::vector<std::thread> workers;
+            for (unsigned p = 1; p < parts; p++) {
+                size_t begin = std::min(n, p * step);
+                size_t end = std::min(n, begin + step);
+                workers.emplace_back([&fn, p, begin, end]() { fn(p, begin, end); });
+            }
+            fn(0u, (size_t)0, std::min(n, step));
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        // Ties are broken by the row, so every observation has its own place
+        bool lowerFirst(const Extreme& a, const Extreme& b) {
+            return a.value < b.value || (a.value == b.value && a.obs < b.obs);
+        }
+
+        bool higherFirst(const Extreme& a, const Extreme& b) {
+            return lowerFirst(b, a);
+        }
+
+        // Keep the k best of what is offered in a heap whose top is the worst kept
+        template <typename Better>
+        void offer(std::vector<Extreme>& heap, size_t k, const Extreme& e, Better better) {
+            if (heap.size() < k) {
+                heap.push_back(e);
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+            else if (k > 0 && better(e, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = e;
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        }
+
+        // Put the values of the sorted ranks [rb, re) in place, all of them
+        // within data[first, last). Each nth_element splits the range, the
+        // ranks on either side only look at their own part.
+        void selectRanks(double* data, size_t first, size_t last, const size_t* rb, const size_t* re) {
+            while (rb != re) {
+                const size_t* mid = rb + (re - rb) / 2;
+                std::nth_element(data + first, data + *mid, data + last);
+                selectRanks(data, first, *mid, rb, mid);
+                first = *mid + 1;
+                rb = mid + 1;
+            }
+        }
+
+        // 1, 2, 2.5 or 5 times a power of ten, not less than x
+        double roundWidth(double x) {
+            double scale = std::pow(10.0, std::floor(std::log10(x)));
+            double f = x / scale;
+            double nice = f <= 1 ? 1 : f <= 2 ? 2 : f <= 2.5 ? 2.5 : f <= 5 ? 5 : 10;
+            return nice * scale;
+        }
+    }
+
+    const std::vector<double>& Univariate::defaultPercents() {
+        static const std::vector<double> percents = { 100, 99, 95, 90, 75, 50, 25, 10, 5, 1, 0 };
+        return percents;
+    }
+
+    UnivariateStats Univariate::compute(std::vector<double>& values, const std::vector<double>& percents,
+        size_t extremes, unsigned threads) {
+        UnivariateStats stats;
+        unsigned parts = partCount(values.size(), threads);
+
+        struct Part {
+            size_t n = 0;
+            double sum = 0, uss = 0;
+            double min = INFINITY, max = -INFINITY;
+            double m2 = 0, m3 = 0, m4 = 0;
+            std::vector<Extreme> lowest, highest;
+        };
+        std::vector<Part> partStats(parts);
+
+        // First pass: counts, sums and the extremes of each part
+        forParts(values.size(), parts, [&](unsigned p, size_t begin, size_t end) {
+            Part& part = partStats[p];
+            for (size_t i = begin; i < end; i++) {
+                double x = values[i];
+                if (isMissing(x)) {
+                    continue;
+                }
+                part.n++;
+                part.sum += x;
+                part.uss += x * x;
+                part.min = std::min(part.min, x);
+                part.max = std::max(part.max, x);
+                offer(part.lowest, extremes, { x, i + 1 }, lowerFirst);
+                offer(part.highest, extremes, { x, i + 1 }, higherFirst);
+            }
+        });
+
+        std::vector<Extreme> lowest, highest;
+        stats.min = INFINITY;
+        stats.max = -INFINITY;
+        for (auto& part : partStats) {
+            stats.n += part.n;
+            stats.sum += part.sum;
+            stats.uss += part.uss;
+            stats.min = std::min(stats.min, part.min);
+            stats.max = std::max(stats.max, part.max);
+            lowest.insert(lowest.end(), part.lowest.begin(), part.lowest.end());
+            highest.insert(highest.end(), part.highest.begin(), part.highest.end());
+        }
+        stats.nmiss = values.size() - stats.n;
+        std::sort(lowest.begin(), lowest.end(), lowerFirst);
+        std::sort(highest.begin(), highest.end(), lowerFirst);
+        stats.lowest.assign(lowest.begin(), lowest.begin() + std::min(extremes, lowest.size()));
+        stats.highest.assign(highest.end() - std::min(extremes, highest.size()), highest.end());
+
+        stats.percents = percents;
+        if (stats.n == 0) {
+            stats.mean = stats.variance = stats.stdDev = stats.skewness = stats.kurtosis = NAN;
+            stats.css = stats.cv = stats.stdMean = stats.min = stats.max = NAN;
+            stats.quantiles.assign(percents.size(), NAN);
+            return stats;
+        }
+        double n = (double)stats.n;
+        stats.mean = stats.sum / n;
+
+        // Second pass: central moments around the mean, they keep their precision
+        forParts(values.size(), parts, [&](unsigned p, size_t begin, size_t end) {
+            Part& part = partStats[p];
+            for (size_t i = begin; i < end; i++) {
+                double x = values[i];
+                if (isMissing(x)) {
+                    continue;
+                }
+                double d = x - stats.mean;
+                double d2 = d * d;
+                part.m2 += d2;
+                part.m3 += d2 * d;
+                part.m4 += d2 * d2;
+            }
+        });
+        double m3 = 0, m4 = 0;
+        for (auto& part : partStats) {
+            stats.css += part.m2;
+            m3 += part.m3;
+            m4 += part.m4;
+        }
+
+        // the formulas of SAS (VARDEF=DF)
+        stats.variance = stats.n > 1 ? stats.css / (n - 1) : NAN;
+        stats.stdDev = std::sqrt(stats.variance);
+        stats.stdMean = stats.stdDev / std::sqrt(n);
+        stats.cv = stats.mean != 0 ? 100 * stats.stdDev / stats.mean : NAN;
+        stats.skewness = stats.n > 2 && stats.variance > 0
+            ? n / ((n - 1) * (n - 2)) * m3 / std::pow(stats.stdDev, 3) : NAN;
+        stats.kurtosis = stats.n > 3 && stats.variance > 0
+            ? n * (n + 1) / ((n - 1) * (n - 2) * (n - 3)) * m4 / (stats.variance * stats.variance)
+                - 3 * (n - 1) * (n - 1) / ((n - 2) * (n - 3))
+            : NAN;
+
+        stats.quantiles = quantiles(values, percents);
+        return stats;
+    }
+
+    std::vector<double> Univariate::quantiles(std::vector<double>& values, const std::vector<double>& percents) {
+        values.erase(std::remove_if(values.begin(), values.end(), isMissing), values.end());
+        size_t n = values.size();
+        std::vector<double> result(percents.size(), NAN);
+        if (n == 0) {
+            return result;
+        }
+
+        // Definition 5: with n*p/100 = j + g, the (j+1)th smallest value,
+        // or the mean of the jth and (j+1)th when g is 0
+        std::vector<std::pair<size_t, size_t>> picks;
+        std::vector<size_t> ranks;
+        for (double p : percents) {
+            if (p < 0 || p > 100) {
+                throw std::runtime_error("Percentile " + std::to_string(p) + " is not between 0 and 100.");
+            }
+            double np = n * p / 100;
+            size_t j = (size_t)std::floor(np);
+            size_t lo, hi;
+            if (np == (double)j) {
+                lo = j == 0 ? 0 : j - 1;
+                hi = std::min(j, n - 1);
+            }
+            else {
+                lo = hi = std::min(j, n - 1);
+            }
+            picks.push_back({ lo, hi });
+            ranks.push_back(lo);
+            ranks.push_back(hi);
+        }
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        selectRanks(values.data(), 0, n, ranks.data(), ranks.data() + ranks.size());
+
+        for (size_t i = 0; i < picks.size(); i++) {
+            result[i] = (values[picks[i].first] + values[picks[i].second]) / 2;
+        }
+        return result;
+    }
+
+    Histogram Univariate::histogram(const std::vector<double>& values, size_t bins, unsigned threads) {
+        Histogram h;
+        unsigned parts = partCount(values.size(), threads);
+
+        struct Range {
+            size_t n = 0;
+            double min = INFINITY, max = -INFINITY;
+        };
+        std::vector<Range> ranges(parts);
+        forParts(values.size(), parts, [&](unsigned p, size_t begin, size_t end) {
+            Range& r = ranges[p];
+            for (size_t i = begin; i < end; i++) {
+                double x = values[i];
+                if (isMissing(x)) continue;
+                r.n++;
+                r.min = std::min(r.min, x);
+                r.max = std::max(r.max, x);
+            }
+        });
+        Range all;
+        for (auto& r : ranges) {
+            all.n += r.n;
+            all.min = std::min(all.min, r.min);
+            all.max = std::max(all.max, r.max);
+        }
+        if (all.n == 0) {
+            return h;
+        }
+
+        size_t count;
+        if (all.max == all.min) {
+            h.width = 1;
+            h.start = all.min - 0.5;
+            count = 1;
+        }
+        else if (bins > 0) {
+            // as many bins as asked for, spanning the values exactly
+            h.width = (all.max - all.min) / bins;
+            h.start = all.min;
+            count = bins;
+        }
+        else {
+            // Sturges' rule, on round bin edges
+            size_t wanted = (size_t)std::ceil(std::log2((double)all.n)) + 1;
+            h.width = roundWidth((all.max - all.min) / wanted);
+            h.start = std::floor(all.min / h.width) * h.width;
+            count = (size_t)std::floor((all.max - h.start) / h.width) + 1;
+        }
+
+        // each thread fills its own bins, they are added up at the end
+        std::vector<std::vector<size_t>> partCounts(parts, std::vector<size_t>(count, 0));
+        forParts(values.size(), parts, [&](unsigned p, size_t begin, size_t end) {
+            auto& counts = partCounts[p];
+            for (size_t i = begin; i < end; i++) {
+                double x = values[i];
+                if (isMissing(x)) continue;
+                double pos = (x - h.start) / h.width;
+                size_t bin = pos > 0 ? (size_t)pos : 0;
+                counts[std::min(bin, count - 1)]++;
+            }
+        });
+        h.counts.assign(count, 0);
+        for (auto& counts : partCounts) {
+            for (size_t b = 0; b < count; b++) {
+                h.counts[b] += counts[b];
+            }
+        }
+        return h;
+    }
+
+}
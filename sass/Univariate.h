@@ -0,0 +1,78 @@
+#ifndef UNIVARIATE_H
+#define UNIVARIATE_H
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+
+namespace sass {
+
+    // Statistics of PROC UNIVARIATE for one numeric column
+    struct UnivariateStats {
+        size_t n = 0;           // non-missing values
+        size_t nmiss = 0;
+        double sum = 0;
+        double mean = 0;
+        double variance = 0;
+        double stdDev = 0;
+        double skewness = 0;
+        double kurtosis = 0;
+        double uss = 0;         // uncorrected sum of squares
+        double css = 0;         // corrected sum of squares
+        double cv = 0;          // coefficient of variation, in percent
+        double stdMean = 0;     // standard error of the mean
+        double min = 0;
+        double max = 0;
+
+        // quantiles[i] is the percents[i] percentile (SAS definition 5)
+        std::vector<double> percents;
+        std::vector<double> quantiles;
+
+        // Extreme observations, obs is 1-based
+        struct Extreme {
+            double value;
+            size_t obs;
+        };
+        std::vector<Extreme> lowest;    // ascending
+        std::vector<Extreme> highest;   // ascending, as SAS lists them
+    };
+
+    struct Histogram {
+        double start = 0;       // lower edge of the first bin
+        double width = 0;
+        std::vector<size_t> counts;
+
+        double midpoint(size_t bin) const { return start + width * (bin + 0.5); }
+    };
+
+    // The computations behind PROC UNIVARIATE, made for columns of
+    // hundreds of millions of values:
+    //   - moments in two passes over the column, split across threads
+    //   - quantiles by multi-selection (nth_element on the ranks that are
+    //     asked for, recursing into the parts in between), no full sort
+    //   - extreme observations from bounded heaps
+    //   - histograms from per-thread bins merged at the end
+    // threads: 0 => as many as the machine has; small columns use one.
+    class Univariate {
+    public:
+        // The percentiles shown by PROC UNIVARIATE
+        static const std::vector<double>& defaultPercents();
+
+        // values: the column with missing values (-INFINITY or NaN) left in,
+        // so extreme observations know their row. values is reordered.
+        static UnivariateStats compute(std::vector<double>& values, const std::vector<double>& percents,
+            size_t extremes = 5, unsigned threads = 0);
+
+        // Percentiles of the non-missing values (definition 5), values is reordered
+        static std::vector<double> quantiles(std::vector<double>& values, const std::vector<double>& percents);
+
+        // bins == 0 => chosen from the number of values; the bin edges are round numbers.
+        // Missing values are not counted.
+        static Histogram histogram(const std::vector<double>& values, size_t bins = 0, unsigned threads = 0);
+
+        static bool isMissing(double v) { return std::isnan(v) || v == -INFINITY; }
+    };
+
+}
+
+#endif // UNIVARIATE_H
@@ -0,0 +1,209 @@
+#include "WhereFilter.h"
+#include "sasdoc.h"
+#include "utility.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace sass {
+
+    // The condition as the filter runs it: compiled comparisons, AND / OR,
+    // and parts left to the row evaluator
+    struct WhereFilter::Node {
+        enum Kind { And, Or, Compare, Row } kind = Row;
+        std::unique_ptr<Node> left, right;
+
+        // Compare: column op constant, column indexing the scanned columns
+        int column = -1;
+        std::string op;
+        bool numeric = true;
+        double number = 0;
+        std::string text;   // without trailing blanks
+
+        // Row
+        ASTNode* expr = nullptr;
+    };
+
+    namespace {
+        std::string_view trimRight(std::string_view s) {
+            return s.substr(0, s.find_last_not_of(' ') + 1);
+        }
+
+        bool isComparison(const std::string& op) {
+            return op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=";
+        }
+
+        // a < b is b > a
+        std::string mirrored(const std::string& op) {
+            if (op == "<") return ">";
+            if (op == ">") return "<";
+            if (op == "<=") return ">=";
+            if (op == ">=") return "<=";
+            return op;
+        }
+
+        template <typename T, typename K>
+        void compare(const std::string& op, std::span<const T> xs, const K& k, std::vector<char>& mask) {
+            auto apply = [&](auto test) {
+                for (size_t i = 0; i < xs.size(); i++) {
+                    mask[i] = mask[i] && test(xs[i]);
+                }
+            };
+            if (op == "==") apply([&](const T& x) { return x == k; });
+            else if (op == "!=") apply([&](const T& x) { return x != k; });
+            else if (op == "<") apply([&](const T& x) { return x < k; });
+            else if (op == ">") apply([&](const T& x) { return x > k; });
+            else if (op == "<=") apply([&](const T& x) { return x <= k; });
+            else apply([&](const T& x) { return x >= k; });
+        }
+    }
+
+    WhereFilter::WhereFilter(ASTNode* condition, RowEvaluator evaluateRow)
+        : condition(condition), evaluateRow(std::move(evaluateRow))
+    {
+    }
+
+    WhereFilter::~WhereFilter() = default;
+
+    RowSelection WhereFilter::select(const Dataset& ds) const {
+        size_t total = ds.scanRowCount();
+        RowSelection selected(total);
+        auto doc = dynamic_cast<const SasDoc*>(&ds);
+        if (doc && doc->deletedCount() > 0) {
+            selected = doc->obs_flag;
+            selected.resize(total, true);
+        }
+        else {
+            selected.set();
+        }
+        if (!condition || total == 0) {
+            return selected;
+        }
+
+        // the types of every column, to compile the comparisons against
+        ColumnBatch columns;
+        ds.describeColumns(columns, {});
+        std::unordered_map<std::string, size_t> byName;
+        for (size_t c = 0; c < columns.columns.size(); c++) {
+            byName.emplace(to_upper(columns.columns[c].name), c);
+        }
+
+        std::vector<std::string> needed;
+        bool anyRow = false;
+        std::function<std::unique_ptr<Node>(ASTNode*)> compile = [&](ASTNode* expr) {
+            auto node = std::make_unique<Node>();
+            node->expr = expr;
+            auto bin = dynamic_cast<BinaryOpNode*>(expr);
+            if (bin && (bin->op == "and" || bin->op == "or")) {
+                node->kind = bin->op == "and" ? Node::And : Node::Or;
+                node->left = compile(bin->left.get());
+                node->right = compile(bin->right.get());
+                return node;
+            }
+            if (bin && isComparison(bin->op)) {
+                auto var = dynamic_cast<VariableNode*>(bin->left.get());
+                ASTNode* constant = bin->right.get();
+                std::string op = bin->op;
+                if (!var) {
+                    var = dynamic_cast<VariableNode*>(bin->right.get());
+                    constant = bin->left.get();
+                    op = mirrored(op);
+                }
+                auto it = var ? byName.find(to_upper(var->varName)) : byName.end();
+                if (it != byName.end() && columns.columns[it->second].source >= 0) {
+                    bool numeric = columns.columns[it->second].numeric;
+                    auto number = dynamic_cast<NumberNode*>(constant);
+                    auto text = dynamic_cast<StringNode*>(constant);
+                    if ((numeric && number) || (!numeric && text)) {
+                        node->kind = Node::Compare;
+                        node->op = op;
+                        node->numeric = numeric;
+                        if (number) node->number = number->value;
+                        else node->text = trimRight(text->value);
+                        node->column = (int)needed.size();
+                        needed.push_back(columns.columns[it->second].name);
+                        return node;
+                    }
+                }
+            }
+            node->kind = Node::Row;
+            anyRow = true;
+            return node;
+        };
+        auto root = compile(condition);
+
+        // the row evaluator may use any variable, otherwise only the compared columns are read
+        if (anyRow) {
+            std::unordered_map<std::string, size_t> position;
+            for (size_t c = 0; c < columns.columns.size(); c++) {
+                position.emplace(columns.columns[c].name, c);
+            }
+            std::function<void(Node&)> renumber = [&](Node& node) {
+                if (node.kind == Node::Compare) node.column = (int)position[needed[node.column]];
+                if (node.left) renumber(*node.left);
+                if (node.right) renumber(*node.right);
+            };
+            renumber(*root);
+            needed.clear();
+        }
+
+        std::vector<char> mask;
+        auto cursor = ds.scan(needed);
+        while (cursor.next()) {
+            const ColumnBatch& batch = cursor.batch();
+            mask.resize(batch.size());
+            bool any = false;
+            for (size_t i = 0; i < batch.size(); i++) {
+                mask[i] = selected.test(batch.firstRow() + i);
+                any = any || mask[i];
+            }
+            if (!any) continue;
+            run(*root, batch, mask);
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (!mask[i]) selected.reset(batch.firstRow() + i);
+            }
+        }
+        return selected;
+    }
+
+    // mask: in, the rows still to decide; out, those of them the node is true for
+    void WhereFilter::run(const Node& node, const ColumnBatch& batch, std::vector<char>& mask) const {
+        switch (node.kind) {
+        case Node::And:
+            run(*node.left, batch, mask);
+            run(*node.right, batch, mask);
+            break;
+        case Node::Or: {
+            // the right side only sees the rows the left one rejected
+            std::vector<char> rest = mask;
+            run(*node.left, batch, mask);
+            for (size_t i = 0; i < rest.size(); i++) {
+                rest[i] = rest[i] && !mask[i];
+            }
+            run(*node.right, batch, rest);
+            for (size_t i = 0; i < rest.size(); i++) {
+                mask[i] = mask[i] || rest[i];
+            }
+            break;
+        }
+        case Node::Compare:
+            if (node.numeric) {
+                compare(node.op, batch.numbers(node.column), node.number, mask);
+            }
+            else {
+                std::vector<std::string_view> trimmed(batch.strings(node.column).begin(), batch.strings(node.column).end());
+                for (auto& s : trimmed) {
+                    s = trimRight(s);
+                }
+                compare(node.op, std::span<const std::string_view>(trimmed), std::string_view(node.text), mask);
+            }
+            break;
+        case Node::Row:
+            for (size_t i = 0; i < mask.size(); i++) {
+                if (mask[i]) mask[i] = evaluateRow(node.expr, batch, i);
+            }
+            break;
+        }
+    }
+
+}
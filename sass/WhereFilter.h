@@ -0,0 +1,39 @@
+#ifndef WHEREFILTER_H
+#define WHEREFILTER_H
+
+#include "AST.h"
+#include "Dataset.h"
+#include <functional>
+#include <memory>
+
+namespace sass {
+
+    // A WHERE condition run over the column batches of a dataset, giving
+    // the rows that pass as a selection the procedures scan through:
+    // nothing is copied. Comparisons of a variable with a constant of its
+    // type, and AND / OR of those, run as loops over the typed columns;
+    // any other part of the condition goes to the row evaluator, only for
+    // rows the compiled parts have not already decided.
+    class WhereFilter {
+    public:
+        // Is part (of the condition) true for row i of batch; the batch has every column
+        using RowEvaluator = std::function<bool(ASTNode* part, const ColumnBatch& batch, size_t i)>;
+
+        WhereFilter(ASTNode* condition, RowEvaluator evaluateRow);
+        ~WhereFilter();
+
+        // The rows of ds the condition selects; rows deleted from a SasDoc never are
+        RowSelection select(const Dataset& ds) const;
+
+    private:
+        struct Node;
+
+        ASTNode* condition;
+        RowEvaluator evaluateRow;
+
+        void run(const Node& node, const ColumnBatch& batch, std::vector<char>& mask) const;
+    };
+
+}
+
+#endif // WHEREFILTER_H
@@ -1,6 +1,8 @@
 #include "sasdoc.h"
 #include "sasdoc.h"
 #include <ReadStat/readstat.h>
+#include <algorithm>
+#include <type_traits>
 #include <cmath>
 #include <cstddef>
 #include <string>
@@ -33,6 +35,195 @@ namespace sass {
 		var_count = 0;
 	}
 
+	size_t SasDoc::memoryUsage() const
+	{
+		// cells shared with other datasets are split between them
+		size_t bytes = sizeof(*this) + values.capacity() * sizeof(Cell) / values.useCount();
+		for (auto& name : var_names) bytes += name.capacity();
+		for (auto& label : var_labels) bytes += label.capacity();
+		for (auto& format : var_formats) bytes += format.capacity();
+		bytes += (obs_flag.num_blocks() + or_flag.num_blocks() + obs_library_filter.num_blocks() + var_flag.num_blocks())
+			* sizeof(boost::dynamic_bitset<>::block_type);
+
+		// Character payloads live in the flyweight pool; estimate them from
+		// a sample of rows rather than walking the whole dataset
+		if (obs_count > 0)
+		{
+			int step = obs_count / 256 + 1, sampled = 0;
+			size_t sampleBytes = 0;
+			for (int r = 0; r < obs_count; r += step, sampled++)
+			{
+				for (int c = 0; c < var_count; c++)
+				{
+					if (auto s = std::get_if<flyweight_string>(&values[(size_t)r * var_count + c]))
+						sampleBytes += s->get().size();
+				}
+			}
+			bytes += sampleBytes / sampled * obs_count / values.useCount();
+		}
+		return bytes;
+	}
+
+	// A SasDoc holds its data in values; procedure temporaries only use rows
+	static bool isCellBacked(const SasDoc& doc)
+	{
+		return !doc.values.empty() || doc.rows.empty();
+	}
+
+	size_t SasDoc::scanRowCount() const
+	{
+		return isCellBacked(*this) ? (size_t)obs_count : rows.size();
+	}
+
+	void SasDoc::describeColumns(ColumnBatch& batch, const std::vector<std::string>& names) const
+	{
+		if (!isCellBacked(*this))
+		{
+			Dataset::describeColumns(batch, names);
+			return;
+		}
+		batch.columns.clear();
+		const std::vector<std::string>& wanted = names.empty() ? var_names : names;
+		for (auto& name : wanted)
+		{
+			ColumnBatch::Column col;
+			col.name = name;
+			auto it = std::find(var_names.begin(), var_names.end(), name);
+			if (it == var_names.end())
+			{
+				// variable names are case insensitive
+				std::string upper = to_upper(name);
+				it = std::find_if(var_names.begin(), var_names.end(),
+					[&](const std::string& v) { return to_upper(v) == upper; });
+			}
+			if (it != var_names.end())
+			{
+				col.source = (int)(it - var_names.begin());
+				col.numeric = col.source >= (int)var_types.size() || var_types[col.source] != READSTAT_TYPE_STRING;
+			}
+			batch.columns.push_back(std::move(col));
+		}
+	}
+
+	void SasDoc::fillBatch(ColumnBatch& batch) const
+	{
+		if (!isCellBacked(*this))
+		{
+			Dataset::fillBatch(batch);
+			return;
+		}
+		const Cell* cells = values.cdata() + batch.first * var_count;
+		for (auto& col : batch.columns)
+		{
+			if (col.source < 0)
+			{
+				std::fill(col.numbers.begin(), col.numbers.end(), -INFINITY);
+				continue;
+			}
+			const Cell* cell = cells + col.source;
+			if (col.numeric)
+			{
+				for (size_t r = 0; r < batch.count; r++, cell += var_count)
+				{
+					const double* d = std::get_if<double>(cell);
+					col.numbers[r] = d ? *d : -INFINITY;
+				}
+			}
+			else
+			{
+				for (size_t r = 0; r < batch.count; r++, cell += var_count)
+				{
+					const flyweight_string* s = std::get_if<flyweight_string>(cell);
+					col.strings[r] = s ? std::string_view(s->get()) : std::string_view();
+				}
+			}
+		}
+	}
+
+	void SasDoc::deleteRow(size_t row)
+	{
+		if (obs_flag.size() < (size_t)obs_count)
+		{
+			obs_flag.resize(obs_count, true);
+		}
+		obs_flag.reset(row);
+	}
+
+	void SasDoc::compact()
+	{
+		if (deletedCount() == 0)
+		{
+			return;
+		}
+		auto& cells = values.mutate();
+		size_t kept = 0;
+		for (size_t r = 0; r < (size_t)obs_count; r++)
+		{
+			if (isDeleted(r))
+			{
+				continue;
+			}
+			if (kept != r)
+			{
+				std::move(cells.begin() + r * var_count, cells.begin() + (r + 1) * var_count, cells.begin() + kept * var_count);
+			}
+			kept++;
+		}
+		cells.resize(kept * var_count);
+		obs_count = (int)kept;
+		obs_flag.clear();
+		obs_flag.resize(kept, true);
+	}
+
+	void SasDoc::keepColumns(const std::vector<std::string>& names)
+	{
+		std::vector<int> kept;
+		for (int c = 0; c < var_count; c++)
+		{
+			if (std::find(names.begin(), names.end(), var_names[c]) != names.end())
+			{
+				kept.push_back(c);
+			}
+		}
+		if ((int)kept.size() == var_count)
+		{
+			return;
+		}
+		auto select = [&](auto& attributes)
+		{
+			std::remove_reference_t<decltype(attributes)> selected;
+			for (int c : kept)
+			{
+				if (c < (int)attributes.size()) selected.push_back(attributes[c]);
+			}
+			attributes = std::move(selected);
+		};
+		select(var_names);
+		select(var_labels);
+		select(var_formats);
+		select(var_types);
+		select(var_length);
+		select(var_display_length);
+		select(var_decimals);
+
+		std::vector<Cell> cells;
+		cells.reserve((size_t)obs_count * kept.size());
+		for (size_t r = 0; r < (size_t)obs_count; r++)
+		{
+			for (int c : kept)
+			{
+				cells.push_back(values[r * var_count + c]);
+			}
+		}
+		values = CowVector<Cell>(std::move(cells));
+		var_count = (int)kept.size();
+		if (!var_flag.empty())
+		{
+			var_flag.clear();
+			var_flag.resize(var_count, true);
+		}
+	}
+
 	// SasDoc commands
 
 	int SasDoc::handle_metadata(readstat_metadata_t* metadata, void* ctx)
@@ -143,6 +334,7 @@ namespace sass {
 		int var_index = readstat_variable_get_index(variable);
 		int var_count = data01->var_count;
 		int str_width;
+		Cell& cell = data01->values.mutate()[obs_index * var_count + var_index];
 
 		readstat_type_t type = readstat_value_type(value);
 		const char* format = readstat_variable_get_format(variable);
@@ -151,28 +343,22 @@ namespace sass {
 		{
 			switch (type) {
 			case READSTAT_TYPE_STRING:
-				data01->values[obs_index * var_count + var_index] =
-					flyweight_string(readstat_string_value(value));
+				cell = flyweight_string(readstat_string_value(value));
 				break;
 			case READSTAT_TYPE_DOUBLE:
-				data01->values[obs_index * var_count + var_index] =
-					(double)readstat_double_value(value);
+				cell = (double)readstat_double_value(value);
 				break;
 			case READSTAT_TYPE_INT8:
-				data01->values[obs_index * var_count + var_index] =
-					(double)readstat_int8_value(value);
+				cell = (double)readstat_int8_value(value);
 				break;
 			case READSTAT_TYPE_INT16:
-				data01->values[obs_index * var_count + var_index] =
-					(double)readstat_int16_value(value);
+				cell = (double)readstat_int16_value(value);
 				break;
 			case READSTAT_TYPE_INT32:
-				data01->values[obs_index * var_count + var_index] =
-					(double)readstat_int32_value(value);
+				cell = (double)readstat_int32_value(value);
 				break;
 			case READSTAT_TYPE_FLOAT:
-				data01->values[obs_index * var_count + var_index] =
-					(double)readstat_float_value(value);
+				cell = (double)readstat_float_value(value);
 				break;
 			default:
 				break;
@@ -181,7 +367,7 @@ namespace sass {
 		else {
 			if (type == READSTAT_TYPE_DOUBLE)
 			{
-				data01->values[obs_index * var_count + var_index] = -INFINITY;
+				cell = -INFINITY;
 			}
 		}
 
@@ -272,6 +458,11 @@ namespace sass {
 	}
 
 	int SasDoc::write_sas7bdat(std::wstring path, SasDoc* doc)
+	{
+		return write_file(path, doc, ReadStatFormat::SAS7BDAT);
+	}
+
+	int SasDoc::write_file(std::wstring path, SasDoc* doc, ReadStatFormat format)
 	{
 		// 1) Convert wstring -> narrow string
 		std::string path_utf8 = std::string(path.begin(), path.end());
@@ -330,10 +521,26 @@ namespace sass {
 
 		// 5) Begin writing for row_count = doc->obs_count
 		int row_count = doc->obs_count;
-		readstat_error_t rc = readstat_begin_writing_sas7bdat(
-			writer, &fd, row_count);
+		readstat_error_t rc = READSTAT_OK;
+		switch (format) {
+		case ReadStatFormat::XPORT:
+			rc = readstat_begin_writing_xport(writer, &fd, row_count);
+			break;
+		case ReadStatFormat::DTA:
+			rc = readstat_begin_writing_dta(writer, &fd, row_count);
+			break;
+		case ReadStatFormat::SAV:
+			rc = readstat_begin_writing_sav(writer, &fd, row_count);
+			break;
+		case ReadStatFormat::POR:
+			rc = readstat_begin_writing_por(writer, &fd, row_count);
+			break;
+		default:
+			rc = readstat_begin_writing_sas7bdat(writer, &fd, row_count);
+			break;
+		}
 		if (rc != READSTAT_OK) {
-			std::cerr << "readstat_begin_writing_sas7bdat failed with code " << rc << std::endl;
+			std::cerr << "readstat_begin_writing failed with code " << rc << std::endl;
 			readstat_writer_free(writer);
 			close(fd);
 			return -3;
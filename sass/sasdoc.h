@@ -41,6 +41,15 @@ namespace sass {
         FATTRSTR attrs;
     };
 
+    // File formats ReadStat can read and write for us
+    enum class ReadStatFormat {
+        SAS7BDAT,
+        XPORT,
+        DTA,
+        SAV,
+        POR
+    };
+
 
     class SasDoc : public Dataset
     {
@@ -63,14 +72,31 @@ namespace sass {
         }
 
         Row getRow(int index) const {
-            Row row;
+            Row row{ RowColumns(std::make_shared<Schema>(var_names)) };
             for (auto i = 0; i != var_count; i++)
             {
-                row.columns.emplace(std::pair<std::string, Value>(var_names[i], cellToValue(values[var_count * index + i])));
+                row.columns.emplace(row.columns.schema()->find(var_names[i])) = cellToValue(values[var_count * index + i]);
             }
             return row;
         }
 
+        size_t memoryUsage() const override;
+
+        // scan() reads the cells directly; row based SasDocs (procedure
+        // temporaries) fall back to the Dataset implementation
+        size_t scanRowCount() const override;
+        void describeColumns(ColumnBatch& batch, const std::vector<std::string>& names) const override;
+        void fillBatch(ColumnBatch& batch) const override;
+
+        // Rows deleted in place (PROC SQL DELETE) are cleared in obs_flag
+        // and keep their cells until compact() drops them
+        bool isDeleted(size_t row) const { return row < obs_flag.size() && !obs_flag[row]; }
+        size_t deletedCount() const { return obs_flag.size() - obs_flag.count(); }
+        void deleteRow(size_t row);
+        void compact();
+        // Drop every column not in names (KEEP=/DROP= of an output data set)
+        void keepColumns(const std::vector<std::string>& names);
+
         static int handle_metadata(readstat_metadata_t* metadata, void* ctx);
         static int handle_metadata_xpt(readstat_metadata_t* metadata, void* ctx);
         static int handle_variable(int index, readstat_variable_t* variable, const char* val_labels, void* ctx);
@@ -84,6 +110,7 @@ namespace sass {
         }
 
         static int write_sas7bdat(std::wstring path, SasDoc* ds);
+        static int write_file(std::wstring path, SasDoc* ds, ReadStatFormat format);
         // todo
         static formatrec loadSASFormat(string formatName, SasDoc* data01);
         string Format(double value01, string aFormat, int w, int d);
@@ -124,7 +151,8 @@ namespace sass {
         vector<int> var_length;
         vector<int> var_display_length;
         vector<int> var_decimals;
-        vector<Cell> values;
+        // Row-major cells, shared copy-on-write between copies of the dataset
+        CowVector<Cell> values;
         boost::dynamic_bitset<> obs_flag;
         boost::dynamic_bitset<> or_flag;
         boost::dynamic_bitset<> obs_library_filter;
@@ -133,11 +161,11 @@ namespace sass {
 
         std::map<string, formatrec> mapFormat;
 
-        string get_value_string(int row, int col) {
+        string get_value_string(int row, int col) const {
             return std::get<flyweight_string>(this->values[row * this->var_count + col]);
         }
 
-        double get_value_double(int row, int col) {
+        double get_value_double(int row, int col) const {
             return std::get<double>(this->values[row * this->var_count + col]);
         }
 
@@ -1,4 +1,5 @@
 ﻿#include <spdlog/spdlog.h>
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <string>
@@ -10,6 +11,11 @@
 #include "DataEnvironment.h"
 #include "AST.h"
 #include "Repl.h"
+#include "Server.h"
+#include "ProgramCache.h"
+#include "Checkpoint.h"
+#include "MappedFile.h"
+#include "StepPipeline.h"
 
 using namespace sass;
 
@@ -28,20 +34,19 @@ std::string readSasFile(const std::string& filename) {
 }
 
 // Function to run SAS code
-void runSasCode(const std::string& sasCode, Interpreter& interpreter, bool interactive) {
-	// Lexing
-	Lexer lexer(sasCode);
-	std::vector<Token> tokens;
-	Token tok;
-	while ((tok = lexer.getNextToken()).type != TokenType::EOF_TOKEN) {
-		tokens.push_back(tok);
+// (with a program cache, a program parsed before is not lexed and parsed again;
+// without, the program is parsed on another thread while its first steps run)
+void runSasCode(const std::string& sasCode, Interpreter& interpreter, bool interactive, const ProgramCache* cache = nullptr) {
+	if (!cache) {
+		StepPipeline pipeline(std::make_unique<Lexer>(sasCode));
+		pipeline.run(interpreter);
+		return;
 	}
 
-	// Parsing
-	Parser parser(tokens);
+	// Lexing and parsing
 	std::unique_ptr<ProgramNode> program;
 	try {
-		program = parser.parseProgram();
+		program = ProgramCache::compile(sasCode, cache);
 	}
 	catch (const std::runtime_error& e) {
 		interpreter.logLogger.error("Parsing failed: {}", e.what());
@@ -57,17 +62,43 @@ void runSasCode(const std::string& sasCode, Interpreter& interpreter, bool inter
 	}
 }
 
+// Function to run a SAS program file as it is parsed: the file is mapped, not
+// read, and each statement runs and is freed soon after it is parsed, so only
+// the statements the parser is ahead by are ever in memory
+bool runSasFile(const std::string& filename, Interpreter& interpreter) {
+	MappedFile file;
+	if (!file.open(filename) || file.size() == 0) {
+		return false;
+	}
+	StepPipeline pipeline(std::make_unique<Lexer>(std::move(file)));
+	pipeline.run(interpreter);
+	return true;
+}
+
 int main(int argc, char** argv)
 {
 	std::string sasFile;
 	std::string logFile;
 	std::string lstFile;
+	std::string memSize;
+	std::string serverSocket;
+	std::string connectSocket;
+	std::string progCache;
+	std::string checkpointFolder;
+	bool checkpointMode = false;
+	bool restart = false;
 
 	// Parse command line arguments
 	// Expected patterns:
 	// -sas=xxx.sas
 	// -log=xxx.log
 	// -lst=xxx.lst
+	// -memsize=2G
+	// -server=/tmp/sass.sock   (run as a daemon)
+	// -connect=/tmp/sass.sock  (run -sas= on that daemon)
+	// -progcache=dir           (keep parsed programs in dir)
+	// -checkpoint[=dir]        (save the session after every step, dir defaults to <sas file>.ckpt)
+	// -restart                 (resume from the checkpoint after the last step that ran)
 	for (int i = 1; i < argc; ++i) {
 		std::string arg = argv[i];
 		if (arg.rfind("-sas=", 0) == 0) {
@@ -79,6 +110,67 @@ int main(int argc, char** argv)
 		else if (arg.rfind("-lst=", 0) == 0) {
 			lstFile = arg.substr(5);
 		}
+		else if (arg.rfind("-memsize=", 0) == 0) {
+			memSize = arg.substr(9);
+		}
+		else if (arg.rfind("-server=", 0) == 0) {
+			serverSocket = arg.substr(8);
+		}
+		else if (arg.rfind("-connect=", 0) == 0) {
+			connectSocket = arg.substr(9);
+		}
+		else if (arg.rfind("-progcache=", 0) == 0) {
+			progCache = arg.substr(11);
+		}
+		else if (arg == "-checkpoint") {
+			checkpointMode = true;
+		}
+		else if (arg.rfind("-checkpoint=", 0) == 0) {
+			checkpointMode = true;
+			checkpointFolder = arg.substr(12);
+		}
+		else if (arg == "-restart") {
+			checkpointMode = true;
+			restart = true;
+		}
+	}
+
+	size_t memLimit = 0;
+	if (!memSize.empty()) {
+		try {
+			memLimit = MemoryManager::parseMemSize(memSize);
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << "\n";
+			return 1;
+		}
+	}
+
+	// Server mode: every program sent to the socket runs in its own session
+	if (!serverSocket.empty()) {
+		Server server(serverSocket, memLimit, progCache);
+		std::cerr << "NOTE: Listening on " << serverSocket << "\n";
+		return server.run();
+	}
+
+	// Client mode: the program runs on the server, log and listing come back
+	if (!connectSocket.empty()) {
+		std::string code = readSasFile(sasFile);
+		if (code.empty()) {
+			std::cerr << "Failed to read SAS file or file is empty: " << sasFile << "\n";
+			return 1;
+		}
+		std::ofstream logOut, lstOut;
+		if (!logFile.empty()) logOut.open(logFile, std::ios::binary);
+		if (!lstFile.empty()) lstOut.open(lstFile, std::ios::binary);
+		int rc = submitProgram(connectSocket, code,
+			logOut.is_open() ? (std::ostream&)logOut : std::cerr,
+			lstOut.is_open() ? (std::ostream&)lstOut : std::cout);
+		if (rc < 0) {
+			std::cerr << "Cannot connect to " << connectSocket << "\n";
+			return 1;
+		}
+		return rc;
 	}
 
 	// Determine mode:
@@ -93,14 +185,30 @@ int main(int argc, char** argv)
 	std::shared_ptr<spdlog::logger> logLogger;
 	std::shared_ptr<spdlog::logger> lstLogger;
 
+	// A file run writes the log and the listing on a thread of its own, through
+	// one bounded queue so their lines keep their order; a step logging faster
+	// than the sink writes waits for room rather than losing lines. The REPL
+	// stays synchronous, its prompt must come after the output of the statement.
+	const size_t logQueueSize = 8192;
+	if (!interactiveMode) {
+		spdlog::init_thread_pool(logQueueSize, 1);
+	}
+	auto makeLogger = [&](const std::string& name, spdlog::sink_ptr sink) -> std::shared_ptr<spdlog::logger> {
+		if (interactiveMode) {
+			return std::make_shared<spdlog::logger>(name, std::move(sink));
+		}
+		return std::make_shared<spdlog::async_logger>(name, std::move(sink), spdlog::thread_pool(),
+			spdlog::async_overflow_policy::block);
+	};
+
 	if (batchMode) {
 		// Batch mode: log and lst to files
 		try {
 			auto logSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(logFile, true);
 			auto lstSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(lstFile, true);
 
-			logLogger = std::make_shared<spdlog::logger>("log", logSink);
-			lstLogger = std::make_shared<spdlog::logger>("lst", lstSink);
+			logLogger = makeLogger("log", logSink);
+			lstLogger = makeLogger("lst", lstSink);
 		}
 		catch (const spdlog::spdlog_ex& ex) {
 			std::cerr << "Log initialization failed: " << ex.what() << "\n";
@@ -113,8 +221,8 @@ int main(int argc, char** argv)
 			auto logSink = std::make_shared<spdlog::sinks::stderr_color_sink_mt>();
 			auto lstSink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
 
-			logLogger = std::make_shared<spdlog::logger>("log", logSink);
-			lstLogger = std::make_shared<spdlog::logger>("lst", lstSink);
+			logLogger = makeLogger("log", logSink);
+			lstLogger = makeLogger("lst", lstSink);
 		}
 		catch (const spdlog::spdlog_ex& ex) {
 			std::cerr << "Console log initialization failed: " << ex.what() << "\n";
@@ -129,11 +237,29 @@ int main(int argc, char** argv)
 	logLogger->set_pattern("%v");
 	lstLogger->set_level(spdlog::level::info);
 	lstLogger->set_pattern("%v");
+	// the queued lines are written out however main returns
+	struct LogShutdown {
+		~LogShutdown() { spdlog::shutdown(); }
+	} logShutdown;
 
 	DataEnvironment env;
+	if (memLimit > 0) {
+		env.memory.setLimit(memLimit);
+	}
 	Interpreter interpreter(env, *logLogger, *lstLogger);
 
+	std::unique_ptr<ProgramCache> cache;
+	if (!progCache.empty()) {
+		cache = std::make_unique<ProgramCache>(progCache);
+	}
+
 	std::string sasCode;
+	std::unique_ptr<Checkpoint> checkpoint;
+	if (checkpointMode && !interactiveMode) {
+		sasCode = readSasFile(sasFile);
+		checkpoint = std::make_unique<Checkpoint>(checkpointFolder.empty() ? sasFile + ".ckpt" : checkpointFolder, sasCode);
+		interpreter.setCheckpoint(checkpoint.get(), restart);
+	}
 
 	if (interactiveMode) {
 		// Initialize REPL
@@ -145,24 +271,36 @@ int main(int argc, char** argv)
 	else if (fileMode) {
 		// File mode: read code from sasFile, output to console
 		logLogger->info("Running from SAS file: {}", sasFile);
-		sasCode = readSasFile(sasFile);
-		if (sasCode.empty()) {
+		if (cache) {
+			sasCode = readSasFile(sasFile);
+			if (sasCode.empty()) {
+				logLogger->error("Failed to read SAS file or file is empty: {}", sasFile);
+				return 1;
+			}
+
+			runSasCode(sasCode, interpreter, false, cache.get());
+		}
+		else if (!runSasFile(sasFile, interpreter)) {
 			logLogger->error("Failed to read SAS file or file is empty: {}", sasFile);
 			return 1;
 		}
-
-		runSasCode(sasCode, interpreter, false);
 	}
 	else if (batchMode) {
 		// Batch mode: read code from sasFile, log and lst to files
 		logLogger->info("Running in batch mode: SAS={} LOG={} LST={}", sasFile, logFile, lstFile);
-		sasCode = readSasFile(sasFile);
-		if (sasCode.empty()) {
+		if (cache) {
+			sasCode = readSasFile(sasFile);
+			if (sasCode.empty()) {
+				logLogger->error("Failed to read SAS file or file is empty: {}", sasFile);
+				return 1;
+			}
+
+			runSasCode(sasCode, interpreter, false, cache.get());
+		}
+		else if (!runSasFile(sasFile, interpreter)) {
 			logLogger->error("Failed to read SAS file or file is empty: {}", sasFile);
 			return 1;
 		}
-
-		runSasCode(sasCode, interpreter, false);
 	}
 
 	return 0;
@@ -2,10 +2,13 @@
 #define UTILITY_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <cstdint>
+#include <cstdio>
 #include <boost/flyweight.hpp>
 
 
@@ -108,5 +111,48 @@ static Cell valueToCell(const Value& input)
     );
 }
 
+// FNV-1a, 64 bit: a hash that stays the same across builds and platforms
+// (unlike std::hash), for cache keys and fingerprints written to disk
+struct Fnv1a {
+    uint64_t hash;
+
+    explicit Fnv1a(uint64_t seed = 14695981039346656037ull) : hash(seed) {}
+
+    Fnv1a& add(const void* data, size_t size) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return *this;
+    }
+    Fnv1a& add(const std::string& text) { return add(text.data(), text.size()); }
+
+    std::string hex() const {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+        return buf;
+    }
+};
+
+// splitmix64 finalizer: spreads every bit of x over the whole hash (FNV-1a
+// alone leaves the high bits poorly mixed), for hash sketches and filters
+inline uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// Well mixed 64 bit hashes of values, -0 hashing like 0
+inline uint64_t hashNumber(double value) {
+    if (value == 0) value = 0;
+    return mix64(Fnv1a().add(&value, sizeof(value)).hash);
+}
+
+inline uint64_t hashString(std::string_view value) {
+    return mix64(Fnv1a().add(value.data(), value.size()).hash);
+}
+
 #endif // !UTILITY_H
 
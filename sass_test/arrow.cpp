@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "sasdoc.h"
+#include "LibraryEngine.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+TEST(Arrow, RoundTrip)
+{
+	SasDoc doc;
+	doc.var_count = 2;
+	doc.obs_count = 3;
+	doc.var_names = { "x", "name" };
+	doc.var_labels = { "X value", "" };
+	doc.var_formats = { "", "" };
+	doc.var_types = { READSTAT_TYPE_DOUBLE, READSTAT_TYPE_STRING };
+	doc.var_length = { 8, 12 };
+	doc.var_display_length = { 0, 0 };
+	doc.var_decimals = { 0, 0 };
+	doc.values = { 1.5, flyweight_string("Alice"), -INFINITY, flyweight_string("Bob"), 3.0, flyweight_string("") };
+
+	auto engine = LibraryEngine::create("arrow");
+	ASSERT_NE(engine, nullptr);
+	EXPECT_EQ(engine->getName(), "ARROW");
+
+	string folder = createUniqueTempFolder();
+	string path = engine->memberPath(folder, "CLASS");
+	EXPECT_EQ(engine->write(path, &doc), 0);
+	EXPECT_FALSE(engine->findMember(folder, "CLASS").empty());
+
+	SasDoc doc1;
+	EXPECT_EQ(engine->read(path, &doc1, ReadOptions()), 0);
+	EXPECT_EQ(doc1.var_count, 2);
+	EXPECT_EQ(doc1.obs_count, 3);
+	EXPECT_EQ(doc1.var_labels[0], "X value");
+	EXPECT_EQ(doc1.var_length[1], 12);
+	EXPECT_EQ(get<double>(doc1.values[0]), 1.5);
+	EXPECT_EQ(get<double>(doc1.values[2]), -INFINITY);
+	EXPECT_EQ(get<flyweight_string>(doc1.values[3]).get(), "Bob");
+
+	// projection and row window are applied while decoding
+	ReadOptions options;
+	options.keep = { "NAME" };
+	options.firstObs = 2;
+	options.obs = 3;
+	SasDoc doc2;
+	EXPECT_EQ(engine->read(path, &doc2, options), 0);
+	EXPECT_EQ(doc2.var_count, 1);
+	EXPECT_EQ(doc2.obs_count, 2);
+	EXPECT_EQ(get<flyweight_string>(doc2.values[0]).get(), "Bob");
+
+	removeDirectoryRecursively(folder);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+
+using namespace sass;
+using namespace std;
+
+class CallRoutine : public SasSession {};
+
+TEST_F(CallRoutine, ExecuteRunsGeneratedStepsAfterTheStep)
+{
+	run(
+		"data control;\n"
+		"  input name $ k;\n"
+		"  datalines;\n"
+		"a 1\n"
+		"b 2\n"
+		";\n"
+		"run;\n"
+		"data gen;\n"
+		"  set control;\n"
+		"  call execute(cats('data out_', name, ';'));\n"
+		"  call execute(cats('x = ', k * 10, ';'));\n"
+		"  call execute('run;');\n"
+		"run;\n");
+	string text = log.str();
+	size_t gen = text.find("NOTE: The data set GEN has 2 observations");
+	size_t a = text.find("NOTE: The data set OUT_A has 1 observations and 1 variables.");
+	size_t b = text.find("NOTE: The data set OUT_B has 1 observations and 1 variables.");
+	ASSERT_NE(gen, string::npos);
+	ASSERT_NE(a, string::npos);
+	ASSERT_NE(b, string::npos);
+	// the generated code runs once the step that made it is done, in the order it was made
+	EXPECT_LT(gen, a);
+	EXPECT_LT(a, b);
+	EXPECT_EQ(text.find("Execution error"), string::npos);
+
+	auto out = table("OUT_B");
+	ASSERT_NE(out, nullptr);
+	EXPECT_EQ(get<double>(out->values[0]), 20.0);
+}
+
+TEST_F(CallRoutine, SymputxSetsMacroVariables)
+{
+	run(
+		"data control;\n"
+		"  input name $ k;\n"
+		"  datalines;\n"
+		"a 1.5\n"
+		"b 2\n"
+		";\n"
+		"run;\n"
+		"data flags;\n"
+		"  set control;\n"
+		"  call symputx(cats('n_', name), k * 2);\n"
+		"  call symputx('  last ', name, 'g');\n"
+		"  call symputx('missing', k / 0);\n"
+		"run;\n"
+		"%macro show;\n"
+		"  title \"&n_a &n_b &last &missing\";\n"
+		"%mend show;\n"
+		"%show\n");
+	EXPECT_EQ(env.title, "3 4 b .");
+}
+
+TEST_F(CallRoutine, Errors)
+{
+	run(
+		"data one;\n"
+		"  x = 1;\n"
+		"  call symputx('a');\n"
+		"run;\n"
+		"data two;\n"
+		"  x = 1;\n"
+		"  call nosuch(x);\n"
+		"run;\n"
+		"data three;\n"
+		"  call execute('title ''generated''; proc nosuchproc; options linesize=90;');\n"
+		"run;\n");
+	string text = log.str();
+	EXPECT_NE(text.find("CALL SYMPUTX expects 2 or 3 arguments."), string::npos);
+	EXPECT_NE(text.find("Unsupported CALL routine: NOSUCH"), string::npos);
+	// a parse error in generated code does not stop the statements after it
+	EXPECT_NE(text.find("Parse error: Unsupported PROC type: nosuchproc"), string::npos);
+	EXPECT_EQ(env.title, "generated");
+	EXPECT_EQ(env.getOption("LINESIZE"), "90");
+}
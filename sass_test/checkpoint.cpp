@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "Checkpoint.h"
+#include "fixture.h"
+#include "TempUtils.h"
+#include <filesystem>
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+TEST(Checkpoint, SaveAndRestore)
+{
+	string folder = createUniqueTempFolder();
+	string libFolder = createUniqueTempFolder();
+	string ckpt = (fs::path(folder) / "ckpt").string();
+	{
+		DataEnvironment env;
+		ASSERT_EQ(env.defineLibrary("PERM", libFolder, LibraryAccess::READONLY, "ARROW"), 0);
+		env.setOption("LINESIZE", "80");
+		env.setTitle("First\tpage");
+		env.getLibrary("WORK")->addDataset("A", TableBuilder("A", 1)
+			.number("v", [](int) { return 1.5; })
+			.text("s", [](int) { return "text"; })
+			.build());
+		unordered_map<string, string> macros = { { "YEAR", "2024" }, { "LIST", "a\\b\nc" } };
+
+		Checkpoint checkpoint(ckpt, "program text");
+		checkpoint.save(env, macros, 3);
+		// unchanged datasets are not written again
+		auto files = distance(fs::directory_iterator(ckpt), fs::directory_iterator());
+		checkpoint.save(env, macros, 4);
+		EXPECT_EQ(distance(fs::directory_iterator(ckpt), fs::directory_iterator()), files);
+	}
+
+	// another program does not restart from it
+	{
+		DataEnvironment env;
+		unordered_map<string, string> macros;
+		Checkpoint other(ckpt, "other program text");
+		EXPECT_EQ(other.restore(env, macros), 0u);
+		EXPECT_TRUE(macros.empty());
+	}
+
+	DataEnvironment env;
+	unordered_map<string, string> macros;
+	Checkpoint checkpoint(ckpt, "program text");
+	EXPECT_EQ(checkpoint.restore(env, macros), 4u);
+	EXPECT_EQ(env.getOption("LINESIZE"), "80");
+	EXPECT_EQ(env.title, "First\tpage");
+	EXPECT_EQ(macros["YEAR"], "2024");
+	EXPECT_EQ(macros["LIST"], "a\\b\nc");
+	auto lib = env.getLibrary("PERM");
+	ASSERT_NE(lib, nullptr);
+	EXPECT_EQ(lib->getAccessMode(), LibraryAccess::READONLY);
+	EXPECT_EQ(lib->getEngine()->getName(), "ARROW");
+	auto a = dynamic_pointer_cast<SasDoc>(env.getLibrary("WORK")->getDataset("A"));
+	ASSERT_NE(a, nullptr);
+	EXPECT_EQ(a->obs_count, 1);
+	EXPECT_EQ(get<double>(a->values[0]), 1.5);
+	EXPECT_EQ(get<flyweight_string>(a->values[1]).get(), "text");
+
+	checkpoint.clear();
+	EXPECT_FALSE(fs::exists(ckpt));
+
+	removeDirectoryRecursively(folder);
+	removeDirectoryRecursively(libFolder);
+}
+
+// Stands for a step that fails this time, e.g. on a file that is not there yet
+struct FailingStep : ASTNode {};
+
+TEST(Checkpoint, RestartAfterFailure)
+{
+	string folder = createUniqueTempFolder();
+	string ckpt = (fs::path(folder) / "ckpt").string();
+	string program =
+		"title 'Restarted';\n"
+		"data a;\n"
+		"   x = 1;\n"
+		"   output;\n"
+		"run;\n"
+		"data b;\n"
+		"   y = 2;\n"
+		"   output;\n"
+		"run;\n";
+	auto run = [&](bool restart, bool fail, DataEnvironment& env) {
+		CapturedLog log;
+		Interpreter interpreter(env, *log, *log);
+		Checkpoint checkpoint(ckpt, program);
+		interpreter.setCheckpoint(&checkpoint, restart);
+		auto parsed = ProgramCache::compile(program, nullptr);
+		if (fail) {
+			parsed->statements[2] = make_unique<FailingStep>();
+		}
+		interpreter.executeProgram(parsed);
+		return log.str();
+	};
+
+	{
+		DataEnvironment env;
+		string log = run(false, true, env);
+		EXPECT_NE(log.find("The data set A"), string::npos);
+	}
+	EXPECT_TRUE(fs::exists(fs::path(ckpt) / "state"));
+
+	// the restart picks up at the step that failed
+	DataEnvironment env;
+	string log = run(true, false, env);
+	EXPECT_NE(log.find("Restarted from checkpoint"), string::npos);
+	EXPECT_EQ(log.find("The data set A"), string::npos);
+	EXPECT_NE(log.find("The data set B"), string::npos);
+	// WORK.A and the title came from the checkpoint
+	EXPECT_TRUE(env.getLibrary("WORK")->hasDataset("A"));
+	EXPECT_EQ(env.title, "Restarted");
+	// the program ran to the end, nothing left to restart from
+	EXPECT_FALSE(fs::exists(ckpt));
+
+	removeDirectoryRecursively(folder);
+}
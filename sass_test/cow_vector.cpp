@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "CowVector.h"
+#include "sasdoc.h"
+#include "Sorter.h"
+
+using namespace sass;
+using namespace std;
+
+TEST(CowVector, SharesUntilWrite)
+{
+	CowVector<int> a = { 3, 1, 2 };
+	CowVector<int> b = a;
+	EXPECT_TRUE(a.sharesWith(b));
+	EXPECT_EQ(a.useCount(), 2);
+
+	// reading and iterating never copies
+	int sum = 0;
+	for (auto v : b) sum += v;
+	EXPECT_EQ(sum, 6);
+	EXPECT_EQ(b.size(), 3u);
+	EXPECT_EQ(b[0] + b.at(1) + b.data()[2], 6);
+	EXPECT_TRUE(a.sharesWith(b));
+
+	b.mutate()[0] = 10;
+	EXPECT_FALSE(a.sharesWith(b));
+	EXPECT_EQ(a[0], 3);
+	EXPECT_EQ(b[0], 10);
+
+	// clear lets go of a shared buffer without touching the other owner
+	CowVector<int> c = a;
+	c.clear();
+	EXPECT_TRUE(c.empty());
+	EXPECT_EQ(a.size(), 3u);
+}
+
+TEST(CowVector, DatasetCopy)
+{
+	SasDoc doc;
+	doc.var_count = 1;
+	doc.obs_count = 3;
+	doc.var_names = { "x" };
+	doc.values = { 3.0, 1.0, 2.0 };
+
+	SasDoc copy = doc;
+	EXPECT_TRUE(copy.values.sharesWith(doc.values));
+	// a shared buffer is split between its owners
+	EXPECT_LT(copy.memoryUsage(), sizeof(SasDoc) + 3 * sizeof(Cell));
+
+	// nor is it by reading one of them
+	EXPECT_EQ(copy.get_value_double(0, 0), 3.0);
+	EXPECT_TRUE(copy.values.sharesWith(doc.values));
+
+	copy.values.mutate()[0] = 5.0;
+	EXPECT_FALSE(copy.values.sharesWith(doc.values));
+	EXPECT_EQ(std::get<double>(doc.values[0]), 3.0);
+
+	for (double x : { 3.0, 1.0, 2.0 }) {
+		Row row;
+		row.columns["x"] = x;
+		doc.rows.push_back(row);
+	}
+	SasDoc sorted;
+	sorted.rows = doc.rows;
+	Sorter::sortDataset(&sorted, { "x" });
+	EXPECT_EQ(std::get<double>(sorted.rows[0].columns.at("x")), 1.0);
+	EXPECT_EQ(std::get<double>(doc.rows[0].columns.at("x")), 3.0);
+}
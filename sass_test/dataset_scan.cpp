@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "Sorter.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+static SasDoc makeClass()
+{
+	const char* names[] = { "Joyce", "Alfred", "Alice", "Barbara", "Carol" };
+	const double ages[] = { 11.0, 14.0, -INFINITY, 13.0, 14.0 };
+	return *TableBuilder("CLASS", 5)
+		.text("Name", [&](int i) { return names[i]; })
+		.number("Age", [&](int i) { return ages[i]; })
+		.build();
+}
+
+TEST(DatasetScan, Batches)
+{
+	SasDoc doc = makeClass();
+	auto cursor = doc.scan({ "age", "name", "weight" }, 2);
+
+	const ColumnBatch& batch = cursor.batch();
+	ASSERT_EQ(batch.columnCount(), 3u);
+	EXPECT_TRUE(batch.isNumeric(0));
+	EXPECT_FALSE(batch.isNumeric(1));
+	EXPECT_EQ(batch.column(0).source, 1);
+	EXPECT_EQ(batch.column(2).source, -1);
+
+	std::vector<double> ages;
+	std::string names;
+	size_t batches = 0;
+	while (cursor.next()) {
+		batches++;
+		for (double age : batch.numbers(0)) ages.push_back(age);
+		for (auto name : batch.strings(1)) names.append(name).append(" ");
+		EXPECT_TRUE(std::isinf(batch.numbers(2)[0]));
+	}
+	EXPECT_EQ(batches, 3u);
+	ASSERT_EQ(ages.size(), 5u);
+	EXPECT_EQ(ages[1], 14.0);
+	EXPECT_TRUE(std::isinf(ages[2]));
+	EXPECT_EQ(names, "Joyce Alfred Alice Barbara Carol ");
+}
+
+TEST(DatasetScan, RowShim)
+{
+	SasDoc doc = makeClass();
+	auto cursor = doc.scan();
+	ASSERT_TRUE(cursor.next());
+	Row row;
+	cursor.batch().fillRow(3, row);
+	EXPECT_EQ(std::get<std::string>(row.columns["Name"]), "Barbara");
+	EXPECT_EQ(std::get<double>(row.columns["Age"]), 13.0);
+	EXPECT_EQ(std::get<std::string>(cursor.batch().value(0, 0)), "Joyce");
+
+	// Row based datasets scan the same way
+	SasDoc rowsOnly;
+	rowsOnly.rows.push_back(row);
+	auto rowCursor = rowsOnly.scan({ "Age" });
+	ASSERT_TRUE(rowCursor.next());
+	EXPECT_EQ(rowCursor.batch().size(), 1u);
+	EXPECT_EQ(rowCursor.batch().numbers(0)[0], 13.0);
+}
+
+TEST(DatasetScan, SortCells)
+{
+	SasDoc doc = makeClass();
+	Sorter::sortDataset(&doc, { "Age", "Name" });
+	auto cursor = doc.scan({ "Name" });
+	ASSERT_TRUE(cursor.next());
+	std::string names;
+	for (auto name : cursor.batch().strings(0)) names.append(name).append(" ");
+	// missing sorts first, ties ordered by the second BY variable
+	EXPECT_EQ(names, "Alice Joyce Barbara Alfred Carol ");
+}
@@ -1,8 +1,13 @@
 #include <gtest/gtest.h>
 #include "Interpreter.h"
 #include "DataEnvironment.h"
+#include "ProgramCache.h"
+#include "sasdoc.h"
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/sinks/ostream_sink.h>
+#include <functional>
+#include <sstream>
 
 using namespace sass;
 
@@ -54,3 +59,98 @@ protected:
     // Class members declared here can be used by all tests in the test suite
     // for Foo.
 };
+
+// A logger whose lines are kept for the test to look at
+class CapturedLog {
+public:
+    explicit CapturedLog(const std::string& name = "log")
+        : logger(std::make_shared<spdlog::logger>(name, std::make_shared<spdlog::sinks::ostream_sink_mt>(out))) {
+        logger->set_pattern("%v");
+    }
+
+    spdlog::logger& operator*() { return *logger; }
+    std::string str() const { return out.str(); }
+    void clear() { out.str(""); }
+
+private:
+    std::ostringstream out;
+    std::shared_ptr<spdlog::logger> logger;
+};
+
+// A data set built column by column, the row number passed to each value:
+//   TableBuilder("T", 10).number("id", [](int i) { return i + 1.0; }).text("grp", [](int i) { return i % 2 ? "B" : "A"; }).build();
+class TableBuilder {
+public:
+    TableBuilder(const std::string& name, int rows) : name(name), rows(rows) {}
+
+    TableBuilder& number(const std::string& var, std::function<double(int)> value) {
+        columns.push_back({ var, READSTAT_TYPE_DOUBLE, 8, [value](int i) { return Cell(value(i)); } });
+        return *this;
+    }
+
+    TableBuilder& text(const std::string& var, std::function<std::string(int)> value, int length = 8) {
+        columns.push_back({ var, READSTAT_TYPE_STRING, length, [value](int i) { return Cell(flyweight_string(value(i))); } });
+        return *this;
+    }
+
+    std::shared_ptr<SasDoc> build() const {
+        auto doc = std::make_shared<SasDoc>();
+        doc->name = name;
+        doc->var_count = (int)columns.size();
+        doc->obs_count = rows;
+        for (const auto& column : columns) {
+            doc->var_names.push_back(column.name);
+            doc->var_labels.push_back("");
+            doc->var_formats.push_back("");
+            doc->var_types.push_back(column.type);
+            doc->var_length.push_back(column.length);
+            doc->var_display_length.push_back(0);
+            doc->var_decimals.push_back(0);
+        }
+        for (int i = 0; i < rows; i++) {
+            for (const auto& column : columns) {
+                doc->values.push_back(column.value(i));
+            }
+        }
+        return doc;
+    }
+
+private:
+    struct Column {
+        std::string name;
+        readstat_type_t type;
+        int length;
+        std::function<Cell(int)> value;
+    };
+    std::string name;
+    int rows;
+    std::vector<Column> columns;
+};
+
+// NUMS: x = 1..n
+inline std::shared_ptr<SasDoc> numbersTable(int n) {
+    return TableBuilder("NUMS", n).number("x", [](int i) { return i + 1.0; }).build();
+}
+
+// One session running SAS code, with its log and listing captured
+class SasSession : public testing::Test {
+protected:
+    DataEnvironment env;
+    CapturedLog log{ "log" };
+    CapturedLog lst{ "lst" };
+    Interpreter interpreter{ env, *log, *lst };
+
+    void run(const std::string& code) {
+        interpreter.executeProgram(ProgramCache::compile(code, nullptr));
+    }
+
+    void addTable(std::shared_ptr<SasDoc> doc) {
+        env.getLibrary("WORK")->addDataset(doc->name, doc);
+    }
+
+    // A data set of WORK, nullptr if there is none
+    std::shared_ptr<SasDoc> table(const std::string& name) {
+        auto library = env.getLibrary("WORK");
+        return library->hasDataset(name) ? std::dynamic_pointer_cast<SasDoc>(library->getDataset(name)) : nullptr;
+    }
+};
@@ -42,4 +42,29 @@ TEST_F(SassTest, GlobalLibname) {
 
     EXPECT_TRUE(hasTestLib);
     EXPECT_EQ(lib->getPath(), "c:\\workspace\\c++\\sass\\test\\data\\");
-}
\ No newline at end of file
+}
+
+TEST_F(SassTest, GlobalLibnameEngine) {
+    std::string code = R"(
+        libname s stata "c:\workspace\c++\sass\test\data\" access=readonly;
+    )";
+
+    Lexer lexer(code);
+    std::vector<Token> tokens = lexer.tokenize();
+
+    Parser parser(tokens);
+    ParseResult parseResult = parser.parseStatement();
+    ASSERT_EQ(parseResult.status, ParseStatus::PARSE_SUCCESS);
+
+    auto libNode = dynamic_cast<LibnameNode*>(parseResult.node.get());
+    ASSERT_NE(libNode, nullptr);
+    EXPECT_EQ(libNode->engine, "STATA");
+    EXPECT_EQ(libNode->accessMode, LibraryAccess::READONLY);
+
+    interpreter->execute(parseResult.node.get());
+
+    auto lib = env->getLibrary("S");
+    ASSERT_NE(lib, nullptr);
+    EXPECT_EQ(lib->getEngine()->getName(), "STATA");
+    EXPECT_EQ(lib->getEngine()->getExtensions().front(), ".dta");
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "HyperLogLog.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+TEST(HyperLogLog, Accuracy)
+{
+	for (size_t n : { 100, 5000, 1000000 }) {
+		HyperLogLog sketch(14);
+		for (size_t i = 0; i < n; i++) {
+			sketch.addNumber((double)i);
+			sketch.addNumber((double)(i % 7));	// repeats count once
+		}
+		double error = fabs(sketch.estimate() - n) / n;
+		// the sparse list is nearly exact, the registers within 4 standard errors
+		EXPECT_LT(error, n < 10000 ? 0.01 : 4 * sketch.standardError()) << "n=" << n;
+	}
+	EXPECT_EQ(HyperLogLog(12).estimate(), 0);
+	EXPECT_NEAR(HyperLogLog::standardError(14), 0.0081, 0.0001);
+}
+
+TEST(HyperLogLog, MergeIsTheUnion)
+{
+	HyperLogLog all(12), merged(12);
+	vector<HyperLogLog> parts(4, HyperLogLog(12));
+	for (size_t i = 0; i < 200000; i++) {
+		string value = "id" + to_string(i % 50000);
+		all.addString(value);
+		parts[i % 4].addString(value);
+	}
+	// a sparse sketch merged into a sparse one, then the dense ones
+	HyperLogLog small(12);
+	small.addString("id1");
+	merged.merge(small);
+	EXPECT_TRUE(merged.isSparse());
+	for (auto& part : parts) {
+		merged.merge(part);
+	}
+	EXPECT_FALSE(merged.isSparse());
+	EXPECT_EQ(merged.estimate(), all.estimate());
+	EXPECT_THROW(merged.merge(HyperLogLog(10)), runtime_error);
+	EXPECT_THROW(HyperLogLog(3), runtime_error);
+}
+
+class ApproxDistinct : public SasSession {
+protected:
+	void SetUp() override
+	{
+		// g = i % 3, x = i % 1000 with every 10th missing, s has two levels
+		addTable(TableBuilder("T", 30000)
+			.number("g", [](int i) { return double(i % 3); })
+			.number("x", [](int i) { return i % 10 == 0 ? -INFINITY : double(i % 1000); })
+			.text("s", [](int i) { return i % 2 ? "odd" : "even"; })
+			.build());
+	}
+
+	double cell(size_t row, const string& column)
+	{
+		auto result = table("RESULT");
+		return get<double>(result->getRow((int)row).columns.at(column));
+	}
+};
+
+TEST_F(ApproxDistinct, SqlCountDistinct)
+{
+	string query =
+		"proc sql;\n"
+		"   create table result as select g, count(distinct x) as levels, count(*) as total, count(x) as nonmissing from t group by g;\n"
+		"quit;\n";
+	run(query);
+	ASSERT_EQ(env.getLibrary("WORK")->getDataset("RESULT")->getRowCount(), 3);
+	// i % 1000 takes every value in each group, a tenth of them missing
+	EXPECT_EQ(cell(0, "g"), 0);
+	EXPECT_EQ(cell(0, "levels"), 900);
+	EXPECT_EQ(cell(0, "total"), 10000);
+	EXPECT_EQ(cell(0, "nonmissing"), 9000);
+	EXPECT_EQ(log.str().find("is approximate"), string::npos);
+
+	run("options approxdistinct distinctprecision=12;\n" + query);
+	EXPECT_NEAR(cell(0, "levels"), 900, 9);
+	EXPECT_EQ(cell(2, "total"), 10000);
+	EXPECT_NE(log.str().find("NOTE: COUNT(DISTINCT) is approximate (HyperLogLog, DISTINCTPRECISION=12): standard error 1.62%"), string::npos);
+
+	// a whole table aggregate without GROUP BY
+	run("proc sql; create table result as select count(distinct x) as levels, max(x) as top from t; quit;");
+	EXPECT_NEAR(cell(0, "levels"), 900, 9);
+	EXPECT_EQ(cell(0, "top"), 999);
+}
+
+TEST_F(ApproxDistinct, FreqNlevels)
+{
+	run("proc freq data=t nlevels; tables x s; run;");
+	EXPECT_NE(lst.str().find("Number of Variable Levels"), string::npos);
+	EXPECT_NE(lst.str().find("x                        901               1                 900"), string::npos);
+	EXPECT_NE(lst.str().find("s                          2               0                   2"), string::npos);
+
+	lst.clear();
+	run("options approxdistinct; proc freq data=t nlevels; tables s*x; run;");
+	EXPECT_NE(lst.str().find("s                          2               0                   2"), string::npos);
+	EXPECT_NE(log.str().find("NOTE: NLEVELS is approximate"), string::npos);
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "Lexer.h"
+#include "IncludeCache.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static string writeFile(const string& folder, const string& name, const string& code)
+{
+	string path = (fs::path(folder) / name).string();
+	ofstream out(path, ios::binary);
+	out << code;
+	return path;
+}
+
+static vector<string> texts(Lexer& lexer)
+{
+	vector<string> result;
+	for (const auto& tok : lexer.tokenize()) {
+		result.push_back(tok.text);
+	}
+	return result;
+}
+
+TEST(IncludeCache, ExpandsIncludedFiles)
+{
+	IncludeCache::shared().clear();
+	string folder = createUniqueTempFolder();
+	string inner = writeFile(folder, "inner.sas", "options linesize=80;");
+	string outer = writeFile(folder, "outer.sas", "title 'outer'; %INCLUDE '" + inner + "';");
+
+	Lexer lexer("title 'a'; %include '" + outer + "'; title 'b';");
+	EXPECT_EQ(texts(lexer), (vector<string>{ "title", "a", ";", "title", "outer", ";",
+		"options", "linesize", "=", "80", ";", "title", "b", ";" }));
+	EXPECT_EQ(lexer.getIncludedFiles(), (vector<string>{ outer, inner }));
+}
+
+TEST(IncludeCache, LexesEachFileOnce)
+{
+	IncludeCache& cache = IncludeCache::shared();
+	cache.clear();
+	string folder = createUniqueTempFolder();
+	string lib = writeFile(folder, "lib.sas", "title 'lib';");
+	string code = "%include '" + lib + "';";
+
+	Lexer first(code), second(code);
+	EXPECT_EQ(texts(first), texts(second));
+	EXPECT_EQ(cache.misses(), 1u);
+	EXPECT_EQ(cache.hits(), 1u);
+	EXPECT_EQ(cache.tokens(lib), cache.tokens(lib));
+
+	// a changed file is lexed again
+	writeFile(folder, "lib.sas", "title 'changed lib';");
+	Lexer changed(code);
+	EXPECT_EQ(texts(changed), (vector<string>{ "title", "changed lib", ";" }));
+	EXPECT_EQ(cache.misses(), 2u);
+}
+
+TEST(IncludeCache, Errors)
+{
+	string folder = createUniqueTempFolder();
+	Lexer missing("%include '" + (fs::path(folder) / "missing.sas").string() + "';");
+	EXPECT_THROW(missing.tokenize(), runtime_error);
+
+	Lexer unquoted("%include lib;");
+	EXPECT_THROW(unquoted.tokenize(), runtime_error);
+
+	string self = (fs::path(folder) / "self.sas").string();
+	writeFile(folder, "self.sas", "%include '" + self + "';");
+	Lexer recursive("%include '" + self + "';");
+	EXPECT_THROW(recursive.tokenize(), runtime_error);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "StepFingerprint.h"
+#include "fixture.h"
+#include "TempUtils.h"
+
+using namespace sass;
+using namespace std;
+
+// data out.result; set nums; run;
+static unique_ptr<DataStepNode> makeStep(const string& outLib)
+{
+	auto step = make_unique<DataStepNode>();
+	step->outputDataSet.libref = outLib;
+	step->outputDataSet.dataName = "RESULT";
+	auto set = make_unique<SetStatementNode>();
+	DatasetRefNode in;
+	in.dataName = "NUMS";
+	set->dataSets.push_back(in);
+	step->statements.push_back(move(set));
+	return step;
+}
+
+TEST(Incremental, Fingerprint)
+{
+	string folder = createUniqueTempFolder();
+	DataEnvironment env;
+	ASSERT_EQ(env.defineLibrary("OUT", folder, LibraryAccess::READWRITE, "ARROW"), 0);
+	env.getLibrary("WORK")->addDataset("NUMS", numbersTable(10));
+	unordered_map<string, string> macros;
+
+	// WORK outputs are never reused
+	auto workStep = makeStep("");
+	EXPECT_FALSE(StepFingerprint(workStep.get(), env, macros).isEligible());
+
+	auto step = makeStep("OUT");
+	StepFingerprint first(step.get(), env, macros);
+	ASSERT_TRUE(first.isEligible());
+	EXPECT_EQ(first.describeOutputs(), "OUT.RESULT");
+	// nothing written yet
+	EXPECT_FALSE(first.isCurrent());
+
+	env.getLibrary("OUT")->addDataset("RESULT", numbersTable(10));
+	env.saveSas7bdat("OUT.RESULT");
+	first.store();
+	EXPECT_TRUE(StepFingerprint(step.get(), env, macros).isCurrent());
+
+	// a macro variable, an option or the WORK input changes the fingerprint
+	macros["YEAR"] = "2024";
+	EXPECT_FALSE(StepFingerprint(step.get(), env, macros).isCurrent());
+	macros.clear();
+	env.setOption("LINESIZE", "80");
+	EXPECT_FALSE(StepFingerprint(step.get(), env, macros).isCurrent());
+	env.options.erase("LINESIZE");
+	env.getLibrary("WORK")->addDataset("NUMS", numbersTable(11));
+	EXPECT_FALSE(StepFingerprint(step.get(), env, macros).isCurrent());
+	env.getLibrary("WORK")->addDataset("NUMS", numbersTable(10));
+	EXPECT_TRUE(StepFingerprint(step.get(), env, macros).isCurrent());
+
+	// so does the code
+	auto other = makeStep("OUT");
+	other->inputDataSet.dataName = "NUMS";
+	EXPECT_FALSE(StepFingerprint(other.get(), env, macros).isCurrent());
+
+	// an output written by someone else is not reused
+	env.getLibrary("OUT")->addDataset("RESULT", numbersTable(3));
+	env.saveSas7bdat("OUT.RESULT");
+	EXPECT_FALSE(StepFingerprint(step.get(), env, macros).isCurrent());
+
+	removeDirectoryRecursively(folder);
+}
+
+TEST(Incremental, SkipsUnchangedStep)
+{
+	string folder = createUniqueTempFolder();
+	auto run = [&](const string& value, const string& more = "") {
+		// every run is a new session
+		CapturedLog log;
+		DataEnvironment env;
+		Interpreter interpreter(env, *log, *log);
+		auto program = ProgramCache::compile(
+			"options incremental;\n"
+			"libname perm arrow '" + folder + "';\n"
+			"data perm.result;\n"
+			"   x = " + value + ";\n"
+			"   output;\n"
+			+ more +
+			"run;\n", nullptr);
+		interpreter.executeProgram(program);
+		if (!more.empty()) {
+			// resolved when the macro runs, after the step
+			interpreter.executeProgram(ProgramCache::compile("%macro show; title \"&answer\"; %mend show; %show", nullptr));
+		}
+		return log.str();
+	};
+
+	EXPECT_EQ(run("42").find("reused"), string::npos);
+	EXPECT_NE(run("42").find("PERM.RESULT reused from a previous run"), string::npos);
+	EXPECT_EQ(run("43").find("reused"), string::npos);
+
+	// a step with a CALL routine always runs: the macro variable is set every time
+	string symput = "   call symputx('answer', x);\n";
+	EXPECT_NE(run("44", symput).find("Title set to: '44'"), string::npos);
+	string again = run("44", symput);
+	EXPECT_EQ(again.find("reused"), string::npos);
+	EXPECT_NE(again.find("Title set to: '44'"), string::npos);
+
+	removeDirectoryRecursively(folder);
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "LogLimiter.h"
+
+using namespace sass;
+using namespace std;
+
+static size_t count(const string& text, const string& what)
+{
+	size_t n = 0;
+	for (size_t at = text.find(what); at != string::npos; at = text.find(what, at + 1)) {
+		n++;
+	}
+	return n;
+}
+
+TEST(LogLimiter, SuppressesPerSite)
+{
+	CapturedLog log;
+	LogLimiter limit(*log, 3);
+
+	for (int i = 0; i < 10; i++) {
+		limit.info("Duplicate key '{}' found.", i);
+		if (i < 2) limit.warn("Variable '{}' not found.", "x");
+	}
+	string text = log.str();
+	EXPECT_EQ(count(text, "Duplicate key"), 3u);
+	EXPECT_NE(text.find("Duplicate key '2' found."), string::npos);
+	EXPECT_EQ(text.find("Duplicate key '3' found."), string::npos);
+	EXPECT_EQ(count(text, "Variable 'x' not found."), 2u);
+	EXPECT_EQ(text.find("suppressed"), string::npos);
+
+	limit.flush();
+	text = log.str();
+	EXPECT_NE(text.find("NOTE: 7 similar messages suppressed, the first was: Duplicate key '0' found."), string::npos);
+	EXPECT_EQ(count(text, "suppressed"), 1u);
+
+	// after a flush every site starts over
+	limit.info("Duplicate key '{}' found.", 99);
+	EXPECT_NE(log.str().find("Duplicate key '99' found."), string::npos);
+}
+
+TEST(LogLimiter, NotesInFirstSeenOrder)
+{
+	CapturedLog log;
+	LogLimiter limit(*log, 1);
+
+	const char* names[] = { "c", "a", "d", "b", "e" };
+	for (int i = 0; i < 3; i++) {
+		limit.info("Site c {}", i);
+		limit.info("Site a {}", i);
+		limit.info("Site d {}", i);
+		limit.info("Site b {}", i);
+		limit.info("Site e {}", i);
+	}
+	limit.flush();
+	string text = log.str();
+	size_t last = 0;
+	for (const char* name : names) {
+		size_t at = text.find(string("suppressed, the first was: Site ") + name + " 0");
+		ASSERT_NE(at, string::npos);
+		EXPECT_GT(at, last);
+		last = at;
+	}
+}
+
+TEST(LogLimiter, NothingBelowTheLevel)
+{
+	CapturedLog log;
+	(*log).set_level(spdlog::level::warn);
+	LogLimiter limit(*log, 1);
+
+	for (int i = 0; i < 5; i++) {
+		limit.info("Duplicate key '{}' found.", i);
+		limit.debug("Resolving macro variable '&{}' to '{}'", "x", i);
+	}
+	limit.flush();
+	EXPECT_EQ(log.str(), "");
+}
+
+class LogLimiterSession : public SasSession {};
+
+TEST_F(LogLimiterSession, SortDuplicates)
+{
+
+	string code = "data t;\n  input k;\n  datalines;\n";
+	for (int i = 0; i < 50; i++) {
+		code += to_string(i % 2) + "\n";
+	}
+	code += ";\nrun;\nproc sort data=t out=s nodupkey; by k; run;\n";
+	run(code);
+
+	string text = log.str();
+	EXPECT_EQ(count(text, "\nDuplicate key"), 20u);
+	EXPECT_NE(text.find("NOTE: 28 similar messages suppressed, the first was: Duplicate key '0.000000_' found. Skipping duplicate observation."), string::npos);
+	EXPECT_NE(text.find("2 observations remain"), string::npos);
+	// the note closes the step that made the messages
+	EXPECT_GT(text.find("suppressed"), text.find("PROC SORT executed successfully"));
+	EXPECT_EQ(count(text, "suppressed"), 1u);
+}
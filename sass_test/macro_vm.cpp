@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "MacroVM.h"
+
+using namespace sass;
+using namespace std;
+
+TEST(MacroVM, Eval)
+{
+	EXPECT_EQ(evalMacroExpression("1 + 2 * 3"), 7);
+	EXPECT_EQ(evalMacroExpression("(1+2)*3"), 9);
+	EXPECT_EQ(evalMacroExpression("10/3"), 3);
+	EXPECT_EQ(evalMacroExpression("-3 + 1"), -2);
+	EXPECT_EQ(evalMacroExpression("2**3"), 8);
+	// integers compare as numbers, anything else as text
+	EXPECT_EQ(evalMacroExpression("2 < 10"), 1);
+	EXPECT_EQ(evalMacroExpression("b < a10"), 0);
+	EXPECT_EQ(evalMacroExpression("New York eq New York"), 1);
+	EXPECT_EQ(evalMacroExpression("= "), 1);
+	EXPECT_EQ(evalMacroExpression("1 and not 0 | 0"), 1);
+	EXPECT_EQ(evalMacroExpression("3 ne 3 or 2 ge 3"), 0);
+	EXPECT_THROW(evalMacroExpression("abc + 1"), runtime_error);
+	EXPECT_THROW(evalMacroExpression("1 / 0"), runtime_error);
+	EXPECT_THROW(evalMacroExpression("(1 + 2"), runtime_error);
+}
+
+class MacroRun : public ::testing::Test {
+protected:
+	unordered_map<string, string> globals;
+	unordered_map<string, shared_ptr<const CompiledMacro>> macros;
+	CapturedLog log;
+
+	void define(const string& name, vector<string> parameters, const string& body)
+	{
+		auto macro = make_shared<CompiledMacro>();
+		macro->name = name;
+		macro->parameters = parameters;
+		macro->program = compileMacro(body);
+		macros[name] = macro;
+	}
+
+	string run(const string& name, vector<string> arguments)
+	{
+		MacroVM vm(globals, [&](const string& n) { return macros.count(n) ? macros[n] : nullptr; }, *log);
+		vm.call(macros.at(name), arguments);
+		string text, piece;
+		while (vm.next(piece)) {
+			text += piece;
+		}
+		return text;
+	}
+};
+
+TEST_F(MacroRun, Loops)
+{
+	define("GEN", { "N" }, "%do i = 1 %to &n; data d&i._x; %end;");
+	EXPECT_EQ(run("GEN", { "3" }), " data d1_x;  data d2_x;  data d3_x; ");
+	define("DOWN", {}, "%do i = 6 %to 1 %by -2;&i %end;%let j = 0;%do %while(&j < 2);w&j %let j = %eval(&j + 1);%end;%do %until(&j = 0);u&j %let j = %eval(&j - 1);%end;");
+	EXPECT_EQ(run("DOWN", {}), "6 4 2 w0 w1 u2 u1 ");
+	// %do index and %let variables of a macro are local to it
+	EXPECT_EQ(globals.count("I"), 0u);
+	EXPECT_EQ(globals.count("J"), 0u);
+}
+
+TEST_F(MacroRun, ConditionsAndFunctions)
+{
+	globals["MODE"] = "full";
+	define("PICK", { "LIST", "K" },
+		"%if &mode = full %then %do; all %end; %else part;"
+		"%if %eval(&k > 1) %then %put k is &k;"
+		" %scan(&list, &k) %substr(&list, 3, 2) %upcase(%scan(&list, -1)) '&k' \"&k\"");
+	EXPECT_EQ(run("PICK", { "ab cd ef", "2" }), " all  cd  c EF '&k' \"2\"");
+	EXPECT_NE(log.str().find("k is 2"), string::npos);
+	globals["MODE"] = "quick";
+	EXPECT_EQ(run("PICK", { "ab cd ef", "1" }), "part; ab  c EF '&k' \"1\"");
+}
+
+TEST_F(MacroRun, IndirectReferencesAndCalls)
+{
+	globals["X1"] = "first";
+	globals["X2"] = "second";
+	define("INNER", { "V" }, "<&v>");
+	define("OUTER", {}, "%do i = 1 %to 2;%inner(&&x&i) %end;%let made = yes;");
+	EXPECT_EQ(run("OUTER", {}), "<first> <second> ");
+	// a new variable set in a macro is local to it, one defined before is set where it is
+	EXPECT_EQ(globals.count("MADE"), 0u);
+	globals["MADE"] = "no";
+	run("OUTER", {});
+	EXPECT_EQ(globals["MADE"], "yes");
+
+	define("BAD", {}, "%nosuch(1)");
+	EXPECT_THROW(run("BAD", {}), runtime_error);
+	EXPECT_THROW(compileMacro("%do i = 1 %to 2; x"), runtime_error);
+	EXPECT_THROW(compileMacro("%if 1 x;"), runtime_error);
+}
+
+class MacroSession : public SasSession {};
+
+TEST_F(MacroSession, GeneratedStepsRun)
+{
+	run(
+		"%macro titles(n);\n"
+		"  %do i = 1 %to &n;\n"
+		"    title \"Page &i of &n\";\n"
+		"  %end;\n"
+		"  options linesize=%eval(60 + &n * 10);\n"
+		"%mend titles;\n"
+		"%titles(3)\n");
+	EXPECT_NE(log.str().find("Title set to: 'Page 2 of 3'"), string::npos);
+	EXPECT_EQ(env.title, "Page 3 of 3");
+	EXPECT_EQ(env.getOption("LINESIZE"), "90");
+	EXPECT_NE(log.str().find("Macro 'titles' executed successfully."), string::npos);
+}
+
+TEST_F(MacroSession, PutInOpenCode)
+{
+	run(
+		"%let x = \"5\";\n"
+		"%put value is &x;\n"
+		"%PUT done;\n");
+	EXPECT_NE(log.str().find("value is 5"), string::npos);
+	EXPECT_NE(log.str().find("done"), string::npos);
+	EXPECT_EQ(log.str().find("Undefined macro"), string::npos);
+}
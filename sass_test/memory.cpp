@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "MemoryManager.h"
+#include "Library.h"
+#include "sasdoc.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+TEST(Memory, ParseMemSize)
+{
+	EXPECT_EQ(MemoryManager::parseMemSize("64K"), 64u * 1024);
+	EXPECT_EQ(MemoryManager::parseMemSize("512m"), 512u * 1024 * 1024);
+	EXPECT_EQ(MemoryManager::parseMemSize("2G"), 2ull * 1024 * 1024 * 1024);
+	EXPECT_EQ(MemoryManager::parseMemSize("1048576"), 1048576u);
+	EXPECT_EQ(MemoryManager::parseMemSize("MAX"), 0u);
+	EXPECT_THROW(MemoryManager::parseMemSize("lots"), std::runtime_error);
+	EXPECT_EQ(MemoryManager::formatKilobytes(1536), "1.50k");
+}
+
+TEST(Memory, ChargeOverLimit)
+{
+	MemoryManager memory;
+	memory.setLimit(1000);
+	{
+		MemoryCharge charge(memory, "PROCEDURE MEANS");
+		EXPECT_TRUE(charge.grow(600));
+		EXPECT_FALSE(charge.grow(600));
+		EXPECT_EQ(memory.getUsed(), 600u);
+		EXPECT_THROW(charge.require(600), std::runtime_error);
+	}
+	EXPECT_EQ(memory.getUsed(), 0u);
+	EXPECT_EQ(memory.getPeak(), 600u);
+}
+
+TEST(Memory, SpillColdDataset)
+{
+	DataEnvironment env;
+	auto work = env.getLibrary("WORK");
+
+	auto doc = std::make_shared<SasDoc>();
+	doc->name = "BIG";
+	doc->var_count = 2;
+	doc->obs_count = 1000;
+	doc->var_names = { "x", "name" };
+	doc->var_labels = { "", "" };
+	doc->var_formats = { "", "" };
+	doc->var_types = { READSTAT_TYPE_DOUBLE, READSTAT_TYPE_STRING };
+	doc->var_length = { 8, 8 };
+	doc->var_display_length = { 0, 0 };
+	doc->var_decimals = { 0, 0 };
+	for (int i = 0; i < doc->obs_count; i++) {
+		doc->values.push_back(i % 10 == 0 ? -INFINITY : double(i));
+		doc->values.push_back(flyweight_string("row" + to_string(i)));
+	}
+	work->addDataset("BIG", doc);
+	doc.reset();
+
+	env.refreshMemoryUsage();
+	size_t size = env.memory.getUsed();
+	EXPECT_GT(size, 0u);
+
+	// Half of the dataset size: BIG has to go to WORK
+	env.memory.setLimit(size / 2);
+	EXPECT_TRUE(work->isSpilled("BIG"));
+	EXPECT_EQ(env.memory.getUsed(), 0u);
+	auto notes = env.takeMemoryNotes();
+	ASSERT_EQ(notes.size(), 1u);
+	EXPECT_NE(notes[0].find("WORK.BIG"), string::npos);
+
+	// and comes back transparently
+	env.memory.setLimit(0);
+	auto back = std::dynamic_pointer_cast<SasDoc>(work->getDataset("BIG"));
+	ASSERT_NE(back, nullptr);
+	EXPECT_FALSE(work->isSpilled("BIG"));
+	EXPECT_EQ(back->obs_count, 1000);
+	EXPECT_TRUE(std::isinf(std::get<double>(back->values[0])));
+	EXPECT_EQ(std::get<double>(back->values[2]), 1.0);
+	EXPECT_EQ(std::get<flyweight_string>(back->values[3]).get(), "row1");
+}
+
+class MemoryOptions : public SasSession {};
+
+TEST_F(MemoryOptions, FlagOptions)
+{
+	run("options fullstimer notes nonumber;");
+	EXPECT_EQ(env.getOption("FULLSTIMER"), "1");
+	EXPECT_EQ(env.getOption("NOTES"), "1");
+	EXPECT_EQ(env.getOption("NUMBER"), "0");
+	EXPECT_EQ(env.getOption("TES"), "");
+
+	run("options nofullstimer nonotes;");
+	EXPECT_EQ(env.getOption("FULLSTIMER"), "0");
+	EXPECT_EQ(env.getOption("NOTES"), "0");
+	// NO is only taken off the options known as flags
+	run("options nosuch;");
+	EXPECT_EQ(env.getOption("NOSUCH"), "1");
+	EXPECT_EQ(env.getOption("SUCH"), "");
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "ProgramCache.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static const string program = R"(
+	options linesize=80;
+	libname mylib 'c:\data' access=readonly;
+	title 'Report';
+	data out;
+	   set mylib.in(keep=x y firstobs=2);
+	   array a{2} x y;
+	   if x > 1 then y = x * 2;
+	   else y = 'low';
+	   output;
+	run;
+	proc print data=out;
+	run;
+)";
+
+TEST(ProgramCache, RoundTrip)
+{
+	bool hit = true;
+	auto parsed = ProgramCache::compile(program, nullptr, &hit);
+	EXPECT_FALSE(hit);
+	ASSERT_FALSE(parsed->statements.empty());
+
+	string bytes = ProgramCache::serialize(*parsed);
+	auto copy = ProgramCache::deserialize(bytes);
+	ASSERT_EQ(copy->statements.size(), parsed->statements.size());
+	EXPECT_EQ(ProgramCache::serialize(*copy), bytes);
+
+	auto step = dynamic_cast<DataStepNode*>(copy->statements[3].get());
+	ASSERT_NE(step, nullptr);
+	EXPECT_EQ(step->outputDataSet.dataName, "OUT");
+
+	EXPECT_THROW(ProgramCache::deserialize(bytes.substr(0, bytes.size() / 2)), std::runtime_error);
+}
+
+TEST(ProgramCache, HitAndMiss)
+{
+	string folder = createUniqueTempFolder();
+	{
+		ProgramCache cache(folder);
+		bool hit = true;
+		auto first = ProgramCache::compile(program, &cache, &hit);
+		EXPECT_FALSE(hit);
+		auto second = ProgramCache::compile(program, &cache, &hit);
+		EXPECT_TRUE(hit);
+		EXPECT_EQ(ProgramCache::serialize(*first), ProgramCache::serialize(*second));
+
+		// any change to the source is a different entry
+		EXPECT_EQ(cache.load(program + " "), nullptr);
+
+		// a damaged entry is a miss, not an error
+		string entry = (fs::path(folder) / (ProgramCache::key(program) + ".ast")).string();
+		ASSERT_TRUE(fs::exists(entry));
+		fs::resize_file(entry, fs::file_size(entry) - 5);
+		EXPECT_EQ(cache.load(program), nullptr);
+		ProgramCache::compile(program, &cache, &hit);
+		EXPECT_FALSE(hit);
+		EXPECT_NE(cache.load(program), nullptr);
+	}
+	removeDirectoryRecursively(folder);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "Rank.h"
+#include <random>
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+static vector<double> ranksOf(const vector<double>& values, Ranker::Options options)
+{
+	vector<double> ranks(values.size());
+	Ranker::rankValues(values, ranks, options);
+	return ranks;
+}
+
+TEST(Rank, Ties)
+{
+	vector<double> values = { 30, 10, 20, 10, -INFINITY, 40, 20 };
+	Ranker::Options options;
+	EXPECT_EQ(ranksOf(values, options), (vector<double>{ 5, 1.5, 3.5, 1.5, -INFINITY, 6, 3.5 }));
+	options.ties = RankTies::Low;
+	EXPECT_EQ(ranksOf(values, options), (vector<double>{ 5, 1, 3, 1, -INFINITY, 6, 3 }));
+	options.ties = RankTies::High;
+	EXPECT_EQ(ranksOf(values, options), (vector<double>{ 5, 2, 4, 2, -INFINITY, 6, 4 }));
+	options.ties = RankTies::Dense;
+	EXPECT_EQ(ranksOf(values, options), (vector<double>{ 3, 1, 2, 1, -INFINITY, 4, 2 }));
+	options.descending = true;
+	EXPECT_EQ(ranksOf(values, options), (vector<double>{ 2, 4, 3, 4, -INFINITY, 1, 3 }));
+}
+
+TEST(Rank, Groups)
+{
+	// quartiles of 1..8: floor(rank * 4 / 9)
+	vector<double> values = { 8, 7, 6, 5, 4, 3, 2, 1 };
+	Ranker::Options options;
+	options.groups = 4;
+	EXPECT_EQ(ranksOf(values, options), (vector<double>{ 3, 3, 2, 2, 1, 1, 0, 0 }));
+}
+
+TEST(Rank, ByGroupsInParallel)
+{
+	mt19937_64 random(3);
+	uniform_int_distribution<int> uniform(0, 1000);
+	size_t rows = 200000;
+	vector<vector<double>> columns(2, vector<double>(rows));
+	for (auto& column : columns) {
+		for (auto& v : column) v = uniform(random);
+	}
+	vector<size_t> groupStarts;
+	for (size_t start = 0; start < rows; start += 7919) groupStarts.push_back(start);
+	groupStarts.push_back(rows);
+
+	Ranker::Options options;
+	auto one = Ranker::rank(columns, groupStarts, options, 1);
+	auto many = Ranker::rank(columns, groupStarts, options, 4);
+	EXPECT_EQ(one, many);
+
+	// each group is ranked on its own
+	size_t begin = groupStarts[3], end = groupStarts[4];
+	vector<double> group(columns[1].begin() + begin, columns[1].begin() + end);
+	vector<double> expected = ranksOf(group, options);
+	EXPECT_TRUE(equal(expected.begin(), expected.end(), many[1].begin() + begin));
+}
+
+class RankSession : public SasSession {};
+
+TEST_F(RankSession, Procedure)
+{
+	run(
+		"data scores;\n"
+		"   input team $ score;\n"
+		"   datalines;\n"
+		"A 7\nA 9\nA 7\nB 1\nB .\nB 3\n"
+		";\n"
+		"run;\n"
+		"proc rank data=scores out=ranked ties=low descending;\n"
+		"   by team;\n"
+		"   var score;\n"
+		"   ranks place;\n"
+		"run;\n");
+
+	auto ranked = table("RANKED");
+	ASSERT_NE(ranked, nullptr);
+	EXPECT_EQ(ranked->var_names, (vector<string>{ "team", "score", "place" }));
+	ASSERT_EQ(ranked->obs_count, 6);
+	// rows stay where they were
+	vector<double> scores, places;
+	for (int r = 0; r < 6; r++) {
+		scores.push_back(get<double>(ranked->values[r * 3 + 1]));
+		places.push_back(get<double>(ranked->values[r * 3 + 2]));
+	}
+	EXPECT_EQ(scores, (vector<double>{ 7, 9, 7, 1, -INFINITY, 3 }));
+	EXPECT_EQ(places, (vector<double>{ 2, 1, 2, 2, -INFINITY, 1 }));
+
+	// without OUT= and RANKS the ranks replace the values in WORK.DATA1
+	run("proc rank data=scores; var score; run;");
+	auto data1 = table("DATA1");
+	ASSERT_NE(data1, nullptr);
+	EXPECT_EQ(data1->var_count, 2);
+	EXPECT_EQ(get<double>(data1->values[1]), 3.5);
+
+	// BY needs sorted data
+	run("data unsorted; input team $ score; datalines;\nB 1\nA 2\n;\nrun;\n"
+		"proc rank data=unsorted out=bad; by team; var score; run;");
+	EXPECT_NE(log.str().find("not sorted"), string::npos);
+	EXPECT_FALSE(env.getLibrary("WORK")->hasDataset("BAD"));
+}
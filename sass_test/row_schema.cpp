@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "Dataset.h"
+#include "sasdoc.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+TEST(RowSchema, ReadsLikeAMap)
+{
+	Row row;
+	row.columns["b"] = 2.0;
+	row.columns["a"] = string("x");
+	EXPECT_EQ(row.columns.size(), 2u);
+	EXPECT_EQ(get<double>(row.columns.at("b")), 2.0);
+	EXPECT_EQ(row.columns.count("c"), 0u);
+	EXPECT_THROW(row.columns.at("c"), out_of_range);
+
+	// columns come in the order they were added
+	vector<string> names;
+	for (const auto& col : row.columns) names.push_back(col.first);
+	EXPECT_EQ(names, (vector<string>{ "b", "a" }));
+
+	EXPECT_EQ(row.columns.erase("b"), 1u);
+	EXPECT_TRUE(row.columns.find("b") == row.columns.end());
+	EXPECT_EQ(row.columns.begin()->first, "a");
+	row.columns.clear();
+	EXPECT_TRUE(row.columns.empty());
+}
+
+TEST(RowSchema, RowsShareTheSchema)
+{
+	auto schema = make_shared<Schema>(vector<string>{ "id", "name" });
+	Row first{ RowColumns(schema) }, second{ RowColumns(schema) };
+	first.columns["id"] = 1.0;
+	second.columns["id"] = 2.0;
+	// a new name gets a slot in the shared schema; the other row has no value there
+	first.columns["extra"] = 3.0;
+	EXPECT_EQ(schema->size(), 3u);
+	EXPECT_EQ(second.columns.count("extra"), 0u);
+	EXPECT_EQ(second.columns.size(), 1u);
+
+	// a cache (of one name) serves every row of the schema, and is looked up again for another
+	SlotCache cache;
+	EXPECT_EQ(get<double>(*first.columns.find("id", cache)), 1.0);
+	EXPECT_EQ(cache.slot, 0);
+	EXPECT_EQ(get<double>(*second.columns.find("id", cache)), 2.0);
+	Row other;
+	other.columns["name"] = string("n");
+	other.columns["id"] = 4.0;
+	EXPECT_EQ(get<double>(*other.columns.find("id", cache)), 4.0);
+	EXPECT_EQ(cache.slot, 1);
+	SlotCache missing;
+	EXPECT_EQ(other.columns.find("missing", missing), nullptr);
+	// a column added to the schema afterwards is found with the same cache
+	other.columns["missing"] = 5.0;
+	ASSERT_NE(other.columns.find("missing", missing), nullptr);
+	EXPECT_EQ(get<double>(*other.columns.find("missing", missing)), 5.0);
+}
+
+TEST(RowSchema, ScanRowsShareTheScanSchema)
+{
+	SasDoc doc;
+	doc.var_count = 2;
+	doc.obs_count = 3;
+	doc.var_names = { "x", "s" };
+	doc.var_types = { READSTAT_TYPE_DOUBLE, READSTAT_TYPE_STRING };
+	for (int i = 0; i < 3; i++) {
+		doc.values.push_back(double(i));
+		doc.values.push_back(flyweight_string("r" + to_string(i)));
+	}
+
+	vector<Row> rows;
+	auto cursor = doc.scan();
+	while (cursor.next()) {
+		const ColumnBatch& batch = cursor.batch();
+		for (size_t i = 0; i < batch.size(); i++) {
+			batch.fillRow(i, rows.emplace_back());
+		}
+	}
+	ASSERT_EQ(rows.size(), 3u);
+	EXPECT_EQ(rows[0].columns.schema(), rows[2].columns.schema());
+	EXPECT_EQ(get<string>(rows[2].columns.at("s")), "r2");
+
+	// row based data scans through the slots
+	Dataset& rowBased = doc;
+	rowBased.rows = CowVector<Row>(rows);
+	doc.values = CowVector<Cell>();
+	auto rowCursor = rowBased.scan({ "x" });
+	ASSERT_TRUE(rowCursor.next());
+	EXPECT_EQ(rowCursor.batch().numbers(0)[1], 1.0);
+}
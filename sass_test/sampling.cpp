@@ -0,0 +1,277 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "LibraryEngine.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <set>
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// rows of (id, x, name): x = 0..rows-1, id = x / perId
+static SasDoc makeRows(int rows, int perId)
+{
+	return *TableBuilder("ROWS", rows)
+		.number("id", [perId](int i) { return double(i / perId); })
+		.number("x", [](int i) { return double(i); })
+		.text("name", [](int i) { return "n" + to_string(i); })
+		.build();
+}
+
+static vector<double> column(const SasDoc& doc, int col)
+{
+	vector<double> out;
+	for (int r = 0; r < doc.obs_count; r++) {
+		out.push_back(get<double>(doc.values[r * doc.var_count + col]));
+	}
+	return out;
+}
+
+TEST(Sampling, Fraction)
+{
+	string folder = createUniqueTempFolder();
+	auto engine = LibraryEngine::create("ARROW");
+	string path = engine->memberPath(folder, "ROWS");
+	SasDoc doc = makeRows(2000, 1);
+	ASSERT_EQ(engine->write(path, &doc), 0);
+
+	ReadOptions options;
+	options.sample = 0.25;
+	options.sampleSeed = 7;
+	SasDoc a, b;
+	ASSERT_EQ(engine->read(path, &a, options), 0);
+	ASSERT_EQ(engine->read(path, &b, options), 0);
+	EXPECT_GT(a.obs_count, 400);
+	EXPECT_LT(a.obs_count, 600);
+	// the same seed picks the same rows
+	EXPECT_EQ(column(a, 1), column(b, 1));
+	// kept rows are whole rows
+	for (int r = 0; r < a.obs_count; r++) {
+		double x = get<double>(a.values[r * 3 + 1]);
+		EXPECT_EQ(get<flyweight_string>(a.values[r * 3 + 2]).get(), "n" + to_string((int)x));
+	}
+
+	options.sampleSeed = 8;
+	SasDoc c;
+	ASSERT_EQ(engine->read(path, &c, options), 0);
+	EXPECT_NE(column(a, 1), column(c, 1));
+
+	removeDirectoryRecursively(folder);
+}
+
+TEST(Sampling, Count)
+{
+	string folder = createUniqueTempFolder();
+	auto engine = LibraryEngine::create("ARROW");
+	string path = engine->memberPath(folder, "ROWS");
+	SasDoc doc = makeRows(1000, 1);
+	ASSERT_EQ(engine->write(path, &doc), 0);
+
+	ReadOptions options;
+	options.sample = 50;
+	options.sampleSeed = 3;
+	options.keep = { "X" };
+	SasDoc a;
+	ASSERT_EQ(engine->read(path, &a, options), 0);
+	ASSERT_EQ(a.obs_count, 50);
+	auto x = column(a, 0);
+	// distinct rows, in the order of the member
+	EXPECT_TRUE(is_sorted(x.begin(), x.end()));
+	EXPECT_EQ(set<double>(x.begin(), x.end()).size(), 50u);
+
+	// more rows than there are: all of them
+	options.sample = 5000;
+	SasDoc all;
+	ASSERT_EQ(engine->read(path, &all, options), 0);
+	EXPECT_EQ(all.obs_count, 1000);
+
+	removeDirectoryRecursively(folder);
+}
+
+TEST(Sampling, ByKey)
+{
+	string folder = createUniqueTempFolder();
+	auto engine = LibraryEngine::create("ARROW");
+	// the same ids, 5 rows each in one table and 1 row each in the other
+	SasDoc visits = makeRows(1000, 5);
+	SasDoc patients = makeRows(200, 1);
+	ASSERT_EQ(engine->write(engine->memberPath(folder, "VISITS"), &visits), 0);
+	ASSERT_EQ(engine->write(engine->memberPath(folder, "PATIENTS"), &patients), 0);
+
+	ReadOptions options;
+	options.sample = 0.3;
+	options.sampleSeed = 11;
+	options.sampleKey = "ID";
+	// the key decides even when it is not read
+	options.keep = { "X" };
+	SasDoc v, p;
+	ASSERT_EQ(engine->read(engine->memberPath(folder, "VISITS"), &v, options), 0);
+	ASSERT_EQ(engine->read(engine->memberPath(folder, "PATIENTS"), &p, options), 0);
+	EXPECT_EQ(v.var_count, 1);
+	ASSERT_GT(p.obs_count, 0);
+	EXPECT_LT(p.obs_count, 200);
+
+	// every visit of a sampled patient is kept, and no other
+	map<int, int> visitsPerId;
+	for (double x : column(v, 0)) visitsPerId[(int)x / 5]++;
+	set<int> patientIds;
+	for (double x : column(p, 0)) patientIds.insert((int)x);
+	EXPECT_EQ(visitsPerId.size(), patientIds.size());
+	for (auto& kv : visitsPerId) {
+		EXPECT_TRUE(patientIds.count(kv.first));
+		EXPECT_EQ(kv.second, 5);
+	}
+
+	removeDirectoryRecursively(folder);
+}
+
+class SamplingSession : public SasSession {};
+
+TEST_F(SamplingSession, SystemOptions)
+{
+	run("options obs=5 sample=0.5 sampleseed=42 samplekey=id;");
+	EXPECT_NE(log.str().find("read as a sample"), string::npos);
+
+	ReadOptions options = env.readOptions(ReadOptions());
+	EXPECT_EQ(options.obs, 5);
+	EXPECT_EQ(options.sample, 0.5);
+	EXPECT_EQ(options.sampleSeed, 42u);
+	EXPECT_EQ(options.sampleKey, "id");
+
+	// the dataset's own OBS= wins
+	ReadOptions dsOptions;
+	dsOptions.obs = 20;
+	EXPECT_EQ(env.readOptions(dsOptions).obs, 20);
+
+	env.setOption("OBS", "max");
+	EXPECT_EQ(env.readOptions(ReadOptions()).obs, -1);
+
+	// a key only works with a fraction
+	env.setOption("SAMPLE", "100");
+	EXPECT_THROW(env.readOptions(ReadOptions()), runtime_error);
+}
+
+TEST_F(SamplingSession, InvalidOptions)
+{
+	// rejected when the OPTIONS statement runs, not when a data set is read
+	run("options sample=all;");
+	EXPECT_NE(log.str().find("SAMPLE= must be a fraction of the rows or a number of rows: all"), string::npos);
+	run("options sampleseed=x obs=ten;");
+	EXPECT_NE(log.str().find("Invalid SAMPLESEED value: x"), string::npos);
+	run("options obs=ten;");
+	EXPECT_NE(log.str().find("Invalid OBS value: ten"), string::npos);
+	run("options distinctprecision=high;");
+	EXPECT_NE(log.str().find("DISTINCTPRECISION= must be between"), string::npos);
+	EXPECT_EQ(env.getOption("SAMPLE"), "");
+	EXPECT_EQ(env.getOption("SAMPLESEED"), "");
+	EXPECT_EQ(env.getOption("OBS"), "");
+	EXPECT_NO_THROW(env.readOptions(ReadOptions()));
+
+	// the values the options can have
+	EXPECT_EQ(DataEnvironment::parseObs("max"), -1);
+	EXPECT_EQ(DataEnvironment::parseObs("10"), 10);
+	EXPECT_THROW(DataEnvironment::parseObs("-1"), runtime_error);
+	EXPECT_EQ(DataEnvironment::parseSample("0.25"), 0.25);
+	EXPECT_THROW(DataEnvironment::parseSample("0"), runtime_error);
+	EXPECT_THROW(DataEnvironment::parseSample("10%"), runtime_error);
+	EXPECT_EQ(DataEnvironment::parseSampleSeed("42"), 42u);
+	EXPECT_THROW(DataEnvironment::parseSampleSeed("-1"), runtime_error);
+
+	// set some other way, a bad value fails the read with the same error
+	env.setOption("SAMPLE", "0.5");
+	env.setOption("SAMPLESEED", "x");
+	EXPECT_THROW(env.readOptions(ReadOptions()), runtime_error);
+}
+
+class DatasetOptionsSession : public SasSession {
+protected:
+	string folder = createUniqueTempFolder();
+
+	void SetUp() override
+	{
+		run(
+			"libname perm arrow '" + folder + "';\n"
+			"data perm.a;\n"
+			"   input x y z;\n"
+			"   datalines;\n"
+			"1 10 100\n"
+			"2 20 200\n"
+			"3 30 300\n"
+			"4 40 400\n"
+			";\n"
+			"run;\n");
+	}
+
+	void TearDown() override
+	{
+		removeDirectoryRecursively(folder);
+	}
+};
+
+TEST_F(DatasetOptionsSession, Input)
+{
+	run(
+		"data b;\n"
+		"   set perm.a(keep=x z firstobs=2 obs=3);\n"
+		"run;\n"
+		"data c;\n"
+		"   set perm.a(drop=y);\n"
+		"run;\n"
+		"data d;\n"
+		"   set perm.a;\n"
+		"run;\n");
+	auto b = table("B");
+	ASSERT_NE(b, nullptr);
+	EXPECT_EQ(b->obs_count, 2);
+	EXPECT_EQ(b->var_names, (vector<string>{ "x", "z" }));
+	EXPECT_EQ(b->get_value_double(0, 0), 2);
+	EXPECT_EQ(b->get_value_double(1, 1), 300);
+
+	auto c = table("C");
+	ASSERT_NE(c, nullptr);
+	EXPECT_EQ(c->obs_count, 4);
+	EXPECT_EQ(c->var_names, (vector<string>{ "x", "z" }));
+
+	// the subsets were not kept as the member
+	auto d = table("D");
+	ASSERT_NE(d, nullptr);
+	EXPECT_EQ(d->obs_count, 4);
+	EXPECT_EQ(d->var_count, 3);
+}
+
+TEST_F(DatasetOptionsSession, Output)
+{
+	run(
+		"data perm.e(drop=y);\n"
+		"   set perm.a;\n"
+		"run;\n"
+		"data f(keep=x);\n"
+		"   set perm.a;\n"
+		"run;\n"
+		"proc sort data=perm.a out=g(drop=z);\n"
+		"   by y;\n"
+		"run;\n");
+	auto e = std::dynamic_pointer_cast<SasDoc>(env.getLibrary("PERM")->getDataset("E"));
+	ASSERT_NE(e, nullptr);
+	EXPECT_EQ(e->var_names, (vector<string>{ "x", "z" }));
+	EXPECT_EQ(e->obs_count, 4);
+	// and so was the file
+	auto read = env.getLibrary("PERM")->readDataset("E", ReadOptions());
+	ASSERT_NE(read, nullptr);
+	EXPECT_EQ(read->var_count, 2);
+
+	ASSERT_NE(table("F"), nullptr);
+	EXPECT_EQ(table("F")->var_names, (vector<string>{ "x" }));
+	ASSERT_NE(table("G"), nullptr);
+	EXPECT_EQ(table("G")->var_names, (vector<string>{ "x", "y" }));
+
+	// they only select the rows to read
+	run(
+		"data h(obs=2);\n"
+		"   set perm.a;\n"
+		"run;\n");
+	EXPECT_NE(log.str().find("FIRSTOBS= and OBS= are not valid for the output data set WORK.H."), string::npos);
+}
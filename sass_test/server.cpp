@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "Server.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+#ifndef _WIN32
+TEST(Server, IsolatedJobs)
+{
+	string folder = createUniqueTempFolder();
+	string socketPath = (fs::path(folder) / "sass.sock").string();
+	Server server(socketPath);
+	thread daemon([&]() { server.run(); });
+	// wait for the socket
+	for (int i = 0; i < 100 && !fs::exists(socketPath); i++) {
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	ostringstream log1, lst1;
+	int rc = submitProgram(socketPath, R"(
+		data a;
+		   x = 42;
+		   output;
+		run;
+		proc print data=a;
+		run;
+	)", log1, lst1);
+	EXPECT_EQ(rc, 0);
+	EXPECT_FALSE(log1.str().empty());
+	EXPECT_NE(lst1.str().find("42"), string::npos);
+
+	// a new job gets its own WORK: A from the first job is gone
+	ostringstream log2, lst2;
+	rc = submitProgram(socketPath, "proc print data=a; run;", log2, lst2);
+	EXPECT_EQ(rc, 0);
+	EXPECT_EQ(lst2.str().find("42"), string::npos);
+
+	// a statement that fails fails the job
+	ostringstream log3, lst3;
+	EXPECT_EQ(submitProgram(socketPath, "options sample=all; title 'still runs';", log3, lst3), 1);
+	EXPECT_NE(log3.str().find("SAMPLE="), string::npos);
+	EXPECT_NE(log3.str().find("still runs"), string::npos);
+
+	// only the owner can connect, and a second server leaves the socket alone
+	EXPECT_EQ(fs::status(socketPath).permissions() & fs::perms::all, fs::perms::owner_read | fs::perms::owner_write);
+	Server second(socketPath);
+	EXPECT_EQ(second.run(), 1);
+	EXPECT_EQ(submitProgram(socketPath, "run;", log2, lst2), 0);
+
+	// a frame over the limit ends the connection instead of being read
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+	ASSERT_EQ(::connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+	string header = "P" + to_string(Server::maxFrameSize + 1) + "\n";
+	ASSERT_EQ(::send(fd, header.data(), header.size(), 0), (ssize_t)header.size());
+	char c;
+	EXPECT_EQ(::recv(fd, &c, 1, 0), 0);
+	::close(fd);
+
+	server.stop();
+	daemon.join();
+	EXPECT_FALSE(fs::exists(socketPath));
+	EXPECT_EQ(submitProgram(socketPath, "run;", log2, lst2), -1);
+	removeDirectoryRecursively(folder);
+}
+#endif
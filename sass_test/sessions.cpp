@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "DataEnvironment.h"
+#include "LibraryRegistry.h"
+#include "fixture.h"
+#include "TempUtils.h"
+#include <thread>
+#include <atomic>
+
+using namespace sass;
+using namespace std;
+
+TEST(Sessions, ShareLibrary)
+{
+	string folder = createUniqueTempFolder();
+	auto registry = make_shared<LibraryRegistry>();
+	DataEnvironment env1(registry), env2(registry);
+	ASSERT_EQ(env1.defineLibrary("SHARED", folder, LibraryAccess::READWRITE, "ARROW"), 0);
+	ASSERT_EQ(env2.defineLibrary("MINE", folder, LibraryAccess::READWRITE, "ARROW"), 0);
+	EXPECT_EQ(env1.getLibrary("SHARED"), env2.getLibrary("MINE"));
+	// WORK stays private
+	EXPECT_NE(env1.getLibrary("WORK"), env2.getLibrary("WORK"));
+	EXPECT_NE(env1.getLibrary("WORK")->getPath(), env2.getLibrary("WORK")->getPath());
+
+	env1.getLibrary("SHARED")->addDataset("NUMS", numbersTable(100));
+	env1.saveSas7bdat("SHARED.NUMS");
+
+	// Loading the unchanged member again shares the cells instead of decoding them
+	DatasetRefNode ref;
+	ref.libref = "SHARED";
+	ref.dataName = "NUMS";
+	auto a = dynamic_pointer_cast<SasDoc>(env1.getOrCreateDataset(ref));
+	ref.libref = "MINE";
+	auto b = dynamic_pointer_cast<SasDoc>(env2.getOrCreateDataset(ref));
+	ASSERT_NE(a, nullptr);
+	ASSERT_NE(b, nullptr);
+	EXPECT_NE(a, b);
+	EXPECT_TRUE(a->values.sharesWith(b->values));
+	EXPECT_EQ(b->obs_count, 100);
+
+	// a change in one session is not seen by the other until it is saved
+	a->values.mutate()[0] = 1000.0;
+	EXPECT_EQ(get<double>(b->values[0]), 1.0);
+
+	removeDirectoryRecursively(folder);
+}
+
+TEST(Sessions, ConcurrentReaders)
+{
+	string folder = createUniqueTempFolder();
+	auto registry = make_shared<LibraryRegistry>();
+	{
+		DataEnvironment env(registry);
+		ASSERT_EQ(env.defineLibrary("LIB", folder, LibraryAccess::READWRITE, "ARROW"), 0);
+		env.getLibrary("LIB")->addDataset("NUMS", numbersTable(1000));
+		env.saveSas7bdat("LIB.NUMS");
+	}
+
+	atomic<int> good{ 0 };
+	vector<thread> sessions;
+	for (int t = 0; t < 8; t++) {
+		sessions.emplace_back([&]() {
+			DataEnvironment env(registry);
+			env.defineLibrary("LIB", folder, LibraryAccess::READWRITE, "ARROW");
+			DatasetRefNode ref;
+			ref.libref = "LIB";
+			ref.dataName = "NUMS";
+			for (int i = 0; i < 20; i++) {
+				auto ds = env.getOrCreateDataset(ref);
+				double sum = 0;
+				auto cursor = ds->scan({ "x" });
+				while (cursor.next()) {
+					for (double x : cursor.batch().numbers(0)) sum += x;
+				}
+				if (sum == 500500) good++;
+			}
+		});
+	}
+	for (auto& s : sessions) s.join();
+	EXPECT_EQ(good, 8 * 20);
+
+	removeDirectoryRecursively(folder);
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+class SqlCreateTable : public SasSession {
+protected:
+	void SetUp() override
+	{
+		// id = 1..10, arm alternates, score is missing for id 4
+		addTable(TableBuilder("T", 10)
+			.number("id", [](int i) { return i + 1.0; })
+			.text("arm", [](int i) { return i % 2 ? "DRUG" : "PLACEBO"; })
+			.number("score", [](int i) { return i == 3 ? -INFINITY : double(97 - i * 3); })
+			.build());
+	}
+};
+
+TEST_F(SqlCreateTable, AsSelect)
+{
+	run("proc sql;\n"
+		"   create table drug as select id, arm, score * 2 as twice from t where arm = 'DRUG' order by twice;\n"
+		"quit;\n");
+	auto drug = table("DRUG");
+	ASSERT_NE(drug, nullptr);
+	EXPECT_EQ(drug->var_names, (vector<string>{ "id", "arm", "twice" }));
+	EXPECT_EQ(drug->var_types, (vector<int>{ READSTAT_TYPE_DOUBLE, READSTAT_TYPE_STRING, READSTAT_TYPE_DOUBLE }));
+	EXPECT_EQ(drug->var_length[1], 4);
+	ASSERT_EQ(drug->obs_count, 5);
+	// ordered by score: the missing one first
+	vector<double> ids;
+	for (int r = 0; r < 5; r++) {
+		ids.push_back(get<double>(drug->values[r * 3]));
+	}
+	EXPECT_EQ(ids, (vector<double>{ 4, 10, 8, 6, 2 }));
+	EXPECT_EQ(get<double>(drug->values[2]), -INFINITY);
+	EXPECT_NE(log.str().find("NOTE: Table WORK.DRUG created, with 5 rows and 3 columns."), string::npos);
+	// nothing is listed, and no SQL_RESULT is left behind
+	EXPECT_EQ(lst.str().find("DRUG"), string::npos);
+	EXPECT_FALSE(env.getLibrary("WORK")->hasDataset("SQL_RESULT"));
+
+	// a table can be made from itself
+	run("proc sql; create table drug as select id from drug where id > 5; quit;");
+	EXPECT_EQ(table("DRUG")->obs_count, 3);
+	EXPECT_EQ(table("DRUG")->var_count, 1);
+
+	// and from a query without rows
+	run("proc sql; create table none as select id, arm from t where id > 10; quit;");
+	ASSERT_NE(table("NONE"), nullptr);
+	EXPECT_EQ(table("NONE")->obs_count, 0);
+	EXPECT_EQ(table("NONE")->var_count, 2);
+}
+
+TEST_F(SqlCreateTable, OutObs)
+{
+	run("proc sql outobs=3; create table few as select id from t; quit;");
+	ASSERT_EQ(table("FEW")->obs_count, 3);
+	EXPECT_EQ(get<double>(table("FEW")->values[2]), 3);
+	EXPECT_NE(log.str().find("WARNING: Statement terminated early due to OUTOBS=3 option."), string::npos);
+
+	// exactly as many rows as the query has: no warning
+	log.clear();
+	run("proc sql outobs=10; create table every as select id from t; quit;");
+	EXPECT_EQ(table("EVERY")->obs_count, 10);
+	EXPECT_EQ(log.str().find("OUTOBS"), string::npos);
+}
+
+TEST_F(SqlCreateTable, SelectIsListed)
+{
+	run("proc sql outobs=2; select arm, score from t order by score; quit;");
+	EXPECT_NE(lst.str().find("OBS\tarm\tscore"), string::npos);
+	EXPECT_NE(lst.str().find("1\tDRUG\t."), string::npos);
+	EXPECT_NE(lst.str().find("2\tDRUG\t70.00"), string::npos);
+	EXPECT_EQ(lst.str().find("3\t"), string::npos);
+	EXPECT_NE(log.str().find("OUTOBS=2"), string::npos);
+
+	run("proc sql; select id from t where id > 10; quit;");
+	EXPECT_NE(log.str().find("NOTE: No rows were selected."), string::npos);
+
+	// CREATE TABLE with column definitions makes an empty table
+	run("proc sql; create table empty (a, b); quit;");
+	ASSERT_NE(table("EMPTY"), nullptr);
+	EXPECT_EQ(table("EMPTY")->var_names, (vector<string>{ "a", "b" }));
+	EXPECT_EQ(table("EMPTY")->obs_count, 0);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+TEST(SasDocDeletions, Compact)
+{
+	SasDoc doc;
+	doc.var_count = 2;
+	doc.obs_count = 5;
+	for (int i = 0; i < 5; i++) {
+		doc.values.push_back(double(i));
+		doc.values.push_back(flyweight_string("r" + to_string(i)));
+	}
+	EXPECT_EQ(doc.deletedCount(), 0u);
+	doc.deleteRow(1);
+	doc.deleteRow(3);
+	doc.deleteRow(3);
+	EXPECT_TRUE(doc.isDeleted(3));
+	EXPECT_FALSE(doc.isDeleted(4));
+	EXPECT_EQ(doc.deletedCount(), 2u);
+	// cells stay until compacted
+	EXPECT_EQ(doc.values.size(), 10u);
+
+	doc.compact();
+	EXPECT_EQ(doc.obs_count, 3);
+	EXPECT_EQ(doc.deletedCount(), 0u);
+	ASSERT_EQ(doc.values.size(), 6u);
+	EXPECT_EQ(get<double>(doc.values[2]), 2);
+	EXPECT_EQ(get<flyweight_string>(doc.values[5]).get(), "r4");
+}
+
+class SqlDml : public SasSession {
+protected:
+	shared_ptr<SasDoc> t;
+
+	void SetUp() override
+	{
+		// id = 1..8, grp alternates A/B, x = id * 10
+		t = TableBuilder("T", 8)
+			.number("id", [](int i) { return i + 1.0; })
+			.text("grp", [](int i) { return i % 2 ? "B" : "A"; }, 1)
+			.number("x", [](int i) { return (i + 1) * 10.0; })
+			.build();
+		addTable(t);
+	}
+
+	vector<double> column(const string& name, int c)
+	{
+		auto doc = table(name);
+		vector<double> values;
+		for (int r = 0; r < doc->obs_count; r++) {
+			values.push_back(get<double>(doc->values[r * doc->var_count + c]));
+		}
+		return values;
+	}
+};
+
+TEST_F(SqlDml, Delete)
+{
+	// later statements do not see the deleted rows; QUIT drops them
+	run("proc sql;\n"
+		"   delete from t where id = 2;\n"
+		"   create table rest as select id from t;\n"
+		"quit;\n");
+	EXPECT_NE(log.str().find("NOTE: 1 row was deleted from WORK.T."), string::npos);
+	EXPECT_EQ(column("REST", 0), (vector<double>{ 1, 3, 4, 5, 6, 7, 8 }));
+	EXPECT_EQ(table("T")->obs_count, 7);
+	EXPECT_EQ(table("T")->deletedCount(), 0u);
+
+	run("proc sql; delete from t where grp = 'A'; quit;");
+	EXPECT_NE(log.str().find("NOTE: 4 rows were deleted from WORK.T."), string::npos);
+	EXPECT_EQ(column("T", 0), (vector<double>{ 4, 6, 8 }));
+
+	run("proc sql; delete from t; quit;");
+	EXPECT_EQ(table("T")->obs_count, 0);
+}
+
+TEST_F(SqlDml, Update)
+{
+	run("proc sql;\n"
+		"   update t set x = x + 1, grp = 'CC' where id > 6;\n"
+		"   update t set id = x, x = id where grp = 'A' and id < 4;\n"
+		"quit;\n");
+	EXPECT_NE(log.str().find("NOTE: 2 rows were updated in WORK.T."), string::npos);
+	EXPECT_EQ(column("T", 2), (vector<double>{ 1, 20, 3, 40, 50, 60, 71, 81 }));
+	// SET values come from the row as it was
+	EXPECT_EQ(column("T", 0), (vector<double>{ 10, 2, 30, 4, 5, 6, 7, 8 }));
+	EXPECT_EQ(get<flyweight_string>(t->values[7 * 3 + 1]).get(), "CC");
+	EXPECT_EQ(t->var_length[1], 2);
+
+	run("proc sql; update t set x = 'text'; quit;");
+	EXPECT_NE(log.str().find("Value 1 of the SET clause does not match the data type of column x."), string::npos);
+	run("proc sql; update t set nope = 1; quit;");
+	EXPECT_NE(log.str().find("not found in the contributing tables: nope"), string::npos);
+}
+
+TEST_F(SqlDml, Insert)
+{
+	run("proc sql;\n"
+		"   insert into t values (9, 'A', 90) values (10, 'B', 100);\n"
+		"   insert into t (x, id) values (110, 11);\n"
+		"   insert into t select id + 100, grp, x from t where id <= 2;\n"
+		"quit;\n");
+	EXPECT_NE(log.str().find("NOTE: 2 rows were inserted into WORK.T."), string::npos);
+	EXPECT_NE(log.str().find("NOTE: 1 row was inserted into WORK.T."), string::npos);
+	ASSERT_EQ(t->obs_count, 13);
+	EXPECT_EQ(column("T", 0), (vector<double>{ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 101, 102 }));
+	EXPECT_EQ(get<flyweight_string>(t->values[10 * 3 + 1]).get(), "");
+
+	run("proc sql; insert into t values (1, 2, 3); quit;");
+	EXPECT_NE(log.str().find("Value 2 of VALUES clause 1 does not match the data type of column grp."), string::npos);
+	run("proc sql; insert into t values (1); quit;");
+	EXPECT_NE(log.str().find("VALUES clause 1 has 1 values for 3 columns."), string::npos);
+	EXPECT_EQ(t->obs_count, 13);
+}
+
+TEST_F(SqlDml, CompactsOnceAQuarterIsDeleted)
+{
+	run("proc sql;\n"
+		"   delete from t where id = 1;\n"
+		"   delete from t where id = 2;\n"
+		"   create table seen as select id from t;\n"
+		"   delete from t where id = 3;\n"
+		"quit;\n");
+	EXPECT_EQ(column("SEEN", 0), (vector<double>{ 3, 4, 5, 6, 7, 8 }));
+	EXPECT_EQ(column("T", 0), (vector<double>{ 4, 5, 6, 7, 8 }));
+	EXPECT_EQ(t->deletedCount(), 0u);
+}
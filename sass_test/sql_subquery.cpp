@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "SqlValueSet.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+TEST(SqlValueSet, TypedWithBloomFilter)
+{
+	SqlValueSet values;
+	for (int i = 0; i < 100000; i++) {
+		values.add(double(i * 2));
+	}
+	values.seal();
+	for (int i = 0; i < 1000; i++) {
+		EXPECT_TRUE(values.contains(double(i * 2)));
+		EXPECT_FALSE(values.contains(double(i * 2 + 1)));
+	}
+	EXPECT_TRUE(values.contains(-0.0));
+	// no missing value was added
+	EXPECT_FALSE(values.contains(-INFINITY));
+	EXPECT_FALSE(values.contains(NAN));
+	EXPECT_THROW(values.contains(string("2")), runtime_error);
+
+	SqlValueSet strings;
+	strings.add(string("Y  "));
+	strings.add(string(" "));
+	strings.seal();
+	EXPECT_TRUE(strings.contains(string("Y")));
+	EXPECT_TRUE(strings.contains(string("")));
+	EXPECT_FALSE(strings.contains(string("N")));
+	EXPECT_EQ(strings.size(), 2u);
+}
+
+class SqlSubquery : public SasSession {
+protected:
+	void SetUp() override
+	{
+		const vector<string> subjects = { "S1", "S2", "S3", "" };
+		const vector<string> flags = { "Y", "N", "Y", "N" };
+		addTable(TableBuilder("ADSL", 4)
+			.text("usubjid", [&](int i) { return subjects[i]; })
+			.text("saffl", [&](int i) { return flags[i]; })
+			.build());
+		const vector<string> events = { "S1", "S2", "S3", "S4", "" };
+		const vector<string> terms = { "HEADACHE", "NAUSEA", "RASH", "HEADACHE", "FATIGUE" };
+		const vector<double> seqs = { 1.0, 1.0, 2.0, 1.0, -INFINITY };
+		addTable(TableBuilder("ADAE", 5)
+			.text("usubjid", [&](int i) { return events[i]; })
+			.text("aeterm", [&](int i) { return terms[i]; })
+			.number("aeseq", [&](int i) { return seqs[i]; })
+			.build());
+	}
+
+	// the given column of every row of the result
+	vector<string> select(const string& query, const string& column = "usubjid")
+	{
+		run("proc sql;\ncreate table result as " + query + "\nquit;\n");
+		vector<string> result;
+		auto ds = table("RESULT");
+		if (!ds) {
+			return result;
+		}
+		for (int r = 0; r < ds->getRowCount(); r++) {
+			const Value v = ds->getRow(r).columns.at(column);
+			result.push_back(holds_alternative<string>(v) ? get<string>(v) : to_string(get<double>(v)));
+		}
+		return result;
+	}
+};
+
+TEST_F(SqlSubquery, In)
+{
+	EXPECT_EQ(select("select usubjid, aeterm from adae where usubjid in (select usubjid from adsl where saffl='Y');"),
+		(vector<string>{ "S1", "S3" }));
+	EXPECT_EQ(select("select usubjid from adae where aeterm in ('HEADACHE', 'RASH') and aeseq = 1;"),
+		(vector<string>{ "S1", "S4" }));
+}
+
+TEST_F(SqlSubquery, NotInAndMissingValues)
+{
+	// ADSL has a subject with a missing usubjid: the AE without one is in it
+	EXPECT_EQ(select("select usubjid from adae where usubjid not in (select usubjid from adsl);"),
+		(vector<string>{ "S4" }));
+	EXPECT_EQ(select("select usubjid from adae where usubjid not in (select usubjid from adsl where saffl = 'Y');"),
+		(vector<string>{ "S2", "S4", "" }));
+	EXPECT_EQ(select("select aeterm from adae where aeseq not in (1);", "aeterm"),
+		(vector<string>{ "RASH", "FATIGUE" }));
+}
+
+TEST_F(SqlSubquery, Exists)
+{
+	EXPECT_EQ(select("select usubjid from adae where exists (select usubjid from adsl where saffl = 'Y') and aeseq = 2;"),
+		(vector<string>{ "S3" }));
+	EXPECT_EQ(select("select usubjid from adae where exists (select usubjid from adsl where saffl = 'X');").size(), 0u);
+	EXPECT_EQ(select("select usubjid from adae where not exists (select usubjid from adsl where saffl = 'X') and aeseq = 2;"),
+		(vector<string>{ "S3" }));
+}
+
+TEST_F(SqlSubquery, Errors)
+{
+	select("select usubjid from adae where usubjid in (select usubjid, saffl from adsl);");
+	EXPECT_NE(log.str().find("must return a single column"), string::npos);
+	select("select usubjid from adae where aeseq in (select usubjid from adsl);");
+	EXPECT_NE(log.str().find("different data types"), string::npos);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "StepPipeline.h"
+
+using namespace sass;
+using namespace std;
+
+TEST(StepPipeline, ItemsInProgramOrder)
+{
+	StepPipeline pipeline(make_unique<Lexer>("options linesize=80; proc nosuchproc; title 'after';"), 1);
+	StepPipeline::Item item;
+	ASSERT_TRUE(pipeline.next(item));
+	EXPECT_NE(dynamic_cast<OptionsNode*>(item.statement.get()), nullptr);
+	ASSERT_TRUE(pipeline.next(item));
+	EXPECT_EQ(item.statement, nullptr);
+	EXPECT_NE(item.error.find("nosuchproc"), string::npos);
+	EXPECT_FALSE(item.fatal);
+	ASSERT_TRUE(pipeline.next(item));
+	EXPECT_NE(dynamic_cast<TitleNode*>(item.statement.get()), nullptr);
+	EXPECT_FALSE(pipeline.next(item));
+}
+
+TEST(StepPipeline, StopsWhenNotReadToTheEnd)
+{
+	string code;
+	for (int i = 0; i < 1000; i++) {
+		code += "title 't" + to_string(i) + "';\n";
+	}
+	StepPipeline pipeline(make_unique<Lexer>(code), 2);
+	StepPipeline::Item item;
+	ASSERT_TRUE(pipeline.next(item));
+	// the parser waiting on the full queue is stopped by the destructor
+}
+
+class PipelineSession : public SasSession {};
+
+TEST_F(PipelineSession, ReportsErrorsWhereTheyAre)
+{
+
+	StepPipeline pipeline(make_unique<Lexer>("title 'one'; proc nosuchproc; title 'two'; options linesize=90;"));
+	EXPECT_TRUE(pipeline.run(interpreter));
+	string text = log.str();
+	size_t one = text.find("Title set to: 'one'");
+	size_t error = text.find("Parse error: Unsupported PROC type: nosuchproc");
+	size_t two = text.find("Title set to: 'two'");
+	ASSERT_NE(error, string::npos);
+	EXPECT_LT(one, error);
+	EXPECT_LT(error, two);
+	EXPECT_EQ(env.getOption("LINESIZE"), "90");
+
+	// the statements before a token the lexer cannot read have run
+	StepPipeline stopped(make_unique<Lexer>("options linesize=70; title @;"));
+	EXPECT_FALSE(stopped.run(interpreter));
+	EXPECT_EQ(env.getOption("LINESIZE"), "70");
+	EXPECT_NE(log.str().find("Parsing failed: Unknown character: @"), string::npos);
+}
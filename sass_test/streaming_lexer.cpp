@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "MappedFile.h"
+#include "TempUtils.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace sass;
+using namespace std;
+
+namespace fs = std::filesystem;
+
+static string writeProgram(const string& code)
+{
+	string path = (fs::path(createUniqueTempFolder()) / "program.sas").string();
+	ofstream out(path, ios::binary);
+	out << code;
+	return path;
+}
+
+static const string program =
+	"options linesize=80;\n"
+	"/* a comment */ title 'First \"page\"';\n"
+	"data a;\n\tx = 1.5; y = x * 2;\n\tif x >= 1 then z = 'yes'; else z = 'no';\nrun;\n";
+
+TEST(StreamingLexer, MappedFileTokensMatch)
+{
+	Lexer fromString(program);
+	Lexer fromFile(MappedFile(writeProgram(program)));
+	Token expected, actual;
+	do {
+		expected = fromString.getNextToken();
+		actual = fromFile.getNextToken();
+		EXPECT_EQ(actual.type, expected.type);
+		EXPECT_EQ(actual.text, expected.text);
+		EXPECT_EQ(actual.line, expected.line);
+		EXPECT_EQ(actual.col, expected.col);
+	} while (expected.type != TokenType::EOF_TOKEN);
+}
+
+TEST(StreamingLexer, ParsesOneStatementAtATime)
+{
+	Lexer lexer(MappedFile(writeProgram(program)));
+	Parser parser(lexer);
+	auto first = parser.parseNext();
+	EXPECT_NE(dynamic_cast<OptionsNode*>(first.get()), nullptr);
+	auto second = parser.parseNext();
+	EXPECT_NE(dynamic_cast<TitleNode*>(second.get()), nullptr);
+	auto third = parser.parseNext();
+	auto data = dynamic_cast<DataStepNode*>(third.get());
+	ASSERT_NE(data, nullptr);
+	EXPECT_FALSE(data->statements.empty());
+	EXPECT_EQ(parser.parseNext(), nullptr);
+	EXPECT_EQ(parser.getErrorCount(), 0u);
+}
+
+TEST(StreamingLexer, SkipsStatementsThatFailToParse)
+{
+	Lexer lexer("options linesize=80; proc nosuchproc; title 'after';");
+	Parser parser(lexer);
+	EXPECT_NE(dynamic_cast<OptionsNode*>(parser.parseNext().get()), nullptr);
+	EXPECT_NE(dynamic_cast<TitleNode*>(parser.parseNext().get()), nullptr);
+	EXPECT_EQ(parser.parseNext(), nullptr);
+	EXPECT_EQ(parser.getErrorCount(), 1u);
+}
+
+class StreamingSession : public SasSession {};
+
+TEST_F(StreamingSession, RunsAsParsed)
+{
+
+	Lexer lexer(MappedFile(writeProgram("options linesize=100; title 'Streamed';")));
+	Parser parser(lexer);
+	interpreter.beginProgram();
+	while (auto stmt = parser.parseNext()) {
+		interpreter.executeStatement(stmt.get());
+	}
+	interpreter.endProgram();
+	EXPECT_EQ(env.getOption("LINESIZE"), "100");
+	EXPECT_EQ(env.title, "Streamed");
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "Univariate.h"
+#include <random>
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+// Definition 5 from a full sort, to check the selection against
+static double sortedQuantile(vector<double> values, double p)
+{
+	sort(values.begin(), values.end());
+	double np = values.size() * p / 100;
+	size_t j = (size_t)floor(np);
+	if (np == j) {
+		if (j == 0) return values[0];
+		if (j == values.size()) return values.back();
+		return (values[j - 1] + values[j]) / 2;
+	}
+	return values[j];
+}
+
+TEST(Univariate, QuantilesBySelection)
+{
+	mt19937_64 random(5);
+	normal_distribution<double> normal(10, 3);
+	for (size_t n : { 1, 2, 7, 100, 1001 }) {
+		vector<double> values(n);
+		for (auto& v : values) v = round(normal(random) * 10) / 10;
+		vector<double> percents = { 0, 1, 2.5, 25, 33, 50, 66, 75, 99, 100 };
+		vector<double> work = values;
+		auto q = Univariate::quantiles(work, percents);
+		for (size_t i = 0; i < percents.size(); i++) {
+			EXPECT_EQ(q[i], sortedQuantile(values, percents[i])) << "n=" << n << " p=" << percents[i];
+		}
+	}
+}
+
+TEST(Univariate, Moments)
+{
+	// 1..10 with two missing values in between
+	vector<double> values = { 3, 1, -INFINITY, 10, 2, 9, 4, NAN, 8, 5, 7, 6 };
+	auto stats = Univariate::compute(values, Univariate::defaultPercents(), 3);
+	EXPECT_EQ(stats.n, 10u);
+	EXPECT_EQ(stats.nmiss, 2u);
+	EXPECT_DOUBLE_EQ(stats.mean, 5.5);
+	EXPECT_DOUBLE_EQ(stats.variance, 82.5 / 9);
+	EXPECT_DOUBLE_EQ(stats.uss, 385);
+	EXPECT_NEAR(stats.skewness, 0, 1e-12);
+	EXPECT_NEAR(stats.kurtosis, -1.2, 1e-12);
+	EXPECT_EQ(stats.min, 1);
+	EXPECT_EQ(stats.max, 10);
+
+	ASSERT_EQ(stats.lowest.size(), 3u);
+	EXPECT_EQ(stats.lowest[0].value, 1);
+	EXPECT_EQ(stats.lowest[0].obs, 2u);
+	EXPECT_EQ(stats.lowest[2].value, 3);
+	ASSERT_EQ(stats.highest.size(), 3u);
+	EXPECT_EQ(stats.highest[0].value, 8);
+	EXPECT_EQ(stats.highest[2].value, 10);
+	EXPECT_EQ(stats.highest[2].obs, 4u);
+
+	// 50% is the mean of the 5th and 6th
+	EXPECT_EQ(stats.quantiles[5], 5.5);
+}
+
+TEST(Univariate, ThreadsAgree)
+{
+	mt19937_64 random(9);
+	uniform_real_distribution<double> uniform(-50, 150);
+	vector<double> values(300000);
+	for (auto& v : values) v = uniform(random);
+	values[1234] = -INFINITY;
+
+	vector<double> one = values, four = values;
+	auto a = Univariate::compute(one, { 50 }, 5, 1);
+	auto b = Univariate::compute(four, { 50 }, 5, 4);
+	EXPECT_EQ(a.n, b.n);
+	EXPECT_NEAR(a.mean, b.mean, 1e-9);
+	EXPECT_NEAR(a.variance, b.variance, 1e-6);
+	EXPECT_EQ(a.quantiles, b.quantiles);
+	for (size_t i = 0; i < 5; i++) {
+		EXPECT_EQ(a.lowest[i].obs, b.lowest[i].obs);
+		EXPECT_EQ(a.highest[i].obs, b.highest[i].obs);
+	}
+
+	auto h1 = Univariate::histogram(values, 0, 1);
+	auto h4 = Univariate::histogram(values, 0, 4);
+	EXPECT_EQ(h1.counts, h4.counts);
+	EXPECT_EQ(accumulate(h4.counts.begin(), h4.counts.end(), (size_t)0), values.size() - 1);
+	// round bin edges
+	EXPECT_EQ(h4.width, 10);
+	EXPECT_EQ(h4.start, -50);
+}
+
+class UnivariateSession : public SasSession {};
+
+TEST_F(UnivariateSession, Procedure)
+{
+	string code = "data scores;\n   input x name $;\n   datalines;\n";
+	for (int i = 1; i <= 10; i++) {
+		code += to_string(i) + " n" + to_string(i) + "\n";
+	}
+	run(code + ";\nrun;\n"
+		"proc univariate data=scores nextrobs=2;\n"
+		"   var x;\n"
+		"   histogram x / nbins=2;\n"
+		"   output out=stats mean=avg q3=upper pctlpts=10 90 pctlpre=p_;\n"
+		"run;\n");
+
+	EXPECT_NE(lst.str().find("Quantiles (Definition 5)"), string::npos);
+	EXPECT_NE(lst.str().find("Extreme Observations"), string::npos);
+	EXPECT_NE(lst.str().find("Histogram"), string::npos);
+
+	auto stats = table("STATS");
+	ASSERT_NE(stats, nullptr);
+	EXPECT_EQ(stats->var_names, (vector<string>{ "avg", "upper", "p_10", "p_90" }));
+	EXPECT_EQ(get<double>(stats->values[0]), 5.5);
+	EXPECT_EQ(get<double>(stats->values[1]), 8);
+	EXPECT_EQ(get<double>(stats->values[2]), 1.5);
+	EXPECT_EQ(get<double>(stats->values[3]), 9.5);
+}
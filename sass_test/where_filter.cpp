@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include "fixture.h"
+#include "WhereFilter.h"
+#include <cmath>
+
+using namespace sass;
+using namespace std;
+
+// id = 1..10, grp "A " / "B" alternating, x = id * 10 with row 5 missing
+static shared_ptr<SasDoc> makeTable()
+{
+	return TableBuilder("T", 10)
+		.number("id", [](int i) { return i + 1.0; })
+		.text("grp", [](int i) { return i % 2 ? "B" : "A "; }, 2)
+		.number("x", [](int i) { return i == 4 ? -INFINITY : (i + 1) * 10.0; })
+		.build();
+}
+
+static unique_ptr<ASTNode> binary(unique_ptr<ASTNode> left, const string& op, unique_ptr<ASTNode> right)
+{
+	auto node = make_unique<BinaryOpNode>();
+	node->left = std::move(left);
+	node->op = op;
+	node->right = std::move(right);
+	return node;
+}
+
+static unique_ptr<ASTNode> var(const string& name) { return make_unique<VariableNode>(name); }
+static unique_ptr<ASTNode> num(double value) { return make_unique<NumberNode>(value); }
+static unique_ptr<ASTNode> str(const string& value) { return make_unique<StringNode>(value); }
+
+static vector<size_t> rowsOf(const RowSelection& selection)
+{
+	vector<size_t> rows;
+	for (size_t r = selection.find_first(); r != RowSelection::npos; r = selection.find_next(r)) {
+		rows.push_back(r);
+	}
+	return rows;
+}
+
+TEST(WhereFilter, CompiledComparisons)
+{
+	auto t = makeTable();
+	int rowCalls = 0;
+	auto never = [&](ASTNode*, const ColumnBatch&, size_t) { rowCalls++; return false; };
+
+	// 35 > x is x < 35; the missing x is below every number
+	auto condition = binary(binary(num(35), ">", var("X")), "and", binary(var("grp"), "==", str("A")));
+	EXPECT_EQ(rowsOf(WhereFilter(condition.get(), never).select(*t)), (vector<size_t>{ 0, 2, 4 }));
+
+	condition = binary(binary(var("id"), "<=", num(2)), "or", binary(var("id"), ">=", num(9)));
+	EXPECT_EQ(rowsOf(WhereFilter(condition.get(), never).select(*t)), (vector<size_t>{ 0, 1, 8, 9 }));
+	EXPECT_EQ(rowCalls, 0);
+
+	// deleted rows are never selected
+	t->deleteRow(1);
+	EXPECT_EQ(rowsOf(WhereFilter(condition.get(), never).select(*t)), (vector<size_t>{ 0, 8, 9 }));
+}
+
+TEST(WhereFilter, RowEvaluatedParts)
+{
+	auto t = makeTable();
+	// id + 1 > 8 is not a comparison with a constant: it is evaluated by row,
+	// only for the rows the compiled part has kept
+	auto condition = binary(binary(var("grp"), "==", str("B")), "and", binary(binary(var("id"), "+", num(1)), ">", num(8)));
+	vector<size_t> asked;
+	auto evaluate = [&](ASTNode* part, const ColumnBatch& batch, size_t i) {
+		EXPECT_EQ(part, static_cast<BinaryOpNode*>(condition.get())->right.get());
+		asked.push_back(batch.rowNumber(i));
+		int c = batch.columnIndex("id");
+		return batch.numbers(c)[i] + 1 > 8;
+	};
+	EXPECT_EQ(rowsOf(WhereFilter(condition.get(), evaluate).select(*t)), (vector<size_t>{ 7, 9 }));
+	EXPECT_EQ(asked, (vector<size_t>{ 1, 3, 5, 7, 9 }));
+}
+
+TEST(WhereFilter, ScanThroughSelection)
+{
+	auto t = makeTable();
+	RowSelection selection(10);
+	for (size_t r : { 1, 2, 6, 9 }) selection.set(r);
+
+	vector<size_t> rows;
+	vector<double> ids;
+	auto cursor = t->scan({ "id" }, 3, &selection);
+	while (cursor.next()) {
+		const ColumnBatch& batch = cursor.batch();
+		EXPECT_GT(batch.size(), 0u);
+		for (size_t i = 0; i < batch.size(); i++) {
+			rows.push_back(batch.rowNumber(i));
+			ids.push_back(batch.numbers(0)[i]);
+		}
+	}
+	EXPECT_EQ(rows, (vector<size_t>{ 1, 2, 6, 9 }));
+	EXPECT_EQ(ids, (vector<double>{ 2, 3, 7, 10 }));
+}
+
+class WhereProcs : public SasSession {
+protected:
+	shared_ptr<SasDoc> t;
+
+	void SetUp() override
+	{
+		t = makeTable();
+		addTable(t);
+	}
+};
+
+TEST_F(WhereProcs, Sort)
+{
+	run("proc sort data=t out=sorted; by x; where grp = 'B' and x > 50; run;");
+	auto sorted = table("SORTED");
+	ASSERT_NE(sorted, nullptr);
+	ASSERT_EQ(sorted->obs_count, 3);
+	EXPECT_EQ(get<double>(sorted->values[0]), 6);
+	EXPECT_EQ(get<double>(sorted->values[3]), 8);
+	EXPECT_EQ(get<double>(sorted->values[6]), 10);
+	// the input is untouched and no temporary data set was made
+	EXPECT_EQ(t->obs_count, 10);
+	EXPECT_EQ(t->values.size(), 30u);
+	EXPECT_FALSE(env.getLibrary("WORK")->hasDataset("TEMP_SORT_FILTERED"));
+
+	run("proc sort data=t nodupkey; by grp; where id > 2; run;");
+	auto firsts = table("T");
+	ASSERT_EQ(firsts->obs_count, 2);
+	EXPECT_EQ(get<double>(firsts->values[0]), 3);
+	EXPECT_EQ(get<double>(firsts->values[3]), 4);
+	EXPECT_FALSE(env.getLibrary("WORK")->hasDataset("TEMP_SORT_NODUPKEY"));
+}
+
+TEST_F(WhereProcs, MeansAndFreq)
+{
+	run("proc means data=t n mean; var x; where id in (1, 2, 3) or grp = 'B' and id > 8; run;");
+	EXPECT_NE(log.str().find("N: 4"), string::npos);
+	EXPECT_NE(log.str().find("Mean: 40"), string::npos);
+	EXPECT_FALSE(env.getLibrary("WORK")->hasDataset("TEMP_MEANS_FILTERED"));
+
+	run("proc freq data=t nlevels; tables grp; where x >= 60; run;");
+	EXPECT_NE(log.str().find("A \t2"), string::npos);
+	EXPECT_NE(log.str().find("B\t3"), string::npos);
+	EXPECT_FALSE(env.getLibrary("WORK")->hasDataset("TEMP_FREQ_FILTERED"));
+}